@@ -0,0 +1,129 @@
+#!/bin/sh
+#
+#	raxpol_live.cgi --
+#		Read RaXPol volume parameters from QUERY_STRING. Send rays
+#		from the volume's RaXPol file, and the files that follow it,
+#		as they are written, as a stream of server-sent events.
+#		raxpol_sweep.js draws them on the current sweep image.
+#
+# QUERY_STRING must be
+#	var=value&var=value ...
+# where var is one of:
+#	case_id		usually, but not necessarily, MMDDYY of case
+#	vol_id		volume identifier, YYYYMMDD-HHMMSS
+#	data_type	RaXPol data type, e.g. "DBZ"
+#	start		optional index of first ray. Default is to send only
+#			rays written after the request arrives. Negative
+#			value counts back from the last ray.
+#
+# If the browser is reconnecting, it sends the index of the last ray it
+# received in a Last-Event-ID header, which the web server should put in
+# HTTP_LAST_EVENT_ID. The stream resumes after that ray.
+#
+# On failure, this script responds with status 204, which tells the browser
+# not to reconnect.
+
+set -e
+trap 'if [ "$?" -gt 0 ];then printf "$fail_out";fi' EXIT
+fail_out='Status: 204 No Content\n\n'
+
+# Web server root must have directories cgi-bin, bin, share/raxpol/colors
+# and img. See raxpol_sweep.cgi.
+# mini-httpd launches CGI scripts in cgi-bin directory.
+# Go up one directory to get to server root.
+# Adjust for other web servers.
+cd ..
+root=`pwd`
+
+# Send standard error to a log file.
+log_dir=${root}/log
+log_fl=${log_dir}/raxpol_live.err
+mkdir -p $log_dir
+touch $log_fl
+exec 2>> $log_fl
+
+# Parse query string. Only the variables listed above are set, and values
+# may only have letters, digits, '.', '_', and '-', so that they cannot
+# run commands or name files outside the server root.
+{
+    IFS='&'
+    for asgn in $QUERY_STRING
+    do
+	val=${asgn#*=}
+	case "$val" in
+	    *[!A-Za-z0-9._-]*|*..*)
+		echo "$0: bad value in $asgn" 1>&2
+		exit 1
+		;;
+	esac
+	case "${asgn%%=*}" in
+	    case_id)
+		case_id=$val
+		;;
+	    vol_id)
+		vol_id=$val
+		;;
+	    data_type)
+		data_type=$val
+		;;
+	    start)
+		start=$val
+		;;
+	esac
+    done
+    unset IFS
+}
+if ! test "$vol_id"
+then
+    echo "$0: raxpol volume identifier not set" 1>&2
+    exit 1
+fi
+if ! test "$data_type"
+then
+    echo "$0: raxpol data type not set" 1>&2
+    exit 1
+fi
+case "$HTTP_LAST_EVENT_ID" in
+    ''|*[!0-9]*)
+	;;
+    *)
+	start=`expr $HTTP_LAST_EVENT_ID + 1`
+	;;
+esac
+if test "$start"
+then
+    if ! expr "x$start" : 'x-\{0,1\}[0-9][0-9]*$' > /dev/null
+    then
+	echo "$0: start must be an integer" 1>&2
+	exit 1
+    fi
+    start_opt="-s $start"
+fi
+PATH="${root}/bin:${root}/cgi-bin:${PATH}"
+export PATH
+
+# Identify local directories
+case_img_dir=${root}/img/${case_id}	# img/MMDDYY
+case_vol_list=${case_img_dir}/vol_list	# raxpol_mk_vols output
+color_fl="${root}/share/raxpol/colors/${data_type}.clrs"
+if ! test -f "$color_fl"
+then
+    echo "$0: No color file named $color_fl" 1>&2
+    exit 1
+fi
+
+# raxpol_sweep.awk reads the case volume list. Its output sets raxpol_path,
+# the RaXPol file with the volume. Only files in the volume list can be sent.
+eval `raxpol_sweep.awk -v vol=$vol_id -v swp_angl=default $case_vol_list`
+if ! test "$scan_mode" || ! test -f "$raxpol_path"
+then
+    echo "$0: Could not find RaXPol file for volume $vol_id" 1>&2
+    exit 1
+fi
+
+# raxpol_live keeps running, waiting for new rays, until the browser closes
+# the connection.
+printf 'Content-type: text/event-stream\n'
+printf 'Cache-Control: no-cache\n\n'
+trap - EXIT
+exec raxpol_live $start_opt -m $data_type -c $color_fl $raxpol_path
@@ -0,0 +1,219 @@
+#
+#	raxpol.py --
+#		Read RaXPol moment files into NumPy arrays through
+#		libraxpol. See libraxpol (3).
+#
+#	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+#
+#	Redistribution and use in source and binary forms, with or without
+#	modification, are permitted provided that the following conditions
+#	are met:
+#
+#	    * Redistributions of source code must retain the above copyright
+#	    notice, this list of conditions and the following disclaimer.
+#	    * Redistributions in binary form must reproduce the above copyright
+#	    notice, this list of conditions and the following disclaimer in the
+#	    documentation and/or other materials provided with the distribution.
+#
+#	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+#	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+#	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+#	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+#	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+#	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+#	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+#	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+#	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+#	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+#	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+#	Please send feedback to dev0@trekix.net
+#
+
+"""
+Read RaXPol moment files into NumPy arrays.
+
+Rays and moments are filled in by libraxpol, in C, directly into arrays
+allocated here, so no text is formatted or parsed. Example:
+
+    import raxpol
+    with raxpol.File(["RAXPOL-20140728-180536.dat"]) as f:
+        rays = f.rays(1000, 360)
+        dbz = f.moment("DBZ", 1000, 360)
+
+rays is a structured array with fields tm, az, el, lon, lat, alt,
+sweep_count, volume_count, and scan_type. dbz is a float32 array with one
+row of f.num_gates values per ray.
+
+ray_index maps the ray index sidecar written by raxpol_mk_idx (1) as a
+structured array, without reading the RaXPol file.
+
+The module loads libraxpol.so from RAXPOL_LIB, if set, or else from the
+system library path.
+"""
+
+import ctypes
+import ctypes.util
+import os
+import numpy
+
+RAXPOL_HDL_VERSION = 2
+RAXPOL_HDL_OLD_FMT = 0x01
+
+# Same layout as struct RaXPol_Mom_Ray in raxpol_mom.h
+RAY_DTYPE = numpy.dtype([
+    ("tm", "f8"),
+    ("az", "f8"),
+    ("el", "f8"),
+    ("lon", "f8"),
+    ("lat", "f8"),
+    ("alt", "f8"),
+    ("sweep_count", "i4"),
+    ("volume_count", "i4"),
+    ("scan_type", "i4"),
+], align=True)
+
+# Ray table entry in a ray index. See raxpol_idx.h.
+IDX_MAGIC = b"RXPLIDX"
+IDX_HDR_SZ = 64
+IDX_SFX = ".idx"
+IDX_RAY_FIELDS = [
+    ("tm", "f8"),
+    ("az", "f4"),
+    ("el", "f4"),
+    ("sweep_count", "i4"),
+    ("volume_count", "i4"),
+    ("v_noise_avg", "f4"),
+    ("h_noise_avg", "f4"),
+]
+
+_lib = None
+
+
+def _load():
+    """Load libraxpol and declare the functions used here."""
+    global _lib
+    if _lib:
+        return _lib
+    path = os.environ.get("RAXPOL_LIB") or ctypes.util.find_library("raxpol")
+    if not path:
+        raise OSError("could not find libraxpol. Set RAXPOL_LIB.")
+    lib = ctypes.CDLL(path)
+    hdl = ctypes.c_void_p
+    c_float_p = ctypes.POINTER(ctypes.c_float)
+    lib.RaXPol_Hdl_Version.restype = ctypes.c_int
+    lib.RaXPol_Hdl_Version.argtypes = []
+    if lib.RaXPol_Hdl_Version() != RAXPOL_HDL_VERSION:
+        raise OSError("%s has interface version %d, expected %d"
+                      % (path, lib.RaXPol_Hdl_Version(), RAXPOL_HDL_VERSION))
+    lib.RaXPol_Hdl_Open.restype = hdl
+    lib.RaXPol_Hdl_Open.argtypes = [ctypes.POINTER(ctypes.c_char_p),
+                                    ctypes.c_int, ctypes.c_int]
+    lib.RaXPol_Hdl_Close.restype = None
+    lib.RaXPol_Hdl_Close.argtypes = [hdl]
+    lib.RaXPol_Hdl_Num_Rays.restype = ctypes.c_long
+    lib.RaXPol_Hdl_Num_Rays.argtypes = [hdl]
+    lib.RaXPol_Hdl_Num_Gates.restype = ctypes.c_int
+    lib.RaXPol_Hdl_Num_Gates.argtypes = [hdl]
+    lib.RaXPol_Hdl_Gate_Spacing.restype = ctypes.c_double
+    lib.RaXPol_Hdl_Gate_Spacing.argtypes = [hdl]
+    lib.RaXPol_Hdl_Ray_Hdrs.restype = ctypes.c_int
+    lib.RaXPol_Hdl_Ray_Hdrs.argtypes = [hdl, ctypes.c_long, ctypes.c_long,
+                                        ctypes.c_void_p]
+    lib.RaXPol_Hdl_Moments.restype = ctypes.c_int
+    lib.RaXPol_Hdl_Moments.argtypes = [hdl, ctypes.c_char_p, ctypes.c_long,
+                                       ctypes.c_long, c_float_p,
+                                       ctypes.c_void_p]
+    _lib = lib
+    return lib
+
+
+class File:
+    """A list of RaXPol files, read as one sequence of rays."""
+
+    def __init__(self, paths, old_fmt=False):
+        if isinstance(paths, (str, bytes, os.PathLike)):
+            paths = [paths]
+        lib = _load()
+        nms = [os.fsencode(p) for p in paths]
+        c_nms = (ctypes.c_char_p * len(nms))(*nms)
+        flags = RAXPOL_HDL_OLD_FMT if old_fmt else 0
+        self._hdl = lib.RaXPol_Hdl_Open(c_nms, len(nms), flags)
+        if not self._hdl:
+            raise OSError("could not open RaXPol files %s" % paths)
+        self.num_gates = lib.RaXPol_Hdl_Num_Gates(self._hdl)
+        self.gate_spacing = lib.RaXPol_Hdl_Gate_Spacing(self._hdl)
+
+    @property
+    def num_rays(self):
+        return _lib.RaXPol_Hdl_Num_Rays(self._hdl)
+
+    def _range(self, r0, n):
+        if n is None:
+            n = self.num_rays - r0
+        if r0 < 0 or n < 0 or r0 + n > self.num_rays:
+            raise IndexError("rays %d to %d not in %d rays"
+                             % (r0, r0 + n - 1, self.num_rays))
+        return n
+
+    def rays(self, r0=0, n=None):
+        """Return time and position for n rays from r0, or to the end."""
+        n = self._range(r0, n)
+        rays = numpy.empty(n, dtype=RAY_DTYPE)
+        if not _lib.RaXPol_Hdl_Ray_Hdrs(self._hdl, r0, n, rays.ctypes.data):
+            raise OSError("could not read ray headers")
+        return rays
+
+    def moment(self, mom_nm, r0=0, n=None, rays=False):
+        """
+        Return moment mom_nm for n rays from r0, or to the end, as a
+        float32 array of shape (n, num_gates). If rays is true, return
+        a tuple with the moment and the ray array, as from rays().
+        """
+        n = self._range(r0, n)
+        vals = numpy.empty((n, self.num_gates), dtype=numpy.float32)
+        ray_arr = numpy.empty(n, dtype=RAY_DTYPE) if rays else None
+        ok = _lib.RaXPol_Hdl_Moments(
+            self._hdl, mom_nm.encode(), r0, n,
+            vals.ctypes.data_as(ctypes.POINTER(ctypes.c_float)),
+            ray_arr.ctypes.data if rays else None)
+        if not ok:
+            raise OSError("could not compute %s for rays %d to %d"
+                          % (mom_nm, r0, r0 + n - 1))
+        return (vals, ray_arr) if rays else vals
+
+    def close(self):
+        if self._hdl:
+            _lib.RaXPol_Hdl_Close(self._hdl)
+            self._hdl = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __del__(self):
+        if getattr(self, "_hdl", None):
+            self.close()
+
+
+def ray_index(path):
+    """
+    Map the ray index for RaXPol file path, path + ".idx", as a read only
+    structured array with fields tm, az, el, sweep_count, volume_count,
+    v_noise_avg, and h_noise_avg. az is pedestal azimuth, without the
+    heading correction in rays().
+    """
+    idx_path = path if path.endswith(IDX_SFX) else path + IDX_SFX
+    hdr = numpy.fromfile(idx_path, dtype=numpy.uint8, count=IDX_HDR_SZ)
+    if bytes(hdr[:len(IDX_MAGIC)]) != IDX_MAGIC:
+        raise ValueError("%s is not a RaXPol ray index" % idx_path)
+    if numpy.frombuffer(hdr[8:12], dtype="<i4")[0] == 0x01020304:
+        order = "<"
+    else:
+        order = ">"
+    num_rays = int(numpy.frombuffer(hdr[16:20], dtype=order + "i4")[0])
+    dtype = numpy.dtype([(nm, order + t) for nm, t in IDX_RAY_FIELDS])
+    return numpy.memmap(idx_path, dtype=dtype, mode="r", offset=IDX_HDR_SZ,
+                        shape=(num_rays,))
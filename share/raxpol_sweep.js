@@ -1039,6 +1039,9 @@ window.addEventListener("load", function (evt)
 	    }
 	    HideUpdating();
 	    AddEventListeners();
+	    if ( LiveSrc ) {
+		StartLive();
+	    }
 	}
     }
 
@@ -1100,6 +1103,176 @@ window.addEventListener("load", function (evt)
 	GetImg(vol_id, swp_angl, data_type);
     }
 
+    /*
+       Live updates. Key "r" toggles a stream of server-sent events from
+       raxpol_live.cgi, which sends rays from the current volume's RaXPol
+       file as they are written, with each gate replaced by an index into
+       the color table. Each ray is drawn in the raxpol_live group, on top of
+       the sweep image, with one path for each run of gates with the same
+       color. The group is cleared when a new sweep starts. The browser
+       reconnects by itself if the connection drops, and the stream resumes
+       after the last ray received. See raxpol_live (1).
+     */
+
+    var LiveScript = CGI_Dir + "/raxpol_live.cgi";
+    var LiveSrc = null;			/* EventSource, or null if not live */
+    var LiveGrp = null;			/* Group with live rays */
+    var LiveColors = [];		/* Color names from colors event */
+    var LiveGateLen = 0.0;		/* Gate spacing, m */
+    var LiveSwpCnt = null;		/* Sweep count of previous ray */
+    var LivePrevAngl = null;		/* Azimuth (PPI) or elevation (RHI) of
+					   previous ray, radians */
+    var LiveMaxWidth = 4.0 * RadPerDeg;	/* If rays are farther apart than this,
+					   use LiveDfltWidth */
+    var LiveDfltWidth = 1.0 * RadPerDeg;
+
+    /* Convert Cartesian coordinates to plot (viewBox) coordinates */
+    function CartToPlot(x, y)
+    {
+	var c = GetCart();
+	var vb = PisaPlot.viewBox.baseVal;
+	return {
+	    x : vb.x + (x - c.x_left) * vb.width / (c.x_rght - c.x_left),
+	    y : vb.y + (c.y_top - y) * vb.height / (c.y_top - c.y_btm)
+	};
+    }
+
+    /*
+       Return plot coordinates of point at distance d along beam at angle
+       angl, radians, for scan mode scan_mode. For PPI, angl is azimuth and
+       tilt is elevation. For RHI, angl is elevation. Geometry is the same as
+       in sweep_img, with the default CylEqDist projection centered on the
+       radar for PPI, and the 4/3 earth radius rule for RHI heights.
+     */
+
+    function LiveBeamPt(scan_mode, angl, tilt, d)
+    {
+	var loc = {};
+	var a0, x, y;
+
+	if ( scan_mode == "RHI" ) {
+	    a0 = REarth * 4.0 / 3.0;
+	    y = Math.sqrt(a0 * a0 + 2.0 * a0 * d * Math.sin(angl) + d * d) - a0;
+	    x = REarth * Math.asin(d * Math.cos(angl) / (REarth + y));
+	} else {
+	    GeogStep(RadarLon, RadarLat, angl,
+		    Math.atan(d * Math.cos(tilt) / (REarth + d * Math.sin(tilt))),
+		    loc);
+	    x = (loc.lon - RadarLon) * Math.cos(RadarLat) * REarth;
+	    y = (loc.lat - RadarLat) * REarth;
+	}
+	return CartToPlot(x, y);
+    }
+
+    /* Colors event gives moment, gate count and spacing, and colors */
+    function LiveColorsEvt(evt)
+    {
+	var f = evt.data.split(/\s+/);
+	LiveGateLen = Number(f[2]);
+	LiveColors = f.slice(4);
+    }
+
+    /*
+       Ray event gives ray index, time, azimuth, elevation, sweep count, and
+       color indeces, with runs abbreviated c*n. Index -1 is not drawn.
+     */
+
+    function LiveRayEvt(evt)
+    {
+	var f = evt.data.split(/\s+/);
+	var scan_mode = SwpElems["scan_mode"].textContent;
+	var swpCnt = Number(f[4]);
+	var az = Number(f[2]) * RadPerDeg;
+	var el = Number(f[3]) * RadPerDeg;
+	var angl = (scan_mode == "RHI") ? el : az;
+	var width, da, a0, a1;
+	var ray, path, p00, p01, p11, p10;
+	var t, run, clr, n, g0, d0, d1;
+
+	if ( !LiveGrp || LiveGateLen <= 0.0 ) {
+	    return;
+	}
+	if ( swpCnt !== LiveSwpCnt ) {
+	    while ( LiveGrp.lastChild ) {
+		LiveGrp.removeChild(LiveGrp.lastChild);
+	    }
+	    LiveSwpCnt = swpCnt;
+	    LivePrevAngl = null;
+	}
+	width = LiveDfltWidth;
+	if ( LivePrevAngl !== null ) {
+	    da = Math.abs(angl - LivePrevAngl);
+	    if ( da > Math.PI ) {
+		da = 2.0 * Math.PI - da;
+	    }
+	    if ( da > 0.0 && da < LiveMaxWidth ) {
+		width = da;
+	    }
+	}
+	LivePrevAngl = angl;
+	a0 = angl - 0.5 * width;
+	a1 = angl + 0.5 * width;
+
+	ray = CreateSVGElement("g");
+	ray.setAttribute("id", "raxpol_live_ray_" + f[0]);
+	for (t = 5, g0 = 0; t < f.length; t++, g0 += n) {
+	    run = f[t].split("*");
+	    clr = Number(run[0]);
+	    n = (run.length > 1) ? Number(run[1]) : 1;
+	    if ( clr < 0 || !LiveColors[clr] ) {
+		continue;
+	    }
+	    d0 = g0 * LiveGateLen;
+	    d1 = (g0 + n) * LiveGateLen;
+	    p00 = LiveBeamPt(scan_mode, a0, el, d0);
+	    p01 = LiveBeamPt(scan_mode, a0, el, d1);
+	    p11 = LiveBeamPt(scan_mode, a1, el, d1);
+	    p10 = LiveBeamPt(scan_mode, a1, el, d0);
+	    path = CreateSVGElement("path");
+	    path.setAttribute("d", "M " + p00.x.toFixed(1) + " "
+		    + p00.y.toFixed(1)
+		    + " L " + p01.x.toFixed(1) + " " + p01.y.toFixed(1)
+		    + " L " + p11.x.toFixed(1) + " " + p11.y.toFixed(1)
+		    + " L " + p10.x.toFixed(1) + " " + p10.y.toFixed(1)
+		    + " Z");
+	    path.setAttribute("fill", LiveColors[clr]);
+	    ray.appendChild(path);
+	}
+	LiveGrp.appendChild(ray);
+    }
+
+    function StartLive()
+    {
+	var req_url;
+
+	StopLive();
+	LiveGrp = CreateSVGElement("g");
+	LiveGrp.setAttribute("id", "raxpol_live");
+	PisaPlot.appendChild(LiveGrp);
+	req_url = LiveScript + "?vol_id=" + SwpElems["vol_id"].textContent
+	    + "&data_type=" + SwpElems["data_type"].textContent;
+	if ( SwpElems["case_id"] ) {
+	    req_url += "&case_id=" + SwpElems["case_id"].textContent;
+	}
+	LiveSrc = new EventSource(req_url);
+	LiveSrc.addEventListener("colors", LiveColorsEvt, false);
+	LiveSrc.addEventListener("ray", LiveRayEvt, false);
+    }
+    function StopLive()
+    {
+	if ( LiveSrc ) {
+	    LiveSrc.close();
+	    LiveSrc = null;
+	}
+	if ( LiveGrp ) {
+	    LiveGrp.parentNode.removeChild(LiveGrp);
+	    LiveGrp = null;
+	}
+	LiveColors = [];
+	LiveSwpCnt = null;
+	LivePrevAngl = null;
+    }
+
     /* Create data type selection menu */
     var DataTypeMenu = {
 	svg : CreateSVGElement("svg"),
@@ -1333,6 +1506,17 @@ window.addEventListener("load", function (evt)
 		break;
 	}
     }
+    function LiveKey(evt)
+    {
+	var r = 82;
+	if ( evt.keyCode == r ) {
+	    if ( LiveSrc ) {
+		StopLive();
+	    } else {
+		StartLive();
+	    }
+	}
+    }
     function AddEventListeners() {
 	PisaPlot.addEventListener("mousedown", StartPlotDrag, false);
 	PisaPlot.addEventListener("wheel", ZoomWheel, false);
@@ -1342,6 +1526,7 @@ window.addEventListener("load", function (evt)
 	if ( CGI_Script ) {
 	    window.addEventListener("keydown", BrowseVol, false);
 	    window.addEventListener("keydown", BrowseSweep, false);
+	    window.addEventListener("keydown", LiveKey, false);
 	    SwpElems["sweep_angle_caption"].onclick = ShowSweepAngleMenu;
 	    SwpElems["data_type_caption"].onclick = ShowDataTypeMenu;
 	}
@@ -1356,6 +1541,7 @@ window.addEventListener("load", function (evt)
 	if ( CGI_Script ) {
 	    window.removeEventListener("keydown", BrowseVol, false);
 	    window.removeEventListener("keydown", BrowseSweep, false);
+	    window.removeEventListener("keydown", LiveKey, false);
 	    SwpElems["sweep_angle_caption"].onclick = null;
 	    SwpElems["data_type_caption"].onclick = null;
 	}
@@ -42,11 +42,30 @@
 static int init;
 static void alloc_init(void);
 static void clean(void);
+static int fail_here(char *, int);
+
+/* Arena blocks are at least this big. Allocations from arenas are aligned
+   to ARENA_ALIGN bytes, which suits any scalar or complex type. */
+#define ARENA_BLK_MIN 16384
+#define ARENA_ALIGN 16
+#define ARENA_RND(sz) (((sz) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN)
+
+/* Arena block. Allocations start at ARENA_RND(sizeof(struct Tkx_Arena_Blk))
+   bytes from the start of the block. */
+struct Tkx_Arena_Blk {
+    struct Tkx_Arena_Blk *prev;		/* Previous block, or NULL */
+    size_t sz;				/* Bytes available for allocations */
+    size_t used;			/* Bytes allocated */
+};
+#define ARENA_HDR_SZ ARENA_RND(sizeof(struct Tkx_Arena_Blk))
 
 /* This counter records the number of times an allocator
  * has been called.  It helps to sort output for debugging. */
 static unsigned c;
 
+/* Number of allocations, reallocations, and frees. See Tkx_Alloc_Counts. */
+static unsigned long n_alloc, n_realloc, n_free;
+
 /* Where to send diagnostic output */
 static FILE *diag_out;
 
@@ -97,6 +116,12 @@ void clean()
     }
 }
 
+/* Return true if MEM_FAIL names source file fnm, line ln. */
+static int fail_here(char *fnm, int ln)
+{
+    return fail_fnm && (ln == fail_line) && strcmp(fail_fnm, fnm) == 0;
+}
+
 /* See alloc (3) */
 void *Tkx_Malloc(size_t sz, char *fnm, int ln)
 {
@@ -106,7 +131,8 @@ void *Tkx_Malloc(size_t sz, char *fnm, int ln)
 	alloc_init();
     }
     m = malloc(sz);
-    if (fail_fnm && (ln == fail_line) && strcmp(fail_fnm, fnm) == 0) {
+    n_alloc++;
+    if (fail_here(fnm, ln)) {
 	return NULL;
     }
     if (m && diag_out) {
@@ -123,10 +149,11 @@ void *Tkx_Calloc(size_t n, size_t sz, char *fnm, int ln)
     if ( !init ) {
 	alloc_init();
     }
-    if (fail_fnm && (ln == fail_line) && strcmp(fail_fnm, fnm) == 0) {
+    if (fail_here(fnm, ln)) {
 	return NULL;
     }
     m = calloc(n, sz);
+    n_alloc++;
     if (m && diag_out) {
 	fprintf(diag_out, "%p (%09x) allocated at %s:%d\n", m, ++c, fnm, ln);
     }
@@ -141,10 +168,11 @@ void *Tkx_ReAlloc(void *m, size_t sz, char *fnm, int ln)
     if ( !init ) {
 	alloc_init();
     }
-    if (fail_fnm && (ln == fail_line) && strcmp(fail_fnm, fnm) == 0) {
+    if (fail_here(fnm, ln)) {
 	return NULL;
     }
     m2 = realloc(m, sz);
+    n_realloc++;
     if (m2 && diag_out) {
 	if (m2 != m) {
 	    if (m) {
@@ -170,6 +198,107 @@ void Tkx_Free(void *m, char *fnm, int ln)
     if (diag_out) {
 	fprintf(diag_out, "%p (%09x) freed at %s:%d\n", m, ++c, fnm, ln);
     }
+    if (m) {
+	n_free++;
+    }
     free(m);
 }
 
+/* See alloc (3) */
+void Tkx_Alloc_Counts(unsigned long *n_alloc_p, unsigned long *n_realloc_p,
+	unsigned long *n_free_p)
+{
+    *n_alloc_p = n_alloc;
+    *n_realloc_p = n_realloc;
+    *n_free_p = n_free;
+}
+
+
+/* See alloc (3) */
+void *Tkx_Arena_Alloc(struct Tkx_Arena *a, size_t sz, char *fnm, int ln)
+{
+    struct Tkx_Arena_Blk *blk, *new_blk;
+    size_t blk_sz;
+    void *m;
+
+    if ( !init ) {
+	alloc_init();
+    }
+    if (fail_here(fnm, ln)) {
+	return NULL;
+    }
+    sz = ARENA_RND(sz);
+    blk = a->blk;
+    if ( !blk || blk->sz - blk->used < sz ) {
+	blk_sz = blk ? 2 * blk->sz : ARENA_BLK_MIN;
+	if (blk_sz < sz) {
+	    blk_sz = sz;
+	}
+	if ( !(new_blk = Tkx_Malloc(ARENA_HDR_SZ + blk_sz, fnm, ln)) ) {
+	    return NULL;
+	}
+	new_blk->prev = blk;
+	new_blk->sz = blk_sz;
+	new_blk->used = 0;
+	a->blk = blk = new_blk;
+    }
+    m = (char *)blk + ARENA_HDR_SZ + blk->used;
+    blk->used += sz;
+    return m;
+}
+
+/* See alloc (3) */
+void *Tkx_Arena_Calloc(struct Tkx_Arena *a, size_t n, size_t sz, char *fnm,
+	int ln)
+{
+    void *m;
+
+    if (sz != 0 && n > (size_t)-1 / sz) {
+	return NULL;
+    }
+    if ( (m = Tkx_Arena_Alloc(a, n * sz, fnm, ln)) ) {
+	memset(m, 0, n * sz);
+    }
+    return m;
+}
+
+/* See alloc (3) */
+void Tkx_Arena_Reset(struct Tkx_Arena *a, char *fnm, int ln)
+{
+    struct Tkx_Arena_Blk *blk, *prev;
+    size_t sz;
+
+    if ( !a->blk ) {
+	return;
+    }
+    if ( !a->blk->prev ) {
+	a->blk->used = 0;
+	return;
+    }
+
+    /* Replace the chain with one block big enough for all of it, so that
+       the next cycle of allocations does not call malloc. */
+    for (sz = 0, blk = a->blk; blk; blk = prev) {
+	prev = blk->prev;
+	sz += blk->sz;
+	Tkx_Free(blk, fnm, ln);
+    }
+    if ( (blk = Tkx_Malloc(ARENA_HDR_SZ + sz, fnm, ln)) ) {
+	blk->prev = NULL;
+	blk->sz = sz;
+	blk->used = 0;
+    }
+    a->blk = blk;
+}
+
+/* See alloc (3) */
+void Tkx_Arena_Free(struct Tkx_Arena *a, char *fnm, int ln)
+{
+    struct Tkx_Arena_Blk *blk, *prev;
+
+    for (blk = a->blk; blk; blk = prev) {
+	prev = blk->prev;
+	Tkx_Free(blk, fnm, ln);
+    }
+    a->blk = NULL;
+}
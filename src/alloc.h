@@ -42,9 +42,32 @@
 #define REALLOC(x,s) Tkx_ReAlloc((x), (s), __FILE__, __LINE__)
 #define FREE(x) Tkx_Free((x), __FILE__, __LINE__)
 
+#define ARENA_ALLOC(a,s) Tkx_Arena_Alloc((a), (s), __FILE__, __LINE__)
+#define ARENA_CALLOC(a,n,s) Tkx_Arena_Calloc((a), (n), (s), __FILE__, __LINE__)
+#define ARENA_RESET(a) Tkx_Arena_Reset((a), __FILE__, __LINE__)
+#define ARENA_FREE(a) Tkx_Arena_Free((a), __FILE__, __LINE__)
+
+/*
+   An arena hands out memory from large blocks. Allocations from an arena
+   are not freed individually. Tkx_Arena_Reset makes all of them available
+   again, and Tkx_Arena_Free returns the blocks to the system. See alloc (3).
+   An arena is initialized by setting all members to zero.
+ */
+
+struct Tkx_Arena_Blk;
+struct Tkx_Arena {
+    struct Tkx_Arena_Blk *blk;		/* Current block, linked to earlier
+					   blocks */
+};
+
 void *Tkx_Malloc(size_t, char *, int);
 void *Tkx_Calloc(size_t, size_t, char *, int);
 void *Tkx_ReAlloc(void *, size_t, char *, int);
 void Tkx_Free(void *, char *, int);
+void Tkx_Alloc_Counts(unsigned long *, unsigned long *, unsigned long *);
+void *Tkx_Arena_Alloc(struct Tkx_Arena *, size_t, char *, int);
+void *Tkx_Arena_Calloc(struct Tkx_Arena *, size_t, size_t, char *, int);
+void Tkx_Arena_Reset(struct Tkx_Arena *, char *, int);
+void Tkx_Arena_Free(struct Tkx_Arena *, char *, int);
 
 #endif
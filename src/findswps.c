@@ -42,8 +42,12 @@
 #include <string.h>
 #include <limits.h>
 #include <math.h>
+#include "raxpol.h"
+#include "raxpol_prof.h"
+#include "raxpol_seq.h"
 
 #define FINDSWPS_VERSION "0.1"
+#define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
 
 /* Defaults for angles measured in degrees. Change defaults for other units. */ 
 static double AngResoln = 0.01;		/* Angular resolution. Angles that
@@ -78,38 +82,74 @@ static double MinStep = 0.04;
 #define NUM_SCAN_TYPES 5
 enum SCAN_TYPE {PPI_I, PPI_D, RHI_I, RHI_D, UNK};
 
-/* One ray */
+/*
+   Rays of interest are kept in a ring buffer of parallel arrays. Rays are
+   numbered from 0 in the order they are kept. Ray n is in slot n % Cap.
+   Rays from Ray0, the first ray in the candidate sweep, to NewRay, the last
+   ray read, are available. The ring starts small and doubles when it fills,
+   up to CapMax slots, enough for 2 * 360 degrees worth of rays separated by
+   AngResoln. If the ring is full at CapMax slots, Ray0 moves forward.
+ */
+
 #define LEN 512
-struct ray_hdr {
-    struct ray_hdr *next;		/* Next ray */
-    struct ray_hdr *prev;		/* Previous ray */
-    unsigned long i;			/* Ray index. First ray read and kept
-					   has index 0. */
-    double az;				/* Azimuth, deg, -180.0 <= az < 180.0 */
-    double el;				/* Elevation, deg */
-    double daz;				/* Azimuth increment from previous
+#define NO_RAY -1L			/* No ray, e.g. at end of input */
+#define CAP0 1024			/* Initial number of slots */
+#define SLOT(n) ((n) % Cap)
+static long Cap;			/* Number of slots in ring */
+static long CapMax;			/* Maximum number of slots */
+static double *Az;			/* Azimuth, deg, -180.0 <= az < 180.0 */
+static double *El;			/* Elevation, deg */
+static double *DAz;			/* Azimuth increment from previous
 					   ray */
-    double del;				/* Elevation increment from previous
+static double *DEl;			/* Elevation increment from previous
 					   ray */
-    char ln[LEN];			/* Other header information */
-};
+static unsigned long *LnOff;		/* Offset of input line in text
+					   store, see below */
+static int *LnLen;			/* Length of input line */
+static long *SeqRay;			/* Index of ray in Seq, if reading
+					   RaXPol files */
+static long Ray0 = NO_RAY;		/* First ray in candidate sweep */
+static long NewRay = NO_RAY;		/* Last ray read */
+
+/*
+   Text store. Input lines for rays are copied end to end into Tx. Offsets
+   count from the start of all text stored, so they stay valid when text
+   from before Ray0 is discarded to make room. Tx0 is the offset of Tx[0].
+   TxEnd is the offset after the line for NewRay.
+ */
+
+static char *Tx;
+static size_t TxSz;			/* Allocation at Tx */
+static unsigned long Tx0, TxEnd;
+
+/*
+   If RaXPol files are given on the command line, rays are read from them
+   directly, with no text input. Ray headers are read SEQ_HDRS at a time
+   with RaXPol_Seq_Scan_Hdrs, which skips ray data. Only ray angles and
+   indeces in Seq are kept. Headers for the first and last rays of each
+   sweep are read again and printed as text when the sweep is found.
+ */
 
-/* Rays of interest */
-static unsigned long i_tot;		/* Total number of rays read in */
-static struct ray_hdr *RayHdrs;		/* Array of ray headers under
-					   consideration */
-static struct ray_hdr *Ray0;		/* First ray in candidate sweep */
+#define SEQ_HDRS 1024
+static struct RaXPol_Seq Seq;
+static int FromSeq;			/* If true, read rays from Seq */
+static struct RaXPol_Ray_Hdr *SeqHdrs;	/* Ray headers from last scan */
+static long SeqNumHdrs;			/* Number of headers in SeqHdrs */
+static long SeqHdr;			/* Index in SeqHdrs of next ray */
+static long SeqCurr = NO_RAY;		/* Index in Seq of last ray read */
 
 /* Local functions */
-static void init_ray(struct ray_hdr *);
-static struct ray_hdr *next_after(struct ray_hdr *);
+static void grow(void);
+static char *tx_room(size_t);
+static long next_after(long);
 static int is_ppi(double, double, double, double);
-static int ppi_moves(struct ray_hdr *, double);
+static int ppi_moves(long, double);
 static int is_rhi(double, double, double, double);
-static int rhi_moves(struct ray_hdr *, double);
-static int read_ray(struct ray_hdr *);
-static void print_sweep(enum SCAN_TYPE, double, struct ray_hdr *,
-	struct ray_hdr *);
+static int rhi_moves(long, double);
+static int read_ray(double *, double *, int *);
+static int read_seq_ray(double *, double *, int *);
+static void print_seq_ray(long);
+static void print_sweep(enum SCAN_TYPE, double, long, long);
 static double ang_to_ref(double, double);
 static double diff_az(double, double);
 static double phi(double);
@@ -126,7 +166,7 @@ int main(int argc, char *argv[])
     double swp_angl = NAN;		/* Azimuth of RHI, or elevation of PPI,
 					   obtained as average for all rays in
 					   the sweep */
-    struct ray_hdr *ray1;		/* Last ray in candidate sweep */
+    long ray1;				/* Last ray in candidate sweep */
     enum SCAN_TYPE scan_type = UNK;	/* Scan type for sweep in input */
     int want_ppi = 1;			/* If true, look for PPI scans */
     int want_rhi = 1;			/* If true, look for RHI scans */
@@ -145,12 +185,19 @@ int main(int argc, char *argv[])
 					   non-fixed angle is increasing
 					   throughout the sweep. If dirn < 0.0,
 					   the non-fixed angle is decreasing. */
-    struct ray_hdr *ray;
+    long ray;
     int n;
 
     argv0 = argv[0];
-    while ((c = getopt(argc, argv, ":i:a:r:n:x:v")) != -1) {
+    RaXPol_Prof_Init(argv0);
+    if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
+	RaXPol_Old_Fmt();
+    }
+    while ((c = getopt(argc, argv, ":i:a:r:n:x:lv")) != -1) {
 	switch(c) {
+	    case 'l':
+		RaXPol_Old_Fmt();
+		break;
 	    case 'v':
 		printf("%s %s: ", argv0, FINDSWPS_VERSION);
 		if ( isnan(sweep_ang_req) ) {
@@ -248,15 +295,21 @@ int main(int argc, char *argv[])
 		break;
 	}
     }
-    if ( optind + 1 == argc ) {
-	fprintf(stderr, "Usage: %s [-v] [-i scan_type] [-a sweep_angle] "
-		"[-r resolution]  [-n MinSpanP[,MinSpanR]] [-x max_dev]\n",
-		argv0);
-	exit(EXIT_FAILURE);
+    if ( optind < argc ) {
+	RaXPol_Seq_Init(&Seq);
+	if ( !RaXPol_Seq_Open(&Seq, argv + optind, argc - optind, NULL) ) {
+	    fprintf(stderr, "%s: could not open RaXPol files.\n", argv0);
+	    exit(EXIT_FAILURE);
+	}
+	if ( !(SeqHdrs = calloc(SEQ_HDRS, sizeof(struct RaXPol_Ray_Hdr))) ) {
+	    fprintf(stderr, "%s: could not allocate ray headers.\n", argv0);
+	    exit(EXIT_FAILURE);
+	}
+	FromSeq = 1;
     }
 
     /* Read and process rays */ 
-    for (Ray0 = next_after(NULL); Ray0; ) {
+    for (Ray0 = next_after(NO_RAY); Ray0 != NO_RAY; ) {
 
 	/*
 	   Read rays until end of input, or until antenna traverses at least
@@ -271,18 +324,18 @@ int main(int argc, char *argv[])
 	sum_az = sum2_az = 0.0;
 	mn_az = mn2_az = var_az = mn_el = mn2_el = var_el = NAN;
 	n = 0;
-	ray1 = NULL;
+	ray1 = NO_RAY;
 	for (ray = next_after(Ray0);
-		ray && fabs(daz) < MinSpanP && fabs(del) < MinSpanR;
+		ray != NO_RAY && fabs(daz) < MinSpanP && fabs(del) < MinSpanR;
 		ray = next_after(ray)) {
 	    ray1 = ray;
 	    n++;
-	    daz += ray1->daz;
-	    del += ray1->del;
-	    sum_az += ray1->az;
-	    sum2_az += ray1->az * ray1->az;
-	    sum_el += ray1->el;
-	    sum2_el += ray1->el * ray1->el;
+	    daz += DAz[SLOT(ray1)];
+	    del += DEl[SLOT(ray1)];
+	    sum_az += Az[SLOT(ray1)];
+	    sum2_az += Az[SLOT(ray1)] * Az[SLOT(ray1)];
+	    sum_el += El[SLOT(ray1)];
+	    sum2_el += El[SLOT(ray1)] * El[SLOT(ray1)];
 	}
 	mn_az = sum_az / n;
 	mn2_az = sum2_az / n;
@@ -296,7 +349,7 @@ int main(int argc, char *argv[])
 	   or elevation to comprise a possible sweep.
 	 */
 
-	if ( !ray1 ) {
+	if ( ray1 == NO_RAY ) {
 	    /* Nothing after Ray0 => end of input */
 	    exit(EXIT_SUCCESS);
 	} else if ( want_ppi && is_ppi(daz, mn_el, var_el, sweep_ang_req) ) {
@@ -305,15 +358,15 @@ int main(int argc, char *argv[])
 	    scan_type = ( daz > 0.0 ) ? PPI_I : PPI_D;
 	    dirn = daz;
 	    for (ray = ray1;
-		    ray && ppi_moves(ray, dirn)
+		    ray != NO_RAY && ppi_moves(ray, dirn)
 			&& is_ppi(daz, mn_el, var_el, sweep_ang_req)
 			&& daz <= D360;
 		    ray = next_after(ray)) {
 		ray1 = ray;
 		n++;
-		daz += ray1->daz;
-		sum_el += ray1->el;
-		sum2_el += ray1->el * ray1->el;
+		daz += DAz[SLOT(ray1)];
+		sum_el += El[SLOT(ray1)];
+		sum2_el += El[SLOT(ray1)] * El[SLOT(ray1)];
 		mn_el = sum_el / n;
 		mn2_el = sum2_el / n;
 		var_el = mn2_el - mn_el * mn_el;
@@ -323,8 +376,8 @@ int main(int argc, char *argv[])
 	    for ( ;
 		    Ray0 != ray1
 		    && ( !ppi_moves(Ray0, dirn)
-			|| fabs(Ray0->el - swp_angl) >= MaxStDv );
-		    Ray0 = Ray0->next) {
+			|| fabs(El[SLOT(Ray0)] - swp_angl) >= MaxStDv );
+		    Ray0++) {
 	    }
 
 	    /*
@@ -333,7 +386,7 @@ int main(int argc, char *argv[])
 	     */
 
 	    for (daz = 0.0, ray = Ray0; ray != ray1; ray = next_after(ray)) {
-		daz += ray->daz;
+		daz += DAz[SLOT(ray)];
 	    }
 	    if ( fabs(daz) >= MinSpanP ) {
 		print_sweep(scan_type, swp_angl, Ray0, ray1);
@@ -345,15 +398,15 @@ int main(int argc, char *argv[])
 	    scan_type = ( del > 0.0 ) ? RHI_I : RHI_D;
 	    dirn = del;
 	    for (ray = ray1;
-		    ray && rhi_moves(ray, dirn)
+		    ray != NO_RAY && rhi_moves(ray, dirn)
 		    && is_rhi(del, mn_az, var_az, sweep_ang_req);
 		    ray = next_after(ray)) {
 		ray1 = ray;
 		n++;
-		del += ray1->del;
-		sum_az += ray1->az;
-		sum2_az += ray1->az * ray1->az;
-		sum2_el += ray1->el * ray1->el;
+		del += DEl[SLOT(ray1)];
+		sum_az += Az[SLOT(ray1)];
+		sum2_az += Az[SLOT(ray1)] * Az[SLOT(ray1)];
+		sum2_el += El[SLOT(ray1)] * El[SLOT(ray1)];
 		mn_az = sum_az / n;
 		mn2_az = sum2_az / n;
 		var_az = mn2_az - mn_az * mn_az;
@@ -363,8 +416,8 @@ int main(int argc, char *argv[])
 	    for ( ;
 		    Ray0 != ray1
 		    && ( !rhi_moves(Ray0, dirn)
-			|| fabs(diff_az(Ray0->az, swp_angl)) >= MaxStDv );
-		    Ray0 = Ray0->next) {
+			|| fabs(diff_az(Az[SLOT(Ray0)], swp_angl)) >= MaxStDv );
+		    Ray0++) {
 	    }
 
 	    /*
@@ -373,7 +426,7 @@ int main(int argc, char *argv[])
 	     */
 
 	    for (del = 0.0, ray = Ray0; ray != ray1; ray = next_after(ray)) {
-		del += ray->del;
+		del += DEl[SLOT(ray)];
 	    }
 	    if ( fabs(del) >= MinSpanP ) {
 		print_sweep(scan_type, swp_angl, Ray0, ray1);
@@ -405,14 +458,15 @@ static int is_ppi(double daz, double mn_el, double var_el, double sweep_ang_req)
 }
 
 /* Return true if NStep rays from ray maintain direction and speed */ 
-static int ppi_moves(struct ray_hdr *ray, double dirn)
+static int ppi_moves(long ray, double dirn)
 {
     double daz;
     int n;
-    struct ray_hdr *r;
+    long r;
 
-    for (r = ray, n = 0, daz = 0.0; r && n < NStep; n++, r = next_after(r)) {
-	daz += r->daz;
+    for (r = ray, n = 0, daz = 0.0; r != NO_RAY && n < NStep;
+	    n++, r = next_after(r)) {
+	daz += DAz[SLOT(r)];
     }
     return daz * dirn > 0.0 && fabs(daz) > MinStep;
 }
@@ -435,145 +489,244 @@ static int is_rhi(double del, double mn_az, double var_az, double sweep_ang_req)
 }
 
 /* Return true if NStep rays from ray maintain direction and speed */ 
-static int rhi_moves(struct ray_hdr *ray, double dirn)
+static int rhi_moves(long ray, double dirn)
 {
     double del;
     int n;
-    struct ray_hdr *r;
+    long r;
 
-    for (r = ray, n = 0, del = 0.0; r && n < NStep; n++, r = next_after(r)) {
-	del += r->del;
+    for (r = ray, n = 0, del = 0.0; r != NO_RAY && n < NStep;
+	    n++, r = next_after(r)) {
+	del += DEl[SLOT(r)];
     }
     return del * dirn > 0.0 && fabs(del) > MinStep;
 }
 
-static void init_ray(struct ray_hdr *ray)
+/*
+   Double the number of slots in the ring, up to CapMax. Rays from Ray0 to
+   NewRay move to their slots in the new ring. Exit on failure.
+ */
+
+static void grow(void)
 {
-    ray->i = ULONG_MAX;
-    ray->next = ray->prev = NULL;
-    ray->az = ray->el = ray->daz = ray->del = NAN;
-    memset(ray->ln, '\0', LEN);
-    memset(ray->ln, '\0', LEN);
+    long cap;				/* New number of slots */
+    double *az, *el, *daz, *del;	/* New arrays */
+    unsigned long *ln_off;
+    int *ln_len;
+    long *seq_ray;
+    long n, s;				/* Ray number, new slot */
+
+    if ( Cap == 0 ) {
+	double d = 2 * D360 / AngResoln;
+
+	CapMax = (d < LONG_MAX / 2) ? (long)d : LONG_MAX / 2;
+	if ( CapMax < 2 ) {
+	    CapMax = 2;
+	}
+	cap = (CAP0 < CapMax) ? CAP0 : CapMax;
+    } else {
+	cap = (Cap < CapMax / 2) ? 2 * Cap : CapMax;
+    }
+    az = calloc(cap, sizeof(double));
+    el = calloc(cap, sizeof(double));
+    daz = calloc(cap, sizeof(double));
+    del = calloc(cap, sizeof(double));
+    ln_off = calloc(cap, sizeof(unsigned long));
+    ln_len = calloc(cap, sizeof(int));
+    seq_ray = calloc(cap, sizeof(long));
+    if ( !az || !el || !daz || !del || !ln_off || !ln_len || !seq_ray ) {
+	fprintf(stderr, "%s: could not allocate space for %ld ray "
+		"headers\n", argv0, cap);
+	exit(EXIT_FAILURE);
+    }
+    if ( Ray0 != NO_RAY ) {
+	for (n = Ray0; n <= NewRay; n++) {
+	    s = n % cap;
+	    az[s] = Az[SLOT(n)];
+	    el[s] = El[SLOT(n)];
+	    daz[s] = DAz[SLOT(n)];
+	    del[s] = DEl[SLOT(n)];
+	    ln_off[s] = LnOff[SLOT(n)];
+	    ln_len[s] = LnLen[SLOT(n)];
+	    seq_ray[s] = SeqRay[SLOT(n)];
+	}
+    }
+    free(Az);
+    free(El);
+    free(DAz);
+    free(DEl);
+    free(LnOff);
+    free(LnLen);
+    free(SeqRay);
+    Az = az;
+    El = el;
+    DAz = daz;
+    DEl = del;
+    LnOff = ln_off;
+    LnLen = ln_len;
+    SeqRay = seq_ray;
+    Cap = cap;
 }
 
 /*
-   Return header for the ray after curr_ray, loading it if necessary.
-   If curr_ray == NULL, read the first ray.
-   Ray0 might be reassigned. Return NULL at end of input.
- */ 
+   Return location in text store for a line of len characters at TxEnd.
+   Text for rays before Ray0 is discarded if necessary. Exit on failure.
+ */
 
-static struct ray_hdr *next_after(struct ray_hdr *curr_ray)
+static char *tx_room(size_t len)
 {
-    static size_t num_rays_in;		/* Total number of rays read in */
-    static size_t num_rays_x;		/* Number of rays that can fit
-					   allocation at RayHdrs, hence
-					   also the maximum number of rays in
-					   a sweep */
-    struct ray_hdr *next_ray;		/* Ray after curr_ray */
-
-    if ( !RayHdrs ) {
-	/*
-	   Allocate an array for the ray headers sufficient for 2 * 360 degrees
-	   worth of rays separated by at least AngResoln.
-	 */
-	num_rays_x = 2 * D360 / AngResoln;
-	if ( !(RayHdrs = calloc(num_rays_x, sizeof(struct ray_hdr))) ) {
-	    fprintf(stderr, "%s: could not allocate space for  %zu ray "
-		    "headers\n", argv0, num_rays_x);
+    unsigned long keep;			/* Offset of first text to keep */
+    size_t sz;				/* New allocation size */
+    char *tx;				/* New allocation */
+
+    if ( TxEnd - Tx0 + len > TxSz ) {
+	keep = (Ray0 == NO_RAY) ? TxEnd : LnOff[SLOT(Ray0)];
+	if ( keep > Tx0 ) {
+	    memmove(Tx, Tx + (keep - Tx0), TxEnd - keep);
+	    Tx0 = keep;
+	}
+    }
+    if ( TxEnd - Tx0 + len > TxSz ) {
+	for (sz = (TxSz > 0) ? TxSz : CAP0 * 64;
+		TxEnd - Tx0 + len > sz;
+		sz *= 2) {
+	}
+	if ( !(tx = realloc(Tx, sz)) ) {
+	    fprintf(stderr, "%s: could not allocate %zu bytes for ray "
+		    "text\n", argv0, sz);
 	    exit(EXIT_FAILURE);
 	}
-	Ray0 = RayHdrs;
+	Tx = tx;
+	TxSz = sz;
     }
+    return Tx + (TxEnd - Tx0);
+}
 
-    /* If no curr_ray, assume no rays. Read the first ray and return it. */
-    if ( !curr_ray ) {
-	struct ray_hdr r0, r1, *ray;
-	int n;
+/*
+   Return the ray after ray curr, reading it if necessary. If curr is
+   NO_RAY, read the first ray. Ray0 might be reassigned. Return NO_RAY at
+   end of input.
+ */
+
+static long next_after(long curr)
+{
+    double az, el;			/* Ray azimuth and elevation */
+    double daz, del;			/* Change from curr */
+    int len;				/* Length of input line */
+    long n, s;				/* New ray, its slot */
+
+    if ( Cap == 0 ) {
+	grow();
+    }
+
+    /* If no curr, assume no rays. Read the first ray and return it. */
+    if ( curr == NO_RAY ) {
+	double az0, el0;		/* Location of first ray read */
 
 	/* Read and discard rays until antenna moves. */
-	init_ray(&r0);
-	init_ray(&r1);
-	if ( !read_ray(&r0) ) {
+	az0 = el0 = NAN;
+	if ( !read_ray(&az0, &el0, &len) ) {
 	    fprintf(stderr, "%s: failed to read first ray.\n", argv0);
 	    exit(EXIT_FAILURE);
 	}
-	r0.i = i_tot++;
-	r0.az = ang_to_ref(r0.az, D180);
-	r0.el = phi(r0.el);
+	az0 = ang_to_ref(az0, D180);
+	el0 = phi(el0);
+	az = el = NAN;
+	len = 0;
 	do {
-	    if ( !read_ray(&r1) ) {
+	    if ( !read_ray(&az, &el, &len) ) {
 		fprintf(stderr, "%s: failed to read second ray.\n", argv0);
 		exit(EXIT_FAILURE);
 	    }
-	    r1.i = i_tot++;
-	    r1.az = ang_to_ref(r1.az, D180);
-	    r1.el = phi(r1.el);
-	    r1.daz = diff_az(r1.az, r0.az);
-	    r1.del = r1.el - r0.el;
-	    r1.prev = &r0;
-	} while ( fabs(r1.daz) < AngResoln && fabs(r1.del) < AngResoln );
-	*Ray0 = r1; /* Ray0->daz and Ray0->del are now defined. */
+	    az = ang_to_ref(az, D180);
+	    el = phi(el);
+	    daz = diff_az(az, az0);
+	    del = el - el0;
+	} while ( fabs(daz) < AngResoln && fabs(del) < AngResoln );
+	Ray0 = NewRay = 0;
+	Az[0] = az;
+	El[0] = el;
+	DAz[0] = daz;
+	DEl[0] = del;
+	LnOff[0] = TxEnd;
+	LnLen[0] = len;
+	SeqRay[0] = SeqCurr;
+	TxEnd += len;
 
 	/* Read NStep rays for initial antenna motion */ 
-	for (ray = Ray0, n = 0; ray && n < NStep; n++) {
-	    ray = next_after(ray);
+	for (curr = Ray0, n = 0; curr != NO_RAY && n < NStep; n++) {
+	    curr = next_after(curr);
 	}
 
 	return Ray0;
     }
 
-    if ( !curr_ray->next ) {
-
-	/*
-	   Set next_ray to the next available slot in RayHdrs. The RayHdrs
-	   array rolls. If next_ray would be after the end of the allocation
-	   at RayHdrs, set next_ray to start of RayHdrs. If next_ray collides
-	   with Ray0, set Ray0 to subsequent ray. next_ray then clobbers the
-	   previous Ray0, making it unavailable for the current sweep. This
-	   will not be a problem if num_rays_x is large enough.
-	 */
+    if ( curr < NewRay ) {
+	return curr + 1;
+    }
 
-	next_ray = RayHdrs + (num_rays_in + 1) % num_rays_x;
-	if ( next_ray == Ray0 ) {
-	    Ray0 = Ray0->next;
+    /*
+       Ray after NewRay goes in the next slot. If that is Ray0's slot, make
+       the ring bigger, or, if it cannot grow, move Ray0 to the subsequent
+       ray, making the previous Ray0 unavailable for the current sweep. This
+       will not be a problem if CapMax is large enough.
+     */
+
+    n = NewRay + 1;
+    if ( n - Ray0 >= Cap ) {
+	if ( Cap < CapMax ) {
+	    grow();
+	} else {
+	    Ray0++;
 	}
+    }
 
-	/*
-	   Read and discard rays until the antenna moves more than AngResoln.
-	   Assign the next distinct ray to next_ray. Update links.
-	 */ 
+    /*
+       Read and discard rays until the antenna moves more than AngResoln.
+       Assign the next distinct ray to slot for n.
+     */ 
 
-	init_ray(next_ray);
-	do {
-	    if ( !read_ray(next_ray) ) {
-		return NULL;
-	    }
-	    next_ray->i = i_tot++;
-	    next_ray->az = ang_to_ref(next_ray->az, D180);
-	    next_ray->el = phi(next_ray->el);
-	    next_ray->daz = diff_az(next_ray->az, curr_ray->az);
-	    next_ray->del = next_ray->el - curr_ray->el;
-	} while ( fabs(next_ray->daz) < AngResoln
-		&& fabs(next_ray->del) < AngResoln );
-
-	num_rays_in++;
-	next_ray->prev = curr_ray;
-	curr_ray->next = next_ray;
-    }
-    return curr_ray->next;
+    az = el = NAN;
+    len = 0;
+    do {
+	if ( !read_ray(&az, &el, &len) ) {
+	    return NO_RAY;
+	}
+	az = ang_to_ref(az, D180);
+	el = phi(el);
+	daz = diff_az(az, Az[SLOT(curr)]);
+	del = el - El[SLOT(curr)];
+    } while ( fabs(daz) < AngResoln && fabs(del) < AngResoln );
+
+    s = SLOT(n);
+    Az[s] = az;
+    El[s] = el;
+    DAz[s] = daz;
+    DEl[s] = del;
+    LnOff[s] = TxEnd;
+    LnLen[s] = len;
+    SeqRay[s] = SeqCurr;
+    TxEnd += len;
+    NewRay = n;
+    return n;
 }
 
 /*
    Read a line from standard input. Exit on failure. Return 0 on eof. If line
-   is a ray, store line, azimuth, and elevation into ray_hdr at ray. If not,
-   pass line to standard output.
+   is a ray, store azimuth and elevation at az_p and el_p, copy the line to
+   the text store at TxEnd, and store its length at len_p. If not, pass line
+   to standard output.
  */
 
-static int read_ray(struct ray_hdr *ray)
+static int read_ray(double *az_p, double *el_p, int *len_p)
 {
     char ln[LEN];
     double az, el;
+    size_t len;
 
+    if ( FromSeq ) {
+	return read_seq_ray(az_p, el_p, len_p);
+    }
     if ( !fgets(ln, LEN, stdin) ) {
 	if ( ferror(stdin) ) {
 	    fprintf(stderr, "%s: failed to read ray.\n", argv0);
@@ -583,9 +736,11 @@ static int read_ray(struct ray_hdr *ray)
 	}
     }
     if ( sscanf(ln, " Ray %lf %lf", &az, &el) == 2 ) {
-	strcpy(ray->ln, ln);
-	ray->az = az;
-	ray->el = el;
+	len = strlen(ln);
+	memcpy(tx_room(len), ln, len);
+	*len_p = len;
+	*az_p = az;
+	*el_p = el;
 	return 1;
     } else {
 	fputs(ln, stdout);
@@ -599,11 +754,11 @@ static int read_ray(struct ray_hdr *ray)
  */ 
 
 static void print_sweep(enum SCAN_TYPE scan_type, double swp_angl,
-	struct ray_hdr *r0, struct ray_hdr *r1)
+	long r0, long r1)
 {
     static long swp_idx;
 
-    if ( !r0 || !r1 || r0 == r1 ) {
+    if ( r0 == NO_RAY || r1 == NO_RAY || r0 == r1 ) {
 	return;
     }
     /* Print sweep information */
@@ -624,8 +779,68 @@ static void print_sweep(enum SCAN_TYPE scan_type, double swp_angl,
 	case UNK:
 	    break;
     }
-    printf("%s", r0->ln);
-    printf("%s", r1->ln);
+    if ( FromSeq ) {
+	print_seq_ray(SeqRay[SLOT(r0)]);
+	print_seq_ray(SeqRay[SLOT(r1)]);
+    } else {
+	fwrite(Tx + (LnOff[SLOT(r0)] - Tx0), 1, LnLen[SLOT(r0)], stdout);
+	fwrite(Tx + (LnOff[SLOT(r1)] - Tx0), 1, LnLen[SLOT(r1)], stdout);
+    }
+}
+
+/*
+   Get the next ray header from Seq, reading more headers if necessary. Exit
+   on failure. Return 0 at end of input. Otherwise, store azimuth and
+   elevation at az_p and el_p, and 0 at len_p, since no text is stored.
+   SeqCurr is the index of the ray.
+ */
+
+static int read_seq_ray(double *az_p, double *el_p, int *len_p)
+{
+    struct RaXPol_Ray_Hdr *ray_hdr_p;
+
+    if ( SeqHdr == SeqNumHdrs ) {
+	if ( Seq.r >= Seq.num_rays ) {
+	    return 0;
+	}
+	if ( (SeqNumHdrs = RaXPol_Seq_Scan_Hdrs(&Seq, 1, SeqHdrs, SEQ_HDRS))
+		< 1 ) {
+	    fprintf(stderr, "%s: failed to read ray headers for ray %ld and "
+		    "after.\n", argv0, SeqCurr + 1);
+	    exit(EXIT_FAILURE);
+	}
+	SeqHdr = 0;
+    }
+    ray_hdr_p = SeqHdrs + SeqHdr++;
+    SeqCurr++;
+    *az_p = RaXPol_Ray_Az(ray_hdr_p);
+    *el_p = ray_hdr_p->el;
+    *len_p = 0;
+    return 1;
+}
+
+/*
+   Print the line that raxpol_mk_vols would give findswps for ray r of
+   Seq, i.e. the ray azimuth and elevation, followed by output from
+   raxpol_ray_hdrs -a. Return to the current position in Seq afterward.
+   Exit on failure.
+ */
+
+static void print_seq_ray(long r)
+{
+    long r_nxt = Seq.r;			/* Next ray to read */
+    struct RaXPol_Ray_Hdr ray_hdr;
+
+    if ( !RaXPol_Seq_Seek(&Seq, r)
+	    || !RaXPol_Seq_Read_Ray_Hdr(&Seq, &ray_hdr)
+	    || !RaXPol_Seq_Seek(&Seq, r_nxt) ) {
+	fprintf(stderr, "%s: failed to read ray header for ray %ld.\n",
+		argv0, r);
+	exit(EXIT_FAILURE);
+    }
+    printf("Ray %.2lf %.2lf ray %-9ld ",
+	    RaXPol_Ray_Az(&ray_hdr), ray_hdr.el, r);
+    RaXPol_FPrint_Abbrv_Ray_Hdr(&ray_hdr, stdout);
 }
 
 /* Put angle l into the interval [r - 180, r + 180) */ 
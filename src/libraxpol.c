@@ -0,0 +1,382 @@
+/*
+   -	libraxpol.c --
+   -		This file defines functions that give other programs
+   -		access to RaXPol files. See libraxpol.h.
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "alloc.h"
+#include "geog_lib.h"
+#include "raxpol.h"
+#include "raxpol_mom.h"
+#include "raxpol_prof.h"
+#include "raxpol_seq.h"
+#include "libraxpol.h"
+
+/* Refraction adjustment to Earth radius for beam height, 4/3 rule */
+#define REFRAC (4.0 / 3.0)
+
+struct RaXPol_Hdl {
+    struct RaXPol_Seq seq;		/* Rays from all files */
+    struct RaXPol_Data dat;		/* Data for current ray */
+    struct RaXPol_Mom_Ray ray;		/* Time and position of current ray */
+    int have_ray;			/* If true, dat and ray have the ray
+					   most recently read */
+    int hdrs_only;			/* If true, rays were last read without
+					   data, so noise averages in dat must
+					   be restored before reading data */
+};
+
+typedef int (*calc_t)(struct RaXPol_Data *, float *);
+static calc_t mom_calc(struct RaXPol_Data *, const char *);
+
+/* Return version of the interface in libraxpol.h this library provides */
+int RaXPol_Hdl_Version(void)
+{
+    return RAXPOL_HDL_VERSION;
+}
+
+/*
+   Open the num_fls RaXPol files named in fl_nms as one sequence of rays.
+   flags is 0, or a bitwise or of RAXPOL_HDL_* flags from libraxpol.h.
+   RAXPOL_HDL_OLD_FMT applies only to this handle.
+   On success, the handle is positioned at ray 0.
+
+   Returns a handle, which should eventually be given to RaXPol_Hdl_Close, or
+   NULL on failure. Prints error messages to stderr on failure.
+ */
+
+struct RaXPol_Hdl *RaXPol_Hdl_Open(char **fl_nms, int num_fls, int flags)
+{
+    struct RaXPol_Hdl *hdl;
+
+    if ( !(hdl = MALLOC(sizeof(struct RaXPol_Hdl))) ) {
+	fprintf(stderr, "Could not allocate RaXPol handle.\n");
+	return NULL;
+    }
+    RaXPol_Seq_Init(&hdl->seq);
+    if ( flags & RAXPOL_HDL_OLD_FMT ) {
+	RaXPol_Seq_Old_Fmt(&hdl->seq);
+    }
+    if ( flags & RAXPOL_HDL_FOLLOW ) {
+	RaXPol_Seq_Follow(&hdl->seq);
+    }
+    if ( !RaXPol_Seq_Open(&hdl->seq, fl_nms, num_fls, &hdl->dat) ) {
+	fprintf(stderr, "Could not open RaXPol files for handle.\n");
+	RaXPol_Seq_Free(&hdl->seq);
+	FREE(hdl);
+	return NULL;
+    }
+    hdl->have_ray = 0;
+    hdl->hdrs_only = 0;
+    return hdl;
+}
+
+/* Close files and free memory associated with hdl. */
+void RaXPol_Hdl_Close(struct RaXPol_Hdl *hdl)
+{
+    if ( !hdl ) {
+	return;
+    }
+    RaXPol_Seq_Free(&hdl->seq);
+    RaXPol_Free_Data(&hdl->dat);
+    FREE(hdl);
+}
+
+/*
+   Return number of rays in the files of hdl. In follow mode, this increases
+   as rays are read from files still being written.
+ */
+
+long RaXPol_Hdl_Num_Rays(struct RaXPol_Hdl *hdl)
+{
+    return hdl->seq.num_rays;
+}
+
+/* Return number of range gates in each ray */
+int RaXPol_Hdl_Num_Gates(struct RaXPol_Hdl *hdl)
+{
+    return hdl->seq.file_hdr.num_rng_gates;
+}
+
+/* Return range gate spacing, meters */
+double RaXPol_Hdl_Gate_Spacing(struct RaXPol_Hdl *hdl)
+{
+    return hdl->seq.file_hdr.range_gate_spacing;
+}
+
+/* Return file header from the first file of hdl */
+const struct RaXPol_File_Hdr *RaXPol_Hdl_File_Hdr(struct RaXPol_Hdl *hdl)
+{
+    return &hdl->seq.file_hdr;
+}
+
+/*
+   Position hdl so that the next ray read is ray r. r may be the number of
+   rays, for end of sequence.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Hdl_Seek(struct RaXPol_Hdl *hdl, long r)
+{
+    hdl->have_ray = 0;
+    hdl->hdrs_only = 0;
+    return RaXPol_Seq_Seek(&hdl->seq, r);
+}
+
+/*
+   Read the next ray from hdl, which becomes the current ray for
+   RaXPol_Hdl_Moment and RaXPol_Hdl_Gate_Loc. If ray_p is not NULL, copy ray
+   time and position to it.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure,
+   except at the end of the sequence when not in follow mode, which is a
+   silent failure.
+ */
+
+int RaXPol_Hdl_Read_Ray(struct RaXPol_Hdl *hdl, struct RaXPol_Mom_Ray *ray_p)
+{
+    hdl->have_ray = 0;
+    if ( !hdl->seq.follow && hdl->seq.r >= hdl->seq.num_rays ) {
+	return 0;
+    }
+    if ( hdl->hdrs_only && !RaXPol_Hdl_Seek(hdl, hdl->seq.r) ) {
+	return 0;
+    }
+    if ( !RaXPol_Seq_Read_Ray(&hdl->seq) ) {
+	fprintf(stderr, "Could not read ray %ld.\n", hdl->seq.r);
+	return 0;
+    }
+    RaXPol_Mom_Set_Ray(&hdl->ray, &hdl->dat.ray_hdr);
+    hdl->have_ray = 1;
+    if ( ray_p ) {
+	*ray_p = hdl->ray;
+    }
+    return 1;
+}
+
+/*
+   Compute moment mom_nm, e.g. "DBZ", for the current ray of hdl, and store
+   it in vals, which must have space for RaXPol_Hdl_Num_Gates values.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Hdl_Moment(struct RaXPol_Hdl *hdl, const char *mom_nm, float *vals)
+{
+    calc_t calc;
+    double t0;				/* Profile start time */
+
+    if ( !hdl->have_ray ) {
+	fprintf(stderr, "No ray read for %s.\n", mom_nm);
+	return 0;
+    }
+    if ( !(calc = mom_calc(&hdl->dat, mom_nm)) ) {
+	fprintf(stderr, "Unknown moment %s.\n", mom_nm);
+	return 0;
+    }
+    t0 = RaXPol_Prof_Start();
+    if ( !calc(&hdl->dat, vals) ) {
+	fprintf(stderr, "Could not compute %s for ray %ld.\n",
+		mom_nm, hdl->seq.r - 1);
+	return 0;
+    }
+    RaXPol_Prof_Mom(mom_nm, t0, hdl->seq.file_hdr.num_rng_gates);
+    return 1;
+}
+
+/*
+   Compute location of the center of range gate g of the current ray of hdl.
+   Gate g covers ranges g through g + 1 times the range gate spacing, as in
+   sweep_img. Longitude and latitude, in degrees, go to lon_p and lat_p.
+   Height above sea level, meters, goes to hgt_p. Beam height uses the 4/3
+   Earth radius rule for refraction. Earth radius is GeogREarth(NULL).
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Hdl_Gate_Loc(struct RaXPol_Hdl *hdl, int g, double *lon_p,
+	double *lat_p, double *hgt_p)
+{
+    double rearth;			/* Earth radius, meters */
+    double reff;			/* Effective Earth radius for beam */
+    double rng;				/* Distance along beam, meters */
+    double el;				/* Elevation, radians */
+    double ht;				/* Beam height above radar, meters */
+    double s;				/* Ground distance, radians */
+    double lon, lat;			/* Gate location, radians */
+
+    if ( !hdl->have_ray ) {
+	fprintf(stderr, "No ray read for gate location.\n");
+	return 0;
+    }
+    if ( g < 0 || g >= hdl->seq.file_hdr.num_rng_gates ) {
+	fprintf(stderr, "Gate index %d out of range.\n", g);
+	return 0;
+    }
+    rearth = GeogREarth(NULL);
+    reff = REFRAC * rearth;
+    rng = (g + 0.5) * hdl->seq.file_hdr.range_gate_spacing;
+    el = hdl->ray.el * RAD_DEG;
+    ht = GeogBeamHt(rng, el, reff);
+    s = reff * asin(rng * cos(el) / (reff + ht)) / rearth;
+    GeogStep(hdl->ray.lon * RAD_DEG, hdl->ray.lat * RAD_DEG,
+	    hdl->ray.az * RAD_DEG, s, &lon, &lat);
+    *lon_p = lon * DEG_RAD;
+    *lat_p = lat * DEG_RAD;
+    *hgt_p = hdl->ray.alt + ht;
+    return 1;
+}
+
+/*
+   Store time and position for num_rays rays of hdl, starting at ray r0, in
+   rays, which must have space for num_rays elements. Only ray headers are
+   read. Afterward, the next ray read is r0 + num_rays, and there is no
+   current ray.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Hdl_Ray_Hdrs(struct RaXPol_Hdl *hdl, long r0, long num_rays,
+	struct RaXPol_Mom_Ray *rays)
+{
+    struct RaXPol_Ray_Hdr ray_hdr;
+    long r;
+    int status;
+
+    if ( r0 < 0 || num_rays < 0 || r0 + num_rays > hdl->seq.num_rays ) {
+	fprintf(stderr, "Rays %ld to %ld out of range. Sequence has %ld "
+		"rays.\n", r0, r0 + num_rays - 1, hdl->seq.num_rays);
+	return 0;
+    }
+    hdl->have_ray = 0;
+    hdl->hdrs_only = 1;
+
+    /*
+       Without ray data, the sequence seeks without restoring noise averages,
+       which would mean reading the file up to r0 if there is no ray index.
+     */
+
+    if ( hdl->seq.r != r0 ) {
+	hdl->seq.dat_p = NULL;
+	status = RaXPol_Seq_Seek(&hdl->seq, r0);
+	hdl->seq.dat_p = &hdl->dat;
+	if ( !status ) {
+	    return 0;
+	}
+    }
+    for (r = 0; r < num_rays; r++) {
+	if ( !RaXPol_Seq_Read_Ray_Hdr(&hdl->seq, &ray_hdr) ) {
+	    return 0;
+	}
+	RaXPol_Mom_Set_Ray(rays + r, &ray_hdr);
+    }
+    return 1;
+}
+
+/*
+   Compute moment mom_nm for num_rays rays of hdl, starting at ray r0, and
+   store the values in vals, which must have space for num_rays times
+   RaXPol_Hdl_Num_Gates values, ray by ray. If rays is not NULL, store ray
+   time and position there, as RaXPol_Hdl_Read_Ray would. Afterward, the last
+   ray is the current ray.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Hdl_Moments(struct RaXPol_Hdl *hdl, const char *mom_nm, long r0,
+	long num_rays, float *vals, struct RaXPol_Mom_Ray *rays)
+{
+    int num_gates = hdl->seq.file_hdr.num_rng_gates;
+    calc_t calc;
+    long r;
+    double t0;				/* Profile start time */
+
+    if ( !(calc = mom_calc(&hdl->dat, mom_nm)) ) {
+	fprintf(stderr, "Unknown moment %s.\n", mom_nm);
+	return 0;
+    }
+    if ( r0 < 0 || num_rays < 0 || r0 + num_rays > hdl->seq.num_rays ) {
+	fprintf(stderr, "Rays %ld to %ld out of range. Sequence has %ld "
+		"rays.\n", r0, r0 + num_rays - 1, hdl->seq.num_rays);
+	return 0;
+    }
+    if ( (hdl->seq.r != r0 || hdl->hdrs_only)
+	    && !RaXPol_Hdl_Seek(hdl, r0) ) {
+	return 0;
+    }
+    for (r = 0; r < num_rays; r++) {
+	if ( !RaXPol_Hdl_Read_Ray(hdl, rays ? rays + r : NULL) ) {
+	    return 0;
+	}
+	t0 = RaXPol_Prof_Start();
+	if ( !calc(&hdl->dat, vals + r * num_gates) ) {
+	    fprintf(stderr, "Could not compute %s for ray %ld.\n",
+		    mom_nm, r0 + r);
+	    return 0;
+	}
+	RaXPol_Prof_Mom(mom_nm, t0, num_gates);
+    }
+    return 1;
+}
+
+/* Return function that computes moment mom_nm, or NULL if unknown. */
+static calc_t mom_calc(struct RaXPol_Data *dat_p, const char *mom_nm)
+{
+    if ( strcmp(mom_nm, "DBMHC") == 0 ) {
+	return dat_p->dbmhc;
+    } else if ( strcmp(mom_nm, "DBMVC") == 0 ) {
+	return dat_p->dbmvc;
+    } else if ( strcmp(mom_nm, "DBZ") == 0 ) {
+	return dat_p->dbz;
+    } else if ( strcmp(mom_nm, "DBZ1") == 0 ) {
+	return dat_p->dbz1;
+    } else if ( strcmp(mom_nm, "VEL") == 0 ) {
+	return dat_p->vel;
+    } else if ( strcmp(mom_nm, "ZDR") == 0 ) {
+	return dat_p->zdr;
+    } else if ( strcmp(mom_nm, "PHIDP") == 0 ) {
+	return dat_p->phidp;
+    } else if ( strcmp(mom_nm, "RHOHV") == 0 ) {
+	return dat_p->rhohv;
+    } else if ( strcmp(mom_nm, "STD") == 0 ) {
+	return dat_p->std;
+    } else if ( strcmp(mom_nm, "SNRHC") == 0 ) {
+	return dat_p->snrhc;
+    } else if ( strcmp(mom_nm, "SNRVC") == 0 ) {
+	return dat_p->snrvc;
+    }
+    return NULL;
+}
@@ -0,0 +1,86 @@
+/*
+   -	libraxpol.h --
+   -		This header file declares the interface to libraxpol,
+   -		a library that reads RaXPol files for other programs.
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+/*
+   libraxpol gives programs access to RaXPol files through a handle,
+   struct RaXPol_Hdl, whose contents are private to the library. A handle
+   reads an ordered list of RaXPol files as one sequence of rays, as
+   described in raxpol_seq.h. For each ray read, the caller can obtain the
+   ray time and position, compute any moment into its own array, and locate
+   range gates.
+
+   RaXPol_Hdl_Ray_Hdrs and RaXPol_Hdl_Moments fill caller arrays for a
+   range of rays in one call, for callers, such as the Python module in
+   python/raxpol.py, for which a call per ray is expensive.
+
+   Programs should check RaXPol_Hdl_Version against RAXPOL_HDL_VERSION.
+   RAXPOL_HDL_VERSION changes, along with the major number of the shared
+   library, only when a function declared here, or a structure it uses,
+   changes in a way that would break existing callers. The shared library
+   exports only the functions declared here. raxpol.h and raxpol_mom.h are
+   installed for their structures. Their functions are internal.
+ */
+
+#ifndef LIBRAXPOL_H_
+#define LIBRAXPOL_H_
+
+#include "raxpol.h"
+#include "raxpol_mom.h"
+
+#define RAXPOL_HDL_VERSION 2
+
+/* Flags for RaXPol_Hdl_Open */
+#define RAXPOL_HDL_OLD_FMT 0x01		/* Files are old (2011) format */
+#define RAXPOL_HDL_FOLLOW 0x02		/* Wait for files being written. See
+					   RaXPol_Seq_Follow. */
+
+struct RaXPol_Hdl;
+
+int RaXPol_Hdl_Version(void);
+struct RaXPol_Hdl *RaXPol_Hdl_Open(char **, int, int);
+void RaXPol_Hdl_Close(struct RaXPol_Hdl *);
+long RaXPol_Hdl_Num_Rays(struct RaXPol_Hdl *);
+int RaXPol_Hdl_Num_Gates(struct RaXPol_Hdl *);
+double RaXPol_Hdl_Gate_Spacing(struct RaXPol_Hdl *);
+const struct RaXPol_File_Hdr *RaXPol_Hdl_File_Hdr(struct RaXPol_Hdl *);
+int RaXPol_Hdl_Seek(struct RaXPol_Hdl *, long);
+int RaXPol_Hdl_Read_Ray(struct RaXPol_Hdl *, struct RaXPol_Mom_Ray *);
+int RaXPol_Hdl_Moment(struct RaXPol_Hdl *, const char *, float *);
+int RaXPol_Hdl_Gate_Loc(struct RaXPol_Hdl *, int, double *, double *,
+	double *);
+int RaXPol_Hdl_Ray_Hdrs(struct RaXPol_Hdl *, long, long,
+	struct RaXPol_Mom_Ray *);
+int RaXPol_Hdl_Moments(struct RaXPol_Hdl *, const char *, long, long,
+	float *, struct RaXPol_Mom_Ray *);
+
+#endif
@@ -38,10 +38,14 @@
 
 #include "unix_defs.h"
 #include <stdio.h>
+#include "alloc.h"
 
 /* RaXPol transmission frequency, Hertz */
 #define RAXPOL_FREQUENCY 9.73E9
 
+/* Number of gates at the start of a ray used to estimate noise */
+#define RAXPOL_NOISE_GATES 11
+
 #define RAXPOL_N_SERVMODES 8
 enum RAXPOL_SERVMODE {
     RAXPOL_SPP, RAXPOL_SPP_SUM_PWR,
@@ -150,6 +154,9 @@ struct RaXPol_File_Hdr {
     int timestamp_usec;			/* Timestamp, usec */
     char pulse_filter_file_name[4096];
     char custom_waveform_file_name[4096];
+    int old_fmt;			/* If true, rays have "old" (2011)
+					   headers. Not in the file. Set by
+					   RaXPol_Read_File_Hdr. */
     int reserved8[4];			/* Reserved */
 };
 
@@ -222,7 +229,7 @@ struct RaXPol_SPP_SumPwr {
     float *zv, *zh;
     float _Complex *pp_v, *pp_h;
     float _Complex *cc;
-} spp_sum_pwr;
+};
 struct RaXPol_DPP {
     float *zv1, *zv2, *zv3, *zh1, *zh2, *zh3;
     float _Complex *pp_v1, *pp_v2, *pp_h1, *pp_h2;
@@ -237,13 +244,32 @@ struct RaXPol_Data {
     struct RaXPol_File_Hdr file_hdr;
     enum RAXPOL_SERVMODE servmode;	/* Server mode, see above */
     double h_noise, v_noise;		/* Power noise */
+    float h_noise_avg, v_noise_avg;	/* Running noise averages, carried
+					   from ray to ray by read_ray */
     double thres_val;			/* Theshold value */
     double cal_hh_val, cal_vv_val;
     struct RaXPol_Ray_Hdr ray_hdr;	/* Ray header */
+    struct Tkx_Arena scratch;		/* Scratch space for moment
+					   calculations, reset by each one */
+    int g_start, g_end;			/* Gate window. Only gates g_start
+					   to g_end - 1 are read and used.
+					   See RaXPol_Set_Gate_Window */
+    float noise_v[RAXPOL_NOISE_GATES];	/* First gates of vertical and */
+    float noise_h[RAXPOL_NOISE_GATES];	/* horizontal power, for noise */
+    int gate_step;			/* Number of gates averaged into one
+					   when a ray is read. See
+					   RaXPol_Set_Gate_Step */
+    double *sum;			/* Sums of input fields over rays. See
+					   RaXPol_Sum_Ray */
+    size_t sum_len;			/* Number of elements at sum */
+    int num_sum;			/* Number of rays in sum */
+    double v_noise_sum, h_noise_sum;	/* Sums of noise over rays */
 
     /*
        Input fields. Union has one structure for each server mode.
-       Data arrays have file_hdr.num_rng_gates elements.
+       Data arrays have g_end - g_start elements, for gates g_start to
+       g_end - 1. After gates are averaged, only the first
+       RaXPol_Num_Gates elements are used.
        See gui_1.pro for "documentation".
      */
 
@@ -257,7 +283,11 @@ struct RaXPol_Data {
 	struct { float dum; } fft2i;	/* Place holder */
     } dat_in;
 
-    /* Function to read one ray */
+    /*
+       Function to read one ray from in, or, if in is NULL, from the ray
+       given to RaXPol_Decode_Ray
+     */
+
     int (*read_ray)(struct RaXPol_Data *dat_p, FILE *in);
 
     /* Functions to compute output moments from input fields */
@@ -277,15 +307,32 @@ struct RaXPol_Data {
 void RaXPol_Init_File_Hdr(struct RaXPol_File_Hdr *);
 void RaXPol_Init_Ray_Hdr(struct RaXPol_Ray_Hdr *);
 int RaXPol_Init_Data(struct RaXPol_Data *, FILE *in);
+int RaXPol_Init_Data_Hdr(struct RaXPol_Data *, struct RaXPol_File_Hdr *);
+void RaXPol_Free_Data(struct RaXPol_Data *);
+int RaXPol_Set_Gate_Window(struct RaXPol_Data *, int, int);
+int RaXPol_Set_Gate_Step(struct RaXPol_Data *, int);
+int RaXPol_Num_Gates(struct RaXPol_Data *);
+int RaXPol_Sum_Ray(struct RaXPol_Data *);
+int RaXPol_Mean_Ray(struct RaXPol_Data *);
 void RaXPol_Old_Fmt(void);
+size_t RaXPol_Ray_Hdr_Sz(int);
 const char *RaXPol_Scan_Type_Descr(enum RAXPOL_SCAN_TYPE);
 int RaXPol_Read_File_Hdr(struct RaXPol_File_Hdr *, FILE *);
+int RaXPol_Write_File_Hdr(struct RaXPol_File_Hdr *, FILE *);
 void RaXPol_FPrintf_File_Hdr(struct RaXPol_File_Hdr *, FILE *);
 void RaXPol_Set_Hdg(double);
-int RaXPol_Read_Ray_Hdr(struct RaXPol_Ray_Hdr *, FILE *);
-int RaXPol_FWrite_Ray_Hdr(struct RaXPol_Ray_Hdr *, FILE *);
+double RaXPol_Get_Hdg(void);
+double RaXPol_Ray_Az(struct RaXPol_Ray_Hdr *);
+double RaXPol_Ray_Tm(struct RaXPol_Ray_Hdr *);
+int RaXPol_Scan_Tm(char *, double *);
+int RaXPol_Scan_Tm_Rng(char *, double *, double *);
+int RaXPol_Read_Ray_Hdr(struct RaXPol_Ray_Hdr *, FILE *, int);
+int RaXPol_Decode_Ray_Hdrs(struct RaXPol_Ray_Hdr *, char *, size_t, long, int);
+int RaXPol_FWrite_Ray_Hdr(struct RaXPol_Ray_Hdr *, FILE *, int);
 int RaXPol_FPrint_Ray_Hdr(struct RaXPol_Ray_Hdr *, FILE *);
 void RaXPol_FPrint_Abbrv_Ray_Hdr(struct RaXPol_Ray_Hdr *, FILE *);
 int RaXPol_Read_Ray(struct RaXPol_Data *, FILE *);
+int RaXPol_Decode_Ray(struct RaXPol_Data *, char *, size_t);
+int RaXPol_Write_Ray(struct RaXPol_Data *, FILE *);
 
 #endif
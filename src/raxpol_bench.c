@@ -0,0 +1,363 @@
+/*
+   -	raxpol_bench.c --
+   -		Time RaXPol decoding and moment calculations.
+   -		See raxpol_bench (1).
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "alloc.h"
+#include "raxpol.h"
+#include "raxpol_prof.h"
+
+#define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
+
+/* Number of ray headers in the header decode test buffer */
+#define NUM_HDRS 10000
+
+/* Server mode names, in order of enum RAXPOL_SERVMODE */
+static char *servmode_s[RAXPOL_N_SERVMODES] = {
+    "SPP", "SPP_SUM_PWR", "DPP", "DPP_SUM_PWR", "FFT", "FFT2", "FFT2I",
+    "UNKNOWN"
+};
+
+/* Moment names, in the order of the moment methods in struct RaXPol_Data */
+#define NUM_MOMS 11
+static char *mom_nms[NUM_MOMS] = {
+    "DBMHC", "DBMVC", "DBZ", "DBZ1", "VEL", "ZDR", "PHIDP", "RHOHV", "STD",
+    "SNRHC", "SNRVC"
+};
+
+static char *argv0;			/* Name of the executable */
+
+/* Local functions */
+static double now(void);
+static int time_cmd(char *);
+static int hdr_decode(FILE *, int, char *, int);
+static int ray_read(FILE *, struct RaXPol_Data *, char *);
+static int moments(FILE *, struct RaXPol_Data *, char *, long);
+
+int main(int argc, char *argv[])
+{
+    extern char *optarg;		/* See getopt (3) */
+    extern int optind;			/* See getopt (3) */
+    int c;				/* Index into argv */
+    char *usage = "Usage: %s [-l] [-r reps] [-c num_rays] raxpol_file\n"
+	"       %s -e command\n";
+    int reps = 10;			/* Passes through header buffer */
+    long num_rays = 360;		/* Rays for moment timing */
+    char *raxpol_fl_nm;			/* RaXPol file path */
+    FILE *in;				/* Stream from raxpol_fl_nm */
+    struct RaXPol_Data dat;		/* Data from raxpol_fl_nm */
+    char *mode;				/* Server mode name */
+    int status = EXIT_SUCCESS;
+
+    argv0 = argv[0];
+    RaXPol_Prof_Init(argv0);
+    if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
+	RaXPol_Old_Fmt();
+    }
+    while ((c = getopt(argc, argv, ":le:r:c:")) != -1) {
+	switch(c) {
+	    case 'l':
+		RaXPol_Old_Fmt();
+		break;
+	    case 'e':
+		exit(time_cmd(optarg) ? EXIT_SUCCESS : EXIT_FAILURE);
+		break;
+	    case 'r':
+		if ( sscanf(optarg, "%d", &reps) != 1 || reps < 1 ) {
+		    fprintf(stderr, "%s: expected positive repetition count, "
+			    "got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'c':
+		if ( sscanf(optarg, "%ld", &num_rays) != 1 || num_rays < 1 ) {
+		    fprintf(stderr, "%s: expected positive ray count, got %s\n",
+			    argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    default:
+		fprintf(stderr, usage, argv0, argv0);
+		exit(EXIT_FAILURE);
+		break;
+	}
+    }
+    if ( optind != argc - 1 ) {
+	fprintf(stderr, usage, argv0, argv0);
+	exit(EXIT_FAILURE);
+    }
+    raxpol_fl_nm = argv[optind];
+    if ( !(in = fopen(raxpol_fl_nm, "r")) ) {
+	fprintf(stderr, "%s: could not open %s.\n", argv0, raxpol_fl_nm);
+	exit(EXIT_FAILURE);
+    }
+    if ( !RaXPol_Init_Data(&dat, in) ) {
+	fprintf(stderr, "%s: could not read %s.\n", argv0, raxpol_fl_nm);
+	exit(EXIT_FAILURE);
+    }
+    mode = servmode_s[dat.servmode];
+    if ( !hdr_decode(in, dat.file_hdr.old_fmt, mode, reps)
+	    || !ray_read(in, &dat, mode)
+	    || !moments(in, &dat, mode, num_rays) ) {
+	fprintf(stderr, "%s: benchmark failed for %s.\n", argv0, raxpol_fl_nm);
+	status = EXIT_FAILURE;
+    }
+    RaXPol_Free_Data(&dat);
+    fclose(in);
+    return status;
+}
+
+/* Return monotonic clock time, seconds */
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+/*
+   Run cmd with sh and print wall clock time, seconds, to standard output.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int time_cmd(char *cmd)
+{
+    double t0;
+    int status;
+
+    t0 = now();
+    status = system(cmd);
+    if ( status == -1 ) {
+	fprintf(stderr, "%s: could not run %s.\n", argv0, cmd);
+	return 0;
+    } else if ( WIFSIGNALED(status) ) {
+	fprintf(stderr, "%s: %s terminated by signal %d.\n",
+		argv0, cmd, WTERMSIG(status));
+	return 0;
+    } else if ( !WIFEXITED(status) || WEXITSTATUS(status) != 0 ) {
+	fprintf(stderr, "%s: %s exited with status %d.\n",
+		argv0, cmd, WEXITSTATUS(status));
+	return 0;
+    }
+    printf("%.6f\n", now() - t0);
+    return 1;
+}
+
+/*
+   Time RaXPol_Read_Ray_Hdr. Copy the first ray header in stream in, which
+   must be positioned at the first ray, and has "old" (2011) ray headers if
+   old_fmt is true, NUM_HDRS times to a temporary file,
+   and read them back reps times. Then decode the same headers from memory
+   reps times with RaXPol_Decode_Ray_Hdrs. Print rates to standard output.
+   in is rewound to the first ray on return.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int hdr_decode(FILE *in, int old_fmt, char *mode, int reps)
+{
+    size_t sz = RaXPol_Ray_Hdr_Sz(old_fmt);
+    char *buf;				/* Raw ray header */
+    FILE *tmp;				/* NUM_HDRS copies of buf */
+    struct RaXPol_Ray_Hdr ray_hdr;
+    char *blk = NULL;			/* NUM_HDRS copies of buf */
+    struct RaXPol_Ray_Hdr *ray_hdrs = NULL; /* Headers decoded from blk */
+    double t0, dt;
+    int n, r;
+    int status = 0;
+
+    if ( !(buf = MALLOC(sz)) ) {
+	fprintf(stderr, "Could not allocate ray header buffer.\n");
+	return 0;
+    }
+    if ( fread(buf, sz, 1, in) != 1
+	    || fseeko(in, RAXPOL_FILE_HDR_SZ, SEEK_SET) == -1 ) {
+	fprintf(stderr, "Could not read first ray header.\n");
+	FREE(buf);
+	return 0;
+    }
+    if ( !(tmp = tmpfile()) ) {
+	fprintf(stderr, "Could not create temporary file for ray headers.\n");
+	FREE(buf);
+	return 0;
+    }
+    for (n = 0; n < NUM_HDRS; n++) {
+	if ( fwrite(buf, sz, 1, tmp) != 1 ) {
+	    fprintf(stderr, "Could not write ray headers to temporary file.\n");
+	    goto error;
+	}
+    }
+    t0 = now();
+    for (r = 0; r < reps; r++) {
+	rewind(tmp);
+	for (n = 0; n < NUM_HDRS; n++) {
+	    if ( !RaXPol_Read_Ray_Hdr(&ray_hdr, tmp, old_fmt) ) {
+		fprintf(stderr, "Could not decode ray header %d.\n", n);
+		goto error;
+	    }
+	}
+    }
+    dt = now() - t0;
+    printf("bench,hdr_decode,%s,%.0f,hdrs/s\n", mode, reps * NUM_HDRS / dt);
+
+    if ( !(blk = MALLOC(NUM_HDRS * sz))
+	    || !(ray_hdrs = CALLOC(NUM_HDRS, sizeof(struct RaXPol_Ray_Hdr))) ) {
+	fprintf(stderr, "Could not allocate ray header block.\n");
+	goto error;
+    }
+    for (n = 0; n < NUM_HDRS; n++) {
+	memcpy(blk + n * sz, buf, sz);
+    }
+    t0 = now();
+    for (r = 0; r < reps; r++) {
+	if ( !RaXPol_Decode_Ray_Hdrs(ray_hdrs, blk, sz, NUM_HDRS, old_fmt) ) {
+	    fprintf(stderr, "Could not decode ray header block.\n");
+	    goto error;
+	}
+    }
+    dt = now() - t0;
+    printf("bench,hdr_decode_block,%s,%.0f,hdrs/s\n",
+	    mode, reps * NUM_HDRS / dt);
+    status = 1;
+
+error:
+    fclose(tmp);
+    FREE(buf);
+    FREE(blk);
+    FREE(ray_hdrs);
+    return status;
+}
+
+/*
+   Time RaXPol_Read_Ray for all rays from in, which must be positioned at
+   the first ray. dat_p must be initialized from the file header. Print rates
+   to standard output. in is rewound to the first ray on return.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int ray_read(FILE *in, struct RaXPol_Data *dat_p, char *mode)
+{
+    long num_rays;
+    double t0, dt;
+    double mb;				/* Megabytes read */
+
+    t0 = now();
+    for (num_rays = 0, mb = 0.0; RaXPol_Read_Ray(dat_p, in); num_rays++) {
+	mb += (RaXPol_Ray_Hdr_Sz(dat_p->file_hdr.old_fmt)
+		+ dat_p->ray_hdr.data_size) / 1.0e6;
+    }
+    dt = now() - t0;
+    if ( ferror(in) || num_rays == 0 ) {
+	fprintf(stderr, "Could not read rays.\n");
+	return 0;
+    }
+    clearerr(in);
+    printf("bench,ray_read,%s,%.0f,rays/s\n", mode, num_rays / dt);
+    printf("bench,ray_read_mb,%s,%.1f,MB/s\n", mode, mb / dt);
+    dat_p->v_noise_avg = dat_p->h_noise_avg = 0.0;
+    if ( fseeko(in, RAXPOL_FILE_HDR_SZ, SEEK_SET) == -1 ) {
+	fprintf(stderr, "Could not rewind RaXPol file.\n");
+	return 0;
+    }
+    return 1;
+}
+
+/*
+   Time each moment method of dat_p for up to num_rays rays from in, which
+   must be positioned at the first ray. Print gate rates to standard output.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int moments(FILE *in, struct RaXPol_Data *dat_p, char *mode,
+	long num_rays)
+{
+    int (*calc[NUM_MOMS])(struct RaXPol_Data *, float *);
+    double dt[NUM_MOMS];		/* Time in each method */
+    int num_gates = dat_p->file_hdr.num_rng_gates;
+    float *vals;			/* Moment values for a ray */
+    long r;
+    int m;
+    double t0;
+
+    calc[0] = dat_p->dbmhc;
+    calc[1] = dat_p->dbmvc;
+    calc[2] = dat_p->dbz;
+    calc[3] = dat_p->dbz1;
+    calc[4] = dat_p->vel;
+    calc[5] = dat_p->zdr;
+    calc[6] = dat_p->phidp;
+    calc[7] = dat_p->rhohv;
+    calc[8] = dat_p->std;
+    calc[9] = dat_p->snrhc;
+    calc[10] = dat_p->snrvc;
+    if ( !(vals = CALLOC(num_gates, sizeof(float))) ) {
+	fprintf(stderr, "Could not allocate %d gates for moments.\n",
+		num_gates);
+	return 0;
+    }
+    for (m = 0; m < NUM_MOMS; m++) {
+	dt[m] = 0.0;
+    }
+    for (r = 0; r < num_rays && RaXPol_Read_Ray(dat_p, in); r++) {
+	for (m = 0; m < NUM_MOMS; m++) {
+	    t0 = now();
+	    if ( !calc[m](dat_p, vals) ) {
+		fprintf(stderr, "Could not compute %s for ray %ld.\n",
+			mom_nms[m], r);
+		FREE(vals);
+		return 0;
+	    }
+	    dt[m] += now() - t0;
+	}
+    }
+    FREE(vals);
+    if ( r == 0 ) {
+	fprintf(stderr, "Could not read rays for moment calculations.\n");
+	return 0;
+    }
+    for (m = 0; m < NUM_MOMS; m++) {
+	printf("bench,moment_%s,%s,%.0f,gates/s\n",
+		mom_nms[m], mode, r * num_gates / dt[m]);
+    }
+    return 1;
+}
@@ -0,0 +1,340 @@
+/*
+   -	raxpol_cache.c --
+   -		Compute all moments for RaXPol files and store them in
+   -		moment caches next to the files. See raxpol_cache (1).
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "alloc.h"
+#include "raxpol.h"
+#include "raxpol_mom.h"
+#include "raxpol_prof.h"
+
+#define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
+
+/* Suffix for cache under construction */
+#define TMP_SFX ".tmp"
+
+static char *argv0;			/* Name of the executable */
+
+/* Moments in the cache */
+#define NUM_MOMS 11
+static char *mom_nms[NUM_MOMS] = {
+    "DBMHC", "DBMVC", "DBZ", "DBZ1", "VEL", "ZDR", "PHIDP", "RHOHV", "STD",
+    "SNRHC", "SNRVC"
+};
+
+/* Local functions */
+static int check_cache(char *);
+static int mk_cache(char *);
+
+int main(int argc, char *argv[])
+{
+    extern char *optarg;		/* See getopt (3) */
+    extern int optind;			/* See getopt (3) */
+    int c;				/* Index into argv */
+    double dflt_hdg;			/* Default heading */
+    int check = 0;			/* If true, only check caches */
+    int force = 0;			/* If true, rebuild current caches */
+    int status = EXIT_SUCCESS;
+    char *raxpol_fl_nm;			/* RaXPol file path */
+
+    argv0 = argv[0];
+    RaXPol_Prof_Init(argv0);
+    if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
+	RaXPol_Old_Fmt();
+    }
+    while ((c = getopt(argc, argv, ":Vcflh:")) != -1) {
+	switch(c) {
+	    case 'V':
+		printf("%s\n", RAXPOL_MOMENT_VERSION);
+		exit(EXIT_SUCCESS);
+		break;
+	    case 'c':
+		check = 1;
+		break;
+	    case 'f':
+		force = 1;
+		break;
+	    case 'l':
+		RaXPol_Old_Fmt();
+		break;
+	    case 'h':
+		if ( sscanf(optarg, "%lf", &dflt_hdg) != 1 ) {
+		    fprintf(stderr, "%s: expected float value for default "
+			    "heading, got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		RaXPol_Set_Hdg(dflt_hdg);
+		break;
+	    case '?':
+		fprintf(stderr, "Usage: %s [-c] [-f] [-l] [-h angle] "
+			"raxpol_file ...\n", argv0);
+		exit(EXIT_FAILURE);
+		break;
+	}
+    }
+    if ( optind == argc ) {
+	fprintf(stderr, "Usage: %s [-c] [-f] [-l] [-h angle] "
+		"raxpol_file ...\n", argv0);
+	exit(EXIT_FAILURE);
+    }
+    for ( ; optind < argc; optind++) {
+	raxpol_fl_nm = argv[optind];
+	if ( check ) {
+	    if ( !check_cache(raxpol_fl_nm) ) {
+		status = EXIT_FAILURE;
+	    }
+	} else if ( force || !check_cache(raxpol_fl_nm) ) {
+	    if ( !mk_cache(raxpol_fl_nm) ) {
+		fprintf(stderr, "%s: could not make moment cache for %s\n",
+			argv0, raxpol_fl_nm);
+		status = EXIT_FAILURE;
+	    }
+	}
+    }
+    return status;
+}
+
+/*
+   Return true if RaXPol file raxpol_fl_nm has a moment cache that matches
+   the file and current settings.
+ */
+
+static int check_cache(char *raxpol_fl_nm)
+{
+    FILE *raxpol_fl;
+    struct RaXPol_Data dat;
+    struct RaXPol_Mom_Hdr hdr;
+    int fd;
+
+    if ( !(raxpol_fl = fopen(raxpol_fl_nm, "r")) ) {
+	return 0;
+    }
+    if ( !RaXPol_Init_Data(&dat, raxpol_fl) ) {
+	RaXPol_Free_Data(&dat);
+	fclose(raxpol_fl);
+	return 0;
+    }
+    fclose(raxpol_fl);
+    fd = RaXPol_Mom_Open_Cache(raxpol_fl_nm, &dat, &hdr);
+    RaXPol_Free_Data(&dat);
+    if ( fd == -1 ) {
+	return 0;
+    }
+    close(fd);
+    return 1;
+}
+
+/*
+   Compute all moments for all rays in RaXPol file raxpol_fl_nm, and store
+   them in its moment cache. The cache is assembled in a temporary file,
+   which replaces the cache when complete.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int mk_cache(char *raxpol_fl_nm)
+{
+    FILE *raxpol_fl = NULL;		/* RaXPol file */
+    struct stat sb;			/* Status of RaXPol file */
+    struct RaXPol_Data dat;		/* Data for one ray */
+    struct RaXPol_Ray_Hdr ray_hdr;	/* First ray header */
+    off_t o0;				/* Offset to start of first ray */
+    off_t o;				/* Offset somewhere in raxpol_fl */
+    off_t ray_sz;			/* Size in file of one ray */
+    long num_rays;			/* Number of rays in RaXPol file */
+    int num_gates;			/* Number of gates */
+    char *cache_nm = NULL;		/* Path to cache */
+    char *tmp_nm = NULL;		/* Path to cache under construction */
+    int fd = -1;			/* Cache under construction */
+    struct RaXPol_Mom_Hdr hdr;		/* Cache header */
+    struct RaXPol_Mom_Ray mom_ray;	/* Ray table entry */
+    float *flds[NUM_MOMS] = {NULL};	/* Moment values for one ray */
+    int (*calc[NUM_MOMS])(struct RaXPol_Data *, float *);
+    long r;
+    int m;
+    double t0;				/* Profile start time */
+    int status = 0;
+
+    if ( !(raxpol_fl = fopen(raxpol_fl_nm, "r")) ) {
+	fprintf(stderr, "%s: could not open %s for reading.\n",
+		argv0, raxpol_fl_nm);
+	return 0;
+    }
+    RaXPol_Init_Data(&dat, NULL);
+    if ( fstat(fileno(raxpol_fl), &sb) == -1 ) {
+	fprintf(stderr, "%s: could not get status of %s.\n%s\n",
+		argv0, raxpol_fl_nm, strerror(errno));
+	goto end;
+    }
+    if ( !RaXPol_Init_Data(&dat, raxpol_fl) ) {
+	fprintf(stderr, "%s: failed to initialize RaXPol data structure.\n",
+		argv0);
+	goto end;
+    }
+    num_gates = dat.file_hdr.num_rng_gates;
+    calc[0] = dat.dbmhc;
+    calc[1] = dat.dbmvc;
+    calc[2] = dat.dbz;
+    calc[3] = dat.dbz1;
+    calc[4] = dat.vel;
+    calc[5] = dat.zdr;
+    calc[6] = dat.phidp;
+    calc[7] = dat.rhohv;
+    calc[8] = dat.std;
+    calc[9] = dat.snrhc;
+    calc[10] = dat.snrvc;
+    for (m = 0; m < NUM_MOMS; m++) {
+	if ( !(flds[m] = CALLOC(num_gates, sizeof(float))) ) {
+	    fprintf(stderr, "%s: could not allocate %d values for %s\n",
+		    argv0, num_gates, mom_nms[m]);
+	    goto end;
+	}
+    }
+
+    /* Determine ray size and number of rays */
+    if ( (o0 = ftello(raxpol_fl)) == -1 ) {
+	fprintf(stderr, "%s: could not determine position in file.\n%s\n",
+		argv0, strerror(errno));
+	goto end;
+    }
+    if ( !RaXPol_Read_Ray_Hdr(&ray_hdr, raxpol_fl, dat.file_hdr.old_fmt) ) {
+	fprintf(stderr, "%s: failed to read header for first ray.\n",
+		argv0);
+	goto end;
+    }
+    if ( (o = ftello(raxpol_fl)) == -1 ) {
+	fprintf(stderr, "%s: could not determine position in file.\n%s\n",
+		argv0, strerror(errno));
+	goto end;
+    }
+    ray_sz = o - o0 + ray_hdr.data_size;
+    num_rays = (sb.st_size - o0) / ray_sz;
+    if ( num_rays > INT_MAX ) {
+	fprintf(stderr, "%s: too many rays (%ld) for moment cache.\n",
+		argv0, num_rays);
+	goto end;
+    }
+    if ( fseeko(raxpol_fl, o0, SEEK_SET) == -1) {
+	fprintf(stderr, "%s: could not position at first ray.\n%s\n",
+		argv0, strerror(errno));
+	goto end;
+    }
+
+    /* Create cache under construction */
+    if ( !(cache_nm = RaXPol_Mom_Cache_Path(raxpol_fl_nm))
+	    || !(tmp_nm = MALLOC(strlen(cache_nm) + strlen(TMP_SFX) + 1)) ) {
+	fprintf(stderr, "%s: could not allocate cache path for %s.\n",
+		argv0, raxpol_fl_nm);
+	goto end;
+    }
+    strcpy(tmp_nm, cache_nm);
+    strcat(tmp_nm, TMP_SFX);
+    if ( (fd = open(tmp_nm, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1 ) {
+	fprintf(stderr, "%s: could not create %s.\n%s\n",
+		argv0, tmp_nm, strerror(errno));
+	goto end;
+    }
+    if ( !RaXPol_Mom_Init_Hdr(&hdr, &dat, 0, num_rays, mom_nms, NUM_MOMS,
+		RAXPOL_MOM_U2) ) {
+	fprintf(stderr, "%s: could not initialize moment cache header.\n",
+		argv0);
+	goto end;
+    }
+    hdr.src_sz = sb.st_size;
+    hdr.src_mtime = sb.st_mtime;
+
+    /* Compute and store moments for all rays */
+    for (r = 0; r < num_rays; r++) {
+	if ( !RaXPol_Read_Ray(&dat, raxpol_fl) ) {
+	    fprintf(stderr, "%s: could not read ray %ld\n", argv0, r);
+	    goto end;
+	}
+	for (m = 0; m < NUM_MOMS; m++) {
+	    t0 = RaXPol_Prof_Start();
+	    if ( !calc[m](&dat, flds[m]) ) {
+		fprintf(stderr, "%s: could not compute %s for ray %ld\n",
+			argv0, mom_nms[m], r);
+		goto end;
+	    }
+	    RaXPol_Prof_Mom(mom_nms[m], t0, num_gates);
+	}
+	t0 = RaXPol_Prof_Start();
+	RaXPol_Mom_Set_Ray(&mom_ray, &dat.ray_hdr);
+	if ( !RaXPol_Mom_Write_Ray(&hdr, fd, r, &mom_ray, flds) ) {
+	    fprintf(stderr, "%s: could not write ray %ld to moment cache.\n",
+		    argv0, r);
+	    goto end;
+	}
+	RaXPol_Prof_Stop("output", t0, 1);
+    }
+    if ( !RaXPol_Mom_Write_Hdr(&hdr, fd) ) {
+	fprintf(stderr, "%s: could not write moment cache header.\n", argv0);
+	goto end;
+    }
+    if ( close(fd) == -1 ) {
+	fd = -1;
+	fprintf(stderr, "%s: could not close %s.\n%s\n",
+		argv0, tmp_nm, strerror(errno));
+	goto end;
+    }
+    fd = -1;
+    if ( rename(tmp_nm, cache_nm) == -1 ) {
+	fprintf(stderr, "%s: could not rename %s to %s.\n%s\n",
+		argv0, tmp_nm, cache_nm, strerror(errno));
+	goto end;
+    }
+    status = 1;
+
+end:
+    if ( fd != -1 ) {
+	close(fd);
+    }
+    if ( !status && tmp_nm ) {
+	unlink(tmp_nm);
+    }
+    fclose(raxpol_fl);
+    RaXPol_Free_Data(&dat);
+    FREE(cache_nm);
+    FREE(tmp_nm);
+    for (m = 0; m < NUM_MOMS; m++) {
+	FREE(flds[m]);
+    }
+    return status;
+}
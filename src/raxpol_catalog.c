@@ -0,0 +1,557 @@
+/*
+   -	raxpol_catalog.c --
+   -		Maintain and query a catalog of RaXPol files, which gives
+   -		the time span and scan summary of each file. See
+   -		raxpol_catalog (1).
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "alloc.h"
+#include "raxpol.h"
+#include "raxpol_idx.h"
+#include "raxpol_prof.h"
+
+#define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
+
+/* First line of a catalog */
+#define CAT_MAGIC "# raxpol_catalog 1"
+
+/* Suffix for catalog under construction */
+#define TMP_SFX ".tmp"
+
+/* Maximum length of a catalog line */
+#define LEN 8192
+
+/* Catalog entry for one RaXPol file */
+struct Entry {
+    char *path;				/* Path to RaXPol file */
+    double tm0, tm1;			/* Times of first and last rays */
+    long num_rays;			/* Number of rays */
+    long ray_sz;			/* Size of one ray */
+    long long src_sz;			/* Size of file */
+    long long src_mtime;		/* Modification time of file */
+    int scan_type;			/* Scan type from file header */
+    int servmode;			/* Server mode from file header */
+    int num_gates;			/* Number of range gates */
+    double gate_spacing;		/* Range gate spacing, meters */
+    int idx;				/* If true, file had current ray index
+					   when entry was made */
+};
+
+/* Catalog */
+struct Cat {
+    struct Entry *entries;		/* Entries, sorted by tm0 */
+    size_t num_entries;
+    size_t num_entries_max;		/* Allocated size of entries */
+};
+
+static char *argv0;			/* Name of the executable */
+
+/* Local functions */
+static int update(char *, char **, int);
+static int query(char *, char *);
+static int cat_read(struct Cat *, char *);
+static int cat_write(struct Cat *, char *);
+static struct Entry *cat_add(struct Cat *);
+static void cat_free(struct Cat *);
+static int mk_entry(struct Entry *, char *, struct stat *);
+static size_t cat_search(struct Cat *, double);
+static int cmp_entry(const void *, const void *);
+
+int main(int argc, char *argv[])
+{
+    extern char *optarg;		/* See getopt (3) */
+    extern int optind;			/* See getopt (3) */
+    int c;				/* Index into argv */
+    int upd = 0;			/* If true, update catalog */
+    char *tm_s = NULL;			/* Query time or time range */
+    char *usage = "Usage: %s [-l] -u catalog raxpol_file ...\n"
+	"       %s [-l] -q time|start,end catalog\n";
+
+    argv0 = argv[0];
+    RaXPol_Prof_Init(argv0);
+    if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
+	RaXPol_Old_Fmt();
+    }
+    while ((c = getopt(argc, argv, ":Vluq:")) != -1) {
+	switch(c) {
+	    case 'V':
+		printf("%s\n", RAXPOL_MOMENT_VERSION);
+		exit(EXIT_SUCCESS);
+		break;
+	    case 'l':
+		RaXPol_Old_Fmt();
+		break;
+	    case 'u':
+		upd = 1;
+		break;
+	    case 'q':
+		tm_s = optarg;
+		break;
+	    case '?':
+	    case ':':
+		fprintf(stderr, usage, argv0, argv0);
+		exit(EXIT_FAILURE);
+		break;
+	}
+    }
+    if ( upd && !tm_s && optind < argc ) {
+	return update(argv[optind], argv + optind + 1, argc - optind - 1)
+	    ? EXIT_SUCCESS : EXIT_FAILURE;
+    } else if ( tm_s && !upd && optind + 1 == argc ) {
+	return query(argv[optind], tm_s) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    fprintf(stderr, usage, argv0, argv0);
+    return EXIT_FAILURE;
+}
+
+/*
+   Update catalog at cat_fl_nm with the num_fls RaXPol files in fl_nms.
+   Files already in the catalog are only read again if their size,
+   modification time, or ray index has changed. Entries for files that
+   no longer exist are dropped. The catalog is written to a temporary file,
+   which replaces the catalog when complete.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int update(char *cat_fl_nm, char **fl_nms, int num_fls)
+{
+    struct Cat cat;			/* Catalog */
+    struct stat sb;			/* Status of a RaXPol file */
+    struct Entry *e_p, *e1_p;
+    int f;				/* Index into fl_nms */
+    size_t e;				/* Index into cat.entries */
+    int status = 0;
+
+    if ( !cat_read(&cat, cat_fl_nm) ) {
+	return 0;
+    }
+
+    /* Drop entries for missing files */
+    for (e = 0, e_p = e1_p = cat.entries; e < cat.num_entries; e++, e_p++) {
+	if ( stat(e_p->path, &sb) == 0 ) {
+	    *e1_p++ = *e_p;
+	} else {
+	    FREE(e_p->path);
+	}
+    }
+    cat.num_entries = e1_p - cat.entries;
+
+    /* Add or refresh entries for files from command line */
+    for (f = 0; f < num_fls; f++) {
+	char *idx_nm;
+	int idx;
+
+	if ( stat(fl_nms[f], &sb) == -1 ) {
+	    fprintf(stderr, "%s: could not get status of %s.\n%s\n",
+		    argv0, fl_nms[f], strerror(errno));
+	    goto end;
+	}
+	if ( !(idx_nm = RaXPol_Idx_Path(fl_nms[f])) ) {
+	    goto end;
+	}
+	idx = access(idx_nm, R_OK) == 0;
+	FREE(idx_nm);
+	for (e = 0, e_p = cat.entries; e < cat.num_entries; e++, e_p++) {
+	    if ( strcmp(e_p->path, fl_nms[f]) == 0 ) {
+		break;
+	    }
+	}
+	if ( e < cat.num_entries ) {
+	    if ( e_p->src_sz == sb.st_size && e_p->src_mtime == sb.st_mtime
+		    && e_p->idx == idx ) {
+		continue;
+	    }
+	    FREE(e_p->path);
+	} else if ( !(e_p = cat_add(&cat)) ) {
+	    goto end;
+	}
+	if ( !mk_entry(e_p, fl_nms[f], &sb) ) {
+	    fprintf(stderr, "%s: could not make catalog entry for %s.\n",
+		    argv0, fl_nms[f]);
+	    cat.num_entries--;
+	    *e_p = cat.entries[cat.num_entries];
+	    goto end;
+	}
+    }
+    qsort(cat.entries, cat.num_entries, sizeof(struct Entry), cmp_entry);
+    status = cat_write(&cat, cat_fl_nm);
+
+end:
+    cat_free(&cat);
+    return status;
+}
+
+/*
+   Print files and rays from catalog cat_fl_nm for time or time range tm_s.
+   For a time, print the file and index of the last ray at or before the
+   time. For a range, print path, index of first ray, and ray count for each
+   file with rays in the range, in time order.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int query(char *cat_fl_nm, char *tm_s)
+{
+    struct Cat cat;			/* Catalog */
+    int rng;				/* If true, tm_s is a range */
+    double tm0, tm1;			/* Start and end of query */
+    size_t e;				/* Index into cat.entries */
+    int status = 0;
+
+    if ( (rng = (strchr(tm_s, ',') != NULL)) ) {
+	if ( !RaXPol_Scan_Tm_Rng(tm_s, &tm0, &tm1) ) {
+	    return 0;
+	}
+    } else if ( RaXPol_Scan_Tm(tm_s, &tm0) ) {
+	tm1 = tm0;
+    } else {
+	return 0;
+    }
+    if ( !cat_read(&cat, cat_fl_nm) ) {
+	return 0;
+    }
+    if ( cat.num_entries == 0 ) {
+	status = 1;
+	goto end;
+    }
+
+    /*
+       e is the first file whose first ray is after tm0. If the time or
+       range start falls in a file, it is the file before e.
+     */
+
+    e = cat_search(&cat, tm0);
+    if ( e > 0 && (!rng || cat.entries[e - 1].tm1 >= tm0) ) {
+	e--;
+    }
+    for ( ; e < cat.num_entries && cat.entries[e].tm0 <= tm1; e++) {
+	struct Entry *e_p = cat.entries + e;
+	FILE *fl;
+	struct RaXPol_File_Hdr file_hdr;
+	struct RaXPol_Idx idx;
+	int have_idx;
+	off_t o0;
+	long r0, r1;
+
+	if ( !(fl = fopen(e_p->path, "r")) ) {
+	    fprintf(stderr, "%s: could not open %s.\n", argv0, e_p->path);
+	    goto end;
+	}
+	RaXPol_Init_File_Hdr(&file_hdr);
+	if ( !RaXPol_Read_File_Hdr(&file_hdr, fl) || (o0 = ftello(fl)) == -1 ) {
+	    fprintf(stderr, "%s: could not read header from %s.\n",
+		    argv0, e_p->path);
+	    fclose(fl);
+	    goto end;
+	}
+	RaXPol_Idx_Init(&idx);
+	have_idx = e_p->idx && RaXPol_Idx_Open(&idx, e_p->path, NULL)
+	    && idx.ray_hdr_sz == (int)RaXPol_Ray_Hdr_Sz(file_hdr.old_fmt);
+	r1 = RaXPol_Idx_Tm_Ray(have_idx ? &idx : NULL, fl, o0, e_p->ray_sz,
+		file_hdr.old_fmt, e_p->num_rays, tm1, 1);
+	r0 = rng ? RaXPol_Idx_Tm_Ray(have_idx ? &idx : NULL, fl, o0,
+		e_p->ray_sz, file_hdr.old_fmt, e_p->num_rays, tm0, 0) : 0;
+	RaXPol_Idx_Free(&idx);
+	fclose(fl);
+	if ( r0 == -1 || r1 == -1 ) {
+	    fprintf(stderr, "%s: could not search %s.\n", argv0, e_p->path);
+	    goto end;
+	}
+	if ( !rng ) {
+	    printf("%s %ld\n", e_p->path, (r1 > 0) ? r1 - 1 : 0);
+	    break;
+	} else if ( r1 > r0 ) {
+	    printf("%s %ld %ld\n", e_p->path, r0, r1 - r0);
+	}
+    }
+    status = 1;
+
+end:
+    cat_free(&cat);
+    return status;
+}
+
+/*
+   Read catalog from cat_fl_nm into cat_p. If cat_fl_nm does not exist,
+   cat_p receives an empty catalog.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int cat_read(struct Cat *cat_p, char *cat_fl_nm)
+{
+    FILE *in;
+    char line[LEN];
+    char path[LEN];
+    struct Entry *e_p;
+    long n = 1;				/* Line number */
+
+    memset(cat_p, 0, sizeof(struct Cat));
+    if ( !(in = fopen(cat_fl_nm, "r")) ) {
+	if ( errno == ENOENT ) {
+	    return 1;
+	}
+	fprintf(stderr, "%s: could not open catalog %s.\n%s\n",
+		argv0, cat_fl_nm, strerror(errno));
+	return 0;
+    }
+    if ( !fgets(line, LEN, in) || strncmp(line, CAT_MAGIC,
+		strlen(CAT_MAGIC)) != 0 ) {
+	fprintf(stderr, "%s: %s is not a RaXPol catalog.\n",
+		argv0, cat_fl_nm);
+	goto error;
+    }
+    while ( fgets(line, LEN, in) ) {
+	n++;
+	if ( line[0] == '#' ) {
+	    continue;
+	}
+	if ( !(e_p = cat_add(cat_p)) ) {
+	    goto error;
+	}
+	if ( sscanf(line, "%s %lf %lf %ld %ld %lld %lld %d %d %d %lf %d",
+		    path, &e_p->tm0, &e_p->tm1, &e_p->num_rays, &e_p->ray_sz,
+		    &e_p->src_sz, &e_p->src_mtime, &e_p->scan_type,
+		    &e_p->servmode, &e_p->num_gates, &e_p->gate_spacing,
+		    &e_p->idx) != 12 ) {
+	    fprintf(stderr, "%s: could not read line %ld of catalog %s.\n",
+		    argv0, n, cat_fl_nm);
+	    cat_p->num_entries--;
+	    goto error;
+	}
+	if ( !(e_p->path = MALLOC(strlen(path) + 1)) ) {
+	    fprintf(stderr, "%s: could not allocate path for line %ld of "
+		    "catalog.\n", argv0, n);
+	    cat_p->num_entries--;
+	    goto error;
+	}
+	strcpy(e_p->path, path);
+    }
+    if ( ferror(in) ) {
+	fprintf(stderr, "%s: could not read catalog %s.\n", argv0, cat_fl_nm);
+	goto error;
+    }
+    fclose(in);
+    return 1;
+
+error:
+    fclose(in);
+    cat_free(cat_p);
+    return 0;
+}
+
+/*
+   Write catalog at cat_p to a temporary file, then move it to cat_fl_nm.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int cat_write(struct Cat *cat_p, char *cat_fl_nm)
+{
+    char *tmp_nm;
+    FILE *out;
+    struct Entry *e_p;
+    size_t e;
+
+    if ( !(tmp_nm = MALLOC(strlen(cat_fl_nm) + strlen(TMP_SFX) + 1)) ) {
+	fprintf(stderr, "%s: could not allocate catalog path.\n", argv0);
+	return 0;
+    }
+    strcpy(tmp_nm, cat_fl_nm);
+    strcat(tmp_nm, TMP_SFX);
+    if ( !(out = fopen(tmp_nm, "w")) ) {
+	fprintf(stderr, "%s: could not create %s.\n%s\n",
+		argv0, tmp_nm, strerror(errno));
+	FREE(tmp_nm);
+	return 0;
+    }
+    fprintf(out, "%s\n", CAT_MAGIC);
+    fprintf(out, "# path tm0 tm1 num_rays ray_sz src_sz src_mtime scan_type "
+	    "servmode num_gates gate_spacing idx\n");
+    for (e = 0, e_p = cat_p->entries; e < cat_p->num_entries; e++, e_p++) {
+	fprintf(out, "%s %.6f %.6f %ld %ld %lld %lld %d %d %d %g %d\n",
+		e_p->path, e_p->tm0, e_p->tm1, e_p->num_rays, e_p->ray_sz,
+		e_p->src_sz, e_p->src_mtime, e_p->scan_type, e_p->servmode,
+		e_p->num_gates, e_p->gate_spacing, e_p->idx);
+    }
+    if ( ferror(out) | (fclose(out) == EOF) ) {
+	fprintf(stderr, "%s: could not write %s.\n", argv0, tmp_nm);
+	unlink(tmp_nm);
+	FREE(tmp_nm);
+	return 0;
+    }
+    if ( rename(tmp_nm, cat_fl_nm) == -1 ) {
+	fprintf(stderr, "%s: could not rename %s to %s.\n%s\n",
+		argv0, tmp_nm, cat_fl_nm, strerror(errno));
+	unlink(tmp_nm);
+	FREE(tmp_nm);
+	return 0;
+    }
+    FREE(tmp_nm);
+    return 1;
+}
+
+/*
+   Append an empty entry to catalog at cat_p and return its address.
+   Return NULL on failure.
+ */
+
+static struct Entry *cat_add(struct Cat *cat_p)
+{
+    struct Entry *e_p;
+
+    if ( cat_p->num_entries == cat_p->num_entries_max ) {
+	size_t n = (cat_p->num_entries_max == 0)
+	    ? 256 : 2 * cat_p->num_entries_max;
+
+	if ( !(e_p = REALLOC(cat_p->entries, n * sizeof(struct Entry))) ) {
+	    fprintf(stderr, "%s: could not allocate catalog with %zu "
+		    "entries.\n", argv0, n);
+	    return NULL;
+	}
+	cat_p->entries = e_p;
+	cat_p->num_entries_max = n;
+    }
+    e_p = cat_p->entries + cat_p->num_entries++;
+    memset(e_p, 0, sizeof(struct Entry));
+    return e_p;
+}
+
+/* Free memory associated with catalog at cat_p */
+static void cat_free(struct Cat *cat_p)
+{
+    size_t e;
+
+    for (e = 0; e < cat_p->num_entries; e++) {
+	FREE(cat_p->entries[e].path);
+    }
+    FREE(cat_p->entries);
+    memset(cat_p, 0, sizeof(struct Cat));
+}
+
+/*
+   Make catalog entry at e_p for RaXPol file fl_nm, which has status sb.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int mk_entry(struct Entry *e_p, char *fl_nm, struct stat *sb)
+{
+    FILE *fl;
+    struct RaXPol_File_Hdr file_hdr;
+    struct RaXPol_Ray_Hdr ray_hdr;
+    struct RaXPol_Idx idx;
+    off_t o0, o;
+    int status = 0;
+
+    memset(e_p, 0, sizeof(struct Entry));
+    if ( !(fl = fopen(fl_nm, "r")) ) {
+	fprintf(stderr, "%s: could not open %s.\n", argv0, fl_nm);
+	return 0;
+    }
+    RaXPol_Init_File_Hdr(&file_hdr);
+    if ( !RaXPol_Read_File_Hdr(&file_hdr, fl)
+	    || (o0 = ftello(fl)) == -1
+	    || !RaXPol_Read_Ray_Hdr(&ray_hdr, fl, file_hdr.old_fmt)
+	    || (o = ftello(fl)) == -1 ) {
+	fprintf(stderr, "%s: could not read headers from %s.\n",
+		argv0, fl_nm);
+	goto end;
+    }
+    e_p->ray_sz = o - o0 + ray_hdr.data_size;
+    e_p->num_rays = (sb->st_size - o0) / e_p->ray_sz;
+    e_p->tm0 = RaXPol_Ray_Tm(&ray_hdr);
+    if ( fseeko(fl, o0 + (e_p->num_rays - 1) * e_p->ray_sz, SEEK_SET) == -1
+	    || !RaXPol_Read_Ray_Hdr(&ray_hdr, fl, file_hdr.old_fmt) ) {
+	fprintf(stderr, "%s: could not read last ray header from %s.\n",
+		argv0, fl_nm);
+	goto end;
+    }
+    e_p->tm1 = RaXPol_Ray_Tm(&ray_hdr);
+    e_p->src_sz = sb->st_size;
+    e_p->src_mtime = sb->st_mtime;
+    e_p->scan_type = file_hdr.scan_type;
+    e_p->servmode = file_hdr.servmode;
+    e_p->num_gates = file_hdr.num_rng_gates;
+    e_p->gate_spacing = file_hdr.range_gate_spacing;
+
+    /* Note whether file has a current ray index */
+    RaXPol_Idx_Init(&idx);
+    e_p->idx = RaXPol_Idx_Open(&idx, fl_nm, NULL)
+	&& idx.ray_hdr_sz == (int)RaXPol_Ray_Hdr_Sz(file_hdr.old_fmt);
+    RaXPol_Idx_Free(&idx);
+    if ( !(e_p->path = MALLOC(strlen(fl_nm) + 1)) ) {
+	fprintf(stderr, "%s: could not allocate path for %s.\n",
+		argv0, fl_nm);
+	goto end;
+    }
+    strcpy(e_p->path, fl_nm);
+    status = 1;
+
+end:
+    fclose(fl);
+    return status;
+}
+
+/*
+   Return index of first entry in catalog at cat_p whose first ray is after
+   tm, or cat_p->num_entries if there is none.
+ */
+
+static size_t cat_search(struct Cat *cat_p, double tm)
+{
+    size_t lo = 0, hi = cat_p->num_entries, m;
+
+    while ( lo < hi ) {
+	m = lo + (hi - lo) / 2;
+	if ( cat_p->entries[m].tm0 <= tm ) {
+	    lo = m + 1;
+	} else {
+	    hi = m;
+	}
+    }
+    return lo;
+}
+
+/* Compare catalog entries by time of first ray, for qsort */
+static int cmp_entry(const void *a, const void *b)
+{
+    const struct Entry *ea = a, *eb = b;
+
+    return (ea->tm0 < eb->tm0) ? -1 : (ea->tm0 > eb->tm0) ? 1 : 0;
+}
@@ -32,47 +32,77 @@
 
 #include "unix_defs.h"
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #include <limits.h>
+#include <math.h>
 #include "alloc.h"
+#include "type_nbit.h"
 #include "tm_calc_lib.h"
 #include "raxpol.h"
+#include "raxpol_mom.h"
+#include "raxpol_idx.h"
+#include "raxpol_prof.h"
+#include "raxpol_seq.h"
 
 static char *argv0;			/* Name of the executable */
 
-#define FFMT "%.5g "			/* Float format */
+/*
+   Float format. sprint_5g must produce the same output as FFMT, without
+   the trailing space. FFMT_SZ is the longest output, with margin.
+ */
+
+#define FFMT "%.5g"
+#define FFMT_SZ 32
+
+/* Size of stdio buffer for ASCII output */
+#define OUT_BUF_SZ 1048576
+
+/* Number of fallback results sprint_5g remembers */
+#define FB_CACHE_SZ 256
 
 #define NUM_OUT_MAX 11			/* Number of output fields */
 
+/* Number of rays to read at a time from a moment cache */
+#define CACHE_CHUNK 256
+
 #define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
 
 /* Local functions */ 
 static void fprintf_field(float *, size_t, char *m, FILE *);
-static void fwrite_field(float *, size_t, char *, FILE *);
+static size_t sprint_5g(char *, float);
+static FILE *mom_out(int *);
 static float *alloc_field_f(char *, size_t);
 
 int main(int argc, char *argv[])
 {
-    char *argv0;			/* argv[0] */
     extern char *optarg;		/* See getopt (3) */
     extern int optind;			/* See getopt (3) */
     int c;				/* Index into argv */
     int ray_hdrs = 0;			/* If true, print ray headers, too */
     long r0, num_rays;			/* First ray, number of rays to print */
     long num_rays_max;			/* Number of rays from r0 to EOF */
-    char *raxpol_fl_nm;			/* RaXPol file path */
-    FILE *raxpol_fl;			/* RaXPol file */
+    char *tm_rng = NULL;		/* Time range from command line */
+    double tm0, tm1;			/* Start, end of time range */
+    int idx_sel = 0;			/* If true, rays selected by index */
+    char *stdin_nm = "-";		/* File name for standard input */
+    char **raxpol_fl_nms;		/* RaXPol file paths */
+    int num_fls;			/* Number of RaXPol files */
+    struct RaXPol_Seq seq;		/* Rays from all RaXPol files */
     double dflt_hdg;			/* Default heading */
     long r;				/* Ray index in loop */
-    struct RaXPol_Ray_Hdr ray_hdr;	/* Ray header */ 
-    off_t o0;				/* Offset to start of first ray */
-    off_t o;				/* Offset somewhere in raxpol_fl */
-    off_t ray_sz;			/* Size in file of one ray */
 
     int num_gates;			/* Number of gates */
+    int g_start = -1, g_end = -1;	/* Gate window from command line */
+    int ray_gates;			/* Number of gates in a ray */
+    int gate_step = 1, ray_step = 1;	/* Number of gates, rays averaged
+					   into one, from command line */
+    long num_rd = 1;			/* Number of rays read for output
+					   ray */
     struct RaXPol_Data dat;		/* Data for one ray */
 
     /*
@@ -99,6 +129,7 @@ int main(int argc, char *argv[])
     };
 
     int n;				/* Index from out_dat */
+    double t0;				/* Profile start time */
     size_t num_out = NUM_OUT_MAX;	/* Number of output moments */
     char *oa;				/* Point into opt_arg */
     char *optarg_m;			/* List of moments from command line */
@@ -107,27 +138,50 @@ int main(int argc, char *argv[])
     char *all_moments
 	= "DBMHC DBMVC DBZ DBZ1 VEL ZDR PHIDP RHOHV STD SNRHC SNRVC";
 
-    /* Field output */
-    int (*prhdr)(struct RaXPol_Ray_Hdr *, FILE *);
-    void (*prfld)(float *, size_t, char *m, FILE *);
+    /* Binary output. See raxpol_mom.h */
+    int bin = 0;			/* If true, write a moment file */
+    struct RaXPol_Mom_Hdr mom_hdr;	/* Moment file header */
+    struct RaXPol_Mom_Ray mom_ray;	/* Ray table entry */
+    int mom_fd = -1;			/* Moment file descriptor */
+    FILE *spool = NULL;			/* If not NULL, temporary file for
+					   moment file, to be copied to
+					   standard output */
+    char *mom_nms[NUM_OUT_MAX];		/* Moment names */
+    float *mom_flds[NUM_OUT_MAX];	/* Moment values */
+
+    /* Moment cache input. See raxpol_cache (1) */
+    int use_cache = 0;			/* If true, try to use a moment cache */
+    int follow = 0;			/* If true, wait for new rays */
+    int cache_fd = -1;			/* Moment cache file descriptor */
+    struct RaXPol_Mom_Hdr cache_hdr;	/* Moment cache header */
+    int cache_idx[NUM_OUT_MAX];		/* Index in cache of each moment */
+    float *cache_buf[NUM_OUT_MAX];	/* Values for CACHE_CHUNK rays */
+    struct RaXPol_Mom_Ray *cache_rays = NULL;	/* Rays in cache_buf */
+    long cache_r0 = 0, cache_nr = 0;	/* Index of first ray, number of rays
+					   in cache_buf */
 
     argv0 = argv[0];
+    RaXPol_Prof_Init(argv0);
+    RaXPol_Seq_Init(&seq);
     r0 = 0;
     num_rays = LONG_MAX;
-    prhdr = RaXPol_FPrint_Ray_Hdr;
-    prfld =  fprintf_field;
     if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
 	RaXPol_Old_Fmt();
     }
-    while ((c = getopt(argc, argv, ":Vblrh:m:s:c:")) != -1) {
+    while ((c = getopt(argc, argv, ":VbCflrh:m:s:c:t:g:d:")) != -1) {
 	switch(c) {
 	    case 'V':
 		printf("%s\n", RAXPOL_MOMENT_VERSION);
 		exit(EXIT_SUCCESS);
 		break;
 	    case 'b':
-		prhdr = RaXPol_FWrite_Ray_Hdr;
-		prfld =  fwrite_field;
+		bin = 1;
+		break;
+	    case 'C':
+		use_cache = 1;
+		break;
+	    case 'f':
+		follow = 1;
 		break;
 	    case 'r':
 		ray_hdrs = 1;
@@ -185,53 +239,104 @@ int main(int argc, char *argv[])
 		}
 		break;
 	    case 's':
+		idx_sel = 1;
 		if ( sscanf(optarg, "%ld", &r0) != 1 ) {
 		    fprintf(stderr, "%s: expected integer for index of first "
 			    "ray, got %s\n", argv0, optarg);
 		    exit(EXIT_FAILURE);
 		}
+		break;
 	    case 'c':
+		idx_sel = 1;
 		if ( sscanf(optarg, "%ld", &num_rays) != 1 ) {
 		    fprintf(stderr, "%s: expected integer for count, got %s\n",
 			    argv0, optarg);
 		    exit(EXIT_FAILURE);
 		}
 		break;
+	    case 't':
+		tm_rng = optarg;
+		if ( !RaXPol_Scan_Tm_Rng(tm_rng, &tm0, &tm1) ) {
+		    fprintf(stderr, "%s: could not read time range.\n",
+			    argv0);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'g':
+		if ( sscanf(optarg, "%d,%d", &g_start, &g_end) != 2 ) {
+		    fprintf(stderr, "%s: expected start,end for gate window, "
+			    "got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'd':
+		if ( sscanf(optarg, "%d,%d", &gate_step, &ray_step) != 2
+			|| gate_step < 1 || ray_step < 1 ) {
+		    fprintf(stderr, "%s: expected positive gate_step,ray_step "
+			    "for decimation, got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
 	    case '?':
-		fprintf(stderr, "Usage: %s [-b] [-l] [-h angle] [-s start] "
-			"[-c count] [raxpol_file]\n", argv0);
+		fprintf(stderr, "Usage: %s [-b] [-C] [-f] [-l] [-r] [-h angle] "
+			"[-m moment,moment,...] [-s start] [-c count] "
+			"[-t start,end] [-g start,end] [-d gate_step,ray_step] "
+			"[raxpol_file ...]\n", argv0);
 		exit(EXIT_FAILURE);
 		break;
 	}
     }
     if ( optind ==  argc ) {
-	raxpol_fl_nm = "-";
-    } else if ( optind + 1 == argc ) {
-	raxpol_fl_nm = argv[optind];
+	raxpol_fl_nms = &stdin_nm;
+	num_fls = 1;
     } else {
-	fprintf(stderr, "Usage: %s [-b] [-l] [-r] [-h angle] "
-		"[-m moment,moment,...] [-s start] [-c count] [raxpol_file]",
-		argv0);
+	raxpol_fl_nms = argv + optind;
+	num_fls = argc - optind;
+    }
+    if ( tm_rng && idx_sel ) {
+	fprintf(stderr, "%s: -t cannot be used with -s or -c.\n", argv0);
+	exit(EXIT_FAILURE);
+    }
+    if ( follow && (tm_rng || bin) ) {
+	fprintf(stderr, "%s: -f cannot be used with -t or -b.\n", argv0);
 	exit(EXIT_FAILURE);
     }
-    if ( strcmp(raxpol_fl_nm, "-") == 0 ) {
-	raxpol_fl = stdin;
-    } else if ( !(raxpol_fl = fopen(raxpol_fl_nm, "r")) ) {
-	fprintf(stderr, "%s: could not open %s for reading.\n",
-		argv0, raxpol_fl_nm);
+    if ( (g_start != -1 || gate_step > 1 || ray_step > 1) && bin ) {
+	fprintf(stderr, "%s: -g and -d cannot be used with -b.\n", argv0);
 	exit(EXIT_FAILURE);
     }
 
-    /* Read file header. Compute some convenience constants. */ 
-    if ( !RaXPol_Init_Data(&dat, raxpol_fl) ) {
+    /*
+       Read file headers. Files are read as one sequence of rays, so ray
+       indeces continue from one file to the next.
+       In follow mode, the sequence waits for rays that have not been written
+       yet, so output is flushed after every ray.
+     */
+
+    if ( follow ) {
+	RaXPol_Seq_Follow(&seq);
+    }
+    if ( !RaXPol_Seq_Open(&seq, raxpol_fl_nms, num_fls, &dat) ) {
 	fprintf(stderr, "%s: failed to initialize RaXPol data structure.\n",
 		argv0);
 	exit(EXIT_FAILURE);
     }
-    num_gates = dat.file_hdr.num_rng_gates;
-    if ( (o0 = ftello(raxpol_fl)) == -1 ) {
-	fprintf(stderr, "%s: could not determine position in file.\n%s\n",
-		argv0, strerror(errno));
+    ray_gates = num_gates = dat.file_hdr.num_rng_gates;
+    if ( g_start != -1 ) {
+	if ( !RaXPol_Set_Gate_Window(&dat, g_start, g_end) ) {
+	    fprintf(stderr, "%s: could not set gate window.\n", argv0);
+	    exit(EXIT_FAILURE);
+	}
+    } else {
+	g_start = 0;
+    }
+    if ( !RaXPol_Set_Gate_Step(&dat, gate_step) ) {
+	fprintf(stderr, "%s: could not set gate step.\n", argv0);
+	exit(EXIT_FAILURE);
+    }
+    num_gates = RaXPol_Num_Gates(&dat);
+    if ( !bin && !follow && setvbuf(stdout, NULL, _IOFBF, OUT_BUF_SZ) != 0 ) {
+	fprintf(stderr, "%s: could not set output buffer.\n", argv0);
 	exit(EXIT_FAILURE);
     }
 
@@ -273,70 +378,203 @@ int main(int argc, char *argv[])
 	}
     }
 
-    /* Determine ray size and num_rays_max */
-    if ( !RaXPol_Read_Ray_Hdr(&ray_hdr, raxpol_fl) ) {
-	fprintf(stderr, "%s: failed to read header for first ray.\n",
-		argv0);
-	exit(EXIT_FAILURE);
+    /* Determine num_rays_max */
+    if ( tm_rng ) {
+	long r1;			/* End of time range */
+
+	if ( (r0 = RaXPol_Seq_Tm_Ray(&seq, tm0, 0)) == -1
+		|| (r1 = RaXPol_Seq_Tm_Ray(&seq, tm1, 1)) == -1 ) {
+	    fprintf(stderr, "%s: could not find rays for time range %s\n",
+		    argv0, tm_rng);
+	    exit(EXIT_FAILURE);
+	}
+	num_rays = r1 - r0;
     }
-    if ( (o = ftello(raxpol_fl)) == -1 ) {
-	fprintf(stderr, "%s: could not determine position in file.\n%s\n",
-		argv0, strerror(errno));
-	exit(EXIT_FAILURE);
+    num_rays_max = seq.num_rays - r0;
+    if ( !follow && num_rays > num_rays_max ) {
+	num_rays = num_rays_max;
     }
-    ray_sz = o - o0 + ray_hdr.data_size;
-    if ( fseeko(raxpol_fl, 0, SEEK_END) == -1
-	    || (o = ftello(raxpol_fl)) == -1 ) {
-	fprintf(stderr, "%s: could not position at end of file.\n"
-		"%s\n", argv0, strerror(errno));
-	exit(EXIT_FAILURE);
+
+    /*
+       If requested, look for a moment cache with all of the output moments.
+       Ray headers are not in the cache, so it is not used with -r. Cached
+       moments are rounded, and cannot be averaged, so it is not used with -d.
+     */
+
+    if ( use_cache && !ray_hdrs && gate_step == 1 && ray_step == 1
+	    && !follow && num_fls == 1 && seq.in != stdin
+	    && (cache_fd = RaXPol_Mom_Open_Cache(raxpol_fl_nms[0], &dat,
+		    &cache_hdr)) != -1 ) {
+	for (n = 0; n < num_out; n++) {
+	    cache_idx[n] = RaXPol_Mom_Fld_Idx(&cache_hdr, out_dat[n].nm);
+	    if ( cache_idx[n] == -1 ) {
+		close(cache_fd);
+		cache_fd = -1;
+		break;
+	    }
+	}
     }
-    num_rays_max = (o - o0) / ray_sz - r0;
-    if ( num_rays > num_rays_max ) {
-	num_rays = num_rays_max;
+
+    /*
+       Move to first ray. Moments depend on noise averages from previous
+       rays, so restore the averages from the ray index if there is one,
+       otherwise read the previous rays. Cached moments do not need this.
+     */
+
+    if ( cache_fd == -1 && num_rays > 0 ) {
+	if ( !RaXPol_Seq_Seek(&seq, r0) ) {
+	    fprintf(stderr, "%s: could not position at start of first ray.\n",
+		    argv0);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if ( cache_fd != -1 ) {
+	if ( r0 + num_rays > cache_hdr.num_rays ) {
+	    fprintf(stderr, "%s: moment cache for %s has %d rays, need %ld.\n",
+		    argv0, raxpol_fl_nms[0], cache_hdr.num_rays, r0 + num_rays);
+	    exit(EXIT_FAILURE);
+	}
+	for (n = 0; n < num_out; n++) {
+	    if ( !(cache_buf[n] = CALLOC((size_t)CACHE_CHUNK * ray_gates,
+			    sizeof(float))) ) {
+		fprintf(stderr, "%s: could not allocate cache buffer for "
+			"%s\n", argv0, out_dat[n].nm);
+		exit(EXIT_FAILURE);
+	    }
+	}
+	if ( !(cache_rays = CALLOC(CACHE_CHUNK,
+			sizeof(struct RaXPol_Mom_Ray))) ) {
+	    fprintf(stderr, "%s: could not allocate cache ray table.\n",
+		    argv0);
+	    exit(EXIT_FAILURE);
+	}
     }
 
-    /* Move to first ray */
-    if ( r0 > 0 ) {
-	if ( fseeko(raxpol_fl, o0 + r0 * ray_sz, SEEK_SET) == -1 ) {
-	    fprintf(stderr, "%s: could not position at start of first ray.\n"
-		    "%s\n", argv0, strerror(errno));
+    /* Set up moment file, if writing binary output. */
+    if ( bin ) {
+	if ( num_rays > INT_MAX ) {
+	    fprintf(stderr, "%s: too many rays (%ld) for moment file.\n",
+		    argv0, num_rays);
 	    exit(EXIT_FAILURE);
 	}
-    } else {
-	if ( fseeko(raxpol_fl, o0, SEEK_SET) == -1) {
-	    fprintf(stderr, "%s: could not position at end of file.\n"
-		    "%s\n", argv0, strerror(errno));
+	for (n = 0; n < num_out; n++) {
+	    mom_nms[n] = out_dat[n].nm;
+	    mom_flds[n] = out_dat[n].f;
+	}
+	if ( !RaXPol_Mom_Init_Hdr(&mom_hdr, &dat, r0, num_rays, mom_nms,
+		    num_out, RAXPOL_MOM_F4) ) {
+	    fprintf(stderr, "%s: could not initialize moment file header.\n",
+		    argv0);
 	    exit(EXIT_FAILURE);
 	}
+	spool = mom_out(&mom_fd);
     }
 
     /* Read and print rays. */
-    for (r = r0; r < r0 + num_rays; r++) {
-	if ( !RaXPol_Read_Ray(&dat, raxpol_fl) ) {
-	    if ( ferror(raxpol_fl) ) {
-		fprintf(stderr, "%s: could not read ray %ld\n",
-			argv0, r);
+    for (r = r0; r < r0 + num_rays; r += num_rd) {
+	if ( cache_fd != -1 ) {
+	    /* Copy moments from cache, reading another chunk if needed. */
+	    if ( r >= cache_r0 + cache_nr ) {
+		cache_r0 = r;
+		cache_nr = r0 + num_rays - r;
+		if ( cache_nr > CACHE_CHUNK ) {
+		    cache_nr = CACHE_CHUNK;
+		}
+		for (n = 0; n < num_out; n++) {
+		    if ( !RaXPol_Mom_Read_Fld(&cache_hdr, cache_fd,
+				cache_idx[n], cache_r0, cache_nr,
+				cache_buf[n]) ) {
+			fprintf(stderr, "%s: could not read %s from moment "
+				"cache.\n", argv0, out_dat[n].nm);
+			exit(EXIT_FAILURE);
+		    }
+		}
+		if ( !RaXPol_Mom_Read_Rays(&cache_hdr, cache_fd, cache_r0,
+			    cache_nr, cache_rays) ) {
+		    fprintf(stderr, "%s: could not read rays from moment "
+			    "cache.\n", argv0);
+		    exit(EXIT_FAILURE);
+		}
+	    }
+	    for (n = 0; n < num_out; n++) {
+		memcpy(out_dat[n].f,
+			cache_buf[n] + (r - cache_r0) * ray_gates + g_start,
+			num_gates * sizeof(float));
+	    }
+	    mom_ray = cache_rays[r - cache_r0];
+	} else {
+	    num_rd = (ray_step < r0 + num_rays - r)
+		? ray_step : r0 + num_rays - r;
+	    if ( (num_rd = RaXPol_Seq_Read_Rays(&seq, num_rd)) == -1 ) {
+		fprintf(stderr, "%s: could not read ray %ld\n", argv0, r);
 		exit(EXIT_FAILURE);
-	    } else {
-		exit(EXIT_SUCCESS);
 	    }
+	    for (n = 0; n < num_out; n++) {
+		t0 = RaXPol_Prof_Start();
+		if ( !out_dat[n].calc(&dat, out_dat[n].f) ) {
+		    fprintf(stderr, "%s: could not compute %s for ray %ld\n",
+			    argv0, out_dat[n].nm, r);
+		    exit(EXIT_FAILURE);
+		}
+		RaXPol_Prof_Mom(out_dat[n].nm, t0, num_gates);
+	    }
+	    RaXPol_Mom_Set_Ray(&mom_ray, &dat.ray_hdr);
 	}
-	if ( ray_hdrs ) {
-	    if ( prhdr == RaXPol_FPrint_Ray_Hdr ) {
-		printf("ray %ld\n", r);
+	t0 = RaXPol_Prof_Start();
+	if ( ray_hdrs && !bin ) {
+	    printf("ray %ld\n", r + (num_rd - 1) / 2);
+	    RaXPol_FPrint_Ray_Hdr(&dat.ray_hdr, stdout);
+	}
+	if ( bin ) {
+	    if ( !RaXPol_Mom_Write_Ray(&mom_hdr, mom_fd, r - r0, &mom_ray,
+			mom_flds) ) {
+		fprintf(stderr, "%s: could not write ray %ld to moment file.\n",
+			argv0, r);
+		exit(EXIT_FAILURE);
+	    }
+	} else {
+	    for (n = 0; n < num_out; n++) {
+		fprintf_field(out_dat[n].f, num_gates, out_dat[n].nm, stdout);
+	    }
+	    printf("\n");
+	    if ( follow ) {
+		fflush(stdout);
 	    }
-	    prhdr(&ray_hdr, stdout);
 	}
-	for (n = 0; n < num_out; n++) {
-	    if ( !out_dat[n].calc(&dat, out_dat[n].f) ) {
-		fprintf(stderr, "%s: could not compute %s for ray %ld\n",
-			argv0, out_dat[n].nm, r);
+	RaXPol_Prof_Stop("output", t0, 1);
+    }
+
+    /*
+       Finish moment file. Header gets the number of rays actually read.
+       If output went to a temporary file, copy it to standard output.
+     */
+
+    if ( bin ) {
+	mom_hdr.num_rays = r - r0;
+	if ( !RaXPol_Mom_Write_Hdr(&mom_hdr, mom_fd) ) {
+	    fprintf(stderr, "%s: could not write moment file header.\n",
+		    argv0);
+	    exit(EXIT_FAILURE);
+	}
+	if ( spool ) {
+	    char buf[BUFSIZ];
+	    size_t sz;
+
+	    rewind(spool);
+	    while ( (sz = fread(buf, 1, BUFSIZ, spool)) > 0 ) {
+		if ( fwrite(buf, 1, sz, stdout) != sz ) {
+		    fprintf(stderr, "%s: could not copy moment file to "
+			    "standard output.\n%s\n", argv0, strerror(errno));
+		    exit(EXIT_FAILURE);
+		}
+	    }
+	    if ( ferror(spool) ) {
+		fprintf(stderr, "%s: could not read temporary moment file.\n"
+			"%s\n", argv0, strerror(errno));
 		exit(EXIT_FAILURE);
 	    }
-	    prfld(out_dat[n].f, num_gates, out_dat[n].nm, stdout);
+	    fclose(spool);
 	}
-	printf("\n");
     }
 
     return 0;
@@ -344,48 +582,249 @@ int main(int argc, char *argv[])
 
 /*
    If not "", print nm to out. Then print n ascii floats from f to out,
-   followed by a newline.
+   followed by a newline. The line is assembled in a local buffer and
+   sent to out with one call to fwrite.
  */
 
 static void fprintf_field(float *f, size_t n, char *nm, FILE *out)
 {
+    static char *buf;			/* Output line */
+    static size_t buf_sz;		/* Allocation at buf */
+    char *b_tmp;
+    char *b;				/* Point into buf */
+    size_t sz;				/* Size of output line */
+    size_t nm_len;			/* strlen(nm) */
     float *f1;				/* End of array f */
 
     if ( !f || !nm ) {
 	fprintf(stderr, "No data to print for field %s\n", nm ? nm : "unknown");
 	exit(EXIT_FAILURE);
     }
-    if ( strlen(nm) > 0 ) {
-	fprintf(out, "%s ", nm);
+    nm_len = strlen(nm);
+    sz = nm_len + 1 + n * (FFMT_SZ + 1) + 1;
+    if ( sz > buf_sz ) {
+	if ( !(b_tmp = REALLOC(buf, sz)) ) {
+	    fprintf(stderr, "%s: could not allocate output line for %s\n",
+		    argv0, nm);
+	    exit(EXIT_FAILURE);
+	}
+	buf = b_tmp;
+	buf_sz = sz;
+    }
+    b = buf;
+    if ( nm_len > 0 ) {
+	memcpy(b, nm, nm_len);
+	b += nm_len;
+	*b++ = ' ';
     }
     for (f1 = f + n; f < f1; f++) {
-	fprintf(out, FFMT, *f);
+	b += sprint_5g(b, *f);
+	*b++ = ' ';
+    }
+    *b++ = '\n';
+    if ( fwrite(buf, 1, b - buf, out) != (size_t)(b - buf) ) {
+	fprintf(stderr, "%s: could not write data for %s.\n%s\n",
+		argv0, nm, strerror(errno));
+	exit(EXIT_FAILURE);
     }
-    fprintf(out, "\n");
 }
 
-/* Write n floats from f to out. Field assumed to be named nm. */ 
-static void fwrite_field(float *f, size_t n, char *nm, FILE *out)
+/*
+   Print f to buf with same result as sprintf(buf, FFMT, f), but faster.
+   Return number of characters printed. Terminating nul is not printed.
+
+   If 1.0e-8 < |f| < 9.0e18, the value is rounded to 5 significant digits
+   with exact integer arithmetic, ties to even, as the C library does.
+   Otherwise, including zero, subnormal, infinite, and nan values,
+   this function calls snprintf and caches the result for the next time
+   the same bit pattern appears.
+ */
+
+static size_t sprint_5g(char *buf, float f)
 {
-    size_t sz = strlen(nm);
+    static const U64BIT pow10[] = {
+	1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL,
+	100000000UL, 1000000000UL, 10000000000UL, 100000000000UL,
+	1000000000000UL, 10000000000000UL, 100000000000000UL,
+	1000000000000000UL, 10000000000000000UL, 100000000000000000UL,
+	1000000000000000000UL
+    };
+    int n_pow10 = sizeof(pow10) / sizeof(pow10[0]);
+    U64BIT u_max = ~(U64BIT)0;
 
-    if ( !f || !nm ) {
-	fprintf(stderr, "No data to print for field %s\n", nm ? nm : "unknown");
-	exit(EXIT_FAILURE);
+    /* Results from snprintf for values outside the fast path */
+    static U32BIT fb_bits[FB_CACHE_SZ];
+    static char fb_ok[FB_CACHE_SZ];
+    static char fb_s[FB_CACHE_SZ][FFMT_SZ];
+    static size_t fb_len[FB_CACHE_SZ];
+    int h;				/* Index into fb_... arrays */
+
+    U32BIT bits;			/* Bits in f */
+    int e_bits;				/* Exponent bits from f */
+    U64BIT num, den;			/* |f| * 10^(4 - x) = num / den */
+    int e2;				/* |f| = m * 2^e2 */
+    int x;				/* Decimal exponent of leading digit */
+    int k;				/* 4 - x */
+    int i;
+    U64BIT q, r;			/* Quotient, remainder num / den */
+    char dgts[5];			/* Significant digits */
+    int nd;				/* Number of digits, less trailing
+					   zeros */
+    char *b = buf;
+
+    memcpy(&bits, &f, sizeof(bits));
+    e_bits = (bits >> 23) & 0xFF;
+    if ( e_bits == 0 || e_bits == 0xFF ) {
+	goto fallback;
     }
-    if ( fwrite(&sz, sizeof(size_t), 1, out) != 1 ) {
-	fprintf(stderr, "%s: could not write size of field name for %s.\n",
-		argv0, nm);
-	exit(EXIT_FAILURE);
+    e2 = e_bits - 150;
+
+    /*
+       Guess x from the binary exponent, then compute the first five
+       significant digits, adjusting x until there are exactly five.
+     */
+
+    x = (int)floor((e2 + 23) * 0.30102999566398120);
+    for (i = 0; i < 3; i++) {
+	num = (bits & 0x7FFFFF) | 0x800000;
+	den = 1;
+	k = 4 - x;
+	if ( k >= 0 ) {
+	    if ( k >= n_pow10 || num > u_max / pow10[k] ) {
+		goto fallback;
+	    }
+	    num *= pow10[k];
+	} else {
+	    if ( -k >= n_pow10 ) {
+		goto fallback;
+	    }
+	    den = pow10[-k];
+	}
+	if ( e2 >= 0 ) {
+	    if ( e2 >= 63 || num > (u_max >> e2) ) {
+		goto fallback;
+	    }
+	    num <<= e2;
+	} else {
+	    if ( -e2 >= 63 || den > (u_max >> -e2) ) {
+		goto fallback;
+	    }
+	    den <<= -e2;
+	}
+	q = num / den;
+	if ( q < 10000 ) {
+	    x--;
+	} else if ( q >= 100000 ) {
+	    x++;
+	} else {
+	    break;
+	}
     }
-    if ( fwrite(nm, sz, 1, out) != 1 ) {
-	fprintf(stderr, "%s: could not write field name for %s.\n", argv0, nm);
-	exit(EXIT_FAILURE);
+    if ( i == 3 ) {
+	goto fallback;
+    }
+    r = num % den;
+    if ( r > den - r || (r == den - r && (q & 1)) ) {
+	if ( ++q == 100000 ) {
+	    q = 10000;
+	    x++;
+	}
+    }
+    for (i = 4; i >= 0; i--) {
+	dgts[i] = '0' + q % 10;
+	q /= 10;
+    }
+    for (nd = 5; nd > 1 && dgts[nd - 1] == '0'; nd--) {
+    }
+
+    /* Print digits in style e or style f, as %g would */
+    if ( bits >> 31 ) {
+	*b++ = '-';
+    }
+    if ( x < -4 || x >= 5 ) {
+	*b++ = dgts[0];
+	if ( nd > 1 ) {
+	    *b++ = '.';
+	    for (i = 1; i < nd; i++) {
+		*b++ = dgts[i];
+	    }
+	}
+	*b++ = 'e';
+	*b++ = (x < 0) ? '-' : '+';
+	x = abs(x);
+	if ( x >= 100 ) {
+	    *b++ = '0' + x / 100;
+	    x %= 100;
+	}
+	*b++ = '0' + x / 10;
+	*b++ = '0' + x % 10;
+    } else if ( x >= 0 ) {
+	for (i = 0; i <= x; i++) {
+	    *b++ = dgts[i];
+	}
+	if ( nd > x + 1 ) {
+	    *b++ = '.';
+	    for ( ; i < nd; i++) {
+		*b++ = dgts[i];
+	    }
+	}
+    } else {
+	*b++ = '0';
+	*b++ = '.';
+	for (i = -1; i > x; i--) {
+	    *b++ = '0';
+	}
+	for (i = 0; i < nd; i++) {
+	    *b++ = dgts[i];
+	}
+    }
+    return b - buf;
+
+fallback:
+    h = (bits ^ (bits >> 8) ^ (bits >> 16) ^ (bits >> 24)) % FB_CACHE_SZ;
+    if ( !fb_ok[h] || fb_bits[h] != bits ) {
+	int l = snprintf(fb_s[h], FFMT_SZ, FFMT, f);
+
+	if ( l < 0 || l >= FFMT_SZ ) {
+	    fprintf(stderr, "%s: could not format value.\n", argv0);
+	    exit(EXIT_FAILURE);
+	}
+	fb_len[h] = l;
+	fb_bits[h] = bits;
+	fb_ok[h] = 1;
+    }
+    memcpy(buf, fb_s[h], fb_len[h]);
+    return fb_len[h];
+}
+
+/*
+   Set up output for a moment file. Moment files are written with pwrite, so
+   if standard output is a regular file opened at offset 0 and not in append
+   mode, write there directly and return NULL. Otherwise, create a temporary
+   file and return it. The caller must copy it to standard output after
+   writing the moment file. Put file descriptor for writing at fd_p.
+ */
+
+static FILE *mom_out(int *fd_p)
+{
+    struct stat sb;
+    int flags;
+    FILE *spool;
+
+    if ( fstat(STDOUT_FILENO, &sb) == 0 && S_ISREG(sb.st_mode)
+	    && lseek(STDOUT_FILENO, 0, SEEK_CUR) == 0
+	    && (flags = fcntl(STDOUT_FILENO, F_GETFL)) != -1
+	    && !(flags & O_APPEND) ) {
+	*fd_p = STDOUT_FILENO;
+	return NULL;
     }
-    if ( fwrite(f, sizeof(float), n, out) != n ) {
-	fprintf(stderr, "%s: could not write field name for %s.\n", argv0, nm);
+    if ( !(spool = tmpfile()) ) {
+	fprintf(stderr, "%s: could not create temporary file for moment "
+		"file.\n%s\n", argv0, strerror(errno));
 	exit(EXIT_FAILURE);
     }
+    *fd_p = fileno(spool);
+    return spool;
 }
 
 /* Allocate memory for an output field named nm with space for n floats */ 
@@ -38,6 +38,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include "raxpol.h"
+#include "raxpol_prof.h"
 
 #define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
 
@@ -54,6 +55,7 @@ int main(int argc, char *argv[])
     struct RaXPol_Ray_Hdr ray_hdr;	/* Ray header from the RaXPol file */
 
     argv0 = argv[0];
+    RaXPol_Prof_Init(argv0);
     if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
 	RaXPol_Old_Fmt();
     }
@@ -99,7 +101,7 @@ int main(int argc, char *argv[])
 		"file header.\n", argv0);
 	exit(EXIT_FAILURE);
     }
-    if ( !RaXPol_Read_Ray_Hdr(&ray_hdr, raxpol_fl) ) {
+    if ( !RaXPol_Read_Ray_Hdr(&ray_hdr, raxpol_fl, file_hdr.old_fmt) ) {
 	fprintf(stderr, "%s: failed to read first ray header.\n", argv0);
 	exit(EXIT_FAILURE);
     }
@@ -127,7 +129,7 @@ int main(int argc, char *argv[])
 		argv0);
 	exit(EXIT_FAILURE);
     }
-    if ( !RaXPol_Read_Ray_Hdr(&ray_hdr, raxpol_fl) ) {
+    if ( !RaXPol_Read_Ray_Hdr(&ray_hdr, raxpol_fl, file_hdr.old_fmt) ) {
 	fprintf(stderr, "%s: failed to read last ray header.\n", argv0);
 	exit(EXIT_FAILURE);
     }
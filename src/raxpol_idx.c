@@ -0,0 +1,590 @@
+/*
+   -	raxpol_idx.c --
+   -		This file defines functions that store and access RaXPol
+   -		ray indeces. See raxpol_idx.h.
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "alloc.h"
+#include "type_nbit.h"
+#include "val_buf.h"
+#include "swap.h"
+#include "raxpol.h"
+#include "raxpol_idx.h"
+
+/* Value of endian tag in host byte order */
+#define ENDIAN_TAG 0x01020304
+
+/* Number of ray table entries to add when growing the ray table */
+#define RAY_INC 1024
+
+static int idx_ray_tm(struct RaXPol_Idx *, FILE *, off_t, off_t, int, long,
+	double *);
+static int ray_tm(FILE *, off_t, int, double *);
+static U8BYT get_u8(char **);
+static void put_u8(char **, U8BYT);
+
+/* Initialize an empty ray index */
+void RaXPol_Idx_Init(struct RaXPol_Idx *idx_p)
+{
+    memset(idx_p, 0, sizeof(struct RaXPol_Idx));
+    idx_p->servmode = RAXPOL_UNK;
+    idx_p->rays = NULL;
+}
+
+/* Free memory in ray index and reinitialize it */
+void RaXPol_Idx_Free(struct RaXPol_Idx *idx_p)
+{
+    FREE(idx_p->rays);
+    RaXPol_Idx_Init(idx_p);
+}
+
+/*
+   Make a ray index at idx_p for all rays in RaXPol stream in. dat_p must
+   have been initialized with RaXPol_Init_Data, with in positioned at the
+   first ray. Rays are read until end of file. Source file size and time are
+   left 0.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Idx_Make(struct RaXPol_Idx *idx_p, struct RaXPol_Data *dat_p,
+	FILE *in)
+{
+    struct RaXPol_Ray_Hdr *rh_p = &dat_p->ray_hdr;
+    struct RaXPol_Idx_Ray *ray_p;
+    int num_rays_max = 0;		/* Allocated size of ray table */
+    off_t o;				/* Offset in in */
+
+    RaXPol_Idx_Free(idx_p);
+    idx_p->servmode = dat_p->servmode;
+    idx_p->ray_hdr_sz = RaXPol_Ray_Hdr_Sz(dat_p->file_hdr.old_fmt);
+    if ( (idx_p->o0 = ftello(in)) == -1 ) {
+	fprintf(stderr, "Could not determine position of first ray.\n%s\n",
+		strerror(errno));
+	return 0;
+    }
+    while ( 1 ) {
+	if ( idx_p->num_rays == num_rays_max ) {
+	    struct RaXPol_Idx_Ray *t;
+
+	    if ( num_rays_max > INT_MAX - RAY_INC ) {
+		fprintf(stderr, "Too many rays for ray index.\n");
+		goto error;
+	    }
+	    num_rays_max += RAY_INC;
+	    t = REALLOC(idx_p->rays,
+		    num_rays_max * sizeof(struct RaXPol_Idx_Ray));
+	    if ( !t ) {
+		fprintf(stderr, "Could not allocate ray index for %d rays.\n",
+			num_rays_max);
+		goto error;
+	    }
+	    idx_p->rays = t;
+	}
+	ray_p = idx_p->rays + idx_p->num_rays;
+	ray_p->v_noise_avg = dat_p->v_noise_avg;
+	ray_p->h_noise_avg = dat_p->h_noise_avg;
+	if ( !RaXPol_Read_Ray(dat_p, in) ) {
+	    if ( ferror(in) ) {
+		fprintf(stderr, "Could not read ray %d.\n", idx_p->num_rays);
+		goto error;
+	    }
+	    break;
+	}
+	ray_p->tm = RaXPol_Ray_Tm(rh_p);
+	ray_p->az = rh_p->az;
+	ray_p->el = rh_p->el;
+	ray_p->sweep_count = rh_p->sweep_count;
+	ray_p->volume_count = rh_p->volume_count;
+	if ( idx_p->num_rays == 0 ) {
+	    if ( (o = ftello(in)) == -1 ) {
+		fprintf(stderr, "Could not determine ray size.\n%s\n",
+			strerror(errno));
+		goto error;
+	    }
+	    idx_p->ray_sz = o - idx_p->o0;
+	}
+	idx_p->num_rays++;
+    }
+    return 1;
+
+error:
+    RaXPol_Idx_Free(idx_p);
+    return 0;
+}
+
+/*
+   Write ray index at idx_p to stream out.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Idx_Write(struct RaXPol_Idx *idx_p, FILE *out)
+{
+    char buf[RAXPOL_IDX_HDR_SZ];
+    char *b;
+    int r;
+
+    memset(buf, 0, RAXPOL_IDX_HDR_SZ);
+    b = buf;
+    ValBuf_PutBytes(&b, RAXPOL_IDX_MAGIC, sizeof(RAXPOL_IDX_MAGIC));
+    b = buf + 8;
+    ValBuf_PutI4BYT(&b, ENDIAN_TAG);
+    ValBuf_PutI4BYT(&b, RAXPOL_IDX_VERSION);
+    ValBuf_PutI4BYT(&b, idx_p->num_rays);
+    ValBuf_PutI4BYT(&b, idx_p->servmode);
+    put_u8(&b, idx_p->o0);
+    put_u8(&b, idx_p->ray_sz);
+    put_u8(&b, idx_p->src_sz);
+    put_u8(&b, idx_p->src_mtime);
+    ValBuf_PutI4BYT(&b, idx_p->ray_hdr_sz);
+    if ( fwrite(buf, RAXPOL_IDX_HDR_SZ, 1, out) != 1 ) {
+	fprintf(stderr, "Could not write ray index header.\n%s\n",
+		strerror(errno));
+	return 0;
+    }
+    for (r = 0; r < idx_p->num_rays; r++) {
+	struct RaXPol_Idx_Ray *ray_p = idx_p->rays + r;
+
+	b = buf;
+	ValBuf_PutF8BYT(&b, ray_p->tm);
+	ValBuf_PutF4BYT(&b, ray_p->az);
+	ValBuf_PutF4BYT(&b, ray_p->el);
+	ValBuf_PutI4BYT(&b, ray_p->sweep_count);
+	ValBuf_PutI4BYT(&b, ray_p->volume_count);
+	ValBuf_PutF4BYT(&b, ray_p->v_noise_avg);
+	ValBuf_PutF4BYT(&b, ray_p->h_noise_avg);
+	if ( fwrite(buf, RAXPOL_IDX_RAY_SZ, 1, out) != 1 ) {
+	    fprintf(stderr, "Could not write ray index entry for ray %d.\n"
+		    "%s\n", r, strerror(errno));
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+   Read a ray index from stream in into idx_p.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Idx_Read(struct RaXPol_Idx *idx_p, FILE *in)
+{
+    char buf[RAXPOL_IDX_HDR_SZ];
+    char *b;
+    I4BYT tag, version;
+    int r;
+
+    RaXPol_Idx_Free(idx_p);
+    if ( fread(buf, RAXPOL_IDX_HDR_SZ, 1, in) != 1 ) {
+	fprintf(stderr, "Could not read ray index header.\n");
+	return 0;
+    }
+    if ( memcmp(buf, RAXPOL_IDX_MAGIC, sizeof(RAXPOL_IDX_MAGIC)) != 0 ) {
+	fprintf(stderr, "Not a RaXPol ray index.\n");
+	return 0;
+    }
+    memcpy(&tag, buf + 8, 4);
+    if ( tag != ENDIAN_TAG ) {
+	Swap_On();
+	Swap_4Byt(&tag);
+	Swap_Off();
+	if ( tag != ENDIAN_TAG ) {
+	    fprintf(stderr, "Ray index has unknown byte order.\n");
+	    return 0;
+	}
+	Swap_On();
+    }
+    b = buf + 12;
+    if ( (version = ValBuf_GetI4BYT(&b)) != RAXPOL_IDX_VERSION ) {
+	fprintf(stderr, "Ray index has unknown version %d.\n", version);
+	goto error;
+    }
+    idx_p->num_rays = ValBuf_GetI4BYT(&b);
+    idx_p->servmode = ValBuf_GetI4BYT(&b);
+    idx_p->o0 = get_u8(&b);
+    idx_p->ray_sz = get_u8(&b);
+    idx_p->src_sz = get_u8(&b);
+    idx_p->src_mtime = get_u8(&b);
+    idx_p->ray_hdr_sz = ValBuf_GetI4BYT(&b);
+    if ( idx_p->num_rays < 0 || (idx_p->num_rays > 0 && idx_p->ray_sz <= 0) ) {
+	fprintf(stderr, "Ray index has bad dimensions: %d rays of %ld "
+		"bytes.\n", idx_p->num_rays, (long)idx_p->ray_sz);
+	goto error;
+    }
+    if ( idx_p->num_rays > 0 ) {
+	idx_p->rays = CALLOC(idx_p->num_rays, sizeof(struct RaXPol_Idx_Ray));
+	if ( !idx_p->rays ) {
+	    fprintf(stderr, "Could not allocate ray index for %d rays.\n",
+		    idx_p->num_rays);
+	    goto error;
+	}
+    }
+    for (r = 0; r < idx_p->num_rays; r++) {
+	struct RaXPol_Idx_Ray *ray_p = idx_p->rays + r;
+
+	if ( fread(buf, RAXPOL_IDX_RAY_SZ, 1, in) != 1 ) {
+	    fprintf(stderr, "Could not read ray index entry for ray %d.\n", r);
+	    goto error;
+	}
+	b = buf;
+	ray_p->tm = ValBuf_GetF8BYT(&b);
+	ray_p->az = ValBuf_GetF4BYT(&b);
+	ray_p->el = ValBuf_GetF4BYT(&b);
+	ray_p->sweep_count = ValBuf_GetI4BYT(&b);
+	ray_p->volume_count = ValBuf_GetI4BYT(&b);
+	ray_p->v_noise_avg = ValBuf_GetF4BYT(&b);
+	ray_p->h_noise_avg = ValBuf_GetF4BYT(&b);
+    }
+    Swap_Off();
+    return 1;
+
+error:
+    Swap_Off();
+    RaXPol_Idx_Free(idx_p);
+    return 0;
+}
+
+/*
+   Return path to ray index for RaXPol file raxpol_fl_nm, in memory
+   allocated with MALLOC. Caller should eventually FREE it.
+   Returns NULL on failure.
+ */
+
+char *RaXPol_Idx_Path(char *raxpol_fl_nm)
+{
+    char *path;
+    size_t sz;
+
+    sz = strlen(raxpol_fl_nm) + strlen(RAXPOL_IDX_SFX) + 1;
+    if ( !(path = MALLOC(sz)) ) {
+	fprintf(stderr, "Could not allocate ray index path for %s.\n",
+		raxpol_fl_nm);
+	return NULL;
+    }
+    strcpy(path, raxpol_fl_nm);
+    strcat(path, RAXPOL_IDX_SFX);
+    return path;
+}
+
+/*
+   Return true if ray index at idx_p was made from a RaXPol file with status
+   src_sb, whose header has been read into dat_p, in the ray header format
+   of dat_p. If dat_p is NULL, server mode and format are not checked.
+ */
+
+int RaXPol_Idx_Match(struct RaXPol_Idx *idx_p, struct RaXPol_Data *dat_p,
+	struct stat *src_sb)
+{
+    return idx_p->src_sz == src_sb->st_size
+	&& idx_p->src_mtime == src_sb->st_mtime
+	&& (!dat_p || (idx_p->servmode == dat_p->servmode
+		    && idx_p->ray_hdr_sz
+		    == (int)RaXPol_Ray_Hdr_Sz(dat_p->file_hdr.old_fmt)));
+}
+
+/*
+   Read the ray index for RaXPol file raxpol_fl_nm into idx_p, if the index
+   exists and matches the file. dat_p must have the file header, from
+   RaXPol_Init_Data, or be NULL if the caller only needs ray times and
+   positions.
+
+   Return 1 if idx_p receives a current index. Return 0, with no message,
+   if there is no current index.
+ */
+
+int RaXPol_Idx_Open(struct RaXPol_Idx *idx_p, char *raxpol_fl_nm,
+	struct RaXPol_Data *dat_p)
+{
+    char *path;
+    struct stat sb;
+    FILE *in;
+    int status;
+
+    RaXPol_Idx_Free(idx_p);
+    if ( stat(raxpol_fl_nm, &sb) == -1 || !S_ISREG(sb.st_mode) ) {
+	return 0;
+    }
+    if ( !(path = RaXPol_Idx_Path(raxpol_fl_nm)) ) {
+	return 0;
+    }
+    in = fopen(path, "r");
+    FREE(path);
+    if ( !in ) {
+	return 0;
+    }
+    status = RaXPol_Idx_Read(idx_p, in) && RaXPol_Idx_Match(idx_p, dat_p, &sb);
+    fclose(in);
+    if ( !status ) {
+	RaXPol_Idx_Free(idx_p);
+    }
+    return status;
+}
+
+/*
+   Position RaXPol stream in at ray r, and set the running noise averages
+   in dat_p to the values they would have if rays 0 through r - 1 had been
+   read, so that moments for ray r and following rays match moments from a
+   pass through the whole file. o0 is the offset to ray 0, ray_sz is the
+   size of a ray. dat_p must have been initialized with RaXPol_Init_Data
+   from in.
+
+   If idx_p is not NULL, it must have the ray index for in, and the noise
+   averages come from the index. Rays after the last ray in the index, and
+   all rays if idx_p is NULL, are read from in to update the averages.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Idx_Seek_Ray(struct RaXPol_Idx *idx_p, struct RaXPol_Data *dat_p,
+	FILE *in, off_t o0, off_t ray_sz, long r)
+{
+    long r1 = 0;			/* Ray to start reading from */
+
+    dat_p->v_noise_avg = dat_p->h_noise_avg = 0.0;
+    if ( idx_p && idx_p->num_rays > 0 ) {
+	if ( idx_p->o0 != o0 || idx_p->ray_sz != ray_sz ) {
+	    fprintf(stderr, "Ray index does not match RaXPol file.\n");
+	    return 0;
+	}
+	r1 = (r < idx_p->num_rays) ? r : idx_p->num_rays - 1;
+	dat_p->v_noise_avg = idx_p->rays[r1].v_noise_avg;
+	dat_p->h_noise_avg = idx_p->rays[r1].h_noise_avg;
+    }
+    if ( fseeko(in, o0 + r1 * ray_sz, SEEK_SET) == -1 ) {
+	fprintf(stderr, "Could not position at ray %ld.\n%s\n",
+		r1, strerror(errno));
+	return 0;
+    }
+    for ( ; r1 < r; r1++) {
+	if ( !RaXPol_Read_Ray(dat_p, in) ) {
+	    fprintf(stderr, "Could not read ray %ld while seeking ray %ld.\n",
+		    r1, r);
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+   Return the number of rays at the start of RaXPol stream in with times
+   before tm, or, if incl is true, not after tm. tm is seconds since
+   1970-01-01 00:00:00. Rays must be in time order. The return value is the
+   index of the first ray at or after tm (at or before tm if incl is true),
+   or num_rays if there is no such ray. o0 is the offset to ray 0, ray_sz is
+   the size of a ray, and num_rays is the number of rays in the stream. Ray
+   headers are in "old" (2011) format if old_fmt is true.
+
+   If idx_p is not NULL and has an entry for every ray, the times come from
+   the index and in is not used. Otherwise, ray headers are read from in.
+   Probes are interpolated from the times of the rays that bracket tm, with
+   bisection whenever interpolation fails to halve the bracket, so the number
+   of headers read is logarithmic in num_rays at worst. Position of in is
+   undefined on return.
+
+   Returns -1 on failure. Prints error messages to stderr on failure.
+ */
+
+long RaXPol_Idx_Tm_Ray(struct RaXPol_Idx *idx_p, FILE *in, off_t o0,
+	off_t ray_sz, int old_fmt, long num_rays, double tm, int incl)
+{
+    long lo, hi;			/* Rays before lo are before tm. Rays
+					   at and after hi are not. */
+    double t_lo, t_hi;			/* Times of rays lo - 1 and hi */
+    long r;				/* Ray to probe */
+    double t;				/* Time of ray r */
+    int bisect = 0;			/* If true, bisect next probe */
+
+    if ( num_rays <= 0 ) {
+	return 0;
+    }
+    if ( idx_p && idx_p->num_rays >= num_rays ) {
+	lo = 0;
+	hi = num_rays;
+	while ( lo < hi ) {
+	    r = lo + (hi - lo) / 2;
+	    t = idx_p->rays[r].tm;
+	    if ( incl ? t <= tm : t < tm ) {
+		lo = r + 1;
+	    } else {
+		hi = r;
+	    }
+	}
+	return lo;
+    }
+
+    /* Bracket tm with the first and last rays */
+    if ( !ray_tm(in, o0, old_fmt, &t_lo) ) {
+	return -1;
+    }
+    if ( !(incl ? t_lo <= tm : t_lo < tm) ) {
+	return 0;
+    }
+    if ( !ray_tm(in, o0 + (num_rays - 1) * ray_sz, old_fmt, &t_hi) ) {
+	return -1;
+    }
+    if ( incl ? t_hi <= tm : t_hi < tm ) {
+	return num_rays;
+    }
+    lo = 1;
+    hi = num_rays - 1;
+    while ( lo < hi ) {
+	long n = hi - lo;
+
+	if ( bisect || !(t_hi > t_lo) ) {
+	    r = lo + n / 2;
+	} else {
+	    r = lo - 1 + (long)((tm - t_lo) / (t_hi - t_lo) * (n + 1));
+	    r = (r < lo) ? lo : (r >= hi) ? hi - 1 : r;
+	}
+	if ( !ray_tm(in, o0 + r * ray_sz, old_fmt, &t) ) {
+	    return -1;
+	}
+	if ( incl ? t <= tm : t < tm ) {
+	    lo = r + 1;
+	    t_lo = t;
+	} else {
+	    hi = r;
+	    t_hi = t;
+	}
+	bisect = !bisect && (hi - lo) > n / 2;
+    }
+    return lo;
+}
+
+/*
+   Same as RaXPol_Idx_Tm_Ray, except that the caller knows that rays before
+   r are before tm (not after tm if incl is true), for example because r was
+   the answer for an earlier time. Probes rays at exponentially increasing
+   distances from r until one is at or after tm, then bisects the last step,
+   so the number of rays examined is logarithmic in the distance from r to
+   the answer. This makes a sequence of queries for increasing times cheap.
+
+   Returns -1 on failure. Prints error messages to stderr on failure.
+ */
+
+long RaXPol_Idx_Gallop(struct RaXPol_Idx *idx_p, FILE *in, off_t o0,
+	off_t ray_sz, int old_fmt, long num_rays, long r, double tm, int incl)
+{
+    long lo, hi;			/* Rays before lo are before tm. Rays
+					   at and after hi are not. */
+    long step;				/* Distance to next probe */
+    long p;				/* Ray to probe */
+    double t;				/* Time of ray p */
+
+    lo = (r < 0) ? 0 : r;
+    hi = num_rays;
+    for (step = 1; lo < hi; step *= 2) {
+	p = (step > hi - lo) ? hi - 1 : lo + step - 1;
+	if ( !idx_ray_tm(idx_p, in, o0, ray_sz, old_fmt, p, &t) ) {
+	    return -1;
+	}
+	if ( incl ? t <= tm : t < tm ) {
+	    lo = p + 1;
+	} else {
+	    hi = p;
+	    break;
+	}
+    }
+    while ( lo < hi ) {
+	p = lo + (hi - lo) / 2;
+	if ( !idx_ray_tm(idx_p, in, o0, ray_sz, old_fmt, p, &t) ) {
+	    return -1;
+	}
+	if ( incl ? t <= tm : t < tm ) {
+	    lo = p + 1;
+	} else {
+	    hi = p;
+	}
+    }
+    return lo;
+}
+
+/*
+   Copy time of ray r to tm_p, from the index at idx_p if it has the ray,
+   otherwise from the ray header in stream in.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int idx_ray_tm(struct RaXPol_Idx *idx_p, FILE *in, off_t o0,
+	off_t ray_sz, int old_fmt, long r, double *tm_p)
+{
+    if ( idx_p && r < idx_p->num_rays ) {
+	*tm_p = idx_p->rays[r].tm;
+	return 1;
+    }
+    return ray_tm(in, o0 + r * ray_sz, old_fmt, tm_p);
+}
+
+/*
+   Read header for ray at offset o in stream in, in "old" (2011) format if
+   old_fmt is true, and copy its time to tm_p.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int ray_tm(FILE *in, off_t o, int old_fmt, double *tm_p)
+{
+    struct RaXPol_Ray_Hdr ray_hdr;
+
+    if ( fseeko(in, o, SEEK_SET) == -1
+	    || !RaXPol_Read_Ray_Hdr(&ray_hdr, in, old_fmt) ) {
+	fprintf(stderr, "Could not read ray header at offset %lld.\n",
+		(long long)o);
+	return 0;
+    }
+    *tm_p = RaXPol_Ray_Tm(&ray_hdr);
+    return 1;
+}
+
+static U8BYT get_u8(char **buf_p)
+{
+    U8BYT u;
+
+    memcpy(&u, *buf_p, 8);
+    *buf_p += 8;
+    Swap_8Byt(&u);
+    return u;
+}
+
+static void put_u8(char **buf_p, U8BYT u)
+{
+    Swap_8Byt(&u);
+    memcpy(*buf_p, &u, 8);
+    *buf_p += 8;
+}
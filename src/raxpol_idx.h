@@ -0,0 +1,125 @@
+/*
+   -	raxpol_idx.h --
+   -		This header file declares structures and functions
+   -		that store and access RaXPol ray indeces, which are
+   -		sidecar files that record time, position, and noise
+   -		state for every ray in a RaXPol data file.
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+/*
+   A ray index has the following layout. Integers and floats are stored in
+   the byte order of the host that wrote the file. Readers compare the
+   endian tag to 0x01020304 to determine whether they must swap bytes.
+
+   .	File header, RAXPOL_IDX_HDR_SZ bytes
+   .	    0	char[8]	magic, RAXPOL_IDX_MAGIC, nul padded
+   .	    8	int32	endian tag, 0x01020304
+   .	   12	int32	format version, RAXPOL_IDX_VERSION
+   .	   16	int32	number of rays
+   .	   20	int32	server mode, enum RAXPOL_SERVMODE in raxpol.h
+   .	   24	uint64	offset in RaXPol file to first ray
+   .	   32	uint64	size in RaXPol file of one ray, header and data
+   .	   40	uint64	size of RaXPol file, bytes
+   .	   48	int64	modification time of RaXPol file, seconds since
+   .			1970-01-01 00:00:00 UTC
+   .	   56	int32	size of ray header, distinguishes old (2011) format
+   .	   60	...	zero
+   .
+   .	Ray table, RAXPOL_IDX_RAY_SZ bytes per ray, starting at
+   .	RAXPOL_IDX_HDR_SZ
+   .	    0	float64	time, seconds since 1970-01-01 00:00:00 UTC
+   .	    8	float32	pedestal azimuth, degrees
+   .	   12	float32	pedestal elevation, degrees
+   .	   16	int32	sweep count
+   .	   20	int32	volume count
+   .	   24	float32	running vertical noise average before this ray
+   .	   28	float32	running horizontal noise average before this ray
+
+   The noise averages are the v_noise_avg and h_noise_avg members of
+   struct RaXPol_Data as they were when the ray was read in a pass from the
+   first ray. Restoring them before reading a ray makes the moments for the
+   ray identical to the moments from a pass through the whole file.
+
+   A ray index is stored next to its RaXPol file, with RAXPOL_IDX_SFX
+   appended to the name.
+ */
+
+#ifndef RAXPOL_IDX_H_
+#define RAXPOL_IDX_H_
+
+#include "unix_defs.h"
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "raxpol.h"
+
+#define RAXPOL_IDX_MAGIC "RXPLIDX"
+#define RAXPOL_IDX_VERSION 1
+#define RAXPOL_IDX_HDR_SZ 64
+#define RAXPOL_IDX_RAY_SZ 32
+#define RAXPOL_IDX_SFX ".idx"
+
+struct RaXPol_Idx_Ray {
+    double tm;				/* Seconds since 1970-01-01 00:00:00 */
+    float az, el;			/* Pedestal azimuth, elevation */
+    int sweep_count;			/* Sweep count */
+    int volume_count;			/* Volume count */
+    float v_noise_avg, h_noise_avg;	/* Noise averages before this ray */
+};
+
+struct RaXPol_Idx {
+    int num_rays;			/* Number of rays */
+    enum RAXPOL_SERVMODE servmode;	/* Server mode */
+    off_t o0;				/* Offset to first ray */
+    off_t ray_sz;			/* Size of one ray */
+    int ray_hdr_sz;			/* Size of ray header */
+    off_t src_sz;			/* Size of RaXPol file */
+    time_t src_mtime;			/* Modification time of RaXPol file */
+    struct RaXPol_Idx_Ray *rays;	/* Ray table, dimensioned num_rays */
+};
+
+void RaXPol_Idx_Init(struct RaXPol_Idx *);
+void RaXPol_Idx_Free(struct RaXPol_Idx *);
+int RaXPol_Idx_Make(struct RaXPol_Idx *, struct RaXPol_Data *, FILE *);
+int RaXPol_Idx_Write(struct RaXPol_Idx *, FILE *);
+int RaXPol_Idx_Read(struct RaXPol_Idx *, FILE *);
+char *RaXPol_Idx_Path(char *);
+int RaXPol_Idx_Match(struct RaXPol_Idx *, struct RaXPol_Data *,
+	struct stat *);
+int RaXPol_Idx_Open(struct RaXPol_Idx *, char *, struct RaXPol_Data *);
+int RaXPol_Idx_Seek_Ray(struct RaXPol_Idx *, struct RaXPol_Data *, FILE *,
+	off_t, off_t, long);
+long RaXPol_Idx_Tm_Ray(struct RaXPol_Idx *, FILE *, off_t, off_t, int, long,
+	double, int);
+long RaXPol_Idx_Gallop(struct RaXPol_Idx *, FILE *, off_t, off_t, int, long,
+	long, double, int);
+
+#endif
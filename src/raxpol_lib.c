@@ -34,6 +34,7 @@
  */
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
@@ -41,23 +42,89 @@
 #include <float.h>
 #include <complex.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include "alloc.h"
 #include "type_nbit.h"
 #include "val_buf.h"
+#include "swap.h"
 #include "geog_lib.h"
 #include "tm_calc_lib.h"
+#include "raxpol_prof.h"
 #include "raxpol.h"
 
 /* Radar heading. If not NAN, overrides heading from ray headers. */ 
 static double dflt_hdg = NAN;
 
-/* If true, read "older format" files */
-static int old_fmt;
+/*
+   If true, all files are "older format" files. Otherwise,
+   RaXPol_Read_File_Hdr detects the format of each file.
+ */
+
+static int old_fmt_forced;
 
 /* Size of ray header. Varies with version. */
 #define RAXPOL_RAY_HDR_SZ_OLD 276
 #define RAXPOL_RAY_HDR_SZ_NEW 292
-static size_t raxpol_ray_hdr_sz;
+
+/*
+   Ray header layout. Each entry has the offsets of a field in current and
+   old format ray headers, or -1 where the old format lacks the field, the
+   member of struct RaXPol_Ray_Hdr that has the value, the number of bytes
+   to copy, and the size of each value to byte swap, or 1 for text. Fields
+   are in file order. Reserved fields are not copied.
+ */
+
+struct ray_hdr_fld {
+    int o_new, o_old;			/* Offsets in ray header */
+    size_t m;				/* Offset of member */
+    size_t sz;				/* Number of bytes */
+    size_t swap_sz;			/* Size of each value */
+};
+#define RH_FLD(o_new, o_old, mbr, sz, swap_sz) \
+    {o_new, o_old, offsetof(struct RaXPol_Ray_Hdr, mbr), sz, swap_sz}
+static struct ray_hdr_fld ray_hdr_flds[] = {
+    RH_FLD(0, 0, timestamp_seconds, 4, 4),
+    RH_FLD(4, 4, timestamp_useconds, 4, 4),
+    RH_FLD(8, 8, radar_temperatures, 16, 4),
+    RH_FLD(24, 24, inclinometer_roll, 4, 4),
+    RH_FLD(28, 28, inclinometer_pitch, 4, 4),
+    RH_FLD(32, 32, fuel_sensor, 4, 4),
+    RH_FLD(36, 36, cpu_temperature, 4, 4),
+    RH_FLD(40, 40, pedestal_scan_type, 4, 4),
+    RH_FLD(44, 44, tx_power, 4, 4),
+    RH_FLD(48, 48, osc_lock, 4, 4),
+    RH_FLD(68, 68, az, 8, 8),
+    RH_FLD(76, 76, el, 8, 8),
+    RH_FLD(84, 84, az_vel, 8, 8),
+    RH_FLD(92, 92, elev_vel, 8, 8),
+    RH_FLD(100, -1, az_current, 8, 8),
+    RH_FLD(108, -1, elev_current, 8, 8),
+    RH_FLD(116, 100, sweep_count, 4, 4),
+    RH_FLD(120, 104, volume_count, 4, 4),
+    RH_FLD(124, 108, flags, 4, 4),
+    RH_FLD(128, 112, lat_ref, 4, 4),
+    RH_FLD(132, 116, lat, 8, 8),
+    RH_FLD(140, 124, lon_ref, 4, 4),
+    RH_FLD(144, 128, lon, 8, 8),
+    RH_FLD(152, 136, alt, 8, 8),
+    RH_FLD(160, 144, hdg_ref, 4, 4),
+    RH_FLD(164, 148, hdg, 8, 8),
+    RH_FLD(172, 156, speed, 8, 8),
+    RH_FLD(180, 164, nmea_msg_gpgga, 95, 1),
+    RH_FLD(276, 260, utc_time_sec, 4, 4),
+    RH_FLD(280, 264, utc_time_usec, 4, 4),
+    RH_FLD(284, 268, data_type, 4, 4),
+    RH_FLD(288, 272, data_size, 4, 4)
+};
+#define NUM_RAY_HDR_FLDS (sizeof(ray_hdr_flds) / sizeof(ray_hdr_flds[0]))
+
+/*
+   Ray being decoded by RaXPol_Decode_Ray. Ray readers read from here
+   instead of a stream when their stream argument is NULL.
+ */
+
+static char *mem_p;			/* Next byte to decode */
+static char *mem_end;			/* End of ray */
 
 /* Math constants */ 
 #ifndef M_PI
@@ -69,7 +136,20 @@ static size_t raxpol_ray_hdr_sz;
 /* Local functions */ 
 static float *alloc_field_f(char *, size_t);
 static float _Complex *alloc_field_fc(char *, size_t);
+static int decode_ray_hdr(struct RaXPol_Ray_Hdr *, char *, int);
+static void swap_ray_hdr(char *, int, int);
+static int detect_fmt(struct RaXPol_File_Hdr *, FILE *);
+static int probe_ray_hdr(FILE *, off_t, size_t, int, int *, int *);
+static int ray_hdr_in(struct RaXPol_Data *, FILE *);
+static int ray_in(void *, size_t, FILE *, char *);
+static int ray_skip(size_t, FILE *, char *);
+static int in_flds(struct RaXPol_Data *, float **, int *, float _Complex **,
+	int *);
+static int decimate_gates(struct RaXPol_Data *);
+static int field_in(struct RaXPol_Data *, void *, size_t, FILE *, char *,
+	float *);
 static int no_in_stub(struct RaXPol_Data *, FILE *);
+static int init_data_from_hdr(struct RaXPol_Data *);
 static int read_spp_ray(struct RaXPol_Data *, FILE *);
 static int read_spp_sum_pwr_ray(struct RaXPol_Data *, FILE *);
 static int read_dpp_ray(struct RaXPol_Data *, FILE *);
@@ -129,6 +209,7 @@ static int dpp_sum_pwr_snrhc(struct RaXPol_Data *, float *);
 static int dpp_sum_pwr_snrvc(struct RaXPol_Data *, float *);
 double ang_to_ref(const double, const double);
 static float mean(float *, int);
+static int first_gate(struct RaXPol_Data *);
 static double ray_az(struct RaXPol_Ray_Hdr *, int);
 
 /* String representations of enumerators defined in raxpol.h */ 
@@ -141,10 +222,24 @@ static char *scan_type_descr[RAXPOL_N_SCAN_TYPES] = {
     "PPI", "RHI", "Az Raster", "El Raster", "Vol", "Paused"
 };
 
-/* Mandate use of "old" (2011) format */ 
+/*
+   Mandate use of "old" (2011) format for files read afterward, instead of
+   detecting it. This applies to the whole process.
+ */ 
+
 void RaXPol_Old_Fmt(void)
 {
-    old_fmt = 1;
+    old_fmt_forced = 1;
+}
+
+/*
+   Return size of a ray header in "old" (2011) format if old_fmt is true,
+   otherwise in current format.
+ */
+
+size_t RaXPol_Ray_Hdr_Sz(int old_fmt)
+{
+    return old_fmt ? RAXPOL_RAY_HDR_SZ_OLD : RAXPOL_RAY_HDR_SZ_NEW;
 }
 
 /* Initialize file header at fh_p with bogus values */
@@ -221,8 +316,20 @@ void RaXPol_Init_File_Hdr(struct RaXPol_File_Hdr *fh_p)
     fh_p->timestamp_usec = -1;
     memset(fh_p->pulse_filter_file_name, '\0', 4096);
     memset(fh_p->custom_waveform_file_name, '\0', 4096);
+    fh_p->old_fmt = old_fmt_forced;
 }
 
+/*
+   Read a file header from in into fh_p. If in is seekable, examine the
+   first rays to determine whether the file has "old" (2011) or current ray
+   headers, unless RaXPol_Old_Fmt has mandated the old format. The format
+   goes in fh_p->old_fmt, which callers give to the ray header readers. in is
+   left at the start of the first ray.
+
+   Returns 1 on success, 0 on failure, or EOF if in is empty. Prints error
+   messages to stderr on failure.
+ */
+
 int RaXPol_Read_File_Hdr(struct RaXPol_File_Hdr *fh_p, FILE *in)
 {
     char buf[RAXPOL_FILE_HDR_SZ];	/* Input buffer */
@@ -239,6 +346,7 @@ int RaXPol_Read_File_Hdr(struct RaXPol_File_Hdr *fh_p, FILE *in)
 	    return 0;
 	}
     }
+    RaXPol_Prof_Count("bytes_read", sz);
     buf_p = buf;
     fh_p->version_code = ValBuf_GetI4BYT(&buf_p);
     fh_p->asp_chirp_bandwidth = ValBuf_GetF8BYT(&buf_p);
@@ -335,6 +443,187 @@ int RaXPol_Read_File_Hdr(struct RaXPol_File_Hdr *fh_p, FILE *in)
     memcpy(fh_p->custom_waveform_file_name, buf_p,
 	    sizeof(fh_p->pulse_filter_file_name) - 1);
     buf_p += sizeof(fh_p->pulse_filter_file_name);
+    fh_p->old_fmt = old_fmt_forced ? 1 : detect_fmt(fh_p, in);
+    return 1;
+}
+
+/*
+   Return true if the rays after file header fh_p in stream in have "old"
+   (2011) headers. in must be at the start of the first ray, and is returned
+   there. Each header size is tried on the first two rays. A header fits if
+   its pedestal scan type is valid and its data size is a positive multiple
+   of the number of range gates. A second ray, if the file is long enough to
+   have one, must have the same data size and a time within a day of the
+   first ray. Otherwise, the file size must be a whole number of rays. If
+   neither size fits better, or in cannot be examined, e.g. a pipe, the
+   current format is assumed.
+ */
+
+static int detect_fmt(struct RaXPol_File_Hdr *fh_p, FILE *in)
+{
+    struct stat sb;			/* Status of in */
+    off_t o0;				/* Offset of first ray */
+    size_t hdr_sz[2] = {RAXPOL_RAY_HDR_SZ_NEW, RAXPOL_RAY_HDR_SZ_OLD};
+    int score[2] = {0, 0};		/* How well each size fits */
+    int n;				/* Index into hdr_sz and score */
+    off_t ray_sz;			/* Ray size for hdr_sz[n] */
+    int data_sz, data_sz1;		/* Data sizes from ray headers */
+    int tm, tm1;			/* Times from ray headers */
+
+    if ( (o0 = ftello(in)) == -1 || fstat(fileno(in), &sb) == -1
+	    || !S_ISREG(sb.st_mode) ) {
+	return 0;
+    }
+    for (n = 0; n < 2; n++) {
+	if ( !probe_ray_hdr(in, o0, hdr_sz[n], fh_p->num_rng_gates,
+		    &data_sz, &tm) ) {
+	    continue;
+	}
+	score[n] = 1;
+	ray_sz = hdr_sz[n] + data_sz;
+	if ( sb.st_size >= o0 + ray_sz + (off_t)hdr_sz[n] ) {
+	    if ( probe_ray_hdr(in, o0 + ray_sz, hdr_sz[n],
+			fh_p->num_rng_gates, &data_sz1, &tm1)
+		    && data_sz1 == data_sz && abs(tm1 - tm) < 86400 ) {
+		score[n] = 2;
+	    }
+	} else if ( (sb.st_size - o0) % ray_sz == 0 ) {
+	    score[n] = 2;
+	}
+    }
+    clearerr(in);
+    if ( fseeko(in, o0, SEEK_SET) == -1 ) {
+	fprintf(stderr, "Could not return to first ray after checking ray "
+		"header format.\n%s\n", strerror(errno));
+    }
+    return score[1] > score[0];
+}
+
+/*
+   Read a ray header of hdr_sz bytes at offset o in stream in, without
+   printing anything. If it has a valid pedestal scan type and a data size
+   that is a positive multiple of num_gates, copy the data size and time
+   to data_sz_p and tm_p and return true. Otherwise return false.
+ */
+
+static int probe_ray_hdr(FILE *in, off_t o, size_t hdr_sz, int num_gates,
+	int *data_sz_p, int *tm_p)
+{
+    char buf[RAXPOL_RAY_HDR_SZ_NEW];	/* Ray header */
+    char *buf_p;			/* Pointer into buf */
+    int scan_type;			/* Pedestal scan type */
+
+    if ( fseeko(in, o, SEEK_SET) == -1 || fread(buf, hdr_sz, 1, in) != 1 ) {
+	return 0;
+    }
+    buf_p = buf;
+    *tm_p = ValBuf_GetI4BYT(&buf_p);
+    buf_p = buf + 10 * 4;
+    scan_type = ValBuf_GetI4BYT(&buf_p);
+    buf_p = buf + hdr_sz - 4;
+    *data_sz_p = ValBuf_GetI4BYT(&buf_p);
+    return scan_type >= 0 && scan_type <= RAXPOL_PAUSED
+	&& num_gates > 0 && *data_sz_p > 0 && *data_sz_p % num_gates == 0;
+}
+
+/*
+   Write file header at fh_p to out in the RaXPol file format, with native
+   byte order.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Write_File_Hdr(struct RaXPol_File_Hdr *fh_p, FILE *out)
+{
+    char buf[RAXPOL_FILE_HDR_SZ];	/* Output buffer */
+    char *buf_p;			/* Pointer into buf */
+
+    memset(buf, 0, sizeof(buf));
+    buf_p = buf;
+    ValBuf_PutI4BYT(&buf_p, fh_p->version_code);
+    ValBuf_PutF8BYT(&buf_p, fh_p->asp_chirp_bandwidth);
+    ValBuf_PutF8BYT(&buf_p, fh_p->asp_chirp_center_freq);
+    ValBuf_PutI4BYT(&buf_p, fh_p->asp_chirp_intrl_delay);
+    ValBuf_PutF8BYT(&buf_p, fh_p->asp_chirp_width);
+    ValBuf_PutF8BYT(&buf_p, fh_p->asp_hop_ctr_freq);
+    ValBuf_PutF8BYT(&buf_p, fh_p->asp_hop_step_freq);
+    ValBuf_PutI4BYT(&buf_p, fh_p->asp_hop_width);
+    ValBuf_PutI4BYT(&buf_p, fh_p->asp_num_hops);
+    ValBuf_PutI4BYT(&buf_p, fh_p->asp_trigger_delay);
+    ValBuf_PutF8BYT(&buf_p, fh_p->asp_tukey_alpha);
+    ValBuf_PutI4BYT(&buf_p, fh_p->asp_waveform_type);
+    buf_p += 4;			/* Skip reserved */
+    ValBuf_PutI4BYT(&buf_p, fh_p->asp_chirp_delay);
+    ValBuf_PutF8BYT(&buf_p, fh_p->clutter_filter_width);
+    ValBuf_PutI4BYT(&buf_p, fh_p->clutter_avg_intvl);
+    ValBuf_PutF8BYT(&buf_p, fh_p->data_rate);
+    ValBuf_PutI4BYT(&buf_p, fh_p->fft_length);
+    ValBuf_PutI4BYT(&buf_p, fh_p->fft_window_type);
+    buf_p += 4;			/* Skip reserved */
+    ValBuf_PutI4BYT(&buf_p, fh_p->auto_file_roll_num_rec);
+    ValBuf_PutI4BYT(&buf_p, fh_p->auto_file_roll_num_scans);
+    ValBuf_PutI4BYT(&buf_p, fh_p->auto_file_roll_flsz);
+    ValBuf_PutI4BYT(&buf_p, fh_p->auto_file_roll_start_time);
+    ValBuf_PutI4BYT(&buf_p, fh_p->auto_file_roll_type);
+    buf_p += 4;			/* Skip reserved */
+    ValBuf_PutF8BYT(&buf_p, fh_p->filter_bandwidth);
+    ValBuf_PutI4BYT(&buf_p, fh_p->group_interval);
+    ValBuf_PutF8BYT(&buf_p, fh_p->H_dBZ_dBm_offset);
+    ValBuf_PutF8BYT(&buf_p, fh_p->H_noise_power);
+    ValBuf_PutF8BYT(&buf_p, fh_p->integration_time);
+    ValBuf_PutF8BYT(&buf_p, fh_p->max_sampled_range);
+    ValBuf_PutI4BYT(&buf_p, fh_p->num_rng_gates);
+    ValBuf_PutI4BYT(&buf_p, fh_p->number_group_pulses);
+    ValBuf_PutI4BYT(&buf_p, fh_p->post_decimation_level);
+    ValBuf_PutI4BYT(&buf_p, fh_p->post_averaging_interval);
+    ValBuf_PutI4BYT(&buf_p, fh_p->pri1);
+    ValBuf_PutI4BYT(&buf_p, fh_p->pri2);
+    ValBuf_PutI4BYT(&buf_p, fh_p->pri_total);
+    ValBuf_PutI4BYT(&buf_p, fh_p->primary_decimation_CIC);
+    ValBuf_PutI4BYT(&buf_p, fh_p->pulse_compression);
+    ValBuf_PutF8BYT(&buf_p, fh_p->fir_output_len_ratio);
+    ValBuf_PutF8BYT(&buf_p, fh_p->fir_output_offset_ratio);
+    buf_p += 4;			/* Skip reserved */
+    ValBuf_PutF8BYT(&buf_p, fh_p->range_gate_spacing);
+    buf_p += 4;			/* Skip reserved */
+    ValBuf_PutF8BYT(&buf_p, fh_p->range_resolution);
+    ValBuf_PutI4BYT(&buf_p, fh_p->record_moments);
+    ValBuf_PutI4BYT(&buf_p, fh_p->record_raw);
+    ValBuf_PutI4BYT(&buf_p, fh_p->recording_enabled);
+    ValBuf_PutI4BYT(&buf_p, fh_p->servmode);
+    buf_p += 4;			/* Skip reserved */
+    ValBuf_PutI4BYT(&buf_p, fh_p->server_state);
+    ValBuf_PutI4BYT(&buf_p, fh_p->skip_count);
+    buf_p += 4;			/* Skip reserved */
+    ValBuf_PutI4BYT(&buf_p, fh_p->software_decimation_level);
+    ValBuf_PutI4BYT(&buf_p, fh_p->sumpower);
+    ValBuf_PutI4BYT(&buf_p, fh_p->switch_delay);
+    ValBuf_PutI4BYT(&buf_p, fh_p->switch_padding);
+    ValBuf_PutI4BYT(&buf_p, fh_p->switch_width);
+    ValBuf_PutI4BYT(&buf_p, fh_p->total_avg_intvl);
+    ValBuf_PutI4BYT(&buf_p, fh_p->twta_internal_delay);
+    ValBuf_PutI4BYT(&buf_p, fh_p->tx_pulse_bracketing);
+    ValBuf_PutI4BYT(&buf_p, fh_p->tx_delay);
+    ValBuf_PutI4BYT(&buf_p, fh_p->tx_trigger_delay);
+    ValBuf_PutI4BYT(&buf_p, fh_p->tx_pulse_center_offset);
+    ValBuf_PutF8BYT(&buf_p, fh_p->unambiguous_range);
+    ValBuf_PutI4BYT(&buf_p, fh_p->clutter_filter);
+    ValBuf_PutI4BYT(&buf_p, fh_p->custom_TX_waveform_was_used);
+    ValBuf_PutF8BYT(&buf_p, fh_p->V_dBZ_dBm_offset);
+    ValBuf_PutF8BYT(&buf_p, fh_p->v_noise_dBm);
+    ValBuf_PutF8BYT(&buf_p, fh_p->zero_range_gate_index);
+    ValBuf_PutI4BYT(&buf_p, fh_p->scan_type);
+    ValBuf_PutI4BYT(&buf_p, fh_p->num_sweeps);
+    ValBuf_PutI4BYT(&buf_p, fh_p->timestamp_sec);
+    ValBuf_PutI4BYT(&buf_p, fh_p->timestamp_usec);
+    ValBuf_PutBytes(&buf_p, fh_p->pulse_filter_file_name,
+	    sizeof(fh_p->pulse_filter_file_name));
+    ValBuf_PutBytes(&buf_p, fh_p->custom_waveform_file_name,
+	    sizeof(fh_p->custom_waveform_file_name));
+    if ( fwrite(buf, sizeof(buf), 1, out) != 1 ) {
+	fprintf(stderr, "Could not write file header\n%s\n", strerror(errno));
+	return 0;
+    }
     return 1;
 }
 
@@ -460,135 +749,149 @@ void RaXPol_Init_Ray_Hdr(struct RaXPol_Ray_Hdr *rh_p) {
 }
 
 /*
-   Read ray header from in. Return 1/0 on success failure.
+   Read ray header from in, in "old" (2011) format if old_fmt is true,
+   otherwise in current format. Return 1/0 on success failure.
    If input fails, feof(in) or ferror(in) can indicate type of failure.
    (This function does not call clearerr(in).)
  */ 
 
-int RaXPol_Read_Ray_Hdr(struct RaXPol_Ray_Hdr *rh_p, FILE *in)
+int RaXPol_Read_Ray_Hdr(struct RaXPol_Ray_Hdr *rh_p, FILE *in, int old_fmt)
 {
-    static char *buf;			/* Input buffer */
-    char *buf_p;			/* Pointer into buf */
+    char buf[RAXPOL_RAY_HDR_SZ_NEW];	/* Input buffer */
+    size_t sz = RaXPol_Ray_Hdr_Sz(old_fmt);
 
     memset(rh_p, 0, sizeof(struct RaXPol_Ray_Hdr));
-    raxpol_ray_hdr_sz = old_fmt ? RAXPOL_RAY_HDR_SZ_OLD : RAXPOL_RAY_HDR_SZ_NEW;
-    if ( !buf ) {
-	if ( !(buf = MALLOC(raxpol_ray_hdr_sz)) ) {
-	    fprintf(stderr, "Could not allocate %zu bytes for ray header "
-		    "input buffer.\n", raxpol_ray_hdr_sz);
-	    return 0;
-	}
-    }
-    memset(buf, 0, raxpol_ray_hdr_sz);
-    if ( fread(buf, raxpol_ray_hdr_sz, 1, in) != 1 ) {
+    memset(buf, 0, sz);
+    if ( fread(buf, sz, 1, in) != 1 ) {
 	if ( ferror(in) ) {
 	    fprintf(stderr, "Input error while reading ray header.\n");
 	}
 	return 0;
     }
-    buf_p = buf;
+    RaXPol_Prof_Count("bytes_read", sz);
+    return decode_ray_hdr(rh_p, buf, old_fmt);
+}
 
-    rh_p->timestamp_seconds = ValBuf_GetI4BYT(&buf_p);
-    rh_p->timestamp_useconds = ValBuf_GetI4BYT(&buf_p);
-    rh_p->radar_temperatures[0] = ValBuf_GetI4BYT(&buf_p);
-    rh_p->radar_temperatures[1] = ValBuf_GetI4BYT(&buf_p);
-    rh_p->radar_temperatures[2] = ValBuf_GetI4BYT(&buf_p);
-    rh_p->radar_temperatures[3] = ValBuf_GetI4BYT(&buf_p);
-    rh_p->inclinometer_roll = ValBuf_GetI4BYT(&buf_p);
-    rh_p->inclinometer_pitch = ValBuf_GetI4BYT(&buf_p);
-    rh_p->fuel_sensor = ValBuf_GetI4BYT(&buf_p);
-    rh_p->cpu_temperature = ValBuf_GetF4BYT(&buf_p);
-    rh_p->pedestal_scan_type = ValBuf_GetI4BYT(&buf_p);
-    if ( rh_p->pedestal_scan_type < 0
-	    || rh_p->pedestal_scan_type > RAXPOL_PAUSED) {
-	fprintf(stderr, "%d not allowed value for pedestal scan type\n",
-		rh_p->pedestal_scan_type);
-	return 0;
+/*
+   Decode ray header, in "old" (2011) format if old_fmt is true, from buf
+   into rh_p.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int decode_ray_hdr(struct RaXPol_Ray_Hdr *rh_p, char *buf, int old_fmt)
+{
+    double t0;				/* Profile start time */
+    int status;
+
+    t0 = RaXPol_Prof_Start();
+    status = RaXPol_Decode_Ray_Hdrs(rh_p, buf, 0, 1, old_fmt);
+    RaXPol_Prof_Stop("hdr_decode", t0, 1);
+    return status;
+}
+
+/*
+   Decode n ray headers, in "old" (2011) format if old_fmt is true,
+   otherwise in current format, from buf, in which each header starts
+   stride bytes after the previous one, into rh_p, which must have space
+   for n headers. Fields are copied with the layout in ray_hdr_flds. Bytes
+   are swapped, after copying, only if swapping is on.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Decode_Ray_Hdrs(struct RaXPol_Ray_Hdr *rh_p, char *buf,
+	size_t stride, long n, int old_fmt)
+{
+    struct ray_hdr_fld *f, *f_end;	/* Loop over ray_hdr_flds */
+    int o;				/* Offset of field in buf */
+    int swap = Swapping();
+    long r;
+
+    f_end = ray_hdr_flds + NUM_RAY_HDR_FLDS;
+    for (r = 0; r < n; r++, rh_p++, buf += stride) {
+	memset(rh_p, 0, sizeof(struct RaXPol_Ray_Hdr));
+	for (f = ray_hdr_flds; f < f_end; f++) {
+	    o = old_fmt ? f->o_old : f->o_new;
+	    if ( o == -1 ) {
+		continue;
+	    }
+
+	    /* Constant sizes let the compiler copy with single loads */
+	    switch (f->sz) {
+		case 4:
+		    memcpy((char *)rh_p + f->m, buf + o, 4);
+		    break;
+		case 8:
+		    memcpy((char *)rh_p + f->m, buf + o, 8);
+		    break;
+		default:
+		    memcpy((char *)rh_p + f->m, buf + o, f->sz);
+		    break;
+	    }
+	}
+	if ( swap ) {
+	    swap_ray_hdr((char *)rh_p, 1, 0);
+	}
+	if ( rh_p->pedestal_scan_type < 0
+		|| rh_p->pedestal_scan_type > RAXPOL_PAUSED) {
+	    fprintf(stderr, "%d not allowed value for pedestal scan type\n",
+		    rh_p->pedestal_scan_type);
+	    return 0;
+	}
     }
-    rh_p->tx_power = ValBuf_GetF4BYT(&buf_p);
-    rh_p->osc_lock = ValBuf_GetI4BYT(&buf_p);
-    buf_p += 4 * 4;			/* Skip reserved */
-    rh_p->az = ValBuf_GetF8BYT(&buf_p);
-    rh_p->el = ValBuf_GetF8BYT(&buf_p);
-    rh_p->az_vel = ValBuf_GetF8BYT(&buf_p);
-    rh_p->elev_vel = ValBuf_GetF8BYT(&buf_p);
-    if ( !old_fmt ) {
-	rh_p->az_current = ValBuf_GetF8BYT(&buf_p);
-	rh_p->elev_current = ValBuf_GetF8BYT(&buf_p);
-    }
-    rh_p->sweep_count = ValBuf_GetI4BYT(&buf_p);
-    rh_p->volume_count = ValBuf_GetI4BYT(&buf_p);
-    rh_p->flags = ValBuf_GetI4BYT(&buf_p);
-    rh_p->lat_ref = ValBuf_GetI4BYT(&buf_p);
-    rh_p->lat = ValBuf_GetF8BYT(&buf_p);
-    rh_p->lon_ref = ValBuf_GetI4BYT(&buf_p);
-    rh_p->lon = ValBuf_GetF8BYT(&buf_p);
-    rh_p->alt = ValBuf_GetF8BYT(&buf_p);
-    rh_p->hdg_ref = ValBuf_GetI4BYT(&buf_p);
-    rh_p->hdg = ValBuf_GetF8BYT(&buf_p);
-    rh_p->speed = ValBuf_GetF8BYT(&buf_p);
-    memcpy(rh_p->nmea_msg_gpgga, buf_p, sizeof(rh_p->nmea_msg_gpgga) - 1);
-    buf_p += sizeof(rh_p->nmea_msg_gpgga);
-    rh_p->utc_time_sec = ValBuf_GetI4BYT(&buf_p);
-    rh_p->utc_time_usec = ValBuf_GetI4BYT(&buf_p);
-    rh_p->data_type = ValBuf_GetI4BYT(&buf_p);
-    rh_p->data_size = ValBuf_GetI4BYT(&buf_p);
     return 1;
 }
 
-/* Write contents of ray header at rh_p to standard output in native binary */
-int RaXPol_FWrite_Ray_Hdr(struct RaXPol_Ray_Hdr *rh_p, FILE *out)
+/*
+   Swap bytes in each field of a ray header at p. If mbr is true, p is a
+   struct RaXPol_Ray_Hdr, otherwise it is a ray header in "old" (2011)
+   format if old_fmt is true, or in current format.
+ */
+
+static void swap_ray_hdr(char *p, int mbr, int old_fmt)
 {
-    static char *buf;			/* Output buffer */
-    char *buf_p;			/* Pointer into buf */
+    struct ray_hdr_fld *f;
+    char *q, *q_end;			/* Values in a field */
+    int o;				/* Offset of field */
 
-    raxpol_ray_hdr_sz = old_fmt ? RAXPOL_RAY_HDR_SZ_OLD : RAXPOL_RAY_HDR_SZ_NEW;
-    if ( !buf ) {
-	if ( !(buf = MALLOC(raxpol_ray_hdr_sz)) ) {
-	    fprintf(stderr, "Could not allocate %zu bytes for ray header "
-		    "input buffer.\n", raxpol_ray_hdr_sz);
-	    return 0;
+    for (f = ray_hdr_flds; f < ray_hdr_flds + NUM_RAY_HDR_FLDS; f++) {
+	o = mbr ? (int)f->m : old_fmt ? f->o_old : f->o_new;
+	if ( o == -1 || f->swap_sz == 1 ) {
+	    continue;
+	}
+	for (q = p + o, q_end = q + f->sz; q < q_end; q += f->swap_sz) {
+	    if ( f->swap_sz == 4 ) {
+		Swap_4Byt(q);
+	    } else {
+		Swap_8Byt(q);
+	    }
 	}
     }
-    memset(buf, 0, raxpol_ray_hdr_sz);
-    buf_p = buf;
-    ValBuf_PutI4BYT(&buf_p, rh_p->timestamp_seconds);
-    ValBuf_PutI4BYT(&buf_p, rh_p->timestamp_useconds);
-    ValBuf_PutI4BYT(&buf_p, rh_p->radar_temperatures[0]);
-    ValBuf_PutI4BYT(&buf_p, rh_p->radar_temperatures[1]);
-    ValBuf_PutI4BYT(&buf_p, rh_p->radar_temperatures[2]);
-    ValBuf_PutI4BYT(&buf_p, rh_p->radar_temperatures[3]);
-    ValBuf_PutI4BYT(&buf_p, rh_p->inclinometer_roll);
-    ValBuf_PutI4BYT(&buf_p, rh_p->inclinometer_pitch);
-    ValBuf_PutI4BYT(&buf_p, rh_p->fuel_sensor);
-    ValBuf_PutF4BYT(&buf_p, rh_p->cpu_temperature);
-    ValBuf_PutI4BYT(&buf_p, rh_p->pedestal_scan_type);
-    ValBuf_PutF4BYT(&buf_p, rh_p->tx_power);
-    ValBuf_PutI4BYT(&buf_p, rh_p->osc_lock);
-    buf_p += 4 * 4;			/* Skip reserved */
-    ValBuf_PutF8BYT(&buf_p, rh_p->az);
-    ValBuf_PutF8BYT(&buf_p, rh_p->el);
-    ValBuf_PutF8BYT(&buf_p, rh_p->az_vel);
-    ValBuf_PutF8BYT(&buf_p, rh_p->elev_vel);
-    ValBuf_PutF8BYT(&buf_p, rh_p->az_current);
-    ValBuf_PutF8BYT(&buf_p, rh_p->elev_current);
-    ValBuf_PutI4BYT(&buf_p, rh_p->sweep_count);
-    ValBuf_PutI4BYT(&buf_p, rh_p->volume_count);
-    ValBuf_PutI4BYT(&buf_p, rh_p->flags);
-    ValBuf_PutI4BYT(&buf_p, rh_p->lat_ref);
-    ValBuf_PutF8BYT(&buf_p, rh_p->lat);
-    ValBuf_PutI4BYT(&buf_p, rh_p->lon_ref);
-    ValBuf_PutF8BYT(&buf_p, rh_p->lon);
-    ValBuf_PutF8BYT(&buf_p, rh_p->alt);
-    ValBuf_PutI4BYT(&buf_p, rh_p->hdg_ref);
-    ValBuf_PutF8BYT(&buf_p, rh_p->hdg);
-    ValBuf_PutF8BYT(&buf_p, rh_p->speed);
-    ValBuf_PutBytes(&buf_p, rh_p->nmea_msg_gpgga, sizeof(rh_p->nmea_msg_gpgga));
-    ValBuf_PutI4BYT(&buf_p, rh_p->utc_time_sec);
-    ValBuf_PutI4BYT(&buf_p, rh_p->utc_time_usec);
-    ValBuf_PutI4BYT(&buf_p, rh_p->data_type);
-    ValBuf_PutI4BYT(&buf_p, rh_p->data_size);
-    if ( fwrite(buf, raxpol_ray_hdr_sz, 1, out) != 1 ) {
+}
+
+/*
+   Write contents of ray header at rh_p to out in native binary, in "old"
+   (2011) format if old_fmt is true, otherwise in current format.
+ */
+
+int RaXPol_FWrite_Ray_Hdr(struct RaXPol_Ray_Hdr *rh_p, FILE *out, int old_fmt)
+{
+    char buf[RAXPOL_RAY_HDR_SZ_NEW];	/* Output buffer */
+    size_t sz = RaXPol_Ray_Hdr_Sz(old_fmt);
+    struct ray_hdr_fld *f;		/* Loop over ray_hdr_flds */
+    int o;				/* Offset of field in buf */
+
+    memset(buf, 0, sz);
+    for (f = ray_hdr_flds; f < ray_hdr_flds + NUM_RAY_HDR_FLDS; f++) {
+	if ( (o = old_fmt ? f->o_old : f->o_new) != -1 ) {
+	    memcpy(buf + o, (char *)rh_p + f->m, f->sz);
+	}
+    }
+    if ( Swapping() ) {
+	swap_ray_hdr(buf, 0, old_fmt);
+    }
+    if ( fwrite(buf, sz, 1, out) != 1 ) {
 	fprintf(stderr, "Could not write ray header\n%s\n", strerror(errno));
 	return 0;
     }
@@ -703,14 +1006,12 @@ void RaXPol_FPrint_Abbrv_Ray_Hdr(struct RaXPol_Ray_Hdr *rh_p, FILE *out)
 
 int RaXPol_Init_Data(struct RaXPol_Data *dat_p, FILE *in)
 {
-    int num_gates;
-    char *s;
-
 
     memset(dat_p, '\0', sizeof(struct RaXPol_Data));
     RaXPol_Init_File_Hdr(&dat_p->file_hdr);
     dat_p->servmode = RAXPOL_UNK;
     dat_p->v_noise = dat_p->h_noise = 0.0;
+    dat_p->v_noise_avg = dat_p->h_noise_avg = 0.0;
     dat_p->thres_val = NAN;
     dat_p->cal_vv_val = NAN;
     dat_p->cal_hh_val = NAN;
@@ -726,6 +1027,37 @@ int RaXPol_Init_Data(struct RaXPol_Data *dat_p, FILE *in)
 		"ray data structure.\n");
 	return 0;
     }
+    return init_data_from_hdr(dat_p);
+}
+
+/*
+   Initialize data structure at dat_p from the file header at fh_p,
+   as if fh_p had been read from the start of a RaXPol file by
+   RaXPol_Init_Data. This is for applications that create RaXPol data,
+   e.g. to write it with RaXPol_Write_File_Hdr and RaXPol_Write_Ray.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Init_Data_Hdr(struct RaXPol_Data *dat_p, struct RaXPol_File_Hdr *fh_p)
+{
+    RaXPol_Init_Data(dat_p, NULL);
+    dat_p->file_hdr = *fh_p;
+    return init_data_from_hdr(dat_p);
+}
+
+/*
+   Set server mode, allocate input fields, and assign methods in dat_p
+   from dat_p->file_hdr.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int init_data_from_hdr(struct RaXPol_Data *dat_p)
+{
+    int num_gates;
+    char *s;
+
     switch (dat_p->file_hdr.servmode) {
 	case 0:
 	    dat_p->servmode = (dat_p->file_hdr.sumpower)
@@ -752,6 +1084,9 @@ int RaXPol_Init_Data(struct RaXPol_Data *dat_p, FILE *in)
 
     /* Allocate input fields */
     num_gates = dat_p->file_hdr.num_rng_gates;
+    dat_p->g_start = 0;
+    dat_p->g_end = num_gates;
+    dat_p->gate_step = 1;
     switch (dat_p->servmode) {
 	case RAXPOL_SPP:
 	    dat_p->dat_in.spp.zv1 = alloc_field_f("zv1", num_gates);
@@ -913,6 +1248,219 @@ int RaXPol_Init_Data(struct RaXPol_Data *dat_p, FILE *in)
     return 1;
 }
 
+/*
+   Free input fields allocated by RaXPol_Init_Data, and reinitialize dat_p
+   as if RaXPol_Init_Data had been called with a NULL file.
+ */
+
+void RaXPol_Free_Data(struct RaXPol_Data *dat_p)
+{
+    switch (dat_p->servmode) {
+	case RAXPOL_SPP:
+	    free(dat_p->dat_in.spp.zv1);
+	    free(dat_p->dat_in.spp.zv2);
+	    free(dat_p->dat_in.spp.zh1);
+	    free(dat_p->dat_in.spp.zh2);
+	    free(dat_p->dat_in.spp.pp_v);
+	    free(dat_p->dat_in.spp.pp_h);
+	    free(dat_p->dat_in.spp.cc);
+	    break;
+	case RAXPOL_SPP_SUM_PWR:
+	    free(dat_p->dat_in.spp_sum_pwr.zv);
+	    free(dat_p->dat_in.spp_sum_pwr.zh);
+	    free(dat_p->dat_in.spp_sum_pwr.pp_v);
+	    free(dat_p->dat_in.spp_sum_pwr.pp_h);
+	    free(dat_p->dat_in.spp_sum_pwr.cc);
+	    break;
+	case RAXPOL_DPP:
+	    free(dat_p->dat_in.dpp.zv1);
+	    free(dat_p->dat_in.dpp.zv2);
+	    free(dat_p->dat_in.dpp.zv3);
+	    free(dat_p->dat_in.dpp.zh1);
+	    free(dat_p->dat_in.dpp.zh2);
+	    free(dat_p->dat_in.dpp.zh3);
+	    free(dat_p->dat_in.dpp.pp_v1);
+	    free(dat_p->dat_in.dpp.pp_v2);
+	    free(dat_p->dat_in.dpp.pp_h1);
+	    free(dat_p->dat_in.dpp.pp_h2);
+	    free(dat_p->dat_in.dpp.cc);
+	    break;
+	case RAXPOL_DPP_SUM_PWR:
+	    free(dat_p->dat_in.dpp_sum_pwr.zv);
+	    free(dat_p->dat_in.dpp_sum_pwr.zh);
+	    free(dat_p->dat_in.dpp_sum_pwr.pp_v1);
+	    free(dat_p->dat_in.dpp_sum_pwr.pp_v2);
+	    free(dat_p->dat_in.dpp_sum_pwr.pp_h1);
+	    free(dat_p->dat_in.dpp_sum_pwr.pp_h2);
+	    free(dat_p->dat_in.dpp_sum_pwr.cc);
+	    break;
+	case RAXPOL_FFT:
+	case RAXPOL_FFT2:
+	case RAXPOL_FFT2I:
+	case RAXPOL_UNK:
+	    break;
+    }
+    free(dat_p->sum);
+    ARENA_FREE(&dat_p->scratch);
+    RaXPol_Init_Data(dat_p, NULL);
+}
+
+/*
+   Set gate window of dat_p, which must have been initialized from a file
+   header, to gates g_start to g_end - 1. Subsequent reads only store those
+   gates, at the start of the input fields, and moment functions only compute
+   values for them, so output moments have g_end - g_start gates. Range gate
+   spacing and noise are as for the full ray.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Set_Gate_Window(struct RaXPol_Data *dat_p, int g_start, int g_end)
+{
+    int num_gates = dat_p->file_hdr.num_rng_gates;
+
+    if ( g_start < 0 || g_start >= g_end || g_end > num_gates ) {
+	fprintf(stderr, "Gate window %d to %d out of range. Ray has %d "
+		"gates.\n", g_start, g_end - 1, num_gates);
+	return 0;
+    }
+    dat_p->g_start = g_start;
+    dat_p->g_end = g_end;
+    return 1;
+}
+
+/*
+   Make subsequent reads into dat_p average each gate_step gates of the gate
+   window into one gate, for quick looks. Powers and covariances are averaged
+   in linear units, before moments are computed, so PHIDP and VEL, which come
+   from the phase of averaged covariances, get circular means. Moment
+   functions then compute RaXPol_Num_Gates values. Output gate n starts
+   at gate g_start + n * gate_step. The last one averages what is left of
+   the window.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Set_Gate_Step(struct RaXPol_Data *dat_p, int gate_step)
+{
+    if ( gate_step < 1 ) {
+	fprintf(stderr, "Gate step must be positive, got %d.\n", gate_step);
+	return 0;
+    }
+    dat_p->gate_step = gate_step;
+    return 1;
+}
+
+/*
+   Return number of gates in input fields and output moments for rays read
+   into dat_p, given its gate window and gate step.
+ */
+
+int RaXPol_Num_Gates(struct RaXPol_Data *dat_p)
+{
+    int k = dat_p->gate_step;
+
+    return (dat_p->g_end - dat_p->g_start + k - 1) / k;
+}
+
+/*
+   Add input fields and noise of the ray most recently read into dat_p to
+   sums in dat_p. RaXPol_Mean_Ray replaces the input fields with the means
+   of the rays summed so far, so that moments can be computed for several
+   rays averaged into one. Gate window and gate step must not change while
+   rays are being summed.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Sum_Ray(struct RaXPol_Data *dat_p)
+{
+    float *f[6];			/* Real input fields */
+    int num_f;				/* Number of real fields */
+    float _Complex *fc[5];		/* Complex input fields */
+    int num_fc;				/* Number of complex fields */
+    int num_gates = RaXPol_Num_Gates(dat_p);
+    size_t len;				/* Number of values to sum */
+    double *sum;			/* Point into dat_p->sum */
+    int n, g;
+
+    if ( !in_flds(dat_p, f, &num_f, fc, &num_fc) ) {
+	return 0;
+    }
+    if ( dat_p->num_sum == 0 ) {
+	len = (size_t)(num_f + 2 * num_fc) * num_gates;
+	if ( len > dat_p->sum_len ) {
+	    if ( !(sum = REALLOC(dat_p->sum, len * sizeof(double))) ) {
+		fprintf(stderr, "Could not allocate %zu values for sums of "
+			"input fields.\n", len);
+		return 0;
+	    }
+	    dat_p->sum = sum;
+	    dat_p->sum_len = len;
+	}
+	memset(dat_p->sum, 0, len * sizeof(double));
+	dat_p->v_noise_sum = dat_p->h_noise_sum = 0.0;
+    }
+    sum = dat_p->sum;
+    for (n = 0; n < num_f; n++) {
+	for (g = 0; g < num_gates; g++) {
+	    *sum++ += f[n][g];
+	}
+    }
+    for (n = 0; n < num_fc; n++) {
+	for (g = 0; g < num_gates; g++) {
+	    *sum++ += crealf(fc[n][g]);
+	    *sum++ += cimagf(fc[n][g]);
+	}
+    }
+    dat_p->v_noise_sum += dat_p->v_noise;
+    dat_p->h_noise_sum += dat_p->h_noise;
+    dat_p->num_sum++;
+    return 1;
+}
+
+/*
+   Replace input fields and noise in dat_p with the means of the rays given
+   to RaXPol_Sum_Ray since the last call to this function, and start new
+   sums. The ray header is not changed.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Mean_Ray(struct RaXPol_Data *dat_p)
+{
+    float *f[6];			/* Real input fields */
+    int num_f;				/* Number of real fields */
+    float _Complex *fc[5];		/* Complex input fields */
+    int num_fc;				/* Number of complex fields */
+    int num_gates = RaXPol_Num_Gates(dat_p);
+    double *sum = dat_p->sum;		/* Point into dat_p->sum */
+    double num_sum = dat_p->num_sum;
+    int n, g;
+
+    if ( dat_p->num_sum == 0 ) {
+	fprintf(stderr, "No rays summed for mean ray.\n");
+	return 0;
+    }
+    if ( !in_flds(dat_p, f, &num_f, fc, &num_fc) ) {
+	return 0;
+    }
+    for (n = 0; n < num_f; n++) {
+	for (g = 0; g < num_gates; g++) {
+	    f[n][g] = *sum++ / num_sum;
+	}
+    }
+    for (n = 0; n < num_fc; n++) {
+	for (g = 0; g < num_gates; g++, sum += 2) {
+	    fc[n][g] = sum[0] / num_sum + I * (sum[1] / num_sum);
+	}
+    }
+    dat_p->v_noise = dat_p->v_noise_sum / num_sum;
+    dat_p->h_noise = dat_p->h_noise_sum / num_sum;
+    dat_p->num_sum = 0;
+    return 1;
+}
+
 /*
    Allocate memory for an output field named nm with space for n floats
    Exit process on failure.
@@ -966,7 +1514,347 @@ const char *RaXPol_Scan_Type_Descr(enum RAXPOL_SCAN_TYPE scan_type)
 
 int RaXPol_Read_Ray(struct RaXPol_Data *dat_p, FILE *in)
 {
-    return dat_p->read_ray(dat_p, in);
+    double t0;
+
+    t0 = RaXPol_Prof_Start();
+    if ( !dat_p->read_ray(dat_p, in)
+	    || (dat_p->gate_step > 1 && !decimate_gates(dat_p)) ) {
+	return 0;
+    }
+    RaXPol_Prof_Count("bytes_read", dat_p->ray_hdr.data_size);
+    RaXPol_Prof_Stop("ray_read", t0, 1);
+    return 1;
+}
+
+/*
+   Decode a ray from the sz bytes at buf into dat_p. buf must have a ray
+   header and ray data, as they appear in a RaXPol file. dat_p should have
+   been initialized with a call to RaXPol_Init_Data. This function is for
+   callers that read rays themselves, for example, to read ahead.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Decode_Ray(struct RaXPol_Data *dat_p, char *buf, size_t sz)
+{
+    double t0;
+    int status;
+
+    t0 = RaXPol_Prof_Start();
+    mem_p = buf;
+    mem_end = buf + sz;
+    status = dat_p->read_ray(dat_p, NULL);
+    mem_p = mem_end = NULL;
+    if ( !status || (dat_p->gate_step > 1 && !decimate_gates(dat_p)) ) {
+	return 0;
+    }
+    RaXPol_Prof_Count("bytes_read", sz);
+    RaXPol_Prof_Stop("ray_decode", t0, 1);
+    return 1;
+}
+
+/*
+   Read ray header into dat_p->ray_hdr from in, or, if in is NULL, from the
+   ray given to RaXPol_Decode_Ray. The header format comes from
+   dat_p->file_hdr.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int ray_hdr_in(struct RaXPol_Data *dat_p, FILE *in)
+{
+    struct RaXPol_Ray_Hdr *rh_p = &dat_p->ray_hdr;
+    int old_fmt = dat_p->file_hdr.old_fmt;
+    size_t sz = RaXPol_Ray_Hdr_Sz(old_fmt);
+
+    if ( in ) {
+	return RaXPol_Read_Ray_Hdr(rh_p, in, old_fmt);
+    }
+    memset(rh_p, 0, sizeof(struct RaXPol_Ray_Hdr));
+    if ( (size_t)(mem_end - mem_p) < sz ) {
+	fprintf(stderr, "Ray is too short for ray header.\n");
+	return 0;
+    }
+    mem_p += sz;
+    return decode_ray_hdr(rh_p, mem_p - sz, old_fmt);
+}
+
+/*
+   Read sz bytes of field nm into dat from in, or, if in is NULL, from the
+   ray given to RaXPol_Decode_Ray.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+   If input fails, error and eof flags are retained in in.
+ */
+
+static int ray_in(void *dat, size_t sz, FILE *in, char *nm)
+{
+    if ( in ) {
+	if ( fread(dat, sz, 1, in) != 1 ) {
+	    if ( ferror(in) ) {
+		fprintf(stderr, "Failed to read %s\n", nm);
+	    }
+	    return 0;
+	}
+	return 1;
+    }
+    if ( (size_t)(mem_end - mem_p) < sz ) {
+	fprintf(stderr, "Ray is too short for %s\n", nm);
+	return 0;
+    }
+    memcpy(dat, mem_p, sz);
+    mem_p += sz;
+    return 1;
+}
+
+/*
+   Skip sz bytes of field nm in in, or, if in is NULL, in the ray given to
+   RaXPol_Decode_Ray. If in cannot seek, e.g. a pipe, the bytes are read
+   and discarded.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+   If input fails, error and eof flags are retained in in.
+ */
+
+static int ray_skip(size_t sz, FILE *in, char *nm)
+{
+    char buf[BUFSIZ];
+    size_t n;
+
+    if ( sz == 0 ) {
+	return 1;
+    }
+    if ( in ) {
+	if ( fseeko(in, (off_t)sz, SEEK_CUR) == 0 ) {
+	    return 1;
+	}
+	for ( ; sz > 0; sz -= n) {
+	    n = (sz < sizeof(buf)) ? sz : sizeof(buf);
+	    if ( fread(buf, 1, n, in) != n ) {
+		if ( ferror(in) ) {
+		    fprintf(stderr, "Failed to read %s\n", nm);
+		}
+		return 0;
+	    }
+	}
+	return 1;
+    }
+    if ( (size_t)(mem_end - mem_p) < sz ) {
+	fprintf(stderr, "Ray is too short for %s\n", nm);
+	return 0;
+    }
+    mem_p += sz;
+    return 1;
+}
+
+/*
+   Read the gate window of field nm, which has elements of size el_sz, into
+   dat, from in, or, if in is NULL, from the ray given to RaXPol_Decode_Ray.
+   Gates outside the window are skipped. If noise is not NULL, the first
+   RAXPOL_NOISE_GATES gates of the field also go there, whatever the window.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+   If input fails, error and eof flags are retained in in.
+ */
+
+static int field_in(struct RaXPol_Data *dat_p, void *dat, size_t el_sz,
+	FILE *in, char *nm, float *noise)
+{
+    int num_gates = dat_p->file_hdr.num_rng_gates;
+    int g_start = dat_p->g_start, g_end = dat_p->g_end;
+    int num_noise = 0;			/* Number of noise gates */
+    int g = 0;				/* Next gate in input */
+    int g1;
+
+    if ( noise ) {
+	num_noise = (num_gates < RAXPOL_NOISE_GATES)
+	    ? num_gates : RAXPOL_NOISE_GATES;
+    }
+
+    /* If window does not start with the noise gates, read them first */
+    if ( num_noise > 0 && (g_start > 0 || g_end < num_noise) ) {
+	if ( !ray_in(noise, num_noise * el_sz, in, nm) ) {
+	    return 0;
+	}
+	g = num_noise;
+	if ( g_start < g ) {
+	    g1 = (g_end < g) ? g_end : g;
+	    memcpy(dat, noise + g_start, (g1 - g_start) * el_sz);
+	}
+    }
+    if ( g_end > g ) {
+	g1 = (g_start > g) ? g_start : g;
+	if ( !ray_skip((g1 - g) * el_sz, in, nm)
+		|| !ray_in((char *)dat + (g1 - g_start) * el_sz,
+		    (g_end - g1) * el_sz, in, nm) ) {
+	    return 0;
+	}
+	if ( g == 0 && num_noise > 0 ) {
+	    memcpy(noise, dat, num_noise * el_sz);
+	}
+	g = g_end;
+    }
+    return ray_skip((num_gates - g) * el_sz, in, nm);
+}
+
+/*
+   Copy pointers to the real and complex input fields of dat_p, in file
+   order, to f and fc, which must have space for 6 and 5 pointers. Copy the
+   numbers of fields to num_f_p and num_fc_p.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int in_flds(struct RaXPol_Data *dat_p, float **f, int *num_f_p,
+	float _Complex **fc, int *num_fc_p)
+{
+    switch (dat_p->servmode) {
+	case RAXPOL_SPP:
+	    f[0] = dat_p->dat_in.spp.zv1;
+	    f[1] = dat_p->dat_in.spp.zv2;
+	    f[2] = dat_p->dat_in.spp.zh1;
+	    f[3] = dat_p->dat_in.spp.zh2;
+	    *num_f_p = 4;
+	    fc[0] = dat_p->dat_in.spp.pp_v;
+	    fc[1] = dat_p->dat_in.spp.pp_h;
+	    fc[2] = dat_p->dat_in.spp.cc;
+	    *num_fc_p = 3;
+	    break;
+	case RAXPOL_SPP_SUM_PWR:
+	    f[0] = dat_p->dat_in.spp_sum_pwr.zv;
+	    f[1] = dat_p->dat_in.spp_sum_pwr.zh;
+	    *num_f_p = 2;
+	    fc[0] = dat_p->dat_in.spp_sum_pwr.pp_v;
+	    fc[1] = dat_p->dat_in.spp_sum_pwr.pp_h;
+	    fc[2] = dat_p->dat_in.spp_sum_pwr.cc;
+	    *num_fc_p = 3;
+	    break;
+	case RAXPOL_DPP:
+	    f[0] = dat_p->dat_in.dpp.zv1;
+	    f[1] = dat_p->dat_in.dpp.zv2;
+	    f[2] = dat_p->dat_in.dpp.zv3;
+	    f[3] = dat_p->dat_in.dpp.zh1;
+	    f[4] = dat_p->dat_in.dpp.zh2;
+	    f[5] = dat_p->dat_in.dpp.zh3;
+	    *num_f_p = 6;
+	    fc[0] = dat_p->dat_in.dpp.pp_v1;
+	    fc[1] = dat_p->dat_in.dpp.pp_v2;
+	    fc[2] = dat_p->dat_in.dpp.pp_h1;
+	    fc[3] = dat_p->dat_in.dpp.pp_h2;
+	    fc[4] = dat_p->dat_in.dpp.cc;
+	    *num_fc_p = 5;
+	    break;
+	case RAXPOL_DPP_SUM_PWR:
+	    f[0] = dat_p->dat_in.dpp_sum_pwr.zv;
+	    f[1] = dat_p->dat_in.dpp_sum_pwr.zh;
+	    *num_f_p = 2;
+	    fc[0] = dat_p->dat_in.dpp_sum_pwr.pp_v1;
+	    fc[1] = dat_p->dat_in.dpp_sum_pwr.pp_v2;
+	    fc[2] = dat_p->dat_in.dpp_sum_pwr.pp_h1;
+	    fc[3] = dat_p->dat_in.dpp_sum_pwr.pp_h2;
+	    fc[4] = dat_p->dat_in.dpp_sum_pwr.cc;
+	    *num_fc_p = 5;
+	    break;
+	default:
+	    fprintf(stderr, "No input fields for %s server mode.\n",
+		    servmode_s[dat_p->servmode]);
+	    return 0;
+    }
+    return 1;
+}
+
+/*
+   Average each dat_p->gate_step gates of the input fields of dat_p into
+   one, in place. See RaXPol_Set_Gate_Step.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int decimate_gates(struct RaXPol_Data *dat_p)
+{
+    float *f[6];			/* Real input fields */
+    int num_f;				/* Number of real fields */
+    float _Complex *fc[5];		/* Complex input fields */
+    int num_fc;				/* Number of complex fields */
+    int num_gates = dat_p->g_end - dat_p->g_start;
+    int k = dat_p->gate_step;
+    int n;
+    int g;				/* Output gate */
+    int g0, g1;				/* Input gates g0 to g1 - 1 */
+    int i;
+    double sum;
+    double _Complex sum_c;
+
+    if ( !in_flds(dat_p, f, &num_f, fc, &num_fc) ) {
+	return 0;
+    }
+    for (n = 0; n < num_f; n++) {
+	for (g = 0, g0 = 0; g0 < num_gates; g++, g0 += k) {
+	    g1 = (g0 + k < num_gates) ? g0 + k : num_gates;
+	    for (sum = 0.0, i = g0; i < g1; i++) {
+		sum += f[n][i];
+	    }
+	    f[n][g] = sum / (g1 - g0);
+	}
+    }
+    for (n = 0; n < num_fc; n++) {
+	for (g = 0, g0 = 0; g0 < num_gates; g++, g0 += k) {
+	    g1 = (g0 + k < num_gates) ? g0 + k : num_gates;
+	    for (sum_c = 0.0, i = g0; i < g1; i++) {
+		sum_c += fc[n][i];
+	    }
+	    fc[n][g] = sum_c / (g1 - g0);
+	}
+    }
+    return 1;
+}
+
+/*
+   Write ray header and input fields from dat_p to out, in the layout
+   RaXPol_Read_Ray reads. dat_p should have been initialized with a call to
+   RaXPol_Init_Data or RaXPol_Init_Data_Hdr. This function sets
+   dat_p->ray_hdr.data_size. Other ray header members are written as given.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Write_Ray(struct RaXPol_Data *dat_p, FILE *out)
+{
+    float *f[6];			/* Real input fields, in file order */
+    int num_f;				/* Number of real fields */
+    float _Complex *fc[5];		/* Complex input fields, in file order */
+    int num_fc;				/* Number of complex fields */
+    size_t num_gates = dat_p->file_hdr.num_rng_gates;
+    int n;
+
+    if ( dat_p->g_start != 0 || (size_t)dat_p->g_end != num_gates
+	    || dat_p->gate_step != 1 ) {
+	fprintf(stderr, "Cannot write ray with gate window or gate step.\n");
+	return 0;
+    }
+    if ( !in_flds(dat_p, f, &num_f, fc, &num_fc) ) {
+	return 0;
+    }
+    dat_p->ray_hdr.data_size = num_gates
+	* (num_f * sizeof(float) + num_fc * sizeof(float _Complex));
+    if ( !RaXPol_FWrite_Ray_Hdr(&dat_p->ray_hdr, out,
+		dat_p->file_hdr.old_fmt) ) {
+	return 0;
+    }
+    for (n = 0; n < num_f; n++) {
+	if ( fwrite(f[n], sizeof(float), num_gates, out) != num_gates ) {
+	    fprintf(stderr, "Could not write ray data\n%s\n", strerror(errno));
+	    return 0;
+	}
+    }
+    for (n = 0; n < num_fc; n++) {
+	if ( fwrite(fc[n], sizeof(float _Complex), num_gates, out)
+		!= num_gates ) {
+	    fprintf(stderr, "Could not write ray data\n%s\n", strerror(errno));
+	    return 0;
+	}
+    }
+    return 1;
 }
 
 static int no_in_stub(struct RaXPol_Data *dat_p, FILE *in)
@@ -992,11 +1880,9 @@ static int no_in_stub(struct RaXPol_Data *dat_p, FILE *in)
 
 static int read_spp_ray(struct RaXPol_Data *dat_p, FILE *in)
 {
-    size_t sz;
     double w = 0.1;			/* Weighting factor for noise
 					   computation. See RaXpol_disp1.pro */
     struct RaXPol_SPP spp = dat_p->dat_in.spp;
-    int num_gates = dat_p->file_hdr.num_rng_gates;
     float *zv1 = spp.zv1;
     float *zv2 = spp.zv2;
     float *zh1 = spp.zh1;
@@ -1004,65 +1890,43 @@ static int read_spp_ray(struct RaXPol_Data *dat_p, FILE *in)
     float _Complex *pp_v = spp.pp_v;
     float _Complex *pp_h = spp.pp_h;
     float _Complex *cc = spp.cc;
-    static float v_noise, h_noise;
 
-    if ( !RaXPol_Read_Ray_Hdr(&dat_p->ray_hdr, in) ) {
+    if ( !ray_hdr_in(dat_p, in) ) {
 	return 0;
     }
-    sz = num_gates * sizeof(float);
-    if ( fread(zv1, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read zv1\n");
-	}
+    if ( !field_in(dat_p, zv1, sizeof(float), in, "zv1", dat_p->noise_v) ) {
 	return 0;
     }
-    if ( fread(zv2, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read zv2\n");
-	}
+    if ( !field_in(dat_p, zv2, sizeof(float), in, "zv2", NULL) ) {
 	return 0;
     }
-    if ( fread(zh1, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read zh1\n");
-	}
+    if ( !field_in(dat_p, zh1, sizeof(float), in, "zh1", dat_p->noise_h) ) {
 	return 0;
     }
-    if ( fread(zh2, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read zh2\n");
-	}
+    if ( !field_in(dat_p, zh2, sizeof(float), in, "zh2", NULL) ) {
 	return 0;
     }
-    sz = num_gates * sizeof(float _Complex);
-    if ( fread(pp_v, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read pp_v\n");
-	}
+    if ( !field_in(dat_p, pp_v, sizeof(float _Complex), in, "pp_v", NULL) ) {
 	return 0;
     }
-    if ( fread(pp_h, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read pp_h\n");
-	}
+    if ( !field_in(dat_p, pp_h, sizeof(float _Complex), in, "pp_h", NULL) ) {
 	return 0;
     }
-    if ( fread(cc, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read cc\n");
-	}
+    if ( !field_in(dat_p, cc, sizeof(float _Complex), in, "cc", NULL) ) {
 	return 0;
     }
 
     /* Update noise */
-    if ( v_noise == 0.0 ) {
-	v_noise = mean(zv1, 10);
+    if ( dat_p->v_noise_avg == 0.0 ) {
+	dat_p->v_noise_avg = mean(dat_p->noise_v, 10);
     }
-    v_noise = dat_p->v_noise = (1.0 - w) * v_noise + w * mean(zv1, 10);
-    if ( h_noise == 0.0 ) {
-	h_noise = mean(zh1, 10);
+    dat_p->v_noise_avg = dat_p->v_noise
+	= (1.0 - w) * dat_p->v_noise_avg + w * mean(dat_p->noise_v, 10);
+    if ( dat_p->h_noise_avg == 0.0 ) {
+	dat_p->h_noise_avg = mean(dat_p->noise_h, 10);
     }
-    h_noise = dat_p->h_noise = (1.0 - w) * h_noise + w * mean(zh1, 2);
+    dat_p->h_noise_avg = dat_p->h_noise
+	= (1.0 - w) * dat_p->h_noise_avg + w * mean(dat_p->noise_h, 2);
 
     return 1;
 }
@@ -1082,63 +1946,45 @@ static int read_spp_ray(struct RaXPol_Data *dat_p, FILE *in)
 
 static int read_spp_sum_pwr_ray(struct RaXPol_Data *dat_p, FILE *in)
 {
-    size_t sz;
     double w = 0.1;			/* Weighting factor for noise
 					   computation. See RaXpol_disp1.pro */
-    int num_gates = dat_p->file_hdr.num_rng_gates;
     struct RaXPol_SPP_SumPwr spp_sum_pwr = dat_p->dat_in.spp_sum_pwr;
     float *zv = spp_sum_pwr.zv;
     float *zh = spp_sum_pwr.zh;
     float _Complex *pp_v = spp_sum_pwr.pp_v;
     float _Complex *pp_h = spp_sum_pwr.pp_h;
     float _Complex *cc = spp_sum_pwr.cc;
-    static float v_noise, h_noise;
 
-    if ( !RaXPol_Read_Ray_Hdr(&dat_p->ray_hdr, in) ) {
+    if ( !ray_hdr_in(dat_p, in) ) {
 	return 0;
     }
-    sz = num_gates * sizeof(float);
-    if ( fread(zv, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read v\n");
-	}
+    if ( !field_in(dat_p, zv, sizeof(float), in, "v", dat_p->noise_v) ) {
 	return 0;
     }
-    if ( fread(zh, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read h\n");
-	}
+    if ( !field_in(dat_p, zh, sizeof(float), in, "h", dat_p->noise_h) ) {
 	return 0;
     }
-    sz = num_gates * sizeof(float _Complex);
-    if ( fread(pp_v, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read pp_v\n");
-	}
+    if ( !field_in(dat_p, pp_v, sizeof(float _Complex), in, "pp_v", NULL) ) {
 	return 0;
     }
-    if ( fread(pp_h, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read pp_h\n");
-	}
+    if ( !field_in(dat_p, pp_h, sizeof(float _Complex), in, "pp_h", NULL) ) {
 	return 0;
     }
-    if ( fread(cc, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read cc\n");
-	}
+    if ( !field_in(dat_p, cc, sizeof(float _Complex), in, "cc", NULL) ) {
 	return 0;
     }
 
     /* Update noise */
-    if ( v_noise == 0.0 ) {
-	v_noise = mean(zv, 10);
+    if ( dat_p->v_noise_avg == 0.0 ) {
+	dat_p->v_noise_avg = mean(dat_p->noise_v, 10);
     }
-    v_noise = dat_p->v_noise = (1.0 - w) * v_noise + w * mean(zv, 10);
-    if ( h_noise == 0.0 ) {
-	h_noise = mean(zh, 10);
+    dat_p->v_noise_avg = dat_p->v_noise
+	= (1.0 - w) * dat_p->v_noise_avg + w * mean(dat_p->noise_v, 10);
+    if ( dat_p->h_noise_avg == 0.0 ) {
+	dat_p->h_noise_avg = mean(dat_p->noise_h, 10);
     }
-    h_noise = dat_p->h_noise = (1.0 - w) * h_noise + w * mean(zh, 10);
+    dat_p->h_noise_avg = dat_p->h_noise
+	= (1.0 - w) * dat_p->h_noise_avg + w * mean(dat_p->noise_h, 10);
     return 1;
 }
 
@@ -1158,10 +2004,8 @@ static int read_spp_sum_pwr_ray(struct RaXPol_Data *dat_p, FILE *in)
 
 static int read_dpp_ray(struct RaXPol_Data *dat_p, FILE *in)
 {
-    size_t sz;
     double w = 0.1;			/* Weighting factor for noise
 					   computation. See RaXpol_disp1.pro */
-    int num_gates = dat_p->file_hdr.num_rng_gates;
     struct RaXPol_DPP dpp = dat_p->dat_in.dpp;
     float *zv1 = dpp.zv1;
     float *zv2 = dpp.zv2;
@@ -1174,89 +2018,55 @@ static int read_dpp_ray(struct RaXPol_Data *dat_p, FILE *in)
     float _Complex *pp_h1 = dpp.pp_h1;
     float _Complex *pp_h2 = dpp.pp_h2;
     float _Complex *cc = dpp.cc;
-    static float v_noise, h_noise;
 
-    if ( !RaXPol_Read_Ray_Hdr(&dat_p->ray_hdr, in) ) {
+    if ( !ray_hdr_in(dat_p, in) ) {
 	return 0;
     }
-    sz = num_gates * sizeof(float);
-    if ( fread(zv1, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read zv1\n");
-	}
+    if ( !field_in(dat_p, zv1, sizeof(float), in, "zv1", dat_p->noise_v) ) {
 	return 0;
     }
-    if ( fread(zv2, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read zv2\n");
-	}
+    if ( !field_in(dat_p, zv2, sizeof(float), in, "zv2", NULL) ) {
 	return 0;
     }
-    if ( fread(zv3, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read zv3\n");
-	}
+    if ( !field_in(dat_p, zv3, sizeof(float), in, "zv3", NULL) ) {
 	return 0;
     }
-    if ( fread(zh1, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read zh1\n");
-	}
+    if ( !field_in(dat_p, zh1, sizeof(float), in, "zh1", dat_p->noise_h) ) {
 	return 0;
     }
-    if ( fread(zh2, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read zh2\n");
-	}
+    if ( !field_in(dat_p, zh2, sizeof(float), in, "zh2", NULL) ) {
 	return 0;
     }
-    if ( fread(zh3, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read zh3\n");
-	}
+    if ( !field_in(dat_p, zh3, sizeof(float), in, "zh3", NULL) ) {
 	return 0;
     }
-    sz = num_gates * sizeof(float _Complex);
-    if ( fread(pp_v1, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read pp_v1\n");
-	}
+    if ( !field_in(dat_p, pp_v1, sizeof(float _Complex), in, "pp_v1", NULL) ) {
 	return 0;
     }
-    if ( fread(pp_v2, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read pp_v2\n");
-	}
+    if ( !field_in(dat_p, pp_v2, sizeof(float _Complex), in, "pp_v2", NULL) ) {
 	return 0;
     }
-    if ( fread(pp_h1, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read pp_h1\n");
-	}
+    if ( !field_in(dat_p, pp_h1, sizeof(float _Complex), in, "pp_h1", NULL) ) {
 	return 0;
     }
-    if ( fread(pp_h2, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read pp_h2\n");
-	}
+    if ( !field_in(dat_p, pp_h2, sizeof(float _Complex), in, "pp_h2", NULL) ) {
 	return 0;
     }
-    if ( fread(cc, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read cc\n");
-	}
+    if ( !field_in(dat_p, cc, sizeof(float _Complex), in, "cc", NULL) ) {
 	return 0;
     }
 
     /* Update noise */
-    if ( v_noise == 0.0 ) {
-	v_noise = mean(zv1, 10);
+    if ( dat_p->v_noise_avg == 0.0 ) {
+	dat_p->v_noise_avg = mean(dat_p->noise_v, 10);
     }
-    v_noise = dat_p->v_noise = (1.0 - w) * v_noise + w * mean(zv1, 10);
-    if ( h_noise == 0.0 ) {
-	h_noise = mean(zh1, 10);
+    dat_p->v_noise_avg = dat_p->v_noise
+	= (1.0 - w) * dat_p->v_noise_avg + w * mean(dat_p->noise_v, 10);
+    if ( dat_p->h_noise_avg == 0.0 ) {
+	dat_p->h_noise_avg = mean(dat_p->noise_h, 10);
     }
-    h_noise = dat_p->h_noise = (1.0 - w) * h_noise + w * mean(zh1, 2);
+    dat_p->h_noise_avg = dat_p->h_noise
+	= (1.0 - w) * dat_p->h_noise_avg + w * mean(dat_p->noise_h, 2);
 
     return 1;
 }
@@ -1276,10 +2086,8 @@ static int read_dpp_ray(struct RaXPol_Data *dat_p, FILE *in)
 
 static int read_dpp_sum_pwr_ray(struct RaXPol_Data *dat_p, FILE *in)
 {
-    size_t sz;
     double w = 0.1;			/* Weighting factor for noise
 					   computation. See RaXpol_disp1.pro */
-    int num_gates = dat_p->file_hdr.num_rng_gates;
     struct RaXPol_DPP_SumPwr dpp_sum_pwr = dat_p->dat_in.dpp_sum_pwr;
     float *zv = dpp_sum_pwr.zv;
     float *zh = dpp_sum_pwr.zh;
@@ -1288,65 +2096,43 @@ static int read_dpp_sum_pwr_ray(struct RaXPol_Data *dat_p, FILE *in)
     float _Complex *pp_h1 = dpp_sum_pwr.pp_h1;
     float _Complex *pp_h2 = dpp_sum_pwr.pp_h2;
     float _Complex *cc = dpp_sum_pwr.cc;
-    static float v_noise, h_noise;
 
-    if ( !RaXPol_Read_Ray_Hdr(&dat_p->ray_hdr, in) ) {
+    if ( !ray_hdr_in(dat_p, in) ) {
 	return 0;
     }
-    sz = num_gates * sizeof(float);
-    if ( fread(zv, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read v\n");
-	}
+    if ( !field_in(dat_p, zv, sizeof(float), in, "v", dat_p->noise_v) ) {
 	return 0;
     }
-    if ( fread(zh, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read h\n");
-	}
+    if ( !field_in(dat_p, zh, sizeof(float), in, "h", dat_p->noise_h) ) {
 	return 0;
     }
-    sz = num_gates * sizeof(float _Complex);
-    if ( fread(pp_v1, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read pp_v1\n");
-	}
+    if ( !field_in(dat_p, pp_v1, sizeof(float _Complex), in, "pp_v1", NULL) ) {
 	return 0;
     }
-    if ( fread(pp_v2, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read pp_v2\n");
-	}
+    if ( !field_in(dat_p, pp_v2, sizeof(float _Complex), in, "pp_v2", NULL) ) {
 	return 0;
     }
-    if ( fread(pp_h1, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read pp_h1\n");
-	}
+    if ( !field_in(dat_p, pp_h1, sizeof(float _Complex), in, "pp_h1", NULL) ) {
 	return 0;
     }
-    if ( fread(pp_h2, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read pp_h2\n");
-	}
+    if ( !field_in(dat_p, pp_h2, sizeof(float _Complex), in, "pp_h2", NULL) ) {
 	return 0;
     }
-    if ( fread(cc, sz, 1, in) != 1 ) {
-	if ( ferror(in) ) {
-	    fprintf(stderr, "Failed to read cc\n");
-	}
+    if ( !field_in(dat_p, cc, sizeof(float _Complex), in, "cc", NULL) ) {
 	return 0;
     }
 
     /* Update noise */
-    if ( v_noise == 0.0 ) {
-	v_noise = mean(zv, 10);
+    if ( dat_p->v_noise_avg == 0.0 ) {
+	dat_p->v_noise_avg = mean(dat_p->noise_v, 10);
     }
-    v_noise = dat_p->v_noise = (1.0 - w) * v_noise + w * mean(zv, 10);
-    if ( h_noise == 0.0 ) {
-	h_noise = mean(zh, 10);
+    dat_p->v_noise_avg = dat_p->v_noise
+	= (1.0 - w) * dat_p->v_noise_avg + w * mean(dat_p->noise_v, 10);
+    if ( dat_p->h_noise_avg == 0.0 ) {
+	dat_p->h_noise_avg = mean(dat_p->noise_h, 10);
     }
-    h_noise = dat_p->h_noise = (1.0 - w) * h_noise + w * mean(zh, 10);
+    dat_p->h_noise_avg = dat_p->h_noise
+	= (1.0 - w) * dat_p->h_noise_avg + w * mean(dat_p->noise_h, 10);
     return 1;
 }
 
@@ -1374,8 +2160,8 @@ static int pp_dbm(struct RaXPol_Data *dat_p, float *z, float *dbm)
 	fprintf(stderr, "Attempted to compute DBMHC for bogus data set.\n");
 	return 0;
     }
-    g0 = floor(dat_p->file_hdr.zero_range_gate_index + 1);
-    num_gates = dat_p->file_hdr.num_rng_gates;
+    g0 = first_gate(dat_p);
+    num_gates = RaXPol_Num_Gates(dat_p);
     for (g = 0; g < g0; g++) {
 	dbm[g] = NAN;
     }
@@ -1434,15 +2220,18 @@ static int pp_dbz(struct RaXPol_Data *dat_p, float *zh, float *dbz)
     double postave;
     double thres = INFINITY;
     double rres;			/* From dat_p->file_hdr */
+    int k;				/* Gate step */
 
     if ( !dat_p || !dbz ) {
 	fprintf(stderr, "Attempted to compute DBZ for bogus data set.\n");
 	return 0;
     }
-    zero_range_gate_index = dat_p->file_hdr.zero_range_gate_index;
-    g0 = floor(zero_range_gate_index + 1);
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    dr = dat_p->file_hdr.range_gate_spacing;
+    k = dat_p->gate_step;
+    zero_range_gate_index = (dat_p->file_hdr.zero_range_gate_index
+	    - dat_p->g_start - 0.5 * (k - 1)) / k;
+    g0 = first_gate(dat_p);
+    num_gates = RaXPol_Num_Gates(dat_p);
+    dr = dat_p->file_hdr.range_gate_spacing * k;
     thres_val = dat_p->thres_val;
     cave = dat_p->file_hdr.clutter_avg_intvl;
     postave = dat_p->file_hdr.post_averaging_interval;
@@ -1468,17 +2257,16 @@ static int spp_dbz(struct RaXPol_Data *dat_p, float *dbz)
 {
     int g, num_gates;
     float *zh1, *zh2;
-    static float *zh;
-    float *z_tmp;
+    float *zh;
     struct RaXPol_SPP spp = dat_p->dat_in.spp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(z_tmp = REALLOC(zh, num_gates * sizeof(float))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    if ( !(zh = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zh when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zh = z_tmp;
     zh1 = spp.zh1;
     zh2 = spp.zh2;
     for (g = 0; g < num_gates; g++) {
@@ -1490,17 +2278,16 @@ static int dpp_dbz(struct RaXPol_Data *dat_p, float *dbz)
 {
     int g, num_gates;
     float *zh1, *zh2, *zh3;
-    static float *zh;
-    float *z_tmp;
+    float *zh;
     struct RaXPol_DPP dpp = dat_p->dat_in.dpp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(z_tmp = REALLOC(zh, num_gates * sizeof(float))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    if ( !(zh = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zh when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zh = z_tmp;
     zh1 = dpp.zh1;
     zh2 = dpp.zh2;
     zh3 = dpp.zh3;
@@ -1541,13 +2328,11 @@ static int pp_vel(struct RaXPol_Data *dat_p, float _Complex *pp, int pri,
     int g;				/* Gate index */
     int g0;				/* Zero range gate index */
     int num_gates;			/* Total gate count */
-    double zero_range_gate_index;
     double c = 2.9979e8;		/* Speed of light, m/s */
     double l = c / RAXPOL_FREQUENCY;	/* Wavelength */
 
-    zero_range_gate_index = dat_p->file_hdr.zero_range_gate_index;
-    g0 = floor(zero_range_gate_index + 1);
-    num_gates = dat_p->file_hdr.num_rng_gates;
+    g0 = first_gate(dat_p);
+    num_gates = RaXPol_Num_Gates(dat_p);
     for (g = 0; g < g0; g++) {
 	vel[g] = NAN;
     }
@@ -1561,17 +2346,17 @@ static int spp_vel(struct RaXPol_Data *dat_p, float *vel)
     int g;
     int num_gates;
     float _Complex *pp_v, *pp_h;
-    static float _Complex *pp;		/* Receive average pp */
-    float _Complex *pp_tmp;
+    float _Complex *pp;		/* Receive average pp */
     struct RaXPol_SPP spp = dat_p->dat_in.spp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(pp_tmp = REALLOC(pp, num_gates * sizeof(float _Complex))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    pp = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float _Complex));
+    if ( !pp ) {
 	fprintf(stderr, "Could not allocate %d gates for zh when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    pp = pp_tmp;
     pp_v = spp.pp_v;
     pp_h = spp.pp_h;
     for (g = 0; g < num_gates; g++) {
@@ -1585,17 +2370,17 @@ static int spp_sum_pwr_vel(struct RaXPol_Data *dat_p, float *vel)
     int num_gates;
     float _Complex *pp_v;
     float _Complex *pp_h;
-    static float _Complex *pp;		/* Receive average pp */
-    float _Complex *pp_tmp;
+    float _Complex *pp;		/* Receive average pp */
     struct RaXPol_SPP_SumPwr spp_sum_pwr = dat_p->dat_in.spp_sum_pwr;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(pp_tmp = REALLOC(pp, num_gates * sizeof(float _Complex))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    pp = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float _Complex));
+    if ( !pp ) {
 	fprintf(stderr, "Could not allocate %d gates for zh when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    pp = pp_tmp;
     pp_v = spp_sum_pwr.pp_v;
     pp_h = spp_sum_pwr.pp_h;
     for (g = 0; g < num_gates; g++) {
@@ -1612,17 +2397,17 @@ static int dpp_vel(struct RaXPol_Data *dat_p, float *vel)
     struct RaXPol_DPP dpp = dat_p->dat_in.dpp;
     float _Complex *pp_v1, *pp_v2, *pp_h1, *pp_h2;
     float _Complex pp1_ave, pp2_ave;
-    static float _Complex *pp;		/* Receive average pp */
-    float _Complex *pp_tmp;
+    float _Complex *pp;		/* Receive average pp */
     int pri1, pri2;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(pp_tmp = REALLOC(pp, num_gates * sizeof(float _Complex))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    pp = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float _Complex));
+    if ( !pp ) {
 	fprintf(stderr, "Could not allocate %d gates for zh when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    pp = pp_tmp;
     pp_v1 = dpp.pp_v1;
     pp_v2 = dpp.pp_v2;
     pp_h1 = dpp.pp_h1;
@@ -1648,18 +2433,18 @@ static int dpp_sum_pwr_vel(struct RaXPol_Data *dat_p, float *vel)
     int num_gates;
     float _Complex *pp_v1, *pp_v2, *pp_h1, *pp_h2;
     float _Complex pp1_ave, pp2_ave;
-    static float _Complex *pp;		/* Receive average pp */
-    float _Complex *pp_tmp;
+    float _Complex *pp;		/* Receive average pp */
     int pri1, pri2;
     struct RaXPol_DPP_SumPwr dpp_sum_pwr = dat_p->dat_in.dpp_sum_pwr;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(pp_tmp = REALLOC(pp, num_gates * sizeof(float _Complex))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    pp = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float _Complex));
+    if ( !pp ) {
 	fprintf(stderr, "Could not allocate %d gates for zh when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    pp = pp_tmp;
     pp_v1 = dpp_sum_pwr.pp_v1;
     pp_v2 = dpp_sum_pwr.pp_v2;
     pp_h1 = dpp_sum_pwr.pp_h1;
@@ -1686,7 +2471,6 @@ static int pp_zdr(struct RaXPol_Data *dat_p, float *zv, float *zh, float *zdr)
     int g;				/* Gate index */
     int g0;				/* Zero range gate index */
     int num_gates;			/* Total gate count */
-    double zero_range_gate_index;
     double zv_, zh_;
     double v_noise, h_noise;		/* Power noise, should have been
 					   updated when ray was read in */
@@ -1698,9 +2482,8 @@ static int pp_zdr(struct RaXPol_Data *dat_p, float *zv, float *zh, float *zdr)
 	fprintf(stderr, "Attempted to compute DBZ for bogus data set.\n");
 	return 0;
     }
-    zero_range_gate_index = dat_p->file_hdr.zero_range_gate_index;
-    g0 = floor(zero_range_gate_index + 1);
-    num_gates = dat_p->file_hdr.num_rng_gates;
+    g0 = first_gate(dat_p);
+    num_gates = RaXPol_Num_Gates(dat_p);
     v_noise = dat_p->v_noise;
     h_noise = dat_p->h_noise;
     thres_val = dat_p->thres_val;
@@ -1730,24 +2513,22 @@ static int pp_zdr(struct RaXPol_Data *dat_p, float *zv, float *zh, float *zdr)
 static int spp_zdr(struct RaXPol_Data *dat_p, float *zdr)
 {
     int g, num_gates;
-    static float *zv, *zh;
-    float *z_tmp;
+    float *zv, *zh;
     float *zv1, *zv2, *zh1, *zh2;
     struct RaXPol_SPP spp = dat_p->dat_in.spp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(z_tmp = REALLOC(zv, num_gates * sizeof(float))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    if ( !(zv = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zv when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zv = z_tmp;
-    if ( !(z_tmp = REALLOC(zh, num_gates * sizeof(float))) ) {
+    if ( !(zh = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zh when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zh = z_tmp;
     zv1 = spp.zv1;
     zv2 = spp.zv2;
     zh1 = spp.zh1;
@@ -1767,24 +2548,22 @@ static int spp_sum_pwr_zdr(struct RaXPol_Data *dat_p, float *zdr)
 static int dpp_zdr(struct RaXPol_Data *dat_p, float *zdr)
 {
     int g, num_gates;
-    static float *zv, *zh;
-    float *z_tmp;
+    float *zv, *zh;
     float *zv1, *zv2, *zv3, *zh1, *zh2, *zh3;
     struct RaXPol_DPP dpp = dat_p->dat_in.dpp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(z_tmp = REALLOC(zv, num_gates * sizeof(float))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    if ( !(zv = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zv when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zv = z_tmp;
-    if ( !(z_tmp = REALLOC(zh, num_gates * sizeof(float))) ) {
+    if ( !(zh = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zh when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zh = z_tmp;
     zv1 = dpp.zv1;
     zv2 = dpp.zv2;
     zv3 = dpp.zv3;
@@ -1812,11 +2591,9 @@ static int pp_phidp(struct RaXPol_Data *dat_p, float _Complex *cc,
     int g;				/* Gate index */
     int g0;				/* Zero range gate index */
     int num_gates;			/* Total gate count */
-    double zero_range_gate_index;
 
-    zero_range_gate_index = dat_p->file_hdr.zero_range_gate_index;
-    g0 = floor(zero_range_gate_index + 1);
-    num_gates = dat_p->file_hdr.num_rng_gates;
+    g0 = first_gate(dat_p);
+    num_gates = RaXPol_Num_Gates(dat_p);
     for (g = 0; g < g0; g++) {
 	phidp[g] = NAN;
     }
@@ -1854,16 +2631,14 @@ static int pp_rhohv(struct RaXPol_Data *dat_p, float *zv, float *zh,
     int g;				/* Gate index */
     int g0;				/* Zero range gate index */
     int num_gates;			/* Total gate count */
-    double zero_range_gate_index;
     double zh_, zv_;
     double v_noise, h_noise;		/* Power noise, should have been
 					   updated when ray was read in */
     double thres_val, cave, postave;	/* dat_p->file_hdr members */
     double thres_h, thres_v;		/* Power threshold */
 
-    zero_range_gate_index = dat_p->file_hdr.zero_range_gate_index;
-    g0 = floor(zero_range_gate_index + 1);
-    num_gates = dat_p->file_hdr.num_rng_gates;
+    g0 = first_gate(dat_p);
+    num_gates = RaXPol_Num_Gates(dat_p);
     v_noise = dat_p->v_noise;
     h_noise = dat_p->h_noise;
     cave = dat_p->file_hdr.clutter_avg_intvl;
@@ -1894,25 +2669,23 @@ static int pp_rhohv(struct RaXPol_Data *dat_p, float *zv, float *zh,
 static int spp_rhohv(struct RaXPol_Data *dat_p, float *rhohv)
 {
     int g, num_gates;
-    static float *zv, *zh;
-    float *z_tmp;
+    float *zv, *zh;
     float *zv1, *zv2, *zh1, *zh2;
     float _Complex *cc;
     struct RaXPol_SPP spp = dat_p->dat_in.spp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(z_tmp = REALLOC(zv, num_gates * sizeof(float))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    if ( !(zv = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zv when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zv = z_tmp;
-    if ( !(z_tmp = REALLOC(zh, num_gates * sizeof(float))) ) {
+    if ( !(zh = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zh when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zh = z_tmp;
     zv1 = spp.zv1;
     zv2 = spp.zv2;
     zh1 = spp.zh1;
@@ -1934,25 +2707,23 @@ static int spp_sum_pwr_rhohv(struct RaXPol_Data *dat_p, float *rhohv)
 static int dpp_rhohv(struct RaXPol_Data *dat_p, float *rhohv)
 {
     int g, num_gates;
-    static float *zv, *zh;
-    float *z_tmp;
+    float *zv, *zh;
     float *zv1, *zv2, *zv3, *zh1, *zh2, *zh3;
     float _Complex *cc;
     struct RaXPol_DPP dpp = dat_p->dat_in.dpp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(z_tmp = REALLOC(zv, num_gates * sizeof(float))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    if ( !(zv = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zv when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zv = z_tmp;
-    if ( !(z_tmp = REALLOC(zh, num_gates * sizeof(float))) ) {
+    if ( !(zh = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zh when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zh = z_tmp;
     zv1 = dpp.zv1;
     zv2 = dpp.zv2;
     zv3 = dpp.zv3;
@@ -1981,7 +2752,6 @@ static int pp_std(struct RaXPol_Data *dat_p, float *zv, float *zh,
     int g;				/* Gate index */
     int g0;				/* Zero range gate index */
     int num_gates;			/* Total gate count */
-    double zero_range_gate_index;
     double v_noise, h_noise;		/* Power noise, should have been
 					   updated when ray was read in */
     double zv_, zh_;
@@ -1989,9 +2759,8 @@ static int pp_std(struct RaXPol_Data *dat_p, float *zv, float *zh,
     double thres_h, thres_v;		/* Power threshold */
     double pri1;
 
-    zero_range_gate_index = dat_p->file_hdr.zero_range_gate_index;
-    g0 = floor(zero_range_gate_index + 1);
-    num_gates = dat_p->file_hdr.num_rng_gates;
+    g0 = first_gate(dat_p);
+    num_gates = RaXPol_Num_Gates(dat_p);
     v_noise = dat_p->v_noise;
     h_noise = dat_p->h_noise;
     cave = dat_p->file_hdr.clutter_avg_intvl;
@@ -2020,25 +2789,23 @@ static int pp_std(struct RaXPol_Data *dat_p, float *zv, float *zh,
 static int spp_std(struct RaXPol_Data *dat_p, float *std)
 {
     int g, num_gates;
-    static float *zv, *zh;
-    float *z_tmp;
+    float *zv, *zh;
     float *zv1, *zv2, *zh1, *zh2;
     float _Complex *pp_v, *pp_h;
     struct RaXPol_SPP spp = dat_p->dat_in.spp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(z_tmp = REALLOC(zv, num_gates * sizeof(float))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    if ( !(zv = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zv when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zv = z_tmp;
-    if ( !(z_tmp = REALLOC(zh, num_gates * sizeof(float))) ) {
+    if ( !(zh = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zh when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zh = z_tmp;
     zv1 = spp.zv1;
     zv2 = spp.zv2;
     zh1 = spp.zh1;
@@ -2062,25 +2829,23 @@ static int spp_sum_pwr_std(struct RaXPol_Data *dat_p, float *std)
 static int dpp_std(struct RaXPol_Data *dat_p, float *std)
 {
     int g, num_gates;
-    static float *zv, *zh;
-    float *z_tmp;
+    float *zv, *zh;
     float *zv1, *zv2, *zv3, *zh1, *zh2, *zh3;
     float _Complex *pp_v, *pp_h;
     struct RaXPol_DPP dpp = dat_p->dat_in.dpp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(z_tmp = REALLOC(zv, num_gates * sizeof(float))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    if ( !(zv = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zv when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zv = z_tmp;
-    if ( !(z_tmp = REALLOC(zh, num_gates * sizeof(float))) ) {
+    if ( !(zh = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zh when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zh = z_tmp;
     zv1 = dpp.zv1;
     zv2 = dpp.zv2;
     zv3 = dpp.zv3;
@@ -2110,7 +2875,6 @@ static int pp_snr(struct RaXPol_Data *dat_p, float *z, double noise, float *snr)
     int g;				/* Gate index */
     int g0;				/* Zero range gate index */
     int num_gates;			/* Total gate count */
-    double zero_range_gate_index;
     float z_;
     double thres_val, cave, postave;	/* dat_p->file_hdr members */
     double thres;			/* Power threshold */
@@ -2122,9 +2886,8 @@ static int pp_snr(struct RaXPol_Data *dat_p, float *z, double noise, float *snr)
     if ( dat_p->file_hdr.sumpower ) {
 	thres /= sqrt(2.0);
     }
-    zero_range_gate_index = dat_p->file_hdr.zero_range_gate_index;
-    g0 = floor(zero_range_gate_index + 1);
-    num_gates = dat_p->file_hdr.num_rng_gates;
+    g0 = first_gate(dat_p);
+    num_gates = RaXPol_Num_Gates(dat_p);
     for (g = 0; g < g0; g++) {
 	snr[g] = NAN;
     }
@@ -2142,17 +2905,16 @@ static int spp_snrhc(struct RaXPol_Data *dat_p, float *snrhc)
     int g;
     int num_gates;
     float *zh1, *zh2;
-    static float *zh;			/* Average power */
-    float *z_tmp;
+    float *zh;			/* Average power */
     struct RaXPol_SPP spp = dat_p->dat_in.spp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(z_tmp = REALLOC(zh, num_gates * sizeof(float))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    if ( !(zh = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zv when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zh = z_tmp;
     zh1 = spp.zh1;
     zh2 = spp.zh2;
     for (g = 0; g < num_gates; g++) {
@@ -2169,17 +2931,16 @@ static int dpp_snrhc(struct RaXPol_Data *dat_p, float *snrhc)
     int g;
     int num_gates;
     float *zh1, *zh2;
-    static float *zh;			/* Average power */
-    float *z_tmp;
+    float *zh;			/* Average power */
     struct RaXPol_DPP dpp = dat_p->dat_in.dpp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(z_tmp = REALLOC(zh, num_gates * sizeof(float))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    if ( !(zh = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zv when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zh = z_tmp;
     zh1 = dpp.zh1;
     zh2 = dpp.zh2;
     for (g = 0; g < num_gates; g++) {
@@ -2198,17 +2959,16 @@ static int spp_snrvc(struct RaXPol_Data *dat_p, float *snrvc)
     int g;
     int num_gates;
     float *zv1, *zv2;
-    static float *zv;			/* Average power */
-    float *z_tmp;
+    float *zv;			/* Average power */
     struct RaXPol_SPP spp = dat_p->dat_in.spp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(z_tmp = REALLOC(zv, num_gates * sizeof(float))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    if ( !(zv = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zv when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zv = z_tmp;
     zv1 = spp.zv1;
     zv2 = spp.zv2;
     for (g = 0; g < num_gates; g++) {
@@ -2225,17 +2985,16 @@ static int dpp_snrvc(struct RaXPol_Data *dat_p, float *snrvc)
     int g;
     int num_gates;
     float *zv1, *zv2;
-    static float *zv;			/* Average power */
-    float *z_tmp;
+    float *zv;			/* Average power */
     struct RaXPol_DPP dpp = dat_p->dat_in.dpp;
 
-    num_gates = dat_p->file_hdr.num_rng_gates;
-    if ( !(z_tmp = REALLOC(zv, num_gates * sizeof(float))) ) {
+    num_gates = RaXPol_Num_Gates(dat_p);
+    ARENA_RESET(&dat_p->scratch);
+    if ( !(zv = ARENA_ALLOC(&dat_p->scratch, num_gates * sizeof(float))) ) {
 	fprintf(stderr, "Could not allocate %d gates for zv when calculating"
 		" dbz\n", num_gates);
 	return 0;
     }
-    zv = z_tmp;
     zv1 = dpp.zv1;
     zv2 = dpp.zv2;
     for (g = 0; g < num_gates; g++) {
@@ -2258,6 +3017,76 @@ void RaXPol_Set_Hdg(double hdg)
     dflt_hdg = hdg;
 }
 
+/* Return heading set with RaXPol_Set_Hdg, or NAN if there is none */
+double RaXPol_Get_Hdg(void)
+{
+    return dflt_hdg;
+}
+
+/* Return true azimuth of the ray with header at rh_p */
+double RaXPol_Ray_Az(struct RaXPol_Ray_Hdr *rh_p)
+{
+    return ray_az(rh_p, 0);
+}
+
+/* Return time of the ray with header at rh_p, seconds since 1970-01-01 */
+double RaXPol_Ray_Tm(struct RaXPol_Ray_Hdr *rh_p)
+{
+    return rh_p->timestamp_seconds + 1.0e-6 * rh_p->timestamp_useconds;
+}
+
+/*
+   Convert time string s, of form YYYYMMDD-HHMMSS, with optional fraction
+   of second, to seconds since 1970-01-01 00:00:00 and copy to tm_p.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Scan_Tm(char *s, double *tm_p)
+{
+    int yr, mon, day, hr, min;		/* Year, month, day, hour, minute */
+    double sec;				/* Second */
+    double days;			/* Days since 1970-01-01 */
+
+    if ( sscanf(s, "%4d%2d%2d-%2d%2d%lf", &yr, &mon, &day, &hr, &min, &sec)
+	    != 6 ) {
+	fprintf(stderr, "%s is not a valid time.\n", s);
+	return 0;
+    }
+
+    /* Day count is an integer, so there is no rounding in the sum below */
+    days = Tm_CalToJul(yr, mon, day, 0, 0, 0.0)
+	- Tm_CalToJul(1970, 1, 1, 0, 0, 0.0);
+    *tm_p = floor(days + 0.5) * 86400.0 + hr * 3600.0 + min * 60.0 + sec;
+    return 1;
+}
+
+/*
+   Convert time range string s, of form start,end, where start and end are
+   times for RaXPol_Scan_Tm, to seconds since 1970-01-01 00:00:00 and copy to
+   tm0_p and tm1_p.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Scan_Tm_Rng(char *s, double *tm0_p, double *tm1_p)
+{
+    char *c;
+
+    if ( !(c = strchr(s, ',')) ) {
+	fprintf(stderr, "Time range %s should be start,end.\n", s);
+	return 0;
+    }
+    if ( !RaXPol_Scan_Tm(s, tm0_p) || !RaXPol_Scan_Tm(c + 1, tm1_p) ) {
+	return 0;
+    }
+    if ( *tm1_p < *tm0_p ) {
+	fprintf(stderr, "Time range %s ends before it starts.\n", s);
+	return 0;
+    }
+    return 1;
+}
+
 /* Return true azimuth of ray r */ 
 static double ray_az(struct RaXPol_Ray_Hdr *ray_hdrs, int r)
 {
@@ -2281,6 +3110,24 @@ double ang_to_ref(const double l, const double r)
     return (l1 == -0.0) ? 0.0 : l1;
 }
 
+/*
+   Return index of the first gate after the zero range gate, counting from
+   the start of the gate window of dat_p, limited to the window. With a gate
+   step, this is the first averaged gate with no gates before the zero range
+   gate.
+ */
+
+static int first_gate(struct RaXPol_Data *dat_p)
+{
+    int g0 = floor(dat_p->file_hdr.zero_range_gate_index + 1);
+    int k = dat_p->gate_step;
+    int num_gates = RaXPol_Num_Gates(dat_p);
+
+    g0 -= dat_p->g_start;
+    g0 = (g0 < 0) ? 0 : (g0 + k - 1) / k;
+    return (g0 > num_gates) ? num_gates : g0;
+}
+
 static float mean(float *f, int n)
 {
     double m;
@@ -0,0 +1,329 @@
+/*
+   -	raxpol_live.c --
+   -		Send rays from RaXPol files as they are written, with
+   -		gate values replaced by color indeces, as a stream of
+   -		server-sent events. See raxpol_live (1).
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include "alloc.h"
+#include "get_colors.h"
+#include "raxpol.h"
+#include "raxpol_mom.h"
+#include "raxpol_prof.h"
+#include "raxpol_seq.h"
+
+#define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
+
+/* Color name for gates that should not be drawn. Same as sweep_img. */
+#define TRANSPARENT "none"
+
+/* Milliseconds browser should wait before reconnecting */
+#define RETRY_MS 2000
+
+static char *argv0;			/* Name of the executable */
+
+/* Local functions */
+static int clr_idx(float, float *, int);
+static void print_ray(long, struct RaXPol_Mom_Ray *, float *, int, float *,
+	char **, int);
+
+int main(int argc, char *argv[])
+{
+    extern char *optarg;		/* See getopt (3) */
+    extern int optind;			/* See getopt (3) */
+    int c;				/* Index into argv */
+    int follow = 1;			/* If true, wait for new rays */
+    long r0 = LONG_MIN;			/* First ray to send */
+    long r;				/* Ray index in loop */
+    double dflt_hdg;			/* Default heading */
+    char *mom_nm = NULL;		/* Moment name, e.g. "DBZ" */
+    char *clr_fl_nm = NULL;		/* Color file path */
+    FILE *clr_fl;			/* Color file */
+    int num_colors;			/* Number of colors */
+    char **colors;			/* Color names, e.g. "#rrggbb" */
+    float *bnds;			/* Color bounds, dimensioned
+					   num_colors + 1 */
+    struct RaXPol_Seq seq;		/* Rays from all RaXPol files */
+    struct RaXPol_Data dat;		/* Data for one ray */
+    int (*calc)(struct RaXPol_Data *, float *) = NULL;
+					/* Function that computes moment */
+    float *f;				/* Moment values for one ray */
+    struct RaXPol_Mom_Ray ray;		/* Ray time and geometry */
+    int num_gates;			/* Number of gates */
+    double t0;				/* Profile start time */
+    char *usage = "Usage: %s [-e] [-l] [-h angle] [-s start] -m moment "
+	"-c color_file raxpol_file ...\n";
+
+    argv0 = argv[0];
+    RaXPol_Prof_Init(argv0);
+    RaXPol_Seq_Init(&seq);
+    if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
+	RaXPol_Old_Fmt();
+    }
+    while ((c = getopt(argc, argv, ":Velh:s:m:c:")) != -1) {
+	switch(c) {
+	    case 'V':
+		printf("%s\n", RAXPOL_MOMENT_VERSION);
+		exit(EXIT_SUCCESS);
+		break;
+	    case 'e':
+		follow = 0;
+		break;
+	    case 'l':
+		RaXPol_Old_Fmt();
+		break;
+	    case 'h':
+		if ( sscanf(optarg, "%lf", &dflt_hdg) != 1 ) {
+		    fprintf(stderr, "%s: expected float value for default "
+			    "heading, got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		RaXPol_Set_Hdg(dflt_hdg);
+		break;
+	    case 's':
+		if ( sscanf(optarg, "%ld", &r0) != 1 ) {
+		    fprintf(stderr, "%s: expected integer for index of first "
+			    "ray, got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'm':
+		mom_nm = optarg;
+		break;
+	    case 'c':
+		clr_fl_nm = optarg;
+		break;
+	    case '?':
+	    case ':':
+		fprintf(stderr, usage, argv0);
+		exit(EXIT_FAILURE);
+		break;
+	}
+    }
+    if ( !mom_nm || !clr_fl_nm || optind == argc ) {
+	fprintf(stderr, usage, argv0);
+	exit(EXIT_FAILURE);
+    }
+    if ( !(clr_fl = fopen(clr_fl_nm, "r")) ) {
+	fprintf(stderr, "%s: could not open color file %s.\n%s\n",
+		argv0, clr_fl_nm, strerror(errno));
+	exit(EXIT_FAILURE);
+    }
+    if ( !GetColors(clr_fl, &num_colors, &colors, &bnds) ) {
+	fprintf(stderr, "%s: could not read colors from %s.\n",
+		argv0, clr_fl_nm);
+	exit(EXIT_FAILURE);
+    }
+    fclose(clr_fl);
+
+    if ( follow ) {
+	RaXPol_Seq_Follow(&seq);
+    }
+    if ( !RaXPol_Seq_Open(&seq, argv + optind, argc - optind, &dat) ) {
+	fprintf(stderr, "%s: failed to initialize RaXPol data structure.\n",
+		argv0);
+	exit(EXIT_FAILURE);
+    }
+    num_gates = dat.file_hdr.num_rng_gates;
+    if ( strcmp(mom_nm, "DBMHC") == 0 ) {
+	calc = dat.dbmhc;
+    } else if ( strcmp(mom_nm, "DBMVC") == 0 ) {
+	calc = dat.dbmvc;
+    } else if ( strcmp(mom_nm, "DBZ") == 0 ) {
+	calc = dat.dbz;
+    } else if ( strcmp(mom_nm, "DBZ1") == 0 ) {
+	calc = dat.dbz1;
+    } else if ( strcmp(mom_nm, "VEL") == 0 ) {
+	calc = dat.vel;
+    } else if ( strcmp(mom_nm, "ZDR") == 0 ) {
+	calc = dat.zdr;
+    } else if ( strcmp(mom_nm, "PHIDP") == 0 ) {
+	calc = dat.phidp;
+    } else if ( strcmp(mom_nm, "RHOHV") == 0 ) {
+	calc = dat.rhohv;
+    } else if ( strcmp(mom_nm, "STD") == 0 ) {
+	calc = dat.std;
+    } else if ( strcmp(mom_nm, "SNRHC") == 0 ) {
+	calc = dat.snrhc;
+    } else if ( strcmp(mom_nm, "SNRVC") == 0 ) {
+	calc = dat.snrvc;
+    } else {
+	fprintf(stderr, "%s: unknown moment %s.\n", argv0, mom_nm);
+	exit(EXIT_FAILURE);
+    }
+    if ( !(f = CALLOC(num_gates, sizeof(float))) ) {
+	fprintf(stderr, "%s: could not allocate storage for %s.\n",
+		argv0, mom_nm);
+	exit(EXIT_FAILURE);
+    }
+
+    /*
+       By default, send only rays written after startup. Negative start
+       counts back from the last ray present at startup.
+     */
+
+    if ( r0 == LONG_MIN ) {
+	r0 = seq.num_rays;
+    } else if ( r0 < 0 ) {
+	r0 = (seq.num_rays + r0 > 0) ? seq.num_rays + r0 : 0;
+    }
+    if ( r0 > seq.num_rays ) {
+	r0 = seq.num_rays;
+    }
+    if ( !RaXPol_Seq_Seek(&seq, r0) ) {
+	fprintf(stderr, "%s: could not position at start of ray %ld.\n",
+		argv0, r0);
+	exit(EXIT_FAILURE);
+    }
+
+    /*
+       First event gives gate geometry and the color table. Colors that
+       should not be drawn are sent as "none".
+     */
+
+    printf("retry: %d\n\n", RETRY_MS);
+    printf("event: colors\n");
+    printf("data: %s %d %.3f %d", mom_nm, num_gates,
+	    dat.file_hdr.range_gate_spacing, num_colors);
+    for (c = 0; c < num_colors; c++) {
+	printf(" %s", colors[c]);
+    }
+    printf("\n\n");
+    fflush(stdout);
+
+    for (r = r0; follow || r < seq.num_rays; r++) {
+	if ( !RaXPol_Seq_Read_Ray(&seq) ) {
+	    fprintf(stderr, "%s: could not read ray %ld\n", argv0, r);
+	    exit(EXIT_FAILURE);
+	}
+	t0 = RaXPol_Prof_Start();
+	if ( !calc(&dat, f) ) {
+	    fprintf(stderr, "%s: could not compute %s for ray %ld\n",
+		    argv0, mom_nm, r);
+	    exit(EXIT_FAILURE);
+	}
+	RaXPol_Prof_Mom(mom_nm, t0, num_gates);
+	t0 = RaXPol_Prof_Start();
+	RaXPol_Mom_Set_Ray(&ray, &dat.ray_hdr);
+	print_ray(r, &ray, f, num_gates, bnds, colors, num_colors);
+	if ( fflush(stdout) == EOF ) {
+	    /* Browser went away */
+	    break;
+	}
+	RaXPol_Prof_Stop("output", t0, 1);
+    }
+
+    RaXPol_Seq_Free(&seq);
+    FREE(f);
+    FREE(colors);
+    FREE(bnds);
+    return EXIT_SUCCESS;
+}
+
+/*
+   Print a ray event for ray r. Event data are ray index, time, azimuth,
+   elevation, sweep count, and color indeces for the gates. Runs of gates
+   with the same color index c are printed as c*n, where n is the length of
+   the run. Gates with no value, values outside the color table, or
+   transparent colors get index -1.
+ */
+
+static void print_ray(long r, struct RaXPol_Mom_Ray *ray_p, float *f,
+	int num_gates, float *bnds, char **colors, int num_colors)
+{
+    int g0, g;				/* Gate indeces */
+    int c0, c;				/* Color indeces */
+
+    printf("id: %ld\n", r);
+    printf("event: ray\n");
+    printf("data: %ld %.3f %.2f %.2f %d", r, ray_p->tm, ray_p->az, ray_p->el,
+	    ray_p->sweep_count);
+    for (g0 = 0; g0 < num_gates; g0 = g) {
+	c0 = clr_idx(f[g0], bnds, num_colors);
+	if ( c0 != -1 && strcmp(colors[c0], TRANSPARENT) == 0 ) {
+	    c0 = -1;
+	}
+	for (g = g0 + 1; g < num_gates; g++) {
+	    c = clr_idx(f[g], bnds, num_colors);
+	    if ( c != -1 && strcmp(colors[c], TRANSPARENT) == 0 ) {
+		c = -1;
+	    }
+	    if ( c != c0 ) {
+		break;
+	    }
+	}
+	if ( g - g0 == 1 ) {
+	    printf(" %d", c0);
+	} else {
+	    printf(" %d*%d", c0, g - g0);
+	}
+    }
+    printf("\n\n");
+}
+
+/*
+   Return index of color for value v, or -1 if v is not finite or is outside
+   the color table. Color c is for values from bnds[c] up to but not including
+   bnds[c + 1]. bnds may be ascending or descending. This matches the
+   interval search in bisearch_lib, so gates get the same colors as they do
+   in sweep_img output.
+ */
+
+static int clr_idx(float v, float *bnds, int num_colors)
+{
+    int lo, hi, mid;			/* Indeces into bnds */
+    int asc;				/* If true, bnds are ascending */
+
+    if ( !isfinite(v) ) {
+	return -1;
+    }
+    asc = bnds[0] < bnds[1];
+    if ( asc ? (v < bnds[0] || v >= bnds[num_colors])
+	    : (v > bnds[0] || v <= bnds[num_colors]) ) {
+	return -1;
+    }
+    for (lo = 0, hi = num_colors; hi - lo > 1; ) {
+	mid = (lo + hi) / 2;
+	if ( asc ? v >= bnds[mid] : v <= bnds[mid] ) {
+	    lo = mid;
+	} else {
+	    hi = mid;
+	}
+    }
+    return lo;
+}
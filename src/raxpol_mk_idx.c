@@ -0,0 +1,230 @@
+/*
+   -	raxpol_mk_idx.c --
+   -		Make ray indeces for RaXPol files. See raxpol_mk_idx (1).
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "alloc.h"
+#include "raxpol.h"
+#include "raxpol_idx.h"
+#include "raxpol_prof.h"
+
+#define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
+
+/* Suffix for index under construction */
+#define TMP_SFX ".tmp"
+
+static char *argv0;			/* Name of the executable */
+
+/* Local functions */
+static int check_idx(char *);
+static int mk_idx(char *);
+
+int main(int argc, char *argv[])
+{
+    extern int optind;			/* See getopt (3) */
+    int c;				/* Index into argv */
+    int check = 0;			/* If true, only check indeces */
+    int force = 0;			/* If true, rebuild current indeces */
+    int status = EXIT_SUCCESS;
+    char *raxpol_fl_nm;			/* RaXPol file path */
+
+    argv0 = argv[0];
+    RaXPol_Prof_Init(argv0);
+    if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
+	RaXPol_Old_Fmt();
+    }
+    while ((c = getopt(argc, argv, ":Vcfl")) != -1) {
+	switch(c) {
+	    case 'V':
+		printf("%s\n", RAXPOL_MOMENT_VERSION);
+		exit(EXIT_SUCCESS);
+		break;
+	    case 'c':
+		check = 1;
+		break;
+	    case 'f':
+		force = 1;
+		break;
+	    case 'l':
+		RaXPol_Old_Fmt();
+		break;
+	    case '?':
+		fprintf(stderr, "Usage: %s [-c] [-f] [-l] raxpol_file ...\n",
+			argv0);
+		exit(EXIT_FAILURE);
+		break;
+	}
+    }
+    if ( optind == argc ) {
+	fprintf(stderr, "Usage: %s [-c] [-f] [-l] raxpol_file ...\n", argv0);
+	exit(EXIT_FAILURE);
+    }
+    for ( ; optind < argc; optind++) {
+	raxpol_fl_nm = argv[optind];
+	if ( check ) {
+	    if ( !check_idx(raxpol_fl_nm) ) {
+		status = EXIT_FAILURE;
+	    }
+	} else if ( force || !check_idx(raxpol_fl_nm) ) {
+	    if ( !mk_idx(raxpol_fl_nm) ) {
+		fprintf(stderr, "%s: could not make ray index for %s\n",
+			argv0, raxpol_fl_nm);
+		status = EXIT_FAILURE;
+	    }
+	}
+    }
+    return status;
+}
+
+/*
+   Return true if RaXPol file raxpol_fl_nm has a ray index that matches
+   the file.
+ */
+
+static int check_idx(char *raxpol_fl_nm)
+{
+    FILE *raxpol_fl;
+    struct RaXPol_Data dat;
+    struct RaXPol_Idx idx;
+    int status;
+
+    if ( !(raxpol_fl = fopen(raxpol_fl_nm, "r")) ) {
+	return 0;
+    }
+    if ( !RaXPol_Init_Data(&dat, raxpol_fl) ) {
+	RaXPol_Free_Data(&dat);
+	fclose(raxpol_fl);
+	return 0;
+    }
+    fclose(raxpol_fl);
+    RaXPol_Idx_Init(&idx);
+    status = RaXPol_Idx_Open(&idx, raxpol_fl_nm, &dat);
+    RaXPol_Idx_Free(&idx);
+    RaXPol_Free_Data(&dat);
+    return status;
+}
+
+/*
+   Read all rays in RaXPol file raxpol_fl_nm, and store their times,
+   positions, and noise averages in its ray index. The index is assembled
+   in a temporary file, which replaces the index when complete.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int mk_idx(char *raxpol_fl_nm)
+{
+    FILE *raxpol_fl = NULL;		/* RaXPol file */
+    struct stat sb;			/* Status of RaXPol file */
+    struct RaXPol_Data dat;		/* Data for one ray */
+    struct RaXPol_Idx idx;		/* Ray index */
+    char *idx_nm = NULL;		/* Path to index */
+    char *tmp_nm = NULL;		/* Path to index under construction */
+    FILE *out = NULL;			/* Index under construction */
+    int status = 0;
+
+    if ( !(raxpol_fl = fopen(raxpol_fl_nm, "r")) ) {
+	fprintf(stderr, "%s: could not open %s for reading.\n",
+		argv0, raxpol_fl_nm);
+	return 0;
+    }
+    RaXPol_Init_Data(&dat, NULL);
+    RaXPol_Idx_Init(&idx);
+    if ( fstat(fileno(raxpol_fl), &sb) == -1 ) {
+	fprintf(stderr, "%s: could not get status of %s.\n%s\n",
+		argv0, raxpol_fl_nm, strerror(errno));
+	goto end;
+    }
+    if ( !RaXPol_Init_Data(&dat, raxpol_fl) ) {
+	fprintf(stderr, "%s: failed to initialize RaXPol data structure.\n",
+		argv0);
+	goto end;
+    }
+    if ( !RaXPol_Idx_Make(&idx, &dat, raxpol_fl) ) {
+	fprintf(stderr, "%s: could not read rays from %s.\n",
+		argv0, raxpol_fl_nm);
+	goto end;
+    }
+    idx.src_sz = sb.st_size;
+    idx.src_mtime = sb.st_mtime;
+
+    /* Write index under construction, then move it into place */
+    if ( !(idx_nm = RaXPol_Idx_Path(raxpol_fl_nm))
+	    || !(tmp_nm = MALLOC(strlen(idx_nm) + strlen(TMP_SFX) + 1)) ) {
+	fprintf(stderr, "%s: could not allocate index path for %s.\n",
+		argv0, raxpol_fl_nm);
+	goto end;
+    }
+    strcpy(tmp_nm, idx_nm);
+    strcat(tmp_nm, TMP_SFX);
+    if ( !(out = fopen(tmp_nm, "w")) ) {
+	fprintf(stderr, "%s: could not create %s.\n%s\n",
+		argv0, tmp_nm, strerror(errno));
+	goto end;
+    }
+    if ( !RaXPol_Idx_Write(&idx, out) ) {
+	fprintf(stderr, "%s: could not write %s.\n", argv0, tmp_nm);
+	goto end;
+    }
+    if ( fclose(out) == EOF ) {
+	out = NULL;
+	fprintf(stderr, "%s: could not close %s.\n%s\n",
+		argv0, tmp_nm, strerror(errno));
+	goto end;
+    }
+    out = NULL;
+    if ( rename(tmp_nm, idx_nm) == -1 ) {
+	fprintf(stderr, "%s: could not rename %s to %s.\n%s\n",
+		argv0, tmp_nm, idx_nm, strerror(errno));
+	goto end;
+    }
+    status = 1;
+
+end:
+    if ( out ) {
+	fclose(out);
+    }
+    if ( !status && tmp_nm ) {
+	unlink(tmp_nm);
+    }
+    fclose(raxpol_fl);
+    RaXPol_Idx_Free(&idx);
+    RaXPol_Free_Data(&dat);
+    FREE(idx_nm);
+    FREE(tmp_nm);
+    return status;
+}
@@ -0,0 +1,746 @@
+/*
+   -	raxpol_mom.c --
+   -		This file defines functions that store and access
+   -		RaXPol moment files. See raxpol_mom.h for the file layout.
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "alloc.h"
+#include "type_nbit.h"
+#include "val_buf.h"
+#include "swap.h"
+#include "raxpol.h"
+#include "raxpol_mom.h"
+
+/* Value of endian tag in host byte order */
+#define ENDIAN_TAG 0x01020304
+
+/*
+   Range of physical values for each moment in RAXPOL_MOM_U2 blocks.
+   Resolution is about (max - min) / 65533.
+ */
+
+static struct {
+    char *nm;
+    double min, max;
+} u2_rng[] = {
+    {"DBMHC", -150.0, 100.0},
+    {"DBMVC", -150.0, 100.0},
+    {"DBZ", -100.0, 100.0},
+    {"DBZ1", -100.0, 100.0},
+    {"VEL", -100.0, 100.0},
+    {"ZDR", -40.0, 40.0},
+    {"PHIDP", -180.0, 180.0},
+    {"RHOHV", 0.0, 2.0},
+    {"STD", 0.0, 100.0},
+    {"SNRHC", -50.0, 150.0},
+    {"SNRVC", -50.0, 150.0}
+};
+
+/* Local functions */
+static size_t type_sz(enum RAXPOL_MOM_TYPE);
+static U2BYT f_to_u2(float, double, double);
+static float u2_to_f(U2BYT, double, double);
+static off_t align(off_t);
+static U8BYT get_u8(char **);
+static void put_u8(char **, U8BYT);
+static int pread_all(int, void *, size_t, off_t);
+static int pwrite_all(int, void *, size_t, off_t);
+
+/*
+   Initialize moment file header at hdr_p for num_rays rays, starting at
+   index r0 in a RaXPol file, with num_moms moments named in nms, stored as
+   values of the given type. Other header values come from dat_p, which must
+   have been initialized with RaXPol_Init_Data. Compute offsets to the ray
+   table and moment blocks. Source file size and time are left 0.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Mom_Init_Hdr(struct RaXPol_Mom_Hdr *hdr_p,
+	struct RaXPol_Data *dat_p, int r0, int num_rays, char **nms,
+	int num_moms, enum RAXPOL_MOM_TYPE type)
+{
+    int m, n;
+    off_t o;				/* Offset in moment file */
+    off_t blk_sz;			/* Size of a moment block */
+
+    if ( num_rays < 0 ) {
+	fprintf(stderr, "Ray count for moment file must not be negative.\n");
+	return 0;
+    }
+    if ( num_moms < 1 || num_moms > RAXPOL_MOM_MAX ) {
+	fprintf(stderr, "Moment file must have between 1 and %d moments.\n",
+		RAXPOL_MOM_MAX);
+	return 0;
+    }
+    memset(hdr_p, 0, sizeof(struct RaXPol_Mom_Hdr));
+    hdr_p->num_rays = num_rays;
+    hdr_p->num_gates = dat_p->file_hdr.num_rng_gates;
+    hdr_p->num_moms = num_moms;
+    hdr_p->servmode = dat_p->servmode;
+    hdr_p->scan_type = dat_p->file_hdr.scan_type;
+    hdr_p->r0 = r0;
+    hdr_p->gate_spacing = dat_p->file_hdr.range_gate_spacing;
+    hdr_p->thres_val = dat_p->thres_val;
+    hdr_p->cal_hh_val = dat_p->cal_hh_val;
+    hdr_p->cal_vv_val = dat_p->cal_vv_val;
+    hdr_p->hdg = RaXPol_Get_Hdg();
+    hdr_p->alg_rev = RAXPOL_MOM_ALG_REV;
+    hdr_p->ray_tbl_off = RAXPOL_MOM_HDR_SZ + num_moms * RAXPOL_MOM_FLD_SZ;
+    o = align(hdr_p->ray_tbl_off + (off_t)num_rays * RAXPOL_MOM_RAY_SZ);
+    for (m = 0; m < num_moms; m++) {
+	struct RaXPol_Mom_Fld *fld_p = hdr_p->flds + m;
+
+	if ( strlen(nms[m]) >= RAXPOL_MOM_NM_SZ ) {
+	    fprintf(stderr, "Moment name %s too long for moment file.\n",
+		    nms[m]);
+	    return 0;
+	}
+	strcpy(fld_p->nm, nms[m]);
+	fld_p->type = type;
+	switch (type) {
+	    case RAXPOL_MOM_F4:
+		fld_p->scale = 1.0;
+		fld_p->offset = 0.0;
+		break;
+	    case RAXPOL_MOM_U2:
+		for (n = 0; n < sizeof(u2_rng) / sizeof(u2_rng[0]); n++) {
+		    if ( strcmp(u2_rng[n].nm, nms[m]) == 0 ) {
+			break;
+		    }
+		}
+		if ( n == sizeof(u2_rng) / sizeof(u2_rng[0]) ) {
+		    fprintf(stderr, "No range for packed values of %s.\n",
+			    nms[m]);
+		    return 0;
+		}
+		fld_p->offset = u2_rng[n].min;
+		fld_p->scale = (u2_rng[n].max - u2_rng[n].min)
+		    / (RAXPOL_MOM_U2_MAX - 1);
+		break;
+	}
+	fld_p->off = o;
+	blk_sz = (off_t)num_rays * hdr_p->num_gates * type_sz(fld_p->type);
+	fld_p->sz = blk_sz;
+	o = align(o + blk_sz);
+    }
+    return 1;
+}
+
+/*
+   Write file header and moment table from hdr_p to the start of the file
+   open for writing at file descriptor fd. Block sizes are recomputed from
+   hdr_p->num_rays, which may be less than the ray count given to
+   RaXPol_Mom_Init_Hdr, e.g. if input ended early.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Mom_Write_Hdr(struct RaXPol_Mom_Hdr *hdr_p, int fd)
+{
+    char buf[RAXPOL_MOM_HDR_SZ + RAXPOL_MOM_MAX * RAXPOL_MOM_FLD_SZ];
+    char *b;
+    int m;
+    size_t sz;
+
+    sz = RAXPOL_MOM_HDR_SZ + hdr_p->num_moms * RAXPOL_MOM_FLD_SZ;
+    memset(buf, 0, sz);
+    b = buf;
+    ValBuf_PutBytes(&b, RAXPOL_MOM_MAGIC, sizeof(RAXPOL_MOM_MAGIC));
+    b = buf + 8;
+    ValBuf_PutI4BYT(&b, ENDIAN_TAG);
+    ValBuf_PutI4BYT(&b, RAXPOL_MOM_VERSION);
+    ValBuf_PutI4BYT(&b, hdr_p->num_rays);
+    ValBuf_PutI4BYT(&b, hdr_p->num_gates);
+    ValBuf_PutI4BYT(&b, hdr_p->num_moms);
+    ValBuf_PutI4BYT(&b, hdr_p->servmode);
+    ValBuf_PutI4BYT(&b, hdr_p->scan_type);
+    ValBuf_PutI4BYT(&b, hdr_p->r0);
+    ValBuf_PutF8BYT(&b, hdr_p->gate_spacing);
+    ValBuf_PutF8BYT(&b, hdr_p->thres_val);
+    ValBuf_PutF8BYT(&b, hdr_p->cal_hh_val);
+    ValBuf_PutF8BYT(&b, hdr_p->cal_vv_val);
+    put_u8(&b, hdr_p->ray_tbl_off);
+    put_u8(&b, hdr_p->src_sz);
+    put_u8(&b, hdr_p->src_mtime);
+    ValBuf_PutF8BYT(&b, hdr_p->hdg);
+    ValBuf_PutI4BYT(&b, hdr_p->alg_rev);
+    for (m = 0; m < hdr_p->num_moms; m++) {
+	struct RaXPol_Mom_Fld *fld_p = hdr_p->flds + m;
+
+	fld_p->sz = (off_t)hdr_p->num_rays * hdr_p->num_gates
+	    * type_sz(fld_p->type);
+	b = buf + RAXPOL_MOM_HDR_SZ + m * RAXPOL_MOM_FLD_SZ;
+	ValBuf_PutBytes(&b, fld_p->nm, RAXPOL_MOM_NM_SZ);
+	ValBuf_PutI4BYT(&b, fld_p->type);
+	ValBuf_PutI4BYT(&b, 0);
+	ValBuf_PutF8BYT(&b, fld_p->scale);
+	ValBuf_PutF8BYT(&b, fld_p->offset);
+	put_u8(&b, fld_p->off);
+	put_u8(&b, fld_p->sz);
+    }
+    if ( !pwrite_all(fd, buf, sz, 0) ) {
+	fprintf(stderr, "Could not write moment file header.\n%s\n",
+		strerror(errno));
+	return 0;
+    }
+    return 1;
+}
+
+/* Copy ray location and time from RaXPol ray header rh_p to ray_p. */
+void RaXPol_Mom_Set_Ray(struct RaXPol_Mom_Ray *ray_p,
+	struct RaXPol_Ray_Hdr *rh_p)
+{
+    ray_p->tm = rh_p->timestamp_seconds + 1.0e-6 * rh_p->timestamp_useconds;
+    ray_p->az = RaXPol_Ray_Az(rh_p);
+    ray_p->el = rh_p->el;
+    ray_p->lon = rh_p->lon * (rh_p->lon_ref == 'E' ? 1.0 : -1.0);
+    ray_p->lat = rh_p->lat * (rh_p->lat_ref == 'N' ? 1.0 : -1.0);
+    ray_p->alt = rh_p->alt;
+    ray_p->sweep_count = rh_p->sweep_count;
+    ray_p->volume_count = rh_p->volume_count;
+    ray_p->scan_type = rh_p->pedestal_scan_type;
+}
+
+/*
+   Write ray table entry for ray r from ray_p, and moment values for ray r
+   from flds, to moment file at file descriptor fd. flds must have
+   hdr_p->num_moms arrays, in the order of the moment table, each with
+   hdr_p->num_gates values.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Mom_Write_Ray(struct RaXPol_Mom_Hdr *hdr_p, int fd, int r,
+	struct RaXPol_Mom_Ray *ray_p, float **flds)
+{
+    char buf[RAXPOL_MOM_RAY_SZ];
+    char *b;
+    int m, g;
+    size_t sz;
+    static U2BYT *u2;			/* Packed values for one ray */
+    static int num_u2;			/* Allocation at u2 */
+    void *v;				/* Values to write */
+
+    if ( r < 0 || r >= hdr_p->num_rays ) {
+	fprintf(stderr, "Ray index %d out of range for moment file with "
+		"%d rays.\n", r, hdr_p->num_rays);
+	return 0;
+    }
+    memset(buf, 0, RAXPOL_MOM_RAY_SZ);
+    b = buf;
+    ValBuf_PutF8BYT(&b, ray_p->tm);
+    ValBuf_PutF8BYT(&b, ray_p->az);
+    ValBuf_PutF8BYT(&b, ray_p->el);
+    ValBuf_PutF8BYT(&b, ray_p->lon);
+    ValBuf_PutF8BYT(&b, ray_p->lat);
+    ValBuf_PutF8BYT(&b, ray_p->alt);
+    ValBuf_PutI4BYT(&b, ray_p->sweep_count);
+    ValBuf_PutI4BYT(&b, ray_p->volume_count);
+    ValBuf_PutI4BYT(&b, ray_p->scan_type);
+    if ( !pwrite_all(fd, buf, RAXPOL_MOM_RAY_SZ,
+		hdr_p->ray_tbl_off + (off_t)r * RAXPOL_MOM_RAY_SZ) ) {
+	fprintf(stderr, "Could not write ray table entry for ray %d.\n%s\n",
+		r, strerror(errno));
+	return 0;
+    }
+    for (m = 0; m < hdr_p->num_moms; m++) {
+	struct RaXPol_Mom_Fld *fld_p = hdr_p->flds + m;
+
+	sz = hdr_p->num_gates * type_sz(fld_p->type);
+	switch (fld_p->type) {
+	    case RAXPOL_MOM_F4:
+		v = flds[m];
+		break;
+	    case RAXPOL_MOM_U2:
+		if ( hdr_p->num_gates > num_u2 ) {
+		    U2BYT *t = REALLOC(u2, hdr_p->num_gates * sizeof(U2BYT));
+
+		    if ( !t ) {
+			fprintf(stderr, "Could not allocate packing buffer for "
+				"%d gates.\n", hdr_p->num_gates);
+			return 0;
+		    }
+		    u2 = t;
+		    num_u2 = hdr_p->num_gates;
+		}
+		for (g = 0; g < hdr_p->num_gates; g++) {
+		    u2[g] = f_to_u2(flds[m][g], fld_p->scale, fld_p->offset);
+		}
+		v = u2;
+		break;
+	}
+	if ( !pwrite_all(fd, v, sz, fld_p->off + (off_t)r * sz) ) {
+	    fprintf(stderr, "Could not write %s for ray %d.\n%s\n",
+		    fld_p->nm, r, strerror(errno));
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+   Read moment file header and moment table from file descriptor fd
+   into hdr_p.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Mom_Read_Hdr(struct RaXPol_Mom_Hdr *hdr_p, int fd)
+{
+    char buf[RAXPOL_MOM_HDR_SZ + RAXPOL_MOM_MAX * RAXPOL_MOM_FLD_SZ];
+    char *b;
+    I4BYT tag, version;
+    int m;
+    int status = 0;
+
+    memset(hdr_p, 0, sizeof(struct RaXPol_Mom_Hdr));
+    if ( !pread_all(fd, buf, RAXPOL_MOM_HDR_SZ, 0) ) {
+	fprintf(stderr, "Could not read moment file header.\n");
+	return 0;
+    }
+    if ( memcmp(buf, RAXPOL_MOM_MAGIC, sizeof(RAXPOL_MOM_MAGIC)) != 0 ) {
+	fprintf(stderr, "Not a RaXPol moment file.\n");
+	return 0;
+    }
+    memcpy(&tag, buf + 8, 4);
+    if ( tag == ENDIAN_TAG ) {
+	hdr_p->swap = 0;
+    } else {
+	Swap_On();
+	Swap_4Byt(&tag);
+	Swap_Off();
+	if ( tag != ENDIAN_TAG ) {
+	    fprintf(stderr, "Moment file has unknown byte order.\n");
+	    return 0;
+	}
+	hdr_p->swap = 1;
+    }
+    if ( hdr_p->swap ) {
+	Swap_On();
+    }
+    b = buf + 12;
+    if ( (version = ValBuf_GetI4BYT(&b)) != RAXPOL_MOM_VERSION ) {
+	fprintf(stderr, "Moment file has unknown version %d.\n", version);
+	goto end;
+    }
+    hdr_p->num_rays = ValBuf_GetI4BYT(&b);
+    hdr_p->num_gates = ValBuf_GetI4BYT(&b);
+    hdr_p->num_moms = ValBuf_GetI4BYT(&b);
+    hdr_p->servmode = ValBuf_GetI4BYT(&b);
+    hdr_p->scan_type = ValBuf_GetI4BYT(&b);
+    hdr_p->r0 = ValBuf_GetI4BYT(&b);
+    hdr_p->gate_spacing = ValBuf_GetF8BYT(&b);
+    hdr_p->thres_val = ValBuf_GetF8BYT(&b);
+    hdr_p->cal_hh_val = ValBuf_GetF8BYT(&b);
+    hdr_p->cal_vv_val = ValBuf_GetF8BYT(&b);
+    hdr_p->ray_tbl_off = get_u8(&b);
+    hdr_p->src_sz = get_u8(&b);
+    hdr_p->src_mtime = get_u8(&b);
+    hdr_p->hdg = ValBuf_GetF8BYT(&b);
+    hdr_p->alg_rev = ValBuf_GetI4BYT(&b);
+    if ( hdr_p->num_rays < 0 || hdr_p->num_gates < 0
+	    || hdr_p->num_moms < 1 || hdr_p->num_moms > RAXPOL_MOM_MAX ) {
+	fprintf(stderr, "Moment file has bad dimensions: %d rays, %d gates, "
+		"%d moments.\n",
+		hdr_p->num_rays, hdr_p->num_gates, hdr_p->num_moms);
+	goto end;
+    }
+    if ( !pread_all(fd, buf, hdr_p->num_moms * RAXPOL_MOM_FLD_SZ,
+		RAXPOL_MOM_HDR_SZ) ) {
+	fprintf(stderr, "Could not read moment table.\n");
+	goto end;
+    }
+    for (m = 0; m < hdr_p->num_moms; m++) {
+	struct RaXPol_Mom_Fld *fld_p = hdr_p->flds + m;
+
+	b = buf + m * RAXPOL_MOM_FLD_SZ;
+	ValBuf_GetBytes(&b, fld_p->nm, RAXPOL_MOM_NM_SZ);
+	fld_p->nm[RAXPOL_MOM_NM_SZ - 1] = '\0';
+	fld_p->type = ValBuf_GetI4BYT(&b);
+	b += 4;
+	fld_p->scale = ValBuf_GetF8BYT(&b);
+	fld_p->offset = ValBuf_GetF8BYT(&b);
+	fld_p->off = get_u8(&b);
+	fld_p->sz = get_u8(&b);
+	if ( fld_p->type != RAXPOL_MOM_F4 && fld_p->type != RAXPOL_MOM_U2 ) {
+	    fprintf(stderr, "Moment %s has unknown type %d.\n",
+		    fld_p->nm, fld_p->type);
+	    goto end;
+	}
+	if ( fld_p->sz != (off_t)hdr_p->num_rays * hdr_p->num_gates
+		* type_sz(fld_p->type) ) {
+	    fprintf(stderr, "Moment %s has wrong block size.\n", fld_p->nm);
+	    goto end;
+	}
+    }
+    status = 1;
+
+end:
+    Swap_Off();
+    return status;
+}
+
+/* Return index of moment named nm in hdr_p, or -1 if there is none. */
+int RaXPol_Mom_Fld_Idx(struct RaXPol_Mom_Hdr *hdr_p, char *nm)
+{
+    int m;
+
+    for (m = 0; m < hdr_p->num_moms; m++) {
+	if ( strcmp(hdr_p->flds[m].nm, nm) == 0 ) {
+	    return m;
+	}
+    }
+    return -1;
+}
+
+/*
+   Read num_rays ray table entries, starting with ray r0, from moment file
+   at file descriptor fd into rays. hdr_p must be from RaXPol_Mom_Read_Hdr.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Mom_Read_Rays(struct RaXPol_Mom_Hdr *hdr_p, int fd, int r0,
+	int num_rays, struct RaXPol_Mom_Ray *rays)
+{
+    char *buf, *b;
+    size_t sz;
+    int r;
+
+    if ( r0 < 0 || num_rays < 0 || r0 + num_rays > hdr_p->num_rays ) {
+	fprintf(stderr, "Rays %d to %d out of range for moment file with "
+		"%d rays.\n", r0, r0 + num_rays - 1, hdr_p->num_rays);
+	return 0;
+    }
+    sz = (size_t)num_rays * RAXPOL_MOM_RAY_SZ;
+    if ( !(buf = MALLOC(sz + 1)) ) {
+	fprintf(stderr, "Could not allocate buffer for %d ray table "
+		"entries.\n", num_rays);
+	return 0;
+    }
+    if ( !pread_all(fd, buf, sz,
+		hdr_p->ray_tbl_off + (off_t)r0 * RAXPOL_MOM_RAY_SZ) ) {
+	fprintf(stderr, "Could not read ray table.\n");
+	FREE(buf);
+	return 0;
+    }
+    if ( hdr_p->swap ) {
+	Swap_On();
+    }
+    for (r = 0; r < num_rays; r++) {
+	b = buf + r * RAXPOL_MOM_RAY_SZ;
+	rays[r].tm = ValBuf_GetF8BYT(&b);
+	rays[r].az = ValBuf_GetF8BYT(&b);
+	rays[r].el = ValBuf_GetF8BYT(&b);
+	rays[r].lon = ValBuf_GetF8BYT(&b);
+	rays[r].lat = ValBuf_GetF8BYT(&b);
+	rays[r].alt = ValBuf_GetF8BYT(&b);
+	rays[r].sweep_count = ValBuf_GetI4BYT(&b);
+	rays[r].volume_count = ValBuf_GetI4BYT(&b);
+	rays[r].scan_type = ValBuf_GetI4BYT(&b);
+    }
+    Swap_Off();
+    FREE(buf);
+    return 1;
+}
+
+/*
+   Read values of moment m for num_rays rays, starting with ray r0, from
+   moment file at file descriptor fd into dat, which must have space for
+   num_rays * hdr_p->num_gates floats. Values are read with a single call
+   to pread, and unpacked if necessary. hdr_p must be from
+   RaXPol_Mom_Read_Hdr.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Mom_Read_Fld(struct RaXPol_Mom_Hdr *hdr_p, int fd, int m, int r0,
+	int num_rays, float *dat)
+{
+    struct RaXPol_Mom_Fld *fld_p;
+    size_t n;				/* Number of values */
+    size_t sz;				/* Size of one value in file */
+    float *d, *d1;
+    U2BYT *u;
+
+    if ( m < 0 || m >= hdr_p->num_moms ) {
+	fprintf(stderr, "Moment index %d out of range for moment file with "
+		"%d moments.\n", m, hdr_p->num_moms);
+	return 0;
+    }
+    if ( r0 < 0 || num_rays < 0 || r0 + num_rays > hdr_p->num_rays ) {
+	fprintf(stderr, "Rays %d to %d out of range for moment file with "
+		"%d rays.\n", r0, r0 + num_rays - 1, hdr_p->num_rays);
+	return 0;
+    }
+    fld_p = hdr_p->flds + m;
+    n = (size_t)num_rays * hdr_p->num_gates;
+    sz = type_sz(fld_p->type);
+
+    /*
+       Packed values are read into the second half of dat, and unpacked
+       from front to back, so they are not overwritten before use.
+     */
+
+    u = (U2BYT *)(dat + n) - n;
+    if ( !pread_all(fd, (fld_p->type == RAXPOL_MOM_U2) ? (void *)u : dat,
+		n * sz, fld_p->off + (off_t)r0 * hdr_p->num_gates * sz) ) {
+	fprintf(stderr, "Could not read %s for rays %d to %d.\n",
+		fld_p->nm, r0, r0 + num_rays - 1);
+	return 0;
+    }
+    if ( hdr_p->swap ) {
+	Swap_On();
+    }
+    switch (fld_p->type) {
+	case RAXPOL_MOM_F4:
+	    if ( hdr_p->swap ) {
+		for (d = dat, d1 = dat + n; d < d1; d++) {
+		    Swap_4Byt(d);
+		}
+	    }
+	    break;
+	case RAXPOL_MOM_U2:
+	    for (d = dat, d1 = dat + n; d < d1; d++, u++) {
+		Swap_2Byt(u);
+		*d = u2_to_f(*u, fld_p->scale, fld_p->offset);
+	    }
+	    break;
+    }
+    Swap_Off();
+    return 1;
+}
+
+/*
+   Return path of moment cache for RaXPol file at raxpol_fl_nm. Storage is
+   allocated with MALLOC. Caller should free it with FREE. Return NULL on
+   failure.
+ */
+
+char *RaXPol_Mom_Cache_Path(char *raxpol_fl_nm)
+{
+    char *path;
+    size_t sz;
+
+    sz = strlen(raxpol_fl_nm) + strlen(RAXPOL_MOM_CACHE_SFX) + 1;
+    if ( !(path = MALLOC(sz)) ) {
+	fprintf(stderr, "Could not allocate cache path for %s.\n",
+		raxpol_fl_nm);
+	return NULL;
+    }
+    strcpy(path, raxpol_fl_nm);
+    strcat(path, RAXPOL_MOM_CACHE_SFX);
+    return path;
+}
+
+/*
+   Return true if moment cache header at hdr_p was made from a RaXPol file
+   with status src_sb, by the current revision of the moment calculations,
+   with the threshold, calibration, and heading now in effect for dat_p,
+   and has all rays of the source.
+ */
+
+int RaXPol_Mom_Cache_Match(struct RaXPol_Mom_Hdr *hdr_p,
+	struct RaXPol_Data *dat_p, struct stat *src_sb)
+{
+    double hdg = RaXPol_Get_Hdg();
+
+    return hdr_p->src_sz == src_sb->st_size
+	&& hdr_p->src_mtime == src_sb->st_mtime
+	&& hdr_p->r0 == 0
+	&& hdr_p->alg_rev == RAXPOL_MOM_ALG_REV
+	&& hdr_p->num_gates == dat_p->file_hdr.num_rng_gates
+	&& hdr_p->servmode == dat_p->servmode
+	&& hdr_p->thres_val == dat_p->thres_val
+	&& hdr_p->cal_hh_val == dat_p->cal_hh_val
+	&& hdr_p->cal_vv_val == dat_p->cal_vv_val
+	&& ((isnan(hdr_p->hdg) && isnan(hdg)) || hdr_p->hdg == hdg);
+}
+
+/*
+   Open moment cache for RaXPol file at raxpol_fl_nm, and read its header
+   into hdr_p. dat_p must have been initialized from the RaXPol file with
+   RaXPol_Init_Data. Return a file descriptor for the cache if it exists and
+   matches the RaXPol file and current settings. Otherwise, return -1.
+   Absent or stale caches are not errors, so nothing is printed for them.
+ */
+
+int RaXPol_Mom_Open_Cache(char *raxpol_fl_nm, struct RaXPol_Data *dat_p,
+	struct RaXPol_Mom_Hdr *hdr_p)
+{
+    char *path;
+    struct stat sb;
+    int fd;
+
+    if ( stat(raxpol_fl_nm, &sb) == -1 || !S_ISREG(sb.st_mode) ) {
+	return -1;
+    }
+    if ( !(path = RaXPol_Mom_Cache_Path(raxpol_fl_nm)) ) {
+	return -1;
+    }
+    fd = open(path, O_RDONLY);
+    FREE(path);
+    if ( fd == -1 ) {
+	return -1;
+    }
+    if ( !RaXPol_Mom_Read_Hdr(hdr_p, fd)
+	    || !RaXPol_Mom_Cache_Match(hdr_p, dat_p, &sb) ) {
+	close(fd);
+	return -1;
+    }
+    return fd;
+}
+
+/* Return size of one value of type t */
+static size_t type_sz(enum RAXPOL_MOM_TYPE t)
+{
+    switch (t) {
+	case RAXPOL_MOM_F4:
+	    return 4;
+	case RAXPOL_MOM_U2:
+	    return 2;
+    }
+    return 0;
+}
+
+/* Pack f into a RAXPOL_MOM_U2 value with given scale and offset */
+static U2BYT f_to_u2(float f, double scale, double offset)
+{
+    double u;
+
+    if ( isnan(f) ) {
+	return RAXPOL_MOM_U2_NAN;
+    } else if ( isinf(f) ) {
+	return (f > 0.0) ? RAXPOL_MOM_U2_POS_INF : RAXPOL_MOM_U2_NEG_INF;
+    }
+    u = 1.0 + floor((f - offset) / scale + 0.5);
+    if ( u < 1.0 ) {
+	return 1;
+    } else if ( u > RAXPOL_MOM_U2_MAX ) {
+	return RAXPOL_MOM_U2_MAX;
+    }
+    return (U2BYT)u;
+}
+
+/* Unpack RAXPOL_MOM_U2 value u with given scale and offset */
+static float u2_to_f(U2BYT u, double scale, double offset)
+{
+    switch (u) {
+	case RAXPOL_MOM_U2_NAN:
+	    return NAN;
+	case RAXPOL_MOM_U2_POS_INF:
+	    return INFINITY;
+	case RAXPOL_MOM_U2_NEG_INF:
+	    return -INFINITY;
+    }
+    return (u - 1) * scale + offset;
+}
+
+/* Return o rounded up to next multiple of RAXPOL_MOM_ALIGN */
+static off_t align(off_t o)
+{
+    return (o + RAXPOL_MOM_ALIGN - 1) / RAXPOL_MOM_ALIGN * RAXPOL_MOM_ALIGN;
+}
+
+static U8BYT get_u8(char **buf_p)
+{
+    U8BYT u;
+
+    memcpy(&u, *buf_p, 8);
+    *buf_p += 8;
+    Swap_8Byt(&u);
+    return u;
+}
+
+static void put_u8(char **buf_p, U8BYT u)
+{
+    Swap_8Byt(&u);
+    memcpy(*buf_p, &u, 8);
+    *buf_p += 8;
+}
+
+/*
+   Read sz bytes at offset o in file descriptor fd into buf, retrying after
+   short reads. Return 1 if all bytes were read, otherwise 0.
+ */
+
+static int pread_all(int fd, void *buf, size_t sz, off_t o)
+{
+    char *b = buf;
+    ssize_t n;
+
+    while ( sz > 0 ) {
+	n = pread(fd, b, sz, o);
+	if ( n == -1 && errno == EINTR ) {
+	    continue;
+	}
+	if ( n <= 0 ) {
+	    return 0;
+	}
+	b += n;
+	sz -= n;
+	o += n;
+    }
+    return 1;
+}
+
+/*
+   Write sz bytes from buf at offset o in file descriptor fd, retrying after
+   short writes. Return 1 if all bytes were written, otherwise 0.
+ */
+
+static int pwrite_all(int fd, void *buf, size_t sz, off_t o)
+{
+    char *b = buf;
+    ssize_t n;
+
+    while ( sz > 0 ) {
+	n = pwrite(fd, b, sz, o);
+	if ( n == -1 && errno == EINTR ) {
+	    continue;
+	}
+	if ( n <= 0 ) {
+	    return 0;
+	}
+	b += n;
+	sz -= n;
+	o += n;
+    }
+    return 1;
+}
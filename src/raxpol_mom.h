@@ -0,0 +1,197 @@
+/*
+   -	raxpol_mom.h --
+   -		This header file declares structures and functions
+   -		that store and access RaXPol moment files, which hold
+   -		moments computed from a RaXPol data file.
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+/*
+   A moment file has the following layout. Integers and floats are stored
+   in the byte order of the host that wrote the file. Readers compare the
+   endian tag to 0x01020304 to determine whether they must swap bytes.
+   Offsets are from the start of the file.
+
+   .	File header, RAXPOL_MOM_HDR_SZ bytes
+   .	    0	char[8]	magic, RAXPOL_MOM_MAGIC, nul padded
+   .	    8	int32	endian tag, 0x01020304
+   .	   12	int32	format version, RAXPOL_MOM_VERSION
+   .	   16	int32	number of rays
+   .	   20	int32	number of gates
+   .	   24	int32	number of moments
+   .	   28	int32	server mode, enum RAXPOL_SERVMODE in raxpol.h
+   .	   32	int32	scan type from RaXPol file header
+   .	   36	int32	index in RaXPol file of first ray
+   .	   40	float64	range gate spacing, meters
+   .	   48	float64	threshold value, RAXPOL_THRES_VAL
+   .	   56	float64	horizontal calibration, RAXPOL_CAL_HH_VAL
+   .	   64	float64	vertical calibration, RAXPOL_CAL_VV_VAL
+   .	   72	uint64	offset to ray table
+   .	   80	uint64	size of RaXPol file, bytes, or 0 if unknown
+   .	   88	int64	modification time of RaXPol file, seconds since
+   .			1970-01-01 00:00:00 UTC, or 0 if unknown
+   .	   96	float64	heading set with RaXPol_Set_Hdg, or NaN if none
+   .	  104	int32	moment algorithm revision, RAXPOL_MOM_ALG_REV, or 0
+   .			if written before revisions were recorded
+   .	  108	...	zero
+   .
+   .	Moment table, RAXPOL_MOM_FLD_SZ bytes per moment, starting at
+   .	RAXPOL_MOM_HDR_SZ
+   .	    0	char[16] moment name, nul padded
+   .	   16	int32	value type, RAXPOL_MOM_F4 or RAXPOL_MOM_U2
+   .	   20	int32	zero
+   .	   24	float64	scale, for packed types
+   .	   32	float64	offset, for packed types
+   .	   40	uint64	offset to moment block
+   .	   48	uint64	size of moment block
+   .	   56	...	zero
+   .
+   .	Ray table, RAXPOL_MOM_RAY_SZ bytes per ray
+   .	    0	float64	time, seconds since 1970-01-01 00:00:00 UTC
+   .	    8	float64	azimuth, degrees clockwise from north
+   .	   16	float64	elevation, degrees
+   .	   24	float64	longitude, degrees, east positive
+   .	   32	float64	latitude, degrees, north positive
+   .	   40	float64	altitude, meters
+   .	   48	int32	sweep count
+   .	   52	int32	volume count
+   .	   56	int32	pedestal scan type
+   .	   60	int32	zero
+   .
+   .	Moment blocks, one per moment. Each block starts at a multiple of
+   .	RAXPOL_MOM_ALIGN, and has values for ray 0 gate 0, ray 0 gate 1, ...
+   .	ray 1 gate 0, ray 1 gate 1, ... and so on.
+
+   RAXPOL_MOM_U2 values are 2 byte unsigned integers u. Physical value is
+   (u - 1) * scale + offset for u in 1 .. RAXPOL_MOM_U2_MAX.
+   RAXPOL_MOM_U2_NEG_INF, RAXPOL_MOM_U2_POS_INF, and RAXPOL_MOM_U2_NAN stand
+   for -Inf, +Inf, and NaN. Finite values outside the range for the moment
+   are stored as the nearest end of the range.
+
+   A moment cache is a moment file with RAXPOL_MOM_U2 values for all moments
+   and all rays of a RaXPol file. It is stored next to the RaXPol file, with
+   RAXPOL_MOM_CACHE_SFX appended to the name.
+ */
+
+#ifndef RAXPOL_MOM_H_
+#define RAXPOL_MOM_H_
+
+#include "unix_defs.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "raxpol.h"
+
+#define RAXPOL_MOM_MAGIC "RXPLMOM"
+#define RAXPOL_MOM_VERSION 1
+#define RAXPOL_MOM_HDR_SZ 512
+#define RAXPOL_MOM_FLD_SZ 64
+#define RAXPOL_MOM_RAY_SZ 64
+#define RAXPOL_MOM_ALIGN 4096
+#define RAXPOL_MOM_NM_SZ 16
+#define RAXPOL_MOM_MAX 11
+
+/*
+   Revision of the moment calculations. Increment this whenever a change
+   to the moment functions in raxpol_lib.c changes their output, so that
+   moment caches computed by older code are recomputed.
+ */
+
+#define RAXPOL_MOM_ALG_REV 1
+
+/* Value types for moment blocks */
+enum RAXPOL_MOM_TYPE {
+    RAXPOL_MOM_F4,			/* 4 byte float */
+    RAXPOL_MOM_U2			/* 2 byte scaled unsigned integer */
+};
+
+#define RAXPOL_MOM_U2_NEG_INF 0x0000
+#define RAXPOL_MOM_U2_MAX 0xFFFD
+#define RAXPOL_MOM_U2_POS_INF 0xFFFE
+#define RAXPOL_MOM_U2_NAN 0xFFFF
+
+#define RAXPOL_MOM_CACHE_SFX ".mom"
+
+struct RaXPol_Mom_Fld {
+    char nm[RAXPOL_MOM_NM_SZ];		/* Moment name, e.g. "DBZ" */
+    enum RAXPOL_MOM_TYPE type;		/* Value type */
+    double scale, offset;		/* Physical value = stored value
+					   * scale + offset, for packed types */
+    off_t off;				/* Offset to moment block */
+    off_t sz;				/* Size of moment block */
+};
+
+struct RaXPol_Mom_Hdr {
+    int num_rays;			/* Number of rays */
+    int num_gates;			/* Number of gates per ray */
+    int num_moms;			/* Number of moments */
+    enum RAXPOL_SERVMODE servmode;	/* Server mode */
+    int scan_type;			/* Scan type from RaXPol file header */
+    int r0;				/* Index in RaXPol file of first ray */
+    double gate_spacing;		/* Range gate spacing, meters */
+    double thres_val;			/* Theshold value */
+    double cal_hh_val, cal_vv_val;	/* Calibration values */
+    off_t ray_tbl_off;			/* Offset to ray table */
+    off_t src_sz;			/* Size of RaXPol file */
+    time_t src_mtime;			/* Modification time of RaXPol file */
+    double hdg;				/* Heading override, or NAN */
+    int alg_rev;			/* Moment algorithm revision */
+    struct RaXPol_Mom_Fld flds[RAXPOL_MOM_MAX];
+    int swap;				/* If true, file byte order differs
+					   from host */
+};
+
+struct RaXPol_Mom_Ray {
+    double tm;				/* Seconds since 1970-01-01 00:00:00 */
+    double az, el;			/* Azimuth, elevation, degrees */
+    double lon, lat;			/* Longitude, latitude, degrees */
+    double alt;				/* Altitude, meters */
+    int sweep_count;			/* Sweep count */
+    int volume_count;			/* Volume count */
+    int scan_type;			/* Pedestal scan type */
+};
+
+int RaXPol_Mom_Init_Hdr(struct RaXPol_Mom_Hdr *, struct RaXPol_Data *, int,
+	int, char **, int, enum RAXPOL_MOM_TYPE);
+int RaXPol_Mom_Write_Hdr(struct RaXPol_Mom_Hdr *, int);
+void RaXPol_Mom_Set_Ray(struct RaXPol_Mom_Ray *, struct RaXPol_Ray_Hdr *);
+int RaXPol_Mom_Write_Ray(struct RaXPol_Mom_Hdr *, int, int,
+	struct RaXPol_Mom_Ray *, float **);
+int RaXPol_Mom_Read_Hdr(struct RaXPol_Mom_Hdr *, int);
+int RaXPol_Mom_Fld_Idx(struct RaXPol_Mom_Hdr *, char *);
+int RaXPol_Mom_Read_Rays(struct RaXPol_Mom_Hdr *, int, int, int,
+	struct RaXPol_Mom_Ray *);
+int RaXPol_Mom_Read_Fld(struct RaXPol_Mom_Hdr *, int, int, int, int, float *);
+char *RaXPol_Mom_Cache_Path(char *);
+int RaXPol_Mom_Cache_Match(struct RaXPol_Mom_Hdr *, struct RaXPol_Data *,
+	struct stat *);
+int RaXPol_Mom_Open_Cache(char *, struct RaXPol_Data *,
+	struct RaXPol_Mom_Hdr *);
+
+#endif
@@ -0,0 +1,277 @@
+/*
+   -	raxpol_prof.c --
+   -		This file defines functions that time processing stages
+   -		and count work when the RAXPOL_PROFILE environment
+   -		variable is set. See raxpol_prof.h.
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include "alloc.h"
+#include "raxpol_prof.h"
+
+/* Output buffer size for a JSON profile. Larger than any profile, so that
+   the profile goes to the file in one write, even when other processes are
+   appending to the same file. */
+#define JSON_BUF_SZ 65536
+
+struct stage {
+    char nm[RAXPOL_PROF_NM_SZ];		/* Stage name */
+    unsigned long calls;		/* Number of calls */
+    double sec;				/* Seconds spent */
+    double count;			/* Work done, e.g. bytes read */
+};
+
+static int init;			/* If true, prof_init has run */
+static int on;				/* If true, profiling is on */
+static char *out_nm;			/* JSON file path, or NULL for table
+					   on standard error */
+static char prog[RAXPOL_PROF_NM_SZ] = "raxpol";
+static double t_start;			/* Time of first call */
+static struct stage stages[RAXPOL_PROF_MAX];
+static int num_stages;
+
+static void prof_init(void);
+static double now(void);
+static struct stage *get_stage(const char *);
+static void report(void);
+static void fprint_json_str(FILE *, char *);
+
+/* Read RAXPOL_PROFILE, when process makes its first profiling call */
+static void prof_init(void)
+{
+    char *s;
+
+    if ( init ) {
+	return;
+    }
+    init = 1;
+    s = getenv(RAXPOL_PROF_ENV);
+    if ( !s || strlen(s) == 0 || strcmp(s, "0") == 0 ) {
+	return;
+    }
+    if ( strcmp(s, "1") != 0 && strcmp(s, "stderr") != 0 ) {
+	out_nm = s;
+    }
+    on = 1;
+    t_start = now();
+    atexit(report);
+}
+
+/* Return monotonic clock time, seconds */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+/*
+   Give the program name to print with the profile, and start the profile
+   clock. Programs should call this at the start of main. Otherwise, the
+   profile is labeled "raxpol" and starts at the first profiled call.
+ */
+
+void RaXPol_Prof_Init(char *argv0)
+{
+    char *s;
+
+    prof_init();
+    if ( argv0 ) {
+	s = strrchr(argv0, '/');
+	s = s ? s + 1 : argv0;
+	strncpy(prog, s, RAXPOL_PROF_NM_SZ - 1);
+    }
+}
+
+/* Return true if profiling is on. */
+int RaXPol_Prof_On(void)
+{
+    prof_init();
+    return on;
+}
+
+/*
+   Return the current time, seconds, for a later call to RaXPol_Prof_Stop,
+   or 0.0 if profiling is off.
+ */
+
+double RaXPol_Prof_Start(void)
+{
+    prof_init();
+    return on ? now() : 0.0;
+}
+
+/*
+   Add one call, the time since t0 from RaXPol_Prof_Start, and count to
+   stage nm.
+ */
+
+void RaXPol_Prof_Stop(const char *nm, double t0, double count)
+{
+    struct stage *stage_p;
+
+    if ( !on || !(stage_p = get_stage(nm)) ) {
+	return;
+    }
+    stage_p->calls++;
+    stage_p->sec += now() - t0;
+    stage_p->count += count;
+}
+
+/*
+   Same as RaXPol_Prof_Stop for moment mom_nm, e.g. "DBZ", with count gates.
+   The stage name is "mom_" followed by mom_nm.
+ */
+
+void RaXPol_Prof_Mom(const char *mom_nm, double t0, double num_gates)
+{
+    char nm[RAXPOL_PROF_NM_SZ];
+
+    if ( !on ) {
+	return;
+    }
+    snprintf(nm, RAXPOL_PROF_NM_SZ, "mom_%s", mom_nm);
+    RaXPol_Prof_Stop(nm, t0, num_gates);
+}
+
+/* Add one call and count to stage nm, without time. */
+void RaXPol_Prof_Count(const char *nm, double count)
+{
+    struct stage *stage_p;
+
+    prof_init();
+    if ( !on || !(stage_p = get_stage(nm)) ) {
+	return;
+    }
+    stage_p->calls++;
+    stage_p->count += count;
+}
+
+/*
+   Return the stage named nm, adding it to the table if necessary, or NULL if
+   the table is full. Stages are few, so a linear search is fine. The last
+   stage found is checked first, since calls tend to repeat.
+ */
+
+static struct stage *get_stage(const char *nm)
+{
+    static int last;
+    int n;
+
+    if ( last < num_stages && strcmp(stages[last].nm, nm) == 0 ) {
+	return stages + last;
+    }
+    for (n = 0; n < num_stages; n++) {
+	if ( strcmp(stages[n].nm, nm) == 0 ) {
+	    last = n;
+	    return stages + n;
+	}
+    }
+    if ( num_stages == RAXPOL_PROF_MAX ) {
+	return NULL;
+    }
+    strncpy(stages[num_stages].nm, nm, RAXPOL_PROF_NM_SZ - 1);
+    last = num_stages;
+    return stages + num_stages++;
+}
+
+/* Print the profile, when process exits */
+static void report(void)
+{
+    double elapsed = now() - t_start;
+    unsigned long n_alloc, n_realloc, n_free;
+    FILE *out;
+    int fd;
+    int n;
+
+    Tkx_Alloc_Counts(&n_alloc, &n_realloc, &n_free);
+    if ( !out_nm ) {
+	fprintf(stderr, "%s: profile, pid %ld, %.6f seconds elapsed\n",
+		prog, (long)getpid(), elapsed);
+	fprintf(stderr, "    %-24s %12s %12s %16s\n",
+		"stage", "calls", "seconds", "count");
+	for (n = 0; n < num_stages; n++) {
+	    fprintf(stderr, "    %-24s %12lu %12.6f %16.0f\n", stages[n].nm,
+		    stages[n].calls, stages[n].sec, stages[n].count);
+	}
+	fprintf(stderr, "    allocations %lu, reallocations %lu, frees %lu\n",
+		n_alloc, n_realloc, n_free);
+	return;
+    }
+    fd = open(out_nm, O_WRONLY | O_APPEND | O_CREAT, 0666);
+    if ( fd == -1 || !(out = fdopen(fd, "a")) ) {
+	fprintf(stderr, "%s: could not open profile file %s.\n%s\n",
+		prog, out_nm, strerror(errno));
+	if ( fd != -1 ) {
+	    close(fd);
+	}
+	return;
+    }
+    setvbuf(out, NULL, _IOFBF, JSON_BUF_SZ);
+    fprintf(out, "{\"prog\":");
+    fprint_json_str(out, prog);
+    fprintf(out, ",\"pid\":%ld,\"elapsed\":%.6f,\"stages\":{",
+	    (long)getpid(), elapsed);
+    for (n = 0; n < num_stages; n++) {
+	fprintf(out, "%s", n > 0 ? "," : "");
+	fprint_json_str(out, stages[n].nm);
+	fprintf(out, ":{\"calls\":%lu,\"seconds\":%.6f,\"count\":%.0f}",
+		stages[n].calls, stages[n].sec, stages[n].count);
+    }
+    fprintf(out, "},\"alloc\":{\"alloc\":%lu,\"realloc\":%lu,\"free\":%lu}}\n",
+	    n_alloc, n_realloc, n_free);
+    if ( fclose(out) == EOF ) {
+	fprintf(stderr, "%s: could not write profile file %s.\n%s\n",
+		prog, out_nm, strerror(errno));
+    }
+}
+
+/* Print s to out as a JSON string */
+static void fprint_json_str(FILE *out, char *s)
+{
+    putc('"', out);
+    for ( ; *s; s++) {
+	if ( *s == '"' || *s == '\\' ) {
+	    fprintf(out, "\\%c", *s);
+	} else if ( (unsigned char)*s < 0x20 ) {
+	    fprintf(out, "\\u%04x", (unsigned char)*s);
+	} else {
+	    putc(*s, out);
+	}
+    }
+    putc('"', out);
+}
@@ -0,0 +1,65 @@
+/*
+   -	raxpol_prof.h --
+   -		This header file declares functions that time
+   -		processing stages and count work when the
+   -		RAXPOL_PROFILE environment variable is set.
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+/*
+   A profile is a table of stages. Each stage has a name, a number of calls,
+   seconds spent, and a count of work done, e.g. bytes read or gates
+   computed. Counters are stages that record no time.
+
+   If RAXPOL_PROFILE is unset, empty, or "0", profiling is off, and the
+   functions below return without doing anything, except that
+   RaXPol_Prof_Start returns 0.0. If RAXPOL_PROFILE is "1" or "stderr", the
+   process prints a table to standard error when it exits. Otherwise,
+   RAXPOL_PROFILE is the path to a file, and the process appends the profile
+   to it as one line of JSON. Processes in a pipeline can share the file.
+
+   Times are from the monotonic clock. Profiling starts at the first call to
+   any of these functions.
+ */
+
+#ifndef RAXPOL_PROF_H_
+#define RAXPOL_PROF_H_
+
+#define RAXPOL_PROF_ENV "RAXPOL_PROFILE"
+#define RAXPOL_PROF_MAX 64
+#define RAXPOL_PROF_NM_SZ 32
+
+void RaXPol_Prof_Init(char *);
+int RaXPol_Prof_On(void);
+double RaXPol_Prof_Start(void);
+void RaXPol_Prof_Stop(const char *, double, double);
+void RaXPol_Prof_Mom(const char *, double, double);
+void RaXPol_Prof_Count(const char *, double);
+
+#endif
@@ -56,10 +56,19 @@
 #include <stdio.h>
 #include <limits.h>
 #include <errno.h>
+#include "alloc.h"
 #include "raxpol.h"
+#include "raxpol_idx.h"
+#include "raxpol_prof.h"
+#include "raxpol_seq.h"
 
 #define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
 
+/* Number of ray headers to read at a time */
+#define NUM_HDRS 1024
+
+static void print_hdr(long, struct RaXPol_Ray_Hdr *, int);
+
 int main(int argc, char *argv[])
 {
     char *argv0;			/* Name of the executable, for error
@@ -67,26 +76,34 @@ int main(int argc, char *argv[])
     int c;				/* Index into argv */
     extern char *optarg;		/* See getopt (3) */
     double dflt_hdg;			/* Default heading */
-    char *raxpol_fl_nm;			/* RaXPol file path */
-    FILE *raxpol_fl;			/* RaXPol file */
+    char *stdin_nm = "-";		/* File name for standard input */
+    char **raxpol_fl_nms;		/* RaXPol file paths */
+    int num_fls;			/* Number of RaXPol files */
+    struct RaXPol_Seq seq;		/* Rays from all RaXPol files */
     long r0, num_rays;			/* First ray, number of rays to read */
     long num_rays_max;			/* Number of rays from r0 to EOF */
-    off_t o0;				/* Offset to start of first ray */
-    off_t o;				/* Offset somewhere in raxpol_fl */
-    off_t ray_sz;			/* Size in file of one ray */
+    char *tm_rng = NULL;		/* Time range from command line */
+    double tm0, tm1;			/* Start, end of time range */
+    int idx_sel = 0;			/* If true, rays selected by index */
     int abbrv;				/* If true, abbreviate */
-    struct RaXPol_File_Hdr file_hdr;	/* Header from the RaXPol file */
+    int follow = 0;			/* If true, wait for new rays */
+    long step = 1;			/* Print every step'th ray */
     struct RaXPol_Ray_Hdr ray_hdr;
+    struct RaXPol_Ray_Hdr *ray_hdrs;	/* Headers from one scan */
+    int f;				/* Index into raxpol_fl_nms */
     long r;
+    long k, n;				/* Index, number of headers in scan */
 
     argv0 = argv[0];
+    RaXPol_Prof_Init(argv0);
     abbrv = 0;
     r0 = 0;
     num_rays = LONG_MAX;
     if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
 	RaXPol_Old_Fmt();
     }
-    while ((c = getopt(argc, argv, ":Valh:s:c:")) != -1) {
+    RaXPol_Seq_Init(&seq);
+    while ((c = getopt(argc, argv, ":Vaflh:s:c:t:n:")) != -1) {
 	switch(c) {
 	    case 'V':
 		printf("%s\n", RAXPOL_MOMENT_VERSION);
@@ -95,6 +112,9 @@ int main(int argc, char *argv[])
 	    case 'a':
 		abbrv = 1;
 		break;
+	    case 'f':
+		follow = 1;
+		break;
 	    case 'l':
 		RaXPol_Old_Fmt();
 		break;
@@ -107,117 +127,151 @@ int main(int argc, char *argv[])
 		RaXPol_Set_Hdg(dflt_hdg);
 		break;
 	    case 's':
+		idx_sel = 1;
 		if ( sscanf(optarg, "%ld", &r0) != 1 ) {
 		    fprintf(stderr, "%s: expected integer for index of first "
 			    "ray, got %s\n", argv0, optarg);
 		    exit(EXIT_FAILURE);
 		}
+		break;
 	    case 'c':
+		idx_sel = 1;
 		if ( sscanf(optarg, "%ld", &num_rays) != 1 ) {
 		    fprintf(stderr, "%s: expected integer for desired ray "
 			    "count, got %s\n", argv0, optarg);
 		    exit(EXIT_FAILURE);
 		}
 		break;
+	    case 'n':
+		if ( sscanf(optarg, "%ld", &step) != 1 || step < 1 ) {
+		    fprintf(stderr, "%s: expected positive integer for ray "
+			    "step, got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 't':
+		tm_rng = optarg;
+		if ( !RaXPol_Scan_Tm_Rng(tm_rng, &tm0, &tm1) ) {
+		    fprintf(stderr, "%s: could not read time range.\n",
+			    argv0);
+		    exit(EXIT_FAILURE);
+		}
+		break;
 	    case '?':
-		fprintf(stderr, "Usage: %s [-a] [-s YYYYMMDD-HHMMSS] "
-			"[-e YYYYMMDD-HHMMSS] [raxpol_file]\n", argv0);
+		fprintf(stderr, "Usage: %s [-a] [-f] [-l] [-h angle] [-s start] "
+			"[-c count] [-t start,end] [-n step] [raxpol_file ...]\n", argv0);
 		exit(EXIT_FAILURE);
 		break;
 	}
     }
+    if ( tm_rng && idx_sel ) {
+	fprintf(stderr, "%s: -t cannot be used with -s or -c.\n", argv0);
+	exit(EXIT_FAILURE);
+    }
     if ( optind == argc ) {
-	raxpol_fl_nm = "-";
+	raxpol_fl_nms = &stdin_nm;
+	num_fls = 1;
     } else {
-	raxpol_fl_nm = argv[optind];
+	raxpol_fl_nms = argv + optind;
+	num_fls = argc - optind;
     }
-    if ( strcmp(raxpol_fl_nm, "-") == 0 ) {
-	raxpol_fl = stdin;
-    } else if ( !(raxpol_fl = fopen(raxpol_fl_nm, "r")) ) {
-	fprintf(stderr, "%s: could not open %s for reading.\n",
-		argv0, raxpol_fl_nm);
+    if ( follow && tm_rng ) {
+	fprintf(stderr, "%s: -f cannot be used with -t.\n", argv0);
 	exit(EXIT_FAILURE);
     }
-    RaXPol_Init_File_Hdr(&file_hdr);
-    if ( !RaXPol_Read_File_Hdr(&file_hdr, raxpol_fl) ) {
-	fprintf(stderr, "%s: failed to read file header.\n", argv0);
-	exit(EXIT_FAILURE);
+    if ( follow ) {
+	RaXPol_Seq_Follow(&seq);
     }
-    if ( (o0 = ftello(raxpol_fl)) == -1 ) {
-	fprintf(stderr, "%s: could not determine position in file.\n%s\n",
-		argv0, strerror(errno));
+    if ( !RaXPol_Seq_Open(&seq, raxpol_fl_nms, num_fls, NULL) ) {
+	fprintf(stderr, "%s: failed to read file headers.\n", argv0);
 	exit(EXIT_FAILURE);
     }
+    if ( tm_rng ) {
+	long r1;			/* End of time range */
 
-    /* Determine ray size and num_rays_max */
-    RaXPol_Init_Ray_Hdr(&ray_hdr);
-    if ( !RaXPol_Read_Ray_Hdr(&ray_hdr, raxpol_fl) ) {
-	fprintf(stderr, "%s: failed to read header for first ray.\n",
-		argv0);
-	exit(EXIT_FAILURE);
-    }
-    if ( (o = ftello(raxpol_fl)) == -1 ) {
-	fprintf(stderr, "%s: could not determine position in file.\n%s\n",
-		argv0, strerror(errno));
-	exit(EXIT_FAILURE);
-    }
-    ray_sz = o - o0 + ray_hdr.data_size;
-    if ( fseeko(raxpol_fl, 0, SEEK_END) == -1
-	    || (o = ftello(raxpol_fl)) == -1 ) {
-	fprintf(stderr, "%s: could not position at end of file.\n"
-		"%s\n", argv0, strerror(errno));
-	exit(EXIT_FAILURE);
+	if ( (r0 = RaXPol_Seq_Tm_Ray(&seq, tm0, 0)) == -1
+		|| (r1 = RaXPol_Seq_Tm_Ray(&seq, tm1, 1)) == -1 ) {
+	    fprintf(stderr, "%s: could not find rays for time range %s\n",
+		    argv0, tm_rng);
+	    exit(EXIT_FAILURE);
+	}
+	num_rays = r1 - r0;
     }
-    num_rays_max = (o - o0) / ray_sz - r0;
-    if ( num_rays > num_rays_max ) {
+    num_rays_max = seq.num_rays - r0;
+    if ( !follow && num_rays > num_rays_max ) {
 	num_rays = num_rays_max;
     }
 
     /* Move to first ray */
-    if ( r0 > 0 ) {
-	if ( fseeko(raxpol_fl, o0 + r0 * ray_sz, SEEK_SET) == -1 ) {
-	    fprintf(stderr, "%s: could not position at start of first ray.\n"
-		    "%s\n", argv0, strerror(errno));
-	    exit(EXIT_FAILURE);
-	}
-    } else {
-	if ( fseeko(raxpol_fl, o0, SEEK_SET) == -1) {
-	    fprintf(stderr, "%s: could not position at end of file.\n"
-		    "%s\n", argv0, strerror(errno));
-	    exit(EXIT_FAILURE);
-	}
+    if ( !RaXPol_Seq_Seek(&seq, r0) ) {
+	fprintf(stderr, "%s: could not position at start of first ray.\n",
+		argv0);
+	exit(EXIT_FAILURE);
     }
 
     /* Print ray headers */
     if ( !abbrv ) {
-	printf("Reading %s\n",
-		(raxpol_fl == stdin) ? "standard input" : raxpol_fl_nm);
+	for (f = 0; f < num_fls; f++) {
+	    printf("Reading %s\n", (seq.in == stdin)
+		    ? "standard input" : raxpol_fl_nms[f]);
+	}
 	printf("File header:\n");
-	RaXPol_FPrintf_File_Hdr(&file_hdr, stdout);
+	RaXPol_FPrintf_File_Hdr(&seq.file_hdr, stdout);
     }
-    for (r = r0;
-	    r < r0 + num_rays && RaXPol_Read_Ray_Hdr(&ray_hdr, raxpol_fl);
-	    r++) {
-	if ( abbrv ) {
-	    printf("ray %-9ld ", r);
-	    RaXPol_FPrint_Abbrv_Ray_Hdr(&ray_hdr, stdout);
-	} else {
-	    printf("******************* ray *******************\n");
-	    printf("ray %ld\n", r);
-	    RaXPol_FPrint_Ray_Hdr(&ray_hdr, stdout);
+    if ( follow ) {
+
+	/* Wait for each ray, including the ones skipped */
+	for (r = r0; r < r0 + num_rays; r++) {
+	    if ( !RaXPol_Seq_Read_Ray_Hdr(&seq, &ray_hdr) ) {
+		fprintf(stderr, "%s: failed to read ray header for ray %ld\n",
+			argv0, r);
+		exit(EXIT_FAILURE);
+	    }
+	    if ( (r - r0) % step == 0 ) {
+		print_hdr(r, &ray_hdr, abbrv);
+		fflush(stdout);
+	    }
 	}
-	if ( fseeko(raxpol_fl, ray_hdr.data_size, SEEK_CUR) == -1 ) {
-	    fprintf(stderr, "%s: could not skip ray data\n%s\n",
-		    argv0, strerror(errno));
+    } else {
+
+	/* Read headers only, NUM_HDRS at a time */
+	if ( !(ray_hdrs = CALLOC(NUM_HDRS, sizeof(struct RaXPol_Ray_Hdr))) ) {
+	    fprintf(stderr, "%s: could not allocate ray headers.\n", argv0);
 	    exit(EXIT_FAILURE);
 	}
+	for (r = r0; r < r0 + num_rays; r += n * step) {
+	    n = (r0 + num_rays - r - 1) / step + 1;
+	    n = (n < NUM_HDRS) ? n : NUM_HDRS;
+	    if ( RaXPol_Seq_Scan_Hdrs(&seq, step, ray_hdrs, n) != n ) {
+		fprintf(stderr, "%s: failed to read ray headers for rays %ld "
+			"and after\n", argv0, r);
+		exit(EXIT_FAILURE);
+	    }
+	    for (k = 0; k < n; k++) {
+		print_hdr(r + k * step, ray_hdrs + k, abbrv);
+	    }
+	}
+	FREE(ray_hdrs);
     }
-    if ( feof(raxpol_fl) || ferror(raxpol_fl) ) {
-	fprintf(stderr, "%s: failed to read ray header for ray %ld of %s\n",
-		argv0, r, raxpol_fl_nm);
-	exit(EXIT_FAILURE);
-    }
+    RaXPol_Seq_Free(&seq);
 
     return EXIT_SUCCESS;
 }
 
+/* Print header ray_hdr_p for ray r, abbreviated if abbrv is true */
+static void print_hdr(long r, struct RaXPol_Ray_Hdr *ray_hdr_p, int abbrv)
+{
+    double t0;				/* Profile start time */
+
+    t0 = RaXPol_Prof_Start();
+    if ( abbrv ) {
+	printf("ray %-9ld ", r);
+	RaXPol_FPrint_Abbrv_Ray_Hdr(ray_hdr_p, stdout);
+    } else {
+	printf("******************* ray *******************\n");
+	printf("ray %ld\n", r);
+	RaXPol_FPrint_Ray_Hdr(ray_hdr_p, stdout);
+    }
+    RaXPol_Prof_Stop("output", t0, 1);
+}
+
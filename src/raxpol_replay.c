@@ -0,0 +1,256 @@
+/*
+   -	raxpol_replay.c --
+   -		Copy RaXPol files to a directory at the rate the rays
+   -		were recorded, to simulate a signal processor that is
+   -		writing them. See raxpol_replay (1).
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include "alloc.h"
+#include "raxpol.h"
+#include "raxpol_prof.h"
+
+#define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
+
+static char *argv0;			/* Name of the executable */
+static struct timespec start;		/* When replay started */
+static double tm_start;			/* Time of first ray in first file */
+static double speed = 1.0;		/* Replay speed, 1.0 for real time */
+
+/* Local functions */
+static int replay(char *, char *);
+static int write_all(char *, size_t, FILE *, char *);
+static void wait_tm(double);
+
+int main(int argc, char *argv[])
+{
+    extern char *optarg;		/* See getopt (3) */
+    extern int optind;			/* See getopt (3) */
+    int c;				/* Index into argv */
+    char *dir;				/* Output directory */
+    int status = EXIT_SUCCESS;
+    char *usage = "Usage: %s [-l] [-x speed] raxpol_file ... dir\n";
+
+    argv0 = argv[0];
+    RaXPol_Prof_Init(argv0);
+    if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
+	RaXPol_Old_Fmt();
+    }
+    while ((c = getopt(argc, argv, ":Vlx:")) != -1) {
+	switch(c) {
+	    case 'V':
+		printf("%s\n", RAXPOL_MOMENT_VERSION);
+		exit(EXIT_SUCCESS);
+		break;
+	    case 'l':
+		RaXPol_Old_Fmt();
+		break;
+	    case 'x':
+		if ( sscanf(optarg, "%lf", &speed) != 1 || !(speed > 0.0) ) {
+		    fprintf(stderr, "%s: expected positive float for speed, "
+			    "got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case '?':
+	    case ':':
+		fprintf(stderr, usage, argv0);
+		exit(EXIT_FAILURE);
+		break;
+	}
+    }
+    if ( argc - optind < 2 ) {
+	fprintf(stderr, usage, argv0);
+	exit(EXIT_FAILURE);
+    }
+    dir = argv[argc - 1];
+    tm_start = NAN;
+    if ( clock_gettime(CLOCK_MONOTONIC, &start) == -1 ) {
+	fprintf(stderr, "%s: could not read clock.\n%s\n",
+		argv0, strerror(errno));
+	exit(EXIT_FAILURE);
+    }
+    for ( ; optind < argc - 1; optind++) {
+	if ( !replay(argv[optind], dir) ) {
+	    fprintf(stderr, "%s: could not replay %s.\n", argv0, argv[optind]);
+	    status = EXIT_FAILURE;
+	    break;
+	}
+    }
+    return status;
+}
+
+/*
+   Copy RaXPol file fl_nm to directory dir, writing each ray when its time,
+   relative to the first ray of the first file and divided by speed, has
+   passed since the replay started. Each ray is written in two pieces, with
+   a flush between, so that readers see partial rays. The output file must
+   not already exist.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int replay(char *fl_nm, char *dir)
+{
+    FILE *in = NULL, *out = NULL;	/* Input and output files */
+    int fd;				/* Output file descriptor */
+    char *base;				/* Name of fl_nm in its directory */
+    char *out_nm = NULL;		/* Output path */
+    struct RaXPol_File_Hdr file_hdr;	/* Input file header */
+    struct RaXPol_Ray_Hdr ray_hdr;	/* Header of current ray */
+    off_t o0, o;			/* Offsets in in */
+    size_t ray_sz;			/* Size of a ray */
+    char *buf = NULL;			/* Input buffer */
+    long r;				/* Ray index */
+    int status = 0;
+
+    base = (base = strrchr(fl_nm, '/')) ? base + 1 : fl_nm;
+    if ( !(out_nm = MALLOC(strlen(dir) + strlen(base) + 2)) ) {
+	fprintf(stderr, "%s: could not allocate output path.\n", argv0);
+	goto end;
+    }
+    sprintf(out_nm, "%s/%s", dir, base);
+    if ( !(in = fopen(fl_nm, "r")) ) {
+	fprintf(stderr, "%s: could not open %s.\n%s\n",
+		argv0, fl_nm, strerror(errno));
+	goto end;
+    }
+    RaXPol_Init_File_Hdr(&file_hdr);
+    RaXPol_Init_Ray_Hdr(&ray_hdr);
+    if ( !RaXPol_Read_File_Hdr(&file_hdr, in)
+	    || (o0 = ftello(in)) == -1
+	    || !RaXPol_Read_Ray_Hdr(&ray_hdr, in, file_hdr.old_fmt)
+	    || (o = ftello(in)) == -1 ) {
+	fprintf(stderr, "%s: could not read headers from %s.\n",
+		argv0, fl_nm);
+	goto end;
+    }
+    ray_sz = o - o0 + ray_hdr.data_size;
+    if ( !(buf = MALLOC(o0 > ray_sz ? o0 : ray_sz)) ) {
+	fprintf(stderr, "%s: could not allocate buffer for %s.\n",
+		argv0, fl_nm);
+	goto end;
+    }
+    if ( (fd = open(out_nm, O_WRONLY | O_CREAT | O_EXCL, 0666)) == -1
+	    || !(out = fdopen(fd, "w")) ) {
+	fprintf(stderr, "%s: could not create %s.\n%s\n",
+		argv0, out_nm, strerror(errno));
+	goto end;
+    }
+
+    /* Copy file header */
+    if ( fseeko(in, 0, SEEK_SET) == -1 || fread(buf, o0, 1, in) != 1
+	    || !write_all(buf, o0, out, out_nm) ) {
+	goto end;
+    }
+
+    /* Copy rays. Read header to get time, then read whole ray. */
+    for (r = 0; ; r++) {
+	if ( (o = ftello(in)) == -1
+		|| !RaXPol_Read_Ray_Hdr(&ray_hdr, in, file_hdr.old_fmt)
+		|| fseeko(in, o, SEEK_SET) == -1
+		|| fread(buf, ray_sz, 1, in) != 1 ) {
+	    if ( ferror(in) ) {
+		fprintf(stderr, "%s: could not read ray %ld from %s.\n",
+			argv0, r, fl_nm);
+		goto end;
+	    }
+	    break;
+	}
+	if ( isnan(tm_start) ) {
+	    tm_start = RaXPol_Ray_Tm(&ray_hdr);
+	}
+	wait_tm(RaXPol_Ray_Tm(&ray_hdr) - tm_start);
+	if ( !write_all(buf, ray_sz / 2, out, out_nm)
+		|| !write_all(buf + ray_sz / 2, ray_sz - ray_sz / 2,
+		    out, out_nm) ) {
+	    goto end;
+	}
+    }
+    status = 1;
+
+end:
+    if ( out && fclose(out) == EOF ) {
+	fprintf(stderr, "%s: could not close %s.\n%s\n",
+		argv0, out_nm, strerror(errno));
+	status = 0;
+    }
+    if ( in ) {
+	fclose(in);
+    }
+    FREE(buf);
+    FREE(out_nm);
+    return status;
+}
+
+/*
+   Write sz bytes from buf to out, which is named out_nm, and flush.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int write_all(char *buf, size_t sz, FILE *out, char *out_nm)
+{
+    if ( fwrite(buf, 1, sz, out) != sz || fflush(out) == EOF ) {
+	fprintf(stderr, "%s: could not write to %s.\n%s\n",
+		argv0, out_nm, strerror(errno));
+	return 0;
+    }
+    return 1;
+}
+
+/* Wait until dt / speed seconds have passed since the start of replay */
+static void wait_tm(double dt)
+{
+    struct timespec now, ts;
+    double t;				/* Seconds to wait */
+
+    if ( clock_gettime(CLOCK_MONOTONIC, &now) == -1 ) {
+	return;
+    }
+    t = dt / speed - (now.tv_sec - start.tv_sec)
+	- (now.tv_nsec - start.tv_nsec) * 1.0e-9;
+    if ( t > 0.0 ) {
+	ts.tv_sec = (time_t)t;
+	ts.tv_nsec = (long)((t - ts.tv_sec) * 1.0e9);
+	while ( nanosleep(&ts, &ts) == -1 && errno == EINTR ) {
+	    continue;
+	}
+    }
+}
@@ -1,13 +1,17 @@
 /*
    -	raxpol_seek_ray.c --
    -		This program defines an application prints the index
-   -		of the ray just before given time from a raxpol file.
+   -		of the ray at or just before a given time in raxpol files.
    .
    .	Usage:
-   .		raxpol_ray_hdrs [-l] YYYYMMDD-HHMMSS [raxpol_file]
+   .		raxpol_seek_ray [-l] YYYYMMDD-HHMMSS [raxpol_file]
+   .		raxpol_seek_ray [-l] -b raxpol_file ...
    .
    .	Options:
    .		-l input file is "old" (2011) format.
+   .		-b batch mode. Read times from standard input, one per
+   .		   line, and print the time, file, and ray index for each
+   .		   in input order.
    .
    .	Non-zero RAXPOL_OLD_FMT environment variable is same as -l.
    .
@@ -46,207 +50,383 @@
 #include <string.h>
 #include <stdio.h>
 #include <limits.h>
-#include <math.h>
 #include <unistd.h>
 #include <errno.h>
+#include "alloc.h"
 #include "raxpol.h"
-#include "tm_calc_lib.h"
+#include "raxpol_idx.h"
+#include "raxpol_z.h"
+#include "raxpol_prof.h"
 
 #define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
 
-static double ray_time_jul(struct RaXPol_Ray_Hdr *ray_hdr_p);
-static off_t off_tm(off_t, off_t, double, FILE *, struct RaXPol_Ray_Hdr *);
-static void fseeko_e(off_t, FILE *);
+/* Maximum length of a time in batch input */
+#define LEN 64
+
+/* A RaXPol file to search */
+struct Fl {
+    char *nm;				/* Path */
+    FILE *fl;				/* Stream, NULL if closed */
+    off_t o0;				/* Offset to first ray */
+    off_t ray_sz;			/* Size of one ray */
+    int old_fmt;			/* If true, ray headers are in "old"
+					   (2011) format */
+    long num_rays;			/* Number of rays */
+    double tm0;				/* Time of first ray */
+    struct RaXPol_Idx idx;		/* Ray index */
+    int have_idx;			/* If true, idx is current */
+    struct RaXPol_Z z;			/* Decompressor, if file is
+					   compressed, in which case fl is
+					   z.in */
+};
+
+/* A batch query */
+struct Query {
+    char tm_s[LEN];			/* Time as given */
+    double tm;				/* Seconds since 1970-01-01 00:00:00 */
+    int f;				/* Index of answer file */
+    long r;				/* Answer ray */
+};
+
+static char *argv0;			/* Name of the executable, for error
+					   messages. */
+
+static int fl_open(struct Fl *, char *, int);
+static void fl_close(struct Fl *);
+static int batch(char **, int);
+static int cmp_fl(const void *, const void *);
+static int cmp_query_tm(const void *, const void *);
 
 int main(int argc, char *argv[])
 {
-    char *argv0;			/* Name of the executable, for error
-					   messages. */
-    char *dttm = NULL;			/* YYYYMMDD-HHMMSS from command line */
-    char *raxpol_fl_nm;			/* RaXPol file path */
-    FILE *raxpol_fl;			/* RaXPol file */
-    int yr, mon, day, hr, min;		/* Year, month, day, hour, minute */
-    double sec;				/* Second */
-    double t0;				/* Ray time. Julian date */
-    off_t o;				/* Offset in raxpol_fl */
-    off_t o0;				/* Offset to start of first ray */
-    off_t o1;				/* Offset at end of file */
-    long ray_sz;			/* Size in file of one ray */
-    struct RaXPol_File_Hdr file_hdr;	/* Header from the RaXPol file */
-    struct RaXPol_Ray_Hdr ray_hdr;
+    extern int optind;			/* See getopt (3) */
+    int c;				/* Return from getopt */
+    int batch_mode = 0;			/* If true, read times from stdin */
+    char *dttm;				/* YYYYMMDD-HHMMSS from command line */
+    double tm;				/* Time from dttm */
+    struct Fl fl;			/* RaXPol file */
+    long r;				/* Ray index */
 
     argv0 = argv[0];
+    RaXPol_Prof_Init(argv0);
     if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
 	RaXPol_Old_Fmt();
     }
-    if ( argc == 2 ) {
-	if ( strcmp(argv[1], "-V") == 0 ) {
-	    printf("%s\n", RAXPOL_MOMENT_VERSION);
-	    exit(EXIT_SUCCESS);
-	} else {
-	    /* raxpol_ray_hdrs YYYYMMDD-HHMMSS */
-	    dttm = argv[1];
-	    raxpol_fl_nm = "-";
+    while ((c = getopt(argc, argv, ":Vlb")) != -1) {
+	switch(c) {
+	    case 'V':
+		printf("%s\n", RAXPOL_MOMENT_VERSION);
+		exit(EXIT_SUCCESS);
+		break;
+	    case 'l':
+		RaXPol_Old_Fmt();
+		break;
+	    case 'b':
+		batch_mode = 1;
+		break;
+	    case '?':
+		fprintf(stderr, "Usage: %s [-l] YYYYMMDD-HHMMSS [raxpol_file]\n"
+			"       %s [-l] -b raxpol_file ...\n", argv0, argv0);
+		exit(EXIT_FAILURE);
+		break;
 	}
-    } else if ( argc == 3 ) {
-	if ( strcmp(argv[1], "-l") == 0 ) {
-	    /* raxpol_ray_hdrs -l YYYYMMDD-HHMMSS */
-	    RaXPol_Old_Fmt();
-	    dttm = argv[2];
-	    raxpol_fl_nm = "-";
-	} else {
-	    /* raxpol_ray_hdrs YYYYMMDD-HHMMSS raxpol_file */
-	    dttm = argv[1];
-	    raxpol_fl_nm = argv[2];
+    }
+    if ( batch_mode ) {
+	if ( optind == argc ) {
+	    fprintf(stderr, "Usage: %s [-l] -b raxpol_file ...\n", argv0);
+	    exit(EXIT_FAILURE);
 	}
-    } else if ( argc == 4 && strcmp(argv[1], "-l") == 0 ) {
-	/* raxpol_ray_hdrs -l YYYYMMDD-HHMMSS raxpol_file */
-	RaXPol_Old_Fmt();
-	dttm = argv[2];
-	raxpol_fl_nm = argv[3];
-    } else {
-	fprintf(stderr, "Usage: %s [-l] YYYYMMDD-HHMMSS [raxpol_file]", argv0);
-	exit(EXIT_FAILURE);
+	return batch(argv + optind, argc - optind)
+	    ? EXIT_SUCCESS : EXIT_FAILURE;
     }
-    if ( sscanf(dttm, "%4d%2d%2d-%2d%2d%lf",
-		&yr, &mon, &day, &hr, &min, &sec) != 6 ) {
-	fprintf(stderr, "%s: %s is not a valid time.\n",
-		argv0, dttm);
+    if ( optind + 1 != argc && optind + 2 != argc ) {
+	fprintf(stderr, "Usage: %s [-l] YYYYMMDD-HHMMSS [raxpol_file]\n",
+		argv0);
 	exit(EXIT_FAILURE);
     }
-    t0 = Tm_CalToJul(yr, mon, day, hr, min, sec);
-    if ( strcmp(raxpol_fl_nm, "-") == 0 ) {
-	raxpol_fl = stdin;
-    } else if ( !(raxpol_fl = fopen(raxpol_fl_nm, "r")) ) {
-	fprintf(stderr, "%s: could not open %s for reading.\n",
-		argv0, raxpol_fl_nm);
+    dttm = argv[optind];
+    if ( !RaXPol_Scan_Tm(dttm, &tm) ) {
+	fprintf(stderr, "%s: %s is not a valid time.\n", argv0, dttm);
 	exit(EXIT_FAILURE);
     }
-    RaXPol_Init_File_Hdr(&file_hdr);
-    if ( !RaXPol_Read_File_Hdr(&file_hdr, raxpol_fl) ) {
-	fprintf(stderr, "%s: failed to read file header.\n", argv0);
+    RaXPol_Idx_Init(&fl.idx);
+    RaXPol_Z_Init(&fl.z);
+    if ( !fl_open(&fl, (optind + 2 == argc) ? argv[optind + 1] : "-", 1) ) {
 	exit(EXIT_FAILURE);
     }
-    if ( (o0 = ftello(raxpol_fl)) == -1 ) {
-	fprintf(stderr, "%s: could not determine position in file.\n%s\n",
-		argv0, strerror(errno));
-	exit(EXIT_FAILURE);
+    if ( fl.z.in ) {
+	r = RaXPol_Z_Tm_Ray(&fl.z, fl.o0, fl.ray_sz, fl.old_fmt,
+		fl.num_rays, tm, 1);
+    } else {
+	r = RaXPol_Idx_Tm_Ray(fl.have_idx ? &fl.idx : NULL, fl.fl, fl.o0,
+		fl.ray_sz, fl.old_fmt, fl.num_rays, tm, 1);
     }
-    if ( !RaXPol_Read_Ray_Hdr(&ray_hdr, raxpol_fl)
-	    || (o = ftello(raxpol_fl)) == -1
-	    || fseek(raxpol_fl, 0, SEEK_END) == -1
-	    || (o1 = ftello(raxpol_fl)) == -1 ) {
-	fprintf(stderr, "%s: could not set position in file.\n", argv0);
+    if ( r == -1 ) {
+	fprintf(stderr, "%s: could not search %s for %s.\n",
+		argv0, fl.nm, dttm);
 	exit(EXIT_FAILURE);
     }
-    ray_sz = o - o0 + ray_hdr.data_size;
-    o1 = o0 + ((o1 - o0) / ray_sz) * ray_sz - ray_sz;
-    o = off_tm(o0, o1, t0, raxpol_fl, &ray_hdr);
-    printf("%zd\n", (size_t)((o - o0) / ray_sz));
+    printf("%ld\n", (r > 0) ? r - 1 : 0);
     return EXIT_SUCCESS;
 }
 
 /*
-   Find offset to ray with a given time.
+   Answer queries from standard input for the num_fls RaXPol files named
+   in fl_nms. Each query is a line with a time YYYYMMDD-HHMMSS. Print the
+   time, the file with the last ray at or before the time, and the index of
+   that ray in the file, in the order of the queries. Times before the
+   first ray of the earliest file resolve to that ray.
 
-   o0 and o1 must give offsets from start of file to some pair of rays in
-   RAXPOL file represented by stream in. tm is a Julian day.
+   Queries are sorted by time, and files by time of first ray, so files are
+   visited once, in order, and each search starts from the answer for the
+   previous query.
 
-   This function calls itself recursively until it converges on the ray
-   with nearest tm. Position of in is set to this ray.
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int batch(char **fl_nms, int num_fls)
+{
+    struct Fl *fls = NULL;		/* Files to search */
+    struct Query *queries = NULL;	/* Queries from standard input */
+    struct Query **q_srt = NULL;	/* Queries sorted by time */
+    size_t num_queries = 0;		/* Number of queries */
+    size_t num_queries_max = 0;		/* Allocated size of queries */
+    char line[LEN];			/* Input line */
+    int f;				/* Index into fls */
+    size_t q;				/* Index into queries */
+    long r;				/* Ray index */
+    int status = 0;
 
-   If tm is before the time of the ray at o0, or if the file is unseekable
-   (stdin or a pipe), or something goes wrong, in is positioned at o0, and
-   return value is o0.
+    /* Read queries */
+    while ( fgets(line, LEN, stdin) ) {
+	struct Query *query_p;
+	char *c;
 
-   If tm is after the time of the ray at o1, in is positioned at o1, and
-   return value is o1.
+	for (c = line; *c == ' ' || *c == '\t'; c++) {
+	}
+	if ( *c == '\n' || *c == '\0' ) {
+	    continue;
+	}
+	if ( num_queries == num_queries_max ) {
+	    struct Query *t;
+	    size_t n = (num_queries_max == 0) ? 1024 : 2 * num_queries_max;
 
-   If tm is after the time of the ray at o0, and before the time of the ray
-   at o1, file is positioned at the latest ray before that at o1. Offset to
-   this ray is returned.
+	    if ( !(t = REALLOC(queries, n * sizeof(struct Query))) ) {
+		fprintf(stderr, "%s: could not allocate space for %zu "
+			"queries.\n", argv0, n);
+		goto end;
+	    }
+	    queries = t;
+	    num_queries_max = n;
+	}
+	query_p = queries + num_queries;
+	if ( sscanf(c, "%63s", query_p->tm_s) != 1
+		|| !RaXPol_Scan_Tm(query_p->tm_s, &query_p->tm) ) {
+	    fprintf(stderr, "%s: could not read time from query %zu.\n",
+		    argv0, num_queries);
+	    goto end;
+	}
+	num_queries++;
+    }
+    if ( ferror(stdin) ) {
+	fprintf(stderr, "%s: could not read queries.\n", argv0);
+	goto end;
+    }
+    if ( num_queries == 0 ) {
+	status = 1;
+	goto end;
+    }
+    if ( !(q_srt = CALLOC(num_queries, sizeof(struct Query *))) ) {
+	fprintf(stderr, "%s: could not allocate query list.\n", argv0);
+	goto end;
+    }
+    for (q = 0; q < num_queries; q++) {
+	q_srt[q] = queries + q;
+    }
+    qsort(q_srt, num_queries, sizeof(struct Query *), cmp_query_tm);
 
-   rh_p will receive the contents of the ray at the returned offset.
+    /* Get time of first ray in each file. Keep files closed until needed. */
+    if ( !(fls = CALLOC(num_fls, sizeof(struct Fl))) ) {
+	fprintf(stderr, "%s: could not allocate file list.\n", argv0);
+	goto end;
+    }
+    for (f = 0; f < num_fls; f++) {
+	RaXPol_Idx_Init(&fls[f].idx);
+	RaXPol_Z_Init(&fls[f].z);
+    }
+    for (f = 0; f < num_fls; f++) {
+	if ( !fl_open(fls + f, fl_nms[f], 0) ) {
+	    goto end;
+	}
+	fl_close(fls + f);
+    }
+    qsort(fls, num_fls, sizeof(struct Fl), cmp_fl);
 
-   If attempt to set in to return value position fails, process exits.
+    /*
+       Merge queries with files. f is the last file whose first ray is not
+       after the query time. r is the answer for the previous query in f.
+     */
+
+    for (q = 0, f = 0, r = 0; q < num_queries; q++) {
+	struct Query *query_p = q_srt[q];
+	struct Fl *fl_p;
+
+	while ( f + 1 < num_fls && fls[f + 1].tm0 <= query_p->tm ) {
+	    fl_close(fls + f);
+	    f++;
+	    r = 0;
+	}
+	fl_p = fls + f;
+	if ( !fl_p->fl && !fl_open(fl_p, fl_p->nm, 1) ) {
+	    goto end;
+	}
+	if ( fl_p->z.in ) {
+	    r = RaXPol_Z_Tm_Ray(&fl_p->z, fl_p->o0, fl_p->ray_sz,
+		    fl_p->old_fmt, fl_p->num_rays, query_p->tm, 1);
+	    fl_p->fl = fl_p->z.in;
+	} else {
+	    r = RaXPol_Idx_Gallop(fl_p->have_idx ? &fl_p->idx : NULL,
+		    fl_p->fl, fl_p->o0, fl_p->ray_sz, fl_p->old_fmt,
+		    fl_p->num_rays, r, query_p->tm, 1);
+	}
+	if ( r == -1 ) {
+	    fprintf(stderr, "%s: could not search %s for %s.\n",
+		    argv0, fl_p->nm, query_p->tm_s);
+	    goto end;
+	}
+	query_p->f = f;
+	query_p->r = (r > 0) ? r - 1 : 0;
+    }
+    for (q = 0; q < num_queries; q++) {
+	printf("%s %s %ld\n",
+		queries[q].tm_s, fls[queries[q].f].nm, queries[q].r);
+    }
+    status = 1;
+
+end:
+    if ( fls ) {
+	for (f = 0; f < num_fls; f++) {
+	    fl_close(fls + f);
+	}
+    }
+    FREE(fls);
+    FREE(q_srt);
+    FREE(queries);
+    return status;
+}
+
+/*
+   Open RaXPol file fl_nm ("-" for standard input) and store its ray
+   geometry and first ray time at fl_p. If use_idx is true, also load its ray
+   index, if current. If fl_nm is compressed, it is read through a
+   decompressor, and its member index, if any, takes the place of the ray
+   index and gives the ray header format.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
  */
 
-static off_t off_tm(off_t o0, off_t o1, double tm, FILE *in,
-	struct RaXPol_Ray_Hdr *rh_p)
+static int fl_open(struct Fl *fl_p, char *fl_nm, int use_idx)
 {
-    double t0, t1;			/* Ray times at o0 and o1 */
-    long ray_sz;			/* Size of one ray */
-    off_t o;
-    double t;
-
-    /* Read ray header at o0. Assign resulting file position to o. */
-    if ( fseeko(in, o0, SEEK_SET) == -1
-	    || !RaXPol_Read_Ray_Hdr(rh_p, in) ) {
-	return o0;
-    }
-    if ( (o = ftello(in)) == -1 ) {
-	fprintf(stderr, "Could not determine position in file.\n%s\n",
-		strerror(errno));
-	return o0;
-    }
-    ray_sz = o - o0 + rh_p->data_size;
-
-    /* Return o0 if tm is before ray at o0, return o1 if tm is after o1. */
-    t0 = ray_time_jul(rh_p);
-    if ( tm < t0 ) {
-	fseeko_e(o0, in);
-	return o0;
-    }
-    if ( fseeko(in, o1, SEEK_SET) == -1
-	    || !RaXPol_Read_Ray_Hdr(rh_p, in) ) {
-	fseeko_e(o0, in);
-	return o0;
-    }
-    t1 = ray_time_jul(rh_p);
-    if ( tm > t1 ) {
-	fseeko_e(o0, in);
-	return o1;
-    }
-
-    /* tm between o0 and o1. Interpolate to a ray before tm. */
-    o = o0 + ray_sz * floor((tm - t0) / (t1 - t0) * (o1 - o0) / ray_sz);
-    if ( fseeko(in, o, SEEK_SET) == -1
-	    || !RaXPol_Read_Ray_Hdr(rh_p, in) ) {
-	fseeko_e(o0, in);
-	return o0;
-    }
-    t = ray_time_jul(rh_p);
-    if ( t < tm ) {
-	/* Overshot backwards. Return o0. */
-	if ( fseeko(in, o, SEEK_SET) == -1 ) {
-	    fseeko_e(o0, in);
-	    return o0;
+    struct RaXPol_File_Hdr file_hdr;	/* Header from the RaXPol file */
+    struct RaXPol_Ray_Hdr ray_hdr;	/* First ray header */
+    off_t o, o1;			/* Offsets in file */
+
+    fl_p->nm = fl_nm;
+    fl_p->have_idx = 0;
+    if ( strcmp(fl_nm, "-") == 0 ) {
+	fl_p->fl = stdin;
+    } else if ( RaXPol_Z_Type(fl_nm) != RAXPOL_Z_NONE ) {
+	if ( !RaXPol_Z_Open(&fl_p->z, fl_nm) ) {
+	    fprintf(stderr, "%s: could not open %s for reading.\n",
+		    argv0, fl_nm);
+	    return 0;
 	}
-	return o;
+	fl_p->fl = fl_p->z.in;
+    } else if ( !(fl_p->fl = fopen(fl_nm, "r")) ) {
+	fprintf(stderr, "%s: could not open %s for reading.\n", argv0, fl_nm);
+	return 0;
+    }
+    RaXPol_Init_File_Hdr(&file_hdr);
+    if ( !RaXPol_Read_File_Hdr(&file_hdr, fl_p->fl) ) {
+	fprintf(stderr, "%s: failed to read file header from %s.\n",
+		argv0, fl_nm);
+	goto error;
+    }
+    if ( fl_p->z.in ) {
+	fl_p->old_fmt = RaXPol_Z_Old_Fmt(&fl_p->z, file_hdr.old_fmt);
     } else {
-	/* Overshot forwards. Call again to push back. */
-	return off_tm(o0, o, tm, in, rh_p);
+	fl_p->old_fmt = file_hdr.old_fmt;
+    }
+    if ( fl_p->z.in ) {
+	fl_p->o0 = fl_p->z.o += RAXPOL_FILE_HDR_SZ;
+	if ( !RaXPol_Read_Ray_Hdr(&ray_hdr, fl_p->fl, fl_p->old_fmt) ) {
+	    fprintf(stderr, "%s: could not read first ray header from %s.\n",
+		    argv0, fl_nm);
+	    goto error;
+	}
+	o = fl_p->z.o += RaXPol_Ray_Hdr_Sz(fl_p->old_fmt);
+	if ( !RaXPol_Z_Size(&fl_p->z, &o1) ) {
+	    fprintf(stderr, "%s: could not get size of %s.\n", argv0, fl_nm);
+	    goto error;
+	}
+    } else if ( (fl_p->o0 = ftello(fl_p->fl)) == -1
+	    || !RaXPol_Read_Ray_Hdr(&ray_hdr, fl_p->fl, fl_p->old_fmt)
+	    || (o = ftello(fl_p->fl)) == -1
+	    || fseeko(fl_p->fl, 0, SEEK_END) == -1
+	    || (o1 = ftello(fl_p->fl)) == -1 ) {
+	fprintf(stderr, "%s: could not set position in %s.\n", argv0, fl_nm);
+	goto error;
     }
+    if ( ray_hdr.data_size <= 0 || file_hdr.num_rng_gates <= 0
+	    || ray_hdr.data_size % file_hdr.num_rng_gates != 0 ) {
+	fprintf(stderr, "%s: first ray in %s has data size %d, which does not "
+		"fit %d range gates. The file might have %s ray headers. "
+		"Try%s -l.\n", argv0, fl_nm, ray_hdr.data_size,
+		file_hdr.num_rng_gates,
+		fl_p->old_fmt ? "current" : "old (2011)",
+		fl_p->old_fmt ? " without" : "");
+	goto error;
+    }
+    fl_p->ray_sz = o - fl_p->o0 + ray_hdr.data_size;
+    fl_p->num_rays = (o1 - fl_p->o0) / fl_p->ray_sz;
+    fl_p->tm0 = RaXPol_Ray_Tm(&ray_hdr);
+    if ( use_idx && fl_p->fl != stdin && !fl_p->z.in ) {
+	fl_p->have_idx = RaXPol_Idx_Open(&fl_p->idx, fl_nm, NULL)
+	    && fl_p->idx.ray_hdr_sz == (int)RaXPol_Ray_Hdr_Sz(fl_p->old_fmt);
+    }
+    return 1;
+
+error:
+    fl_close(fl_p);
+    return 0;
 }
 
-/* Set in to offset o or exit */ 
-static void fseeko_e(off_t o, FILE *in)
+/* Close file and free indeces at fl_p */
+static void fl_close(struct Fl *fl_p)
 {
-    if ( fseeko(in, o, SEEK_SET) == -1 ) {
-	fprintf(stderr, "Could not set position in file.\n%s\n",
-		strerror(errno));
-	exit(EXIT_FAILURE);
+    if ( fl_p->z.type != RAXPOL_Z_NONE ) {
+	RaXPol_Z_Close(&fl_p->z);
+    } else if ( fl_p->fl && fl_p->fl != stdin ) {
+	fclose(fl_p->fl);
     }
+    fl_p->fl = NULL;
+    RaXPol_Idx_Free(&fl_p->idx);
+    fl_p->have_idx = 0;
 }
 
-/* Return ray time as Julian day */
-static double ray_time_jul(struct RaXPol_Ray_Hdr *ray_hdr_p)
+/* Compare files by time of first ray, for qsort */
+static int cmp_fl(const void *a, const void *b)
 {
-    double jul0;			/* 1970/01/01 00:00:00 */
-    jul0 = Tm_CalToJul(1970, 1, 1, 0, 0, 0);
+    const struct Fl *fa = a, *fb = b;
 
-    return jul0
-	+ (ray_hdr_p->timestamp_seconds
-		+ 1.0e-6 * ray_hdr_p->timestamp_useconds) / 86400.0;
+    return (fa->tm0 < fb->tm0) ? -1 : (fa->tm0 > fb->tm0) ? 1 : 0;
 }
 
+/* Compare pointers to queries by time, for qsort */
+static int cmp_query_tm(const void *a, const void *b)
+{
+    const struct Query *qa = *(struct Query **)a;
+    const struct Query *qb = *(struct Query **)b;
+
+    return (qa->tm < qb->tm) ? -1 : (qa->tm > qb->tm) ? 1 : 0;
+}
@@ -0,0 +1,1435 @@
+/*
+   -	raxpol_seq.c --
+   -		This file defines functions that read an ordered list
+   -		of RaXPol files as one stream of rays. See raxpol_seq.h.
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+#include "alloc.h"
+#include "raxpol_prof.h"
+#include "raxpol.h"
+#include "raxpol_idx.h"
+#include "raxpol_seq.h"
+
+static int fl_scan(struct RaXPol_Seq *, struct RaXPol_Seq_Fl *, FILE *,
+	struct RaXPol_Z *, int);
+static int fl_seek(struct RaXPol_Seq *, off_t);
+static void fl_close(struct RaXPol_Seq *);
+static int compat(struct RaXPol_File_Hdr *, struct RaXPol_File_Hdr *, char *);
+static int hdrs_decode(struct RaXPol_Seq_Fl *, struct RaXPol_Ray_Hdr *, char *,
+	size_t, long);
+static int seq_use(struct RaXPol_Seq *, int);
+static int seq_next(struct RaXPol_Seq *);
+static void prefetch(struct RaXPol_Seq *);
+static int seq_grow(struct RaXPol_Seq *);
+static int fl_sz(char *, off_t *);
+static int fl_ready(struct RaXPol_Seq *, char *);
+static int next_fl_nm(char *, char **);
+static char *fl_dir(char *);
+static void seq_wait(struct RaXPol_Seq *, char *);
+static void ahead_start(struct RaXPol_Seq *);
+static void ahead_stop(struct RaXPol_Seq *);
+static void *ahead_thr(void *);
+static char *ahead_ray(struct RaXPol_Seq *);
+
+/*
+   Read ahead in the current file. Thread thr reads rays r_rd through r_end
+   - 1, indeces in the file, into ring, where ray r goes into slot r % k. It
+   does not overwrite a slot until the caller has decoded the ray in it.
+ */
+
+struct RaXPol_Seq_Ahead {
+    pthread_t thr;			/* Thread that reads */
+    pthread_mutex_t mtx;		/* Guards r_rd, r_use, err, eof, done,
+					   stop */
+    pthread_cond_t cnd;			/* Signals change in guarded members */
+    int fd;				/* Current file */
+    off_t o0;				/* Offset to first ray in file */
+    off_t ray_sz;			/* Size of one ray */
+    long k;				/* Number of slots in ring */
+    char *ring;				/* Ray buffers, k * ray_sz bytes */
+    long r_rd;				/* Next ray to read */
+    long r_use;				/* Next ray to decode */
+    long r_end;				/* End of reads */
+    int err;				/* errno from failed read, or 0 */
+    int eof;				/* If true, file ended early */
+    int done;				/* If true, thread has finished */
+    int stop;				/* If true, thread should finish */
+};
+
+/* Initialize an empty sequence */
+void RaXPol_Seq_Init(struct RaXPol_Seq *seq_p)
+{
+    memset(seq_p, 0, sizeof(struct RaXPol_Seq));
+    RaXPol_Init_File_Hdr(&seq_p->file_hdr);
+    seq_p->dat_p = NULL;
+    seq_p->fls = NULL;
+    seq_p->f = -1;
+    seq_p->in = seq_p->nxt = NULL;
+    seq_p->follow = 0;
+    seq_p->old_fmt = 0;
+    seq_p->wfd = -1;
+    seq_p->ahead = 0;
+    seq_p->ahd = NULL;
+    RaXPol_Z_Init(&seq_p->z);
+}
+
+/*
+   Put sequence seq_p, initialized with RaXPol_Seq_Init, in follow mode.
+   Call before RaXPol_Seq_Open. In follow mode, RaXPol_Seq_Open waits for the
+   last file to have its file header and first ray header.
+ */
+
+void RaXPol_Seq_Follow(struct RaXPol_Seq *seq_p)
+{
+    seq_p->follow = 1;
+}
+
+/*
+   Make sequence seq_p, initialized with RaXPol_Seq_Init, read all of its
+   files as "old" (2011) format files, instead of detecting the format of
+   each file. Call before RaXPol_Seq_Open. Unlike RaXPol_Old_Fmt, this does
+   not affect other sequences.
+ */
+
+void RaXPol_Seq_Old_Fmt(struct RaXPol_Seq *seq_p)
+{
+    seq_p->old_fmt = 1;
+}
+
+/*
+   Open the num_fls RaXPol files named in fl_nms as sequence seq_p, which
+   must have been initialized with RaXPol_Seq_Init. The file headers and first
+   ray headers of all files are read, and the files are checked for
+   compatibility. If dat_p is not NULL, it is initialized with
+   RaXPol_Init_Data from the first file, and rays read from the sequence go
+   into it. If dat_p is NULL, only ray headers can be read. "-" refers to
+   standard input, and can only be used if it is the only file, and not in
+   follow mode. On success, the sequence is positioned at ray 0.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Seq_Open(struct RaXPol_Seq *seq_p, char **fl_nms, int num_fls,
+	struct RaXPol_Data *dat_p)
+{
+    struct RaXPol_Seq_Fl *fl_p;		/* Member of seq_p->fls */
+    FILE *in = NULL;			/* File being examined */
+    struct RaXPol_Z z;			/* in, if compressed */
+    int f;				/* Index into fl_nms */
+    char *s;				/* Value of RAXPOL_SEQ_AHEAD_ENV */
+
+    if ( num_fls < 1 ) {
+	fprintf(stderr, "Sequence must have at least one file.\n");
+	return 0;
+    }
+    if ( !(seq_p->fls = CALLOC(num_fls, sizeof(struct RaXPol_Seq_Fl))) ) {
+	fprintf(stderr, "Could not allocate sequence with %d files.\n",
+		num_fls);
+	return 0;
+    }
+    seq_p->dat_p = dat_p;
+    RaXPol_Z_Init(&z);
+    for (f = 0, fl_p = seq_p->fls; f < num_fls; f++, fl_p++) {
+	if ( !(fl_p->nm = MALLOC(strlen(fl_nms[f]) + 1)) ) {
+	    fprintf(stderr, "Could not allocate name for %s.\n", fl_nms[f]);
+	    goto error;
+	}
+	strcpy(fl_p->nm, fl_nms[f]);
+	seq_p->num_fls = f + 1;
+	if ( strcmp(fl_p->nm, "-") == 0 ) {
+	    if ( num_fls > 1 || seq_p->follow ) {
+		fprintf(stderr, "Standard input cannot be part of a sequence "
+			"with other files, or followed.\n");
+		goto error;
+	    }
+	    in = stdin;
+	} else if ( RaXPol_Z_Type(fl_p->nm) != RAXPOL_Z_NONE ) {
+	    if ( seq_p->follow ) {
+		fprintf(stderr, "Compressed file %s cannot be followed.\n",
+			fl_p->nm);
+		goto error;
+	    }
+	    if ( !RaXPol_Z_Open(&z, fl_p->nm) ) {
+		goto error;
+	    }
+	    in = z.in;
+	} else if ( seq_p->follow && f == num_fls - 1
+		&& !fl_ready(seq_p, fl_p->nm) ) {
+	    goto error;
+	} else if ( !(in = fopen(fl_p->nm, "r")) ) {
+	    fprintf(stderr, "Could not open %s for reading.\n%s\n",
+		    fl_p->nm, strerror(errno));
+	    goto error;
+	}
+	if ( !fl_scan(seq_p, fl_p, in, z.in ? &z : NULL, f == 0) ) {
+	    goto error;
+	}
+	if ( f == 0 ) {
+	    seq_p->in = in;
+	    seq_p->z = z;
+	    RaXPol_Z_Init(&z);
+	    seq_p->f = 0;
+	} else if ( z.in ) {
+	    RaXPol_Z_Close(&z);
+	} else {
+	    fclose(in);
+	}
+	in = NULL;
+    }
+    if ( !fl_seek(seq_p, seq_p->fls[0].o0) ) {
+	fprintf(stderr, "Could not position at first ray of %s.\n%s\n",
+		seq_p->fls[0].nm, strerror(errno));
+	goto error;
+    }
+    seq_p->r = 0;
+    if ( seq_p->dat_p && seq_p->in != stdin && !seq_p->follow ) {
+	seq_p->ahead = RAXPOL_SEQ_AHEAD;
+	if ( (s = getenv(RAXPOL_SEQ_AHEAD_ENV))
+		&& sscanf(s, "%ld", &seq_p->ahead) != 1 ) {
+	    fprintf(stderr, "Expected integer for %s, got %s.\n",
+		    RAXPOL_SEQ_AHEAD_ENV, s);
+	    goto error;
+	}
+    }
+    return 1;
+
+error:
+    if ( z.in ) {
+	RaXPol_Z_Close(&z);
+    } else if ( in && in != stdin && in != seq_p->in ) {
+	fclose(in);
+    }
+    RaXPol_Seq_Free(seq_p);
+    return 0;
+}
+
+/* Close files and free memory in sequence, and reinitialize it */
+void RaXPol_Seq_Free(struct RaXPol_Seq *seq_p)
+{
+    int f;
+
+    fl_close(seq_p);
+    if ( seq_p->nxt ) {
+	fclose(seq_p->nxt);
+    }
+    if ( seq_p->wfd >= 0 ) {
+	close(seq_p->wfd);
+    }
+    for (f = 0; f < seq_p->num_fls; f++) {
+	FREE(seq_p->fls[f].nm);
+    }
+    FREE(seq_p->fls);
+    RaXPol_Seq_Init(seq_p);
+}
+
+/*
+   Position sequence seq_p at global ray r. If the sequence has ray data,
+   running noise averages are restored from the ray index for the file that
+   has ray r, if the index is current, otherwise by reading the previous rays
+   in the file. r may be seq_p->num_rays, for end of sequence.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Seq_Seek(struct RaXPol_Seq *seq_p, long r)
+{
+    int lo, hi, m;			/* Indeces into seq_p->fls */
+    struct RaXPol_Seq_Fl *fl_p;		/* File with ray r */
+    struct RaXPol_Idx idx;		/* Ray index for fl_p */
+    int have_idx;			/* If true, idx is current */
+    long r1;				/* Ray in compressed file to read
+					   from */
+    int status;
+
+    if ( r < 0 || r > seq_p->num_rays ) {
+	fprintf(stderr, "Ray %ld is not in sequence of %ld rays.\n",
+		r, seq_p->num_rays);
+	return 0;
+    }
+    ahead_stop(seq_p);
+
+    /* Find last file that starts at or before r */
+    for (lo = 0, hi = seq_p->num_fls - 1; lo < hi; ) {
+	m = hi - (hi - lo) / 2;
+	if ( seq_p->fls[m].r0 <= r ) {
+	    lo = m;
+	} else {
+	    hi = m - 1;
+	}
+    }
+    if ( !seq_use(seq_p, lo) ) {
+	return 0;
+    }
+    fl_p = seq_p->fls + lo;
+    if ( seq_p->dat_p && seq_p->z.in ) {
+
+	/* Noise averages from member index, if any, then read to ray r */
+	r1 = RaXPol_Z_Mbr_Ray(&seq_p->z, r - fl_p->r0,
+		&seq_p->dat_p->v_noise_avg, &seq_p->dat_p->h_noise_avg);
+	status = fl_seek(seq_p, fl_p->o0 + r1 * fl_p->ray_sz);
+	for ( ; status && r1 < r - fl_p->r0; r1++) {
+	    status = RaXPol_Read_Ray(seq_p->dat_p, seq_p->in);
+	    seq_p->z.o += fl_p->ray_sz;
+	}
+    } else if ( seq_p->dat_p ) {
+	RaXPol_Idx_Init(&idx);
+	have_idx = seq_p->in != stdin
+	    && RaXPol_Idx_Open(&idx, fl_p->nm, seq_p->dat_p);
+	status = RaXPol_Idx_Seek_Ray(have_idx ? &idx : NULL, seq_p->dat_p,
+		seq_p->in, fl_p->o0, fl_p->ray_sz, r - fl_p->r0);
+	RaXPol_Idx_Free(&idx);
+    } else {
+	status = fl_seek(seq_p, fl_p->o0 + (r - fl_p->r0) * fl_p->ray_sz);
+    }
+    if ( !status ) {
+	fprintf(stderr, "Could not position at ray %ld of sequence, ray %ld "
+		"of %s.\n", r, r - fl_p->r0, fl_p->nm);
+	seq_p->r = -1;
+	return 0;
+    }
+    seq_p->r = r;
+    return 1;
+}
+
+/*
+   Return the number of rays in sequence seq_p with times before tm, or, if
+   incl is true, not after tm. tm is seconds since 1970-01-01 00:00:00. The
+   file that might have tm is found from the times of the first rays, then
+   searched with RaXPol_Idx_Tm_Ray, using the ray index if it is current.
+   The sequence must be repositioned with RaXPol_Seq_Seek before reading
+   more rays.
+
+   Returns -1 on failure. Prints error messages to stderr on failure.
+ */
+
+long RaXPol_Seq_Tm_Ray(struct RaXPol_Seq *seq_p, double tm, int incl)
+{
+    int lo, hi, m;			/* Indeces into seq_p->fls */
+    struct RaXPol_Seq_Fl *fl_p;		/* File that might have tm */
+    struct RaXPol_Idx idx;		/* Ray index for fl_p */
+    int have_idx;			/* If true, idx is current */
+    long n;				/* Return value from RaXPol_Idx_Tm_Ray */
+
+    /* lo = number of files starting before tm */
+    for (lo = 0, hi = seq_p->num_fls; lo < hi; ) {
+	m = lo + (hi - lo) / 2;
+	if ( seq_p->fls[m].tm0 < tm || (incl && seq_p->fls[m].tm0 == tm) ) {
+	    lo = m + 1;
+	} else {
+	    hi = m;
+	}
+    }
+    if ( lo == 0 ) {
+	return 0;
+    }
+    ahead_stop(seq_p);
+    seq_p->r = -1;
+    if ( !seq_use(seq_p, lo - 1) ) {
+	return -1;
+    }
+    fl_p = seq_p->fls + lo - 1;
+    if ( seq_p->z.in ) {
+	n = RaXPol_Z_Tm_Ray(&seq_p->z, fl_p->o0, fl_p->ray_sz,
+		fl_p->old_fmt, fl_p->num_rays, tm, incl);
+	seq_p->in = seq_p->z.in;
+	return (n == -1) ? -1 : fl_p->r0 + n;
+    }
+    RaXPol_Idx_Init(&idx);
+    have_idx = seq_p->in != stdin
+	&& RaXPol_Idx_Open(&idx, fl_p->nm, seq_p->dat_p);
+    n = RaXPol_Idx_Tm_Ray(have_idx ? &idx : NULL, seq_p->in, fl_p->o0,
+	    fl_p->ray_sz, fl_p->old_fmt, fl_p->num_rays, tm, incl);
+    RaXPol_Idx_Free(&idx);
+    return (n == -1) ? -1 : fl_p->r0 + n;
+}
+
+/*
+   Read the next ray from sequence seq_p into the RaXPol_Data structure
+   given to RaXPol_Seq_Open.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure,
+   including an attempt to read past the last ray.
+ */
+
+int RaXPol_Seq_Read_Ray(struct RaXPol_Seq *seq_p)
+{
+    struct RaXPol_Seq_Fl *fl_p;		/* Current file */
+    char *buf;				/* Ray read ahead */
+    int status;
+
+    if ( !seq_p->dat_p ) {
+	fprintf(stderr, "Sequence does not have ray data.\n");
+	return 0;
+    }
+    if ( !seq_next(seq_p) ) {
+	return 0;
+    }
+    fl_p = seq_p->fls + seq_p->f;
+    if ( !seq_p->ahd ) {
+	ahead_start(seq_p);
+    }
+    if ( seq_p->ahd ) {
+	status = (buf = ahead_ray(seq_p))
+	    && RaXPol_Decode_Ray(seq_p->dat_p, buf, fl_p->ray_sz);
+	if ( status ) {
+	    pthread_mutex_lock(&seq_p->ahd->mtx);
+	    seq_p->ahd->r_use++;
+	    pthread_cond_signal(&seq_p->ahd->cnd);
+	    pthread_mutex_unlock(&seq_p->ahd->mtx);
+	}
+    } else {
+	status = RaXPol_Read_Ray(seq_p->dat_p, seq_p->in);
+	if ( seq_p->z.in ) {
+	    seq_p->z.o += fl_p->ray_sz;
+	}
+    }
+    if ( !status ) {
+	fprintf(stderr, "Could not read ray %ld of sequence, ray %ld of %s.\n",
+		seq_p->r, seq_p->r - fl_p->r0, fl_p->nm);
+	return 0;
+    }
+    seq_p->r++;
+    return 1;
+}
+
+/*
+   Read up to num_rays rays from sequence seq_p, fewer if the sequence ends
+   first, and average them into one ray in the RaXPol_Data structure given to
+   RaXPol_Seq_Open, with RaXPol_Sum_Ray and RaXPol_Mean_Ray. Ray header is
+   the header of the middle ray. In follow mode, this waits for num_rays
+   rays.
+
+   Returns number of rays read, or -1 on failure. Prints error messages to
+   stderr on failure.
+ */
+
+long RaXPol_Seq_Read_Rays(struct RaXPol_Seq *seq_p, long num_rays)
+{
+    struct RaXPol_Ray_Hdr ray_hdr;	/* Header of middle ray */
+    long n;
+
+    if ( !seq_p->follow && num_rays > seq_p->num_rays - seq_p->r ) {
+	num_rays = seq_p->num_rays - seq_p->r;
+    }
+    if ( num_rays < 1 ) {
+	fprintf(stderr, "No rays to read at ray %ld of sequence.\n",
+		seq_p->r);
+	return -1;
+    }
+    if ( num_rays == 1 ) {
+	return RaXPol_Seq_Read_Ray(seq_p) ? 1 : -1;
+    }
+    RaXPol_Init_Ray_Hdr(&ray_hdr);
+    for (n = 0; n < num_rays; n++) {
+	if ( !RaXPol_Seq_Read_Ray(seq_p) || !RaXPol_Sum_Ray(seq_p->dat_p) ) {
+	    seq_p->dat_p->num_sum = 0;
+	    return -1;
+	}
+	if ( n == (num_rays - 1) / 2 ) {
+	    ray_hdr = seq_p->dat_p->ray_hdr;
+	}
+    }
+    if ( !RaXPol_Mean_Ray(seq_p->dat_p) ) {
+	return -1;
+    }
+    seq_p->dat_p->ray_hdr = ray_hdr;
+    return num_rays;
+}
+
+/*
+   Read the header of the next ray from sequence seq_p into ray_hdr_p, and
+   skip the ray data.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure,
+   including an attempt to read past the last ray.
+ */
+
+int RaXPol_Seq_Read_Ray_Hdr(struct RaXPol_Seq *seq_p,
+	struct RaXPol_Ray_Hdr *ray_hdr_p)
+{
+    struct RaXPol_Seq_Fl *fl_p;
+
+    if ( seq_p->ahd ) {
+
+	/* Stream did not move while reading ahead */
+	ahead_stop(seq_p);
+	fl_p = seq_p->fls + seq_p->f;
+	if ( seq_p->r >= 0 && fseeko(seq_p->in,
+		    fl_p->o0 + (seq_p->r - fl_p->r0) * fl_p->ray_sz,
+		    SEEK_SET) == -1 ) {
+	    fprintf(stderr, "Could not position at ray %ld of %s.\n%s\n",
+		    seq_p->r - fl_p->r0, fl_p->nm, strerror(errno));
+	    return 0;
+	}
+    }
+    if ( !seq_next(seq_p) ) {
+	return 0;
+    }
+    fl_p = seq_p->fls + seq_p->f;
+    if ( !RaXPol_Read_Ray_Hdr(ray_hdr_p, seq_p->in, fl_p->old_fmt) ) {
+	goto error;
+    }
+    if ( seq_p->z.in ) {
+	seq_p->z.o += RaXPol_Ray_Hdr_Sz(fl_p->old_fmt);
+	if ( !fl_seek(seq_p, seq_p->z.o + ray_hdr_p->data_size) ) {
+	    goto error;
+	}
+    } else if ( fseeko(seq_p->in, ray_hdr_p->data_size, SEEK_CUR) == -1 ) {
+	goto error;
+    }
+    seq_p->r++;
+    return 1;
+
+error:
+    fprintf(stderr, "Could not read header for ray %ld of sequence, "
+	    "ray %ld of %s.\n", seq_p->r,
+	    seq_p->r - seq_p->fls[seq_p->f].r0, seq_p->fls[seq_p->f].nm);
+    return 0;
+}
+
+/*
+   Read headers for rays r, r + step, r + 2 * step, ..., where r is the
+   current ray in sequence seq_p, into ray_hdrs, which must have room for n
+   headers. Ray data, and the rays in between, are skipped. Reading stops
+   after n headers or at the end of the sequence. It does not wait for new
+   rays in follow mode. Afterward, the sequence is positioned, as with
+   RaXPol_Seq_Seek, at the ray step rays after the last ray read, or at the
+   end of the sequence, so the next call continues the scan.
+
+   In regular files, each header is read with pread (2) at its offset. If
+   headers are more than RAXPOL_SEQ_SCAN_GAP bytes apart, the files are
+   opened again for the scan, and the system is advised not to read ahead
+   from the new descriptors, so that ray data is not read. Read ahead
+   already started for seq_p->in would keep reading ray data. Headers from
+   standard input, and from sequences with compressed files, are read one
+   ray at a time with RaXPol_Seq_Read_Ray_Hdr.
+
+   Returns number of headers read, or -1 on failure. Prints error messages
+   to stderr on failure.
+ */
+
+long RaXPol_Seq_Scan_Hdrs(struct RaXPol_Seq *seq_p, long step,
+	struct RaXPol_Ray_Hdr *ray_hdrs, long n)
+{
+    struct RaXPol_Seq_Fl *fl_p;		/* File with ray r */
+    struct RaXPol_Ray_Hdr ray_hdr;	/* Header of skipped ray */
+    size_t stride;			/* Space for one raw ray header */
+    char *buf = NULL;			/* Raw ray headers, stride apart */
+    int sparse;				/* If true, do not read ahead */
+    int fd = -1;			/* File with ray r */
+    long r;				/* Global index of next ray to read */
+    long k;				/* Number of headers read */
+    long k0;				/* First header read from fl_p */
+    long j;
+    int f;
+    double t0;				/* Profile start time */
+
+    if ( step < 1 ) {
+	fprintf(stderr, "Ray step must be positive, got %ld.\n", step);
+	return -1;
+    }
+    if ( !seq_p->in || seq_p->r < 0 ) {
+	fprintf(stderr, "Sequence is not positioned at a ray.\n");
+	return -1;
+    }
+    for (f = 0; f < seq_p->num_fls
+	    && RaXPol_Z_Type(seq_p->fls[f].nm) == RAXPOL_Z_NONE; f++) {
+	continue;
+    }
+    if ( seq_p->in == stdin || f < seq_p->num_fls ) {
+	for (k = 0; k < n && seq_p->r < seq_p->num_rays; k++) {
+	    if ( !RaXPol_Seq_Read_Ray_Hdr(seq_p, ray_hdrs + k) ) {
+		return -1;
+	    }
+	    for (j = 1; j < step && seq_p->r < seq_p->num_rays; j++) {
+		if ( !RaXPol_Seq_Read_Ray_Hdr(seq_p, &ray_hdr) ) {
+		    return -1;
+		}
+	    }
+	}
+	return k;
+    }
+
+    t0 = RaXPol_Prof_Start();
+    ahead_stop(seq_p);
+
+    /* Format can change from file to file, so allow for the larger */
+    stride = RaXPol_Ray_Hdr_Sz(0);
+    if ( n > 0 && !(buf = MALLOC(n * stride)) ) {
+	fprintf(stderr, "Could not allocate buffer for %ld ray headers.\n", n);
+	return -1;
+    }
+    fl_p = seq_p->fls + seq_p->f;
+    sparse = step * fl_p->ray_sz > RAXPOL_SEQ_SCAN_GAP;
+    for (k = k0 = 0, r = seq_p->r; k < n && r < seq_p->num_rays;
+	    k++, r += step) {
+	if ( fd == -1 || r >= fl_p->r0 + fl_p->num_rays ) {
+	    if ( !hdrs_decode(fl_p, ray_hdrs + k0, buf + k0 * stride, stride,
+			k - k0) ) {
+		goto error;
+	    }
+	    k0 = k;
+	    while ( r >= fl_p->r0 + fl_p->num_rays ) {
+		fl_p++;
+	    }
+	    if ( sparse ) {
+		if ( fd != -1 ) {
+		    close(fd);
+		}
+		if ( (fd = open(fl_p->nm, O_RDONLY)) == -1 ) {
+		    fprintf(stderr, "Could not open %s for reading.\n%s\n",
+			    fl_p->nm, strerror(errno));
+		    goto error;
+		}
+		(void)posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+	    } else if ( seq_use(seq_p, fl_p - seq_p->fls) ) {
+		fd = fileno(seq_p->in);
+	    } else {
+		goto error;
+	    }
+	}
+	errno = 0;
+	if ( pread(fd, buf + k * stride, RaXPol_Ray_Hdr_Sz(fl_p->old_fmt),
+		    fl_p->o0 + (r - fl_p->r0) * fl_p->ray_sz)
+		!= (ssize_t)RaXPol_Ray_Hdr_Sz(fl_p->old_fmt) ) {
+	    fprintf(stderr, "Could not read header for ray %ld of sequence, "
+		    "ray %ld of %s.\n%s\n", r, r - fl_p->r0, fl_p->nm,
+		    (errno == 0) ? "Short read" : strerror(errno));
+	    goto error;
+	}
+	RaXPol_Prof_Count("bytes_read", RaXPol_Ray_Hdr_Sz(fl_p->old_fmt));
+    }
+    if ( sparse && fd != -1 ) {
+	close(fd);
+	fd = -1;
+    }
+    if ( !hdrs_decode(fl_p, ray_hdrs + k0, buf + k0 * stride, stride,
+		k - k0) ) {
+	goto error;
+    }
+    FREE(buf);
+    RaXPol_Prof_Stop("hdr_scan", t0, k);
+    r = (r < seq_p->num_rays) ? r : seq_p->num_rays;
+    if ( !RaXPol_Seq_Seek(seq_p, r) ) {
+	return -1;
+    }
+    return k;
+
+error:
+    if ( sparse && fd != -1 ) {
+	close(fd);
+    }
+    FREE(buf);
+    seq_p->r = -1;
+    return -1;
+}
+
+/*
+   Decode n raw ray headers from file fl_p, stride bytes apart in buf, into
+   ray_hdrs, and check that their data sizes match the ray size of fl_p.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int hdrs_decode(struct RaXPol_Seq_Fl *fl_p,
+	struct RaXPol_Ray_Hdr *ray_hdrs, char *buf, size_t stride, long n)
+{
+    off_t hdr_sz = RaXPol_Ray_Hdr_Sz(fl_p->old_fmt);
+    long j;
+
+    if ( !RaXPol_Decode_Ray_Hdrs(ray_hdrs, buf, stride, n, fl_p->old_fmt) ) {
+	return 0;
+    }
+    for (j = 0; j < n; j++) {
+	if ( hdr_sz + ray_hdrs[j].data_size != fl_p->ray_sz ) {
+	    fprintf(stderr, "Ray header in %s has data size %d, expected "
+		    "%lld.\n", fl_p->nm, ray_hdrs[j].data_size,
+		    (long long)(fl_p->ray_sz - hdr_sz));
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+   Read the file header and first ray header of RaXPol file in, and fill in
+   sequence member fl_p, which becomes the last file in sequence seq_p. If
+   init is true, this is the first file, and the sequence file header comes
+   from it, and the sequence ray data, if any, is initialized from it.
+   Otherwise, the file must be compatible with the first file. Ray header
+   format and ray size are kept in fl_p, so they can differ from the first
+   file. The format of a compressed file comes from its index, if any.
+   If the file is compressed, z_p must have it, with in == z_p->in,
+   otherwise z_p must be NULL. Position of in is undefined on return.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int fl_scan(struct RaXPol_Seq *seq_p, struct RaXPol_Seq_Fl *fl_p,
+	FILE *in, struct RaXPol_Z *z_p, int init)
+{
+    struct RaXPol_File_Hdr file_hdr;	/* Header from in */
+    struct RaXPol_Ray_Hdr ray_hdr;	/* First ray header from in */
+    off_t o, o1;			/* Offsets in in */
+
+    if ( init && seq_p->dat_p ) {
+	if ( !RaXPol_Init_Data(seq_p->dat_p, in) ) {
+	    fprintf(stderr, "Could not initialize RaXPol data from %s.\n",
+		    fl_p->nm);
+	    return 0;
+	}
+	file_hdr = seq_p->dat_p->file_hdr;
+    } else {
+	RaXPol_Init_File_Hdr(&file_hdr);
+	if ( !RaXPol_Read_File_Hdr(&file_hdr, in) ) {
+	    fprintf(stderr, "Could not read file header from %s.\n",
+		    fl_p->nm);
+	    return 0;
+	}
+    }
+    if ( init ) {
+	seq_p->file_hdr = file_hdr;
+    } else if ( !compat(&seq_p->file_hdr, &file_hdr, fl_p->nm) ) {
+	return 0;
+    }
+    if ( seq_p->old_fmt ) {
+	fl_p->old_fmt = 1;
+    } else if ( z_p ) {
+	fl_p->old_fmt = RaXPol_Z_Old_Fmt(z_p, file_hdr.old_fmt);
+    } else {
+	fl_p->old_fmt = file_hdr.old_fmt;
+    }
+    if ( init ) {
+	seq_p->file_hdr.old_fmt = fl_p->old_fmt;
+	if ( seq_p->dat_p ) {
+	    seq_p->dat_p->file_hdr.old_fmt = fl_p->old_fmt;
+	}
+    }
+    RaXPol_Init_Ray_Hdr(&ray_hdr);
+    if ( z_p ) {
+	fl_p->o0 = z_p->o += RAXPOL_FILE_HDR_SZ;
+	if ( !RaXPol_Read_Ray_Hdr(&ray_hdr, in, fl_p->old_fmt) ) {
+	    fprintf(stderr, "Could not read first ray header from %s.\n",
+		    fl_p->nm);
+	    return 0;
+	}
+	o = z_p->o += RaXPol_Ray_Hdr_Sz(fl_p->old_fmt);
+    } else if ( (fl_p->o0 = ftello(in)) == -1
+	    || !RaXPol_Read_Ray_Hdr(&ray_hdr, in, fl_p->old_fmt)
+	    || (o = ftello(in)) == -1 ) {
+	fprintf(stderr, "Could not read first ray header from %s.\n",
+		fl_p->nm);
+	return 0;
+    }
+    if ( ray_hdr.data_size <= 0 || file_hdr.num_rng_gates <= 0
+	    || ray_hdr.data_size % file_hdr.num_rng_gates != 0 ) {
+	fprintf(stderr, "First ray in %s has data size %d, which does not "
+		"fit %d range gates. The file might have %s ray headers. "
+		"Try%s -l.\n", fl_p->nm, ray_hdr.data_size,
+		file_hdr.num_rng_gates,
+		fl_p->old_fmt ? "current" : "old (2011)",
+		fl_p->old_fmt ? " without" : "");
+	return 0;
+    }
+    fl_p->ray_sz = o - fl_p->o0 + ray_hdr.data_size;
+    if ( !init && ray_hdr.data_size != seq_p->fls[0].ray_sz
+	    - (off_t)RaXPol_Ray_Hdr_Sz(seq_p->fls[0].old_fmt) ) {
+	fprintf(stderr, "Rays in %s have data size %d, expected %lld.\n",
+		fl_p->nm, ray_hdr.data_size, (long long)(seq_p->fls[0].ray_sz
+		    - (off_t)RaXPol_Ray_Hdr_Sz(seq_p->fls[0].old_fmt)));
+	return 0;
+    }
+    if ( z_p ) {
+	if ( !RaXPol_Z_Size(z_p, &o1) ) {
+	    fprintf(stderr, "Could not get size of %s.\n", fl_p->nm);
+	    return 0;
+	}
+    } else if ( fseeko(in, 0, SEEK_END) == -1 || (o1 = ftello(in)) == -1 ) {
+	fprintf(stderr, "Could not position at end of %s.\n%s\n",
+		fl_p->nm, strerror(errno));
+	return 0;
+    }
+    fl_p->tm0 = RaXPol_Ray_Tm(&ray_hdr);
+    fl_p->num_rays = (o1 - fl_p->o0) / fl_p->ray_sz;
+    fl_p->r0 = seq_p->num_rays;
+    seq_p->num_rays += fl_p->num_rays;
+    return 1;
+}
+
+/*
+   Position current file in sequence seq_p at offset o.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int fl_seek(struct RaXPol_Seq *seq_p, off_t o)
+{
+    int status;
+
+    if ( seq_p->z.in ) {
+
+	/* Decompressor might restart with a new stream */
+	status = RaXPol_Z_Seek(&seq_p->z, o);
+	seq_p->in = seq_p->z.in;
+	return status;
+    }
+    return fseeko(seq_p->in, o, SEEK_SET) == 0;
+}
+
+/* Stop reading ahead, and close the current file in sequence seq_p */
+static void fl_close(struct RaXPol_Seq *seq_p)
+{
+    ahead_stop(seq_p);
+    if ( seq_p->z.type != RAXPOL_Z_NONE ) {
+	RaXPol_Z_Close(&seq_p->z);
+    } else if ( seq_p->in && seq_p->in != stdin ) {
+	fclose(seq_p->in);
+    }
+    seq_p->in = NULL;
+}
+
+/*
+   Check that file header fh1_p, from file nm, is compatible with file
+   header fh0_p, from the first file in a sequence.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int compat(struct RaXPol_File_Hdr *fh0_p, struct RaXPol_File_Hdr *fh1_p,
+	char *nm)
+{
+    if ( fh1_p->num_rng_gates != fh0_p->num_rng_gates ) {
+	fprintf(stderr, "%s has %d range gates, expected %d.\n",
+		nm, fh1_p->num_rng_gates, fh0_p->num_rng_gates);
+	return 0;
+    }
+    if ( fh1_p->servmode != fh0_p->servmode
+	    || fh1_p->sumpower != fh0_p->sumpower ) {
+	fprintf(stderr, "%s has server mode %d, sum power %d, expected %d, "
+		"%d.\n", nm, fh1_p->servmode, fh1_p->sumpower,
+		fh0_p->servmode, fh0_p->sumpower);
+	return 0;
+    }
+    if ( fh1_p->pri1 != fh0_p->pri1 || fh1_p->pri2 != fh0_p->pri2 ) {
+	fprintf(stderr, "%s has PRI %d,%d usec, expected %d,%d usec.\n",
+		nm, fh1_p->pri1, fh1_p->pri2, fh0_p->pri1, fh0_p->pri2);
+	return 0;
+    }
+    return 1;
+}
+
+/*
+   Make file f the current file in sequence seq_p, using the file opened by
+   prefetch if there is one. Position of the current file is undefined on
+   return.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int seq_use(struct RaXPol_Seq *seq_p, int f)
+{
+    if ( f == seq_p->f && seq_p->in ) {
+	return 1;
+    }
+    fl_close(seq_p);
+    if ( RaXPol_Z_Type(seq_p->fls[f].nm) != RAXPOL_Z_NONE ) {
+	if ( seq_p->nxt ) {
+	    fclose(seq_p->nxt);
+	    seq_p->nxt = NULL;
+	}
+	if ( !RaXPol_Z_Open(&seq_p->z, seq_p->fls[f].nm) ) {
+	    seq_p->f = -1;
+	    return 0;
+	}
+	seq_p->in = seq_p->z.in;
+    } else if ( f == seq_p->f + 1 && seq_p->nxt ) {
+	seq_p->in = seq_p->nxt;
+	seq_p->nxt = NULL;
+    } else {
+	if ( seq_p->nxt ) {
+	    fclose(seq_p->nxt);
+	    seq_p->nxt = NULL;
+	}
+	if ( !(seq_p->in = fopen(seq_p->fls[f].nm, "r")) ) {
+	    fprintf(stderr, "Could not open %s for reading.\n%s\n",
+		    seq_p->fls[f].nm, strerror(errno));
+	    seq_p->f = -1;
+	    return 0;
+	}
+    }
+    seq_p->f = f;
+    if ( seq_p->dat_p ) {
+	seq_p->dat_p->file_hdr.old_fmt = seq_p->fls[f].old_fmt;
+    }
+    return 1;
+}
+
+/*
+   Make sure the current file in sequence seq_p has the next ray, moving to
+   the start of the following file at a file boundary, and start prefetch
+   of the following file if the end of the current file is near.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int seq_next(struct RaXPol_Seq *seq_p)
+{
+    struct RaXPol_Seq_Fl *fl_p;
+
+    if ( !seq_p->in || seq_p->r < 0 ) {
+	fprintf(stderr, "Sequence is not positioned at a ray.\n");
+	return 0;
+    }
+    while ( seq_p->r >= seq_p->num_rays ) {
+	if ( !seq_p->follow ) {
+	    fprintf(stderr, "Attempted to read past end of sequence of %ld "
+		    "rays.\n", seq_p->num_rays);
+	    return 0;
+	}
+	if ( !seq_grow(seq_p) ) {
+	    return 0;
+	}
+    }
+    fl_p = seq_p->fls + seq_p->f;
+    while ( seq_p->r >= fl_p->r0 + fl_p->num_rays ) {
+
+	/* Noise averages restart at the start of each file */
+	if ( !seq_use(seq_p, seq_p->f + 1) ) {
+	    return 0;
+	}
+	fl_p = seq_p->fls + seq_p->f;
+	if ( seq_p->dat_p ) {
+	    seq_p->dat_p->v_noise_avg = seq_p->dat_p->h_noise_avg = 0.0;
+	}
+	if ( !fl_seek(seq_p, fl_p->o0) ) {
+	    fprintf(stderr, "Could not position at first ray of %s.\n%s\n",
+		    fl_p->nm, strerror(errno));
+	    return 0;
+	}
+    }
+    if ( !seq_p->nxt && seq_p->f + 1 < seq_p->num_fls
+	    && fl_p->r0 + fl_p->num_rays - seq_p->r <= RAXPOL_SEQ_PREFETCH ) {
+	prefetch(seq_p);
+    }
+    return 1;
+}
+
+/*
+   Open the file after the current file in sequence seq_p, and advise the
+   system to read its first rays. Failure is not reported here. If the
+   file cannot be opened, the error is reported when the file is needed.
+ */
+
+static void prefetch(struct RaXPol_Seq *seq_p)
+{
+    struct RaXPol_Seq_Fl *fl_p = seq_p->fls + seq_p->f + 1;
+
+    if ( RaXPol_Z_Type(fl_p->nm) != RAXPOL_Z_NONE
+	    || !(seq_p->nxt = fopen(fl_p->nm, "r")) ) {
+	return;
+    }
+    (void)posix_fadvise(fileno(seq_p->nxt), fl_p->o0,
+	    RAXPOL_SEQ_PREFETCH * fl_p->ray_sz, POSIX_FADV_WILLNEED);
+}
+
+/*
+   Wait for more rays in sequence seq_p, in follow mode. Add complete rays
+   appended to the last file, or, if a new file has appeared, add the rest of
+   the last file and the new file. If there is nothing new, wait until the
+   directory changes or RAXPOL_SEQ_POLL_MS milliseconds pass. Return when
+   there might be more rays. Caller should check seq_p->num_rays.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int seq_grow(struct RaXPol_Seq *seq_p)
+{
+    struct RaXPol_Seq_Fl *fl_p;		/* Last file in sequence */
+    off_t sz;				/* Size of last file */
+    long n;				/* Number of complete rays in fl_p */
+    char *nxt_nm;			/* Name of new file, or NULL */
+    off_t nxt_sz;			/* Size of new file */
+    FILE *in;				/* New file */
+
+    fl_p = seq_p->fls + seq_p->num_fls - 1;
+    if ( !fl_sz(fl_p->nm, &sz) ) {
+	return 0;
+    }
+    n = (sz - fl_p->o0) / fl_p->ray_sz;
+    if ( n > fl_p->num_rays ) {
+	seq_p->num_rays += n - fl_p->num_rays;
+	fl_p->num_rays = n;
+	if ( seq_p->f == seq_p->num_fls - 1 ) {
+	    clearerr(seq_p->in);
+	}
+	return 1;
+    }
+    if ( !next_fl_nm(fl_p->nm, &nxt_nm) ) {
+	return 0;
+    }
+    if ( !nxt_nm || !fl_sz(nxt_nm, &nxt_sz)
+	    || nxt_sz < RAXPOL_FILE_HDR_SZ + (off_t)RaXPol_Ray_Hdr_Sz(0) ) {
+	FREE(nxt_nm);
+	seq_wait(seq_p, fl_p->nm);
+	return 1;
+    }
+
+    /*
+       Processor has moved to a new file, so the last file is complete. Add
+       any rays that arrived since the last check, then the new file.
+     */
+
+    if ( !fl_sz(fl_p->nm, &sz) ) {
+	FREE(nxt_nm);
+	return 0;
+    }
+    n = (sz - fl_p->o0) / fl_p->ray_sz;
+    seq_p->num_rays += n - fl_p->num_rays;
+    fl_p->num_rays = n;
+    if ( (sz - fl_p->o0) % fl_p->ray_sz != 0 ) {
+	fprintf(stderr, "Ignoring partial ray at end of %s.\n", fl_p->nm);
+    }
+    if ( !(fl_p = REALLOC(seq_p->fls,
+		    (seq_p->num_fls + 1) * sizeof(struct RaXPol_Seq_Fl))) ) {
+	fprintf(stderr, "Could not allocate sequence with %d files.\n",
+		seq_p->num_fls + 1);
+	FREE(nxt_nm);
+	return 0;
+    }
+    seq_p->fls = fl_p;
+    fl_p = seq_p->fls + seq_p->num_fls;
+    memset(fl_p, 0, sizeof(struct RaXPol_Seq_Fl));
+    fl_p->nm = nxt_nm;
+    if ( !(in = fopen(fl_p->nm, "r")) ) {
+	fprintf(stderr, "Could not open %s for reading.\n%s\n",
+		fl_p->nm, strerror(errno));
+	FREE(nxt_nm);
+	return 0;
+    }
+    if ( !fl_scan(seq_p, fl_p, in, NULL, 0) ) {
+	fclose(in);
+	FREE(nxt_nm);
+	return 0;
+    }
+    fclose(in);
+    seq_p->num_fls++;
+    return 1;
+}
+
+/*
+   Copy size of file nm to sz_p.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int fl_sz(char *nm, off_t *sz_p)
+{
+    struct stat sb;
+
+    if ( stat(nm, &sb) == -1 ) {
+	fprintf(stderr, "Could not get status of %s.\n%s\n",
+		nm, strerror(errno));
+	return 0;
+    }
+    *sz_p = sb.st_size;
+    return 1;
+}
+
+/*
+   Wait until file nm is big enough to have a file header and the first ray
+   header.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int fl_ready(struct RaXPol_Seq *seq_p, char *nm)
+{
+    off_t sz;
+
+    while ( fl_sz(nm, &sz) ) {
+	if ( sz >= RAXPOL_FILE_HDR_SZ + (off_t)RaXPol_Ray_Hdr_Sz(0) ) {
+	    return 1;
+	}
+	seq_wait(seq_p, nm);
+    }
+    return 0;
+}
+
+/*
+   Look for the file that follows file nm when the signal processor rolls
+   over. This is the first file in the same directory whose name sorts after
+   the name of nm and has the same prefix, up to the first '-', and suffix,
+   from the last '.'. If there is such a file, copy its path, which is
+   allocated and should be freed by the caller, to nxt_p. If there is none,
+   set nxt_p to NULL.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int next_fl_nm(char *nm, char **nxt_p)
+{
+    char *dir;				/* Directory with nm */
+    char *base;				/* Name of nm in dir */
+    size_t pfx_len;			/* Length of prefix of base */
+    char *sfx;				/* Suffix of base */
+    size_t sfx_len;			/* Length of sfx */
+    DIR *dirp;
+    struct dirent *ent;
+    char *best = NULL;			/* Best candidate so far */
+    size_t len;
+
+    *nxt_p = NULL;
+    base = (base = strrchr(nm, '/')) ? base + 1 : nm;
+    pfx_len = strchr(base, '-') ? (size_t)(strchr(base, '-') - base) + 1 : 0;
+    sfx = strrchr(base, '.') ? strrchr(base, '.') : base + strlen(base);
+    sfx_len = strlen(sfx);
+    if ( !(dir = fl_dir(nm)) ) {
+	return 0;
+    }
+    if ( !(dirp = opendir(dir)) ) {
+	fprintf(stderr, "Could not open directory %s.\n%s\n",
+		dir, strerror(errno));
+	FREE(dir);
+	return 0;
+    }
+    while ( (ent = readdir(dirp)) ) {
+	len = strlen(ent->d_name);
+	if ( len >= pfx_len + sfx_len
+		&& strncmp(ent->d_name, base, pfx_len) == 0
+		&& strcmp(ent->d_name + len - sfx_len, sfx) == 0
+		&& strcmp(ent->d_name, base) > 0
+		&& (!best || strcmp(ent->d_name, best) < 0) ) {
+	    FREE(best);
+	    if ( !(best = MALLOC(len + 1)) ) {
+		fprintf(stderr, "Could not allocate file name.\n");
+		closedir(dirp);
+		FREE(dir);
+		return 0;
+	    }
+	    strcpy(best, ent->d_name);
+	}
+    }
+    closedir(dirp);
+    if ( best ) {
+	if ( !(*nxt_p = MALLOC(strlen(dir) + strlen(best) + 2)) ) {
+	    fprintf(stderr, "Could not allocate file name.\n");
+	    FREE(best);
+	    FREE(dir);
+	    return 0;
+	}
+	if ( base == nm ) {
+	    strcpy(*nxt_p, best);
+	} else {
+	    sprintf(*nxt_p, "%s/%s", dir, best);
+	}
+	FREE(best);
+    }
+    FREE(dir);
+    return 1;
+}
+
+/*
+   Return the directory that has file nm, or "." if nm has no '/'. Return
+   value is allocated and should be freed by the caller. Return NULL on
+   failure.
+ */
+
+static char *fl_dir(char *nm)
+{
+    char *dir;
+    char *s;
+    size_t len;
+
+    len = (s = strrchr(nm, '/')) ? (size_t)(s - nm) : 0;
+    if ( !(dir = MALLOC(len + 2)) ) {
+	fprintf(stderr, "Could not allocate directory name for %s.\n", nm);
+	return NULL;
+    }
+    if ( !s ) {
+	strcpy(dir, ".");
+    } else if ( len == 0 ) {
+	strcpy(dir, "/");
+    } else {
+	strncpy(dir, nm, len);
+	dir[len] = '\0';
+    }
+    return dir;
+}
+
+/*
+   Wait for a change in the directory that has file nm, or for
+   RAXPOL_SEQ_POLL_MS milliseconds, whichever comes first. On Linux, the
+   directory is watched with inotify, and the timeout is longer, since it
+   only guards against missed events, e.g. on network file systems.
+ */
+
+static void seq_wait(struct RaXPol_Seq *seq_p, char *nm)
+{
+    struct timespec ts;
+
+#ifdef __linux__
+    if ( seq_p->wfd == -1 ) {
+	char *dir = fl_dir(nm);
+
+	seq_p->wfd = -2;
+	if ( dir ) {
+	    int wfd = inotify_init();
+
+	    if ( wfd != -1 && inotify_add_watch(wfd, dir, IN_MODIFY | IN_CREATE
+			| IN_MOVED_TO | IN_CLOSE_WRITE) != -1 ) {
+		seq_p->wfd = wfd;
+	    } else if ( wfd != -1 ) {
+		close(wfd);
+	    }
+	    FREE(dir);
+	}
+    }
+    if ( seq_p->wfd >= 0 ) {
+	struct pollfd pfd;
+	char buf[4096];
+
+	pfd.fd = seq_p->wfd;
+	pfd.events = POLLIN;
+	if ( poll(&pfd, 1, 4 * RAXPOL_SEQ_POLL_MS) > 0 ) {
+	    if ( read(seq_p->wfd, buf, sizeof(buf)) == -1 ) {
+		close(seq_p->wfd);
+		seq_p->wfd = -2;
+	    }
+	}
+	return;
+    }
+#endif
+    ts.tv_sec = RAXPOL_SEQ_POLL_MS / 1000;
+    ts.tv_nsec = (RAXPOL_SEQ_POLL_MS % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+}
+
+/*
+   Start reading ahead from the next ray in the current file of sequence
+   seq_p. If read ahead is off, the file has no more than one ray left, or
+   the thread cannot start, do nothing, and rays are read from seq_p->in.
+   Starting a thread can only fail for want of resources, so read ahead is
+   turned off for the rest of the sequence in that case, without a message.
+ */
+
+static void ahead_start(struct RaXPol_Seq *seq_p)
+{
+    struct RaXPol_Seq_Fl *fl_p = seq_p->fls + seq_p->f;
+    struct RaXPol_Seq_Ahead *ahd;
+    long r;				/* Index in file of next ray */
+
+    r = seq_p->r - fl_p->r0;
+    if ( seq_p->ahead < 1 || seq_p->z.in || fl_p->num_rays - r < 2 ) {
+	return;
+    }
+    if ( !(ahd = CALLOC(1, sizeof(struct RaXPol_Seq_Ahead))) ) {
+	seq_p->ahead = 0;
+	return;
+    }
+    ahd->fd = fileno(seq_p->in);
+    ahd->o0 = fl_p->o0;
+    ahd->ray_sz = fl_p->ray_sz;
+    ahd->k = seq_p->ahead;
+    if ( ahd->k > fl_p->num_rays - r ) {
+	ahd->k = fl_p->num_rays - r;
+    }
+    ahd->r_rd = ahd->r_use = r;
+    ahd->r_end = fl_p->num_rays;
+    if ( !(ahd->ring = MALLOC(ahd->k * ahd->ray_sz)) ) {
+	FREE(ahd);
+	seq_p->ahead = 0;
+	return;
+    }
+    if ( pthread_mutex_init(&ahd->mtx, NULL) != 0 ) {
+	FREE(ahd->ring);
+	FREE(ahd);
+	seq_p->ahead = 0;
+	return;
+    }
+    if ( pthread_cond_init(&ahd->cnd, NULL) != 0 ) {
+	pthread_mutex_destroy(&ahd->mtx);
+	FREE(ahd->ring);
+	FREE(ahd);
+	seq_p->ahead = 0;
+	return;
+    }
+    if ( pthread_create(&ahd->thr, NULL, ahead_thr, ahd) != 0 ) {
+	pthread_cond_destroy(&ahd->cnd);
+	pthread_mutex_destroy(&ahd->mtx);
+	FREE(ahd->ring);
+	FREE(ahd);
+	seq_p->ahead = 0;
+	return;
+    }
+    seq_p->ahd = ahd;
+}
+
+/*
+   Stop reading ahead in sequence seq_p, if running. Rays already read are
+   discarded. Position of seq_p->in is as it was when read ahead started.
+ */
+
+static void ahead_stop(struct RaXPol_Seq *seq_p)
+{
+    struct RaXPol_Seq_Ahead *ahd = seq_p->ahd;
+
+    if ( !ahd ) {
+	return;
+    }
+    pthread_mutex_lock(&ahd->mtx);
+    ahd->stop = 1;
+    pthread_cond_signal(&ahd->cnd);
+    pthread_mutex_unlock(&ahd->mtx);
+    pthread_join(ahd->thr, NULL);
+    pthread_cond_destroy(&ahd->cnd);
+    pthread_mutex_destroy(&ahd->mtx);
+    FREE(ahd->ring);
+    FREE(ahd);
+    seq_p->ahd = NULL;
+}
+
+/*
+   Read ahead thread. Fill free slots in the ring, several rays per read,
+   until the end of the file, a failure, or a stop request. Reads are limited
+   to a quarter of the ring, so that the caller does not wait long for the
+   first ray. This function must not print, allocate, or profile, since
+   those are not thread safe.
+ */
+
+static void *ahead_thr(void *arg)
+{
+    struct RaXPol_Seq_Ahead *ahd = arg;
+    long r;				/* First ray to read */
+    long s;				/* Slot for ray r */
+    long n;				/* Number of rays to read */
+    char *buf;				/* Where to put data */
+    size_t len;				/* Number of bytes left to read */
+    off_t o;				/* Offset in file to read from */
+    ssize_t c;				/* Return from pread */
+    int err = 0, eof = 0;
+
+    pthread_mutex_lock(&ahd->mtx);
+    while ( !ahd->stop && ahd->r_rd < ahd->r_end ) {
+	if ( ahd->r_rd - ahd->r_use >= ahd->k ) {
+	    pthread_cond_wait(&ahd->cnd, &ahd->mtx);
+	    continue;
+	}
+	r = ahd->r_rd;
+	s = r % ahd->k;
+	n = ahd->r_use + ahd->k - r;
+	if ( n > ahd->k - s ) {
+	    n = ahd->k - s;
+	}
+	if ( n > ahd->r_end - r ) {
+	    n = ahd->r_end - r;
+	}
+	if ( n > (ahd->k + 3) / 4 ) {
+	    n = (ahd->k + 3) / 4;
+	}
+	pthread_mutex_unlock(&ahd->mtx);
+	buf = ahd->ring + s * ahd->ray_sz;
+	len = n * ahd->ray_sz;
+	o = ahd->o0 + r * ahd->ray_sz;
+	while ( len > 0 ) {
+	    c = pread(ahd->fd, buf, len, o);
+	    if ( c == -1 && errno == EINTR ) {
+		continue;
+	    } else if ( c == -1 ) {
+		err = errno;
+		break;
+	    } else if ( c == 0 ) {
+		eof = 1;
+		break;
+	    }
+	    buf += c;
+	    len -= c;
+	    o += c;
+	}
+	pthread_mutex_lock(&ahd->mtx);
+	if ( err || eof ) {
+	    ahd->err = err;
+	    ahd->eof = eof;
+	    break;
+	}
+	ahd->r_rd += n;
+	pthread_cond_signal(&ahd->cnd);
+    }
+    ahd->done = 1;
+    pthread_cond_signal(&ahd->cnd);
+    pthread_mutex_unlock(&ahd->mtx);
+    return NULL;
+}
+
+/*
+   Wait for the read ahead thread in sequence seq_p to read the next ray,
+   and return its address in the ring. Caller must increment r_use when
+   done with the ray, so that the thread can reuse its slot.
+
+   Returns NULL on failure. Prints error messages to stderr on failure.
+ */
+
+static char *ahead_ray(struct RaXPol_Seq *seq_p)
+{
+    struct RaXPol_Seq_Ahead *ahd = seq_p->ahd;
+    struct RaXPol_Seq_Fl *fl_p = seq_p->fls + seq_p->f;
+    long r;				/* Index in file of next ray */
+    int have;				/* If true, thread has read ray r */
+    double t0;
+
+    r = seq_p->r - fl_p->r0;
+    t0 = RaXPol_Prof_Start();
+    pthread_mutex_lock(&ahd->mtx);
+    while ( ahd->r_rd <= r && !ahd->done ) {
+	pthread_cond_wait(&ahd->cnd, &ahd->mtx);
+    }
+    have = ahd->r_rd > r;
+    pthread_mutex_unlock(&ahd->mtx);
+    RaXPol_Prof_Stop("ray_wait", t0, 1);
+    if ( !have ) {
+	fprintf(stderr, "Could not read ray %ld of %s.\n%s\n", r, fl_p->nm,
+		ahd->eof ? "File ended early." : strerror(ahd->err));
+	return NULL;
+    }
+    return ahd->ring + (r % ahd->k) * ahd->ray_sz;
+}
@@ -0,0 +1,164 @@
+/*
+   -	raxpol_seq.h --
+   -		This header file declares structures and functions
+   -		that present an ordered list of RaXPol files as one
+   -		stream of rays.
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+/*
+   A sequence is a list of RaXPol files, given in time order, read as one
+   stream of rays. Rays have global indeces, starting at 0 for the first ray
+   of the first file and continuing across file boundaries.
+
+   All files in a sequence must have the same number of range gates, server
+   mode, sum power setting, and PRI, so that every ray has the same data and
+   moments are computed the same way. Ray header format is detected for each
+   file, so "old" (2011) and current files can be mixed, and ray size is kept
+   for each file. The file header in the sequence is the header from the
+   first file.
+
+   Running noise averages restart at the start of each file, so moments for a
+   ray are the same as moments from the ray's own file read by itself, and
+   ray indeces from raxpol_mk_idx can be used to seek within each file.
+
+   When a read comes within RAXPOL_SEQ_PREFETCH rays of the end of a file,
+   the next file is opened and the system is advised to read its first
+   rays, so that reads across the file boundary do not wait for the disk.
+
+   RaXPol_Seq_Read_Ray reads ahead. While the caller decodes a ray and
+   computes moments from it, a thread reads the rays that follow it in the
+   current file, with pread, into a ring of RAXPOL_SEQ_AHEAD rays, so that
+   input overlaps computation. The thread only reads. Rays are decoded, and
+   noise averages updated, in the calling thread, in order. Environment
+   variable RAXPOL_READ_AHEAD, if set, gives the number of rays in the ring.
+   0 turns read ahead off. There is no read ahead from standard input or in
+   follow mode.
+
+   In follow mode, set with RaXPol_Seq_Follow, a read past the last ray
+   waits for the last file to grow, as it does while the signal processor is
+   still writing it. Only complete rays are read. A partial ray at the end
+   of the file is read when the rest of it arrives. When a new file appears
+   in the same directory, with a name that sorts after the last file and the
+   same prefix, up to the first '-', and suffix, from the last '.', the last
+   file is taken to be complete, and the new file is added to the sequence.
+   On Linux, waits use inotify (7), with polling as a fallback.
+
+   RaXPol_Seq_Read_Rays averages several rays into one, for quick looks. The
+   rays are read and decoded as usual, and their input fields averaged before
+   moments are computed.
+
+   RaXPol_Seq_Scan_Hdrs reads only ray headers, optionally every Nth ray,
+   for programs that need ray times and angles, but not ray data. From
+   regular files, it reads each header at its offset, so ray data does not
+   pass through the page cache.
+
+   Files with names ending in .gz or .zst are read through a decompressor.
+   See raxpol_z.h. Compressed files are not read ahead, since the
+   decompressor already runs alongside the caller, and cannot be followed.
+ */
+
+#ifndef RAXPOL_SEQ_H_
+#define RAXPOL_SEQ_H_
+
+#include "unix_defs.h"
+#include <stdio.h>
+#include <sys/types.h>
+#include "raxpol.h"
+#include "raxpol_z.h"
+
+#define RAXPOL_SEQ_PREFETCH 64
+
+/* Default number of rays to read ahead, and variable that overrides it */
+#define RAXPOL_SEQ_AHEAD 32
+#define RAXPOL_SEQ_AHEAD_ENV "RAXPOL_READ_AHEAD"
+
+/*
+   Distance, in bytes, between ray headers beyond which RaXPol_Seq_Scan_Hdrs
+   reads without read ahead. Closer headers share pages with the ray data
+   between them, and reading whole pages in order is faster.
+ */
+
+#define RAXPOL_SEQ_SCAN_GAP 32768
+
+/* Milliseconds between checks for new rays in follow mode */
+#define RAXPOL_SEQ_POLL_MS 250
+
+struct RaXPol_Seq_Fl {
+    char *nm;				/* Path to file, "-" for stdin.
+					   Allocated. */
+    long r0;				/* Global index of first ray */
+    long num_rays;			/* Number of rays in file */
+    off_t o0;				/* Offset to first ray */
+    off_t ray_sz;			/* Size of one ray, header and data */
+    int old_fmt;			/* If true, rays have "old" (2011)
+					   headers */
+    double tm0;				/* Time of first ray */
+};
+
+struct RaXPol_Seq_Ahead;
+
+struct RaXPol_Seq {
+    struct RaXPol_File_Hdr file_hdr;	/* File header from first file */
+    struct RaXPol_Data *dat_p;		/* Ray data, or NULL if only reading
+					   ray headers */
+    struct RaXPol_Seq_Fl *fls;		/* Files, dimensioned num_fls */
+    int num_fls;			/* Number of files */
+    long num_rays;			/* Number of rays in all files */
+    int f;				/* Index in fls of current file */
+    FILE *in;				/* Current file */
+    struct RaXPol_Z z;			/* Current file, if compressed, in
+					   which case in is z.in */
+    FILE *nxt;				/* File f + 1, if opened early */
+    long r;				/* Global index of next ray */
+    int follow;				/* If true, wait for new rays */
+    int old_fmt;			/* If true, all files have "old"
+					   (2011) ray headers */
+    int wfd;				/* inotify descriptor, -1 if not open,
+					   -2 if not available */
+    long ahead;				/* Number of rays to read ahead,
+					   0 if not reading ahead */
+    struct RaXPol_Seq_Ahead *ahd;	/* Read ahead in current file, or
+					   NULL if not running */
+};
+
+void RaXPol_Seq_Init(struct RaXPol_Seq *);
+int RaXPol_Seq_Open(struct RaXPol_Seq *, char **, int, struct RaXPol_Data *);
+void RaXPol_Seq_Free(struct RaXPol_Seq *);
+void RaXPol_Seq_Follow(struct RaXPol_Seq *);
+void RaXPol_Seq_Old_Fmt(struct RaXPol_Seq *);
+int RaXPol_Seq_Seek(struct RaXPol_Seq *, long);
+long RaXPol_Seq_Tm_Ray(struct RaXPol_Seq *, double, int);
+int RaXPol_Seq_Read_Ray(struct RaXPol_Seq *);
+long RaXPol_Seq_Read_Rays(struct RaXPol_Seq *, long);
+int RaXPol_Seq_Read_Ray_Hdr(struct RaXPol_Seq *, struct RaXPol_Ray_Hdr *);
+long RaXPol_Seq_Scan_Hdrs(struct RaXPol_Seq *, long, struct RaXPol_Ray_Hdr *,
+	long);
+
+#endif
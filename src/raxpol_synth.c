@@ -0,0 +1,817 @@
+/*
+   -	raxpol_synth.c --
+   -		Write a synthetic RaXPol file. See raxpol_synth (1).
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include "raxpol.h"
+#include "raxpol_prof.h"
+
+#define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
+
+/* Maximum number of angles in an angle list */
+#define MAX_ANGLS 64
+
+/* Effective earth radius for 4/3 refraction, km */
+#define REFRAC (4.0 / 3.0 * 6371.0)
+
+/* Speed of light, m/s. Same value raxpol_lib uses */
+#define C_LIGHT 2.9979e8
+
+/* Scan patterns */
+enum PATTERN {PPI, RHI, SECTOR, POINT};
+
+/*
+   A sweep. Pedestal starts at az0, el0 and moves daz, del per ray
+   for num_rays rays.
+ */
+
+struct Sweep {
+    double az0, el0;			/* Start angles, degrees */
+    double daz, del;			/* Increment per ray, degrees */
+    int num_rays;
+};
+
+/*
+   A storm cell. Reflectivity falls off with square of distance from the
+   center, and by 10 dB per km above top. If vmax is nonzero, cell has a
+   Rankine vortex of radius vr.
+ */
+
+struct Cell {
+    double x, y;			/* Center at time 0, km east, north
+					   of radar */
+    double radius;			/* km */
+    double dbz_max;
+    double top;				/* Echo top, km above radar */
+    double vmax, vr;			/* Vortex tangential speed, m/s,
+					   and core radius, km */
+};
+
+static struct Cell cells[] = {
+    {15.0, 20.0, 4.0, 60.0, 12.0, 30.0, 1.5},
+    {-25.0, 10.0, 6.0, 45.0, 8.0, 0.0, 0.0},
+    {5.0, -30.0, 3.0, 50.0, 10.0, 0.0, 0.0}
+};
+#define NUM_CELLS (sizeof(cells) / sizeof(cells[0]))
+
+/* Storm motion, m/s toward east and north */
+#define STORM_U 8.0
+#define STORM_V 5.0
+
+/* Melting layer bottom and top, km above radar */
+#define ML_BOT 3.5
+#define ML_TOP 4.5
+
+static char *argv0;			/* Name of the executable */
+
+/* Random number state. See rnd_unif */
+static unsigned long long rnd_state = 88172645463325252ULL;
+
+/* Local functions */
+static int parse_angls(char *, double *);
+static double rnd_unif(void);
+static double rnd_gauss(void);
+static double model_dbz(double, double, double, double);
+static double model_vel(double, double, double, double, double, double);
+static void nmea_gga(char *, size_t, double, double, double, double);
+static void synth_ray(struct RaXPol_Data *, double, double, double, double,
+	double);
+
+int main(int argc, char *argv[])
+{
+    extern char *optarg;		/* See getopt (3) */
+    extern int optind, optopt;		/* See getopt (3) */
+    int c;				/* Index into argv */
+    char *usage = "Usage: %s [-l] [-m servmode] [-p ppi|rhi|sector|point] "
+	"[-a angles] [-e angles] [-w step] [-g num_gates] [-d gate_spacing] "
+	"[-n num_rays] [-v num_vols] [-t start] [-i interval] "
+	"[-x lon,lat,alt[,hdg]] [-s seed] raxpol_file\n";
+    char *mode_s = "DPP";		/* Server mode */
+    char *pattern_s = "ppi";		/* Scan pattern */
+    enum PATTERN pattern;
+    char *az_s = NULL, *el_s = NULL;	/* Angle lists from command line */
+    double az[MAX_ANGLS], el[MAX_ANGLS];/* Angles from az_s, el_s */
+    int num_az, num_el;			/* Number of angles in az, el */
+    double step = 1.0;			/* Angular increment per ray */
+    int num_gates = 1000;
+    double gate_spacing = 30.0;		/* Meters */
+    long num_rays = -1;			/* Number of rays to write */
+    int num_vols = 1;			/* Number of volumes to write */
+    char *start_s = "20160524-230000";	/* Time of first ray */
+    double tm0;				/* Time of first ray, sec since epoch */
+    double intvl = 0.05;		/* Time between rays, seconds */
+    double lon = -97.4377, lat = 35.1811;/* Radar location, degrees */
+    double alt = 360.0;			/* Radar altitude, meters */
+    double hdg = 0.0;			/* Truck heading, degrees */
+    unsigned long seed = 1;
+    int old_fmt = 0;			/* If true, write "old" (2011) ray
+					   headers */
+    char *out_fl_nm;			/* Output file name */
+    FILE *out;				/* Output stream */
+    off_t o, sz;			/* Output size, actual and expected */
+    struct RaXPol_File_Hdr fh;
+    struct RaXPol_Data dat;
+    struct Sweep *swps;			/* Sweeps in one volume */
+    int num_swps;			/* Number of sweeps in a volume */
+    int s;				/* Sweep index */
+    long r, r_swp;			/* Ray indeces in file and sweep */
+    int v;				/* Volume index */
+    double tm;				/* Ray time */
+    double dir;				/* Direction of sweep, +1 or -1 */
+    double az_r, el_r;			/* Ray azimuth (geographic), elevation */
+    char *mode_nms[] = {"SPP", "SPP_SUM_PWR", "DPP", "DPP_SUM_PWR"};
+    int m;
+
+    argv0 = argv[0];
+    RaXPol_Prof_Init(argv0);
+    if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
+	old_fmt = 1;
+    }
+    while ((c = getopt(argc, argv, ":lm:p:a:e:w:g:d:n:v:t:i:x:s:")) != -1) {
+	switch(c) {
+	    case 'l':
+		old_fmt = 1;
+		break;
+	    case 'm':
+		mode_s = optarg;
+		break;
+	    case 'p':
+		pattern_s = optarg;
+		break;
+	    case 'a':
+		az_s = optarg;
+		break;
+	    case 'e':
+		el_s = optarg;
+		break;
+	    case 'w':
+		if ( sscanf(optarg, "%lf", &step) != 1 || !(step > 0.0) ) {
+		    fprintf(stderr, "%s: expected positive angular step, "
+			    "got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'g':
+		if ( sscanf(optarg, "%d", &num_gates) != 1 || num_gates < 10 ) {
+		    fprintf(stderr, "%s: expected at least 10 gates, got %s\n",
+			    argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'd':
+		if ( sscanf(optarg, "%lf", &gate_spacing) != 1
+			|| !(gate_spacing > 0.0) ) {
+		    fprintf(stderr, "%s: expected positive gate spacing, "
+			    "got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'n':
+		if ( sscanf(optarg, "%ld", &num_rays) != 1 || num_rays < 1 ) {
+		    fprintf(stderr, "%s: expected positive ray count, got %s\n",
+			    argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'v':
+		if ( sscanf(optarg, "%d", &num_vols) != 1 || num_vols < 1 ) {
+		    fprintf(stderr, "%s: expected positive volume count, "
+			    "got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 't':
+		start_s = optarg;
+		break;
+	    case 'i':
+		if ( sscanf(optarg, "%lf", &intvl) != 1 || !(intvl > 0.0) ) {
+		    fprintf(stderr, "%s: expected positive ray interval, "
+			    "got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'x':
+		if ( sscanf(optarg, "%lf,%lf,%lf,%lf", &lon, &lat, &alt, &hdg)
+			< 3 ) {
+		    fprintf(stderr, "%s: expected lon,lat,alt[,hdg] for radar "
+			    "location, got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 's':
+		if ( sscanf(optarg, "%lu", &seed) != 1 ) {
+		    fprintf(stderr, "%s: expected integer seed, got %s\n",
+			    argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case '?':
+		fprintf(stderr, "%s: unknown option \"-%c\"\n", argv0, optopt);
+		fprintf(stderr, usage, argv0);
+		exit(EXIT_FAILURE);
+		break;
+	    case ':':
+		fprintf(stderr, "%s: \"-%c\" requires an argument\n",
+			argv0, optopt);
+		fprintf(stderr, usage, argv0);
+		exit(EXIT_FAILURE);
+		break;
+	}
+    }
+    if ( optind != argc - 1 ) {
+	fprintf(stderr, usage, argv0);
+	exit(EXIT_FAILURE);
+    }
+    out_fl_nm = argv[optind];
+    if ( !RaXPol_Scan_Tm(start_s, &tm0) ) {
+	fprintf(stderr, "%s: could not get start time.\n", argv0);
+	exit(EXIT_FAILURE);
+    }
+    rnd_state ^= seed * 2654435761ULL;
+    if ( rnd_state == 0 ) {
+	rnd_state = 88172645463325252ULL;
+    }
+
+    /* Set default angles for the scan pattern and make the sweep list */
+    if ( strcmp(pattern_s, "ppi") == 0 ) {
+	pattern = PPI;
+	az_s = az_s ? az_s : "0";
+	el_s = el_s ? el_s : "0.5,1.5,2.5,3.5,4.5";
+    } else if ( strcmp(pattern_s, "rhi") == 0 ) {
+	pattern = RHI;
+	az_s = az_s ? az_s : "30,40,50";
+	el_s = el_s ? el_s : "0,60";
+    } else if ( strcmp(pattern_s, "sector") == 0 ) {
+	pattern = SECTOR;
+	az_s = az_s ? az_s : "0,90";
+	el_s = el_s ? el_s : "0.5,1.5,2.5,3.5,4.5";
+    } else if ( strcmp(pattern_s, "point") == 0 ) {
+	pattern = POINT;
+	az_s = az_s ? az_s : "37";
+	el_s = el_s ? el_s : "2";
+    } else {
+	fprintf(stderr, "%s: unknown scan pattern %s. Must be ppi, rhi, "
+		"sector, or point.\n", argv0, pattern_s);
+	exit(EXIT_FAILURE);
+    }
+    if ( (num_az = parse_angls(az_s, az)) == 0
+	    || (num_el = parse_angls(el_s, el)) == 0 ) {
+	fprintf(stderr, "%s: could not read scan angles.\n", argv0);
+	exit(EXIT_FAILURE);
+    }
+    if ( !(swps = calloc(MAX_ANGLS, sizeof(struct Sweep))) ) {
+	fprintf(stderr, "%s: could not allocate sweep list.\n", argv0);
+	exit(EXIT_FAILURE);
+    }
+    switch (pattern) {
+	case PPI:
+	    for (s = 0; s < num_el; s++) {
+		swps[s].az0 = az[0];
+		swps[s].el0 = el[s];
+		swps[s].daz = step;
+		swps[s].del = 0.0;
+		swps[s].num_rays = floor(360.0 / step + 0.5);
+	    }
+	    num_swps = num_el;
+	    break;
+	case RHI:
+	    if ( num_el != 2 || !(el[1] > el[0]) ) {
+		fprintf(stderr, "%s: RHI needs -e el0,el1 with el0 < el1.\n",
+			argv0);
+		exit(EXIT_FAILURE);
+	    }
+	    for (s = 0, dir = 1.0; s < num_az; s++, dir = -dir) {
+		swps[s].az0 = az[s];
+		swps[s].el0 = (dir > 0.0) ? el[0] : el[1];
+		swps[s].daz = 0.0;
+		swps[s].del = dir * step;
+		swps[s].num_rays = floor((el[1] - el[0]) / step + 0.5) + 1;
+	    }
+	    num_swps = num_az;
+	    break;
+	case SECTOR:
+	    if ( num_az != 2 ) {
+		fprintf(stderr, "%s: sector scan needs -a az0,az1.\n", argv0);
+		exit(EXIT_FAILURE);
+	    }
+	    for (s = 0, dir = 1.0; s < num_el; s++, dir = -dir) {
+		double span = fmod(az[1] - az[0] + 720.0, 360.0);
+
+		swps[s].az0 = (dir > 0.0) ? az[0] : az[0] + span;
+		swps[s].el0 = el[s];
+		swps[s].daz = dir * step;
+		swps[s].del = 0.0;
+		swps[s].num_rays = floor(span / step + 0.5) + 1;
+	    }
+	    num_swps = num_el;
+	    break;
+	case POINT:
+	    swps[0].az0 = az[0];
+	    swps[0].el0 = el[0];
+	    swps[0].daz = swps[0].del = 0.0;
+	    swps[0].num_rays = 360;
+	    num_swps = 1;
+	    break;
+    }
+    if ( num_rays == -1 ) {
+	for (num_rays = 0, s = 0; s < num_swps; s++) {
+	    num_rays += swps[s].num_rays;
+	}
+	num_rays *= num_vols;
+    }
+
+    /* File header */
+    memset(&fh, 0, sizeof(fh));
+    fh.old_fmt = old_fmt;
+    for (m = 0; m < 4 && strcmp(mode_s, mode_nms[m]) != 0; m++) {
+    }
+    if ( m == 4 ) {
+	fprintf(stderr, "%s: unknown server mode %s. Must be SPP, SPP_SUM_PWR, "
+		"DPP, or DPP_SUM_PWR.\n", argv0, mode_s);
+	exit(EXIT_FAILURE);
+    }
+    fh.servmode = (m < 2) ? 0 : 1;
+    fh.sumpower = (m == 1 || m == 3);
+    fh.version_code = 1;
+    fh.clutter_avg_intvl = 32;
+    fh.data_rate = 1.0 / intvl;
+    fh.fft_length = 64;
+    fh.H_dBZ_dBm_offset = 68.8;
+    fh.H_noise_power = -90.0;
+    fh.integration_time = intvl;
+    fh.max_sampled_range = num_gates * gate_spacing;
+    fh.num_rng_gates = num_gates;
+    fh.number_group_pulses = 32;
+    fh.post_decimation_level = 1;
+    fh.post_averaging_interval = 2;
+    fh.pri1 = 500;
+    fh.pri2 = (fh.servmode == 1) ? 600 : 500;
+    fh.pri_total = (fh.servmode == 1) ? fh.pri1 + fh.pri2 : fh.pri1;
+    fh.pulse_compression = 0;
+    fh.range_gate_spacing = gate_spacing;
+    fh.range_resolution = gate_spacing;
+    fh.recording_enabled = 1;
+    fh.record_raw = 1;
+    fh.total_avg_intvl = fh.number_group_pulses * fh.post_averaging_interval;
+    fh.unambiguous_range = 0.5 * C_LIGHT * fh.pri1 * 1.0e-6;
+    fh.V_dBZ_dBm_offset = 68.8;
+    fh.v_noise_dBm = -90.0;
+    fh.zero_range_gate_index = 2.5;
+    switch (pattern) {
+	case PPI:
+	    fh.scan_type = (num_swps > 1) ? RAXPOL_VOL : RAXPOL_PPI;
+	    break;
+	case RHI:
+	    fh.scan_type = RAXPOL_RHI;
+	    break;
+	case SECTOR:
+	    fh.scan_type = RAXPOL_AZ_RASTER;
+	    break;
+	case POINT:
+	    fh.scan_type = RAXPOL_POINT;
+	    break;
+    }
+    fh.num_sweeps = num_swps;
+    fh.timestamp_sec = floor(tm0);
+    fh.timestamp_usec = 0;
+    if ( !RaXPol_Init_Data_Hdr(&dat, &fh) ) {
+	fprintf(stderr, "%s: could not initialize ray data.\n", argv0);
+	exit(EXIT_FAILURE);
+    }
+
+    /* Constant ray header members */
+    memset(&dat.ray_hdr, 0, sizeof(dat.ray_hdr));
+    dat.ray_hdr.radar_temperatures[0] = 35;
+    dat.ray_hdr.radar_temperatures[1] = 37;
+    dat.ray_hdr.radar_temperatures[2] = 34;
+    dat.ray_hdr.radar_temperatures[3] = 41;
+    dat.ray_hdr.fuel_sensor = 80;
+    dat.ray_hdr.cpu_temperature = 48.0;
+    dat.ray_hdr.tx_power = 38.5;
+    dat.ray_hdr.osc_lock = 1;
+    dat.ray_hdr.az_current = 0.6;
+    dat.ray_hdr.elev_current = 0.3;
+    dat.ray_hdr.lat_ref = (lat >= 0.0) ? 'N' : 'S';
+    dat.ray_hdr.lat = fabs(lat);
+    dat.ray_hdr.lon_ref = (lon >= 0.0) ? 'E' : 'W';
+    dat.ray_hdr.lon = fabs(lon);
+    dat.ray_hdr.alt = alt;
+    dat.ray_hdr.hdg_ref = 'T';
+    dat.ray_hdr.hdg = hdg;
+    switch (pattern) {
+	case PPI:
+	    dat.ray_hdr.pedestal_scan_type = RAXPOL_PPI;
+	    break;
+	case RHI:
+	    dat.ray_hdr.pedestal_scan_type = RAXPOL_RHI;
+	    break;
+	case SECTOR:
+	    dat.ray_hdr.pedestal_scan_type = RAXPOL_AZ_RASTER;
+	    break;
+	case POINT:
+	    dat.ray_hdr.pedestal_scan_type = RAXPOL_POINT;
+	    break;
+    }
+
+    if ( strcmp(out_fl_nm, "-") == 0 ) {
+	out = stdout;
+    } else if ( !(out = fopen(out_fl_nm, "w")) ) {
+	fprintf(stderr, "%s: could not open %s for writing.\n",
+		argv0, out_fl_nm);
+	exit(EXIT_FAILURE);
+    }
+    if ( !RaXPol_Write_File_Hdr(&fh, out) ) {
+	fprintf(stderr, "%s: could not write file header to %s.\n",
+		argv0, out_fl_nm);
+	exit(EXIT_FAILURE);
+    }
+    for (r = 0, v = 0; r < num_rays; v++) {
+	for (s = 0; s < num_swps && r < num_rays; s++) {
+	    for (r_swp = 0; r_swp < swps[s].num_rays && r < num_rays;
+		    r_swp++, r++) {
+		tm = tm0 + r * intvl;
+		az_r = fmod(swps[s].az0 + r_swp * swps[s].daz + 720.0, 360.0);
+		el_r = swps[s].el0 + r_swp * swps[s].del + 0.02 * rnd_gauss();
+		dat.ray_hdr.timestamp_seconds = floor(tm);
+		dat.ray_hdr.timestamp_useconds
+		    = floor((tm - floor(tm)) * 1.0e6 + 0.5);
+		dat.ray_hdr.utc_time_sec = dat.ray_hdr.timestamp_seconds;
+		dat.ray_hdr.utc_time_usec = dat.ray_hdr.timestamp_useconds;
+		dat.ray_hdr.inclinometer_roll = floor(10.0 * rnd_gauss());
+		dat.ray_hdr.inclinometer_pitch = floor(10.0 * rnd_gauss());
+
+		/* Pedestal azimuth is relative to the back of the truck */
+		dat.ray_hdr.az = fmod(az_r - hdg - 180.0 + 720.0, 360.0);
+		dat.ray_hdr.el = el_r;
+		dat.ray_hdr.az_vel = swps[s].daz / intvl;
+		dat.ray_hdr.elev_vel = swps[s].del / intvl;
+		dat.ray_hdr.sweep_count = v * num_swps + s;
+		dat.ray_hdr.volume_count = v;
+		nmea_gga(dat.ray_hdr.nmea_msg_gpgga,
+			sizeof(dat.ray_hdr.nmea_msg_gpgga), tm, lon, lat, alt);
+		synth_ray(&dat, tm - tm0, az_r, el_r, 0.001 * alt,
+			0.001 * gate_spacing);
+		if ( !RaXPol_Write_Ray(&dat, out) ) {
+		    fprintf(stderr, "%s: could not write ray %ld to %s.\n",
+			    argv0, r, out_fl_nm);
+		    exit(EXIT_FAILURE);
+		}
+	    }
+	}
+    }
+
+    /* Check that rays have the requested ray header format */
+    sz = RAXPOL_FILE_HDR_SZ
+	+ num_rays * (off_t)(RaXPol_Ray_Hdr_Sz(old_fmt)
+		+ dat.ray_hdr.data_size);
+    if ( (o = ftello(out)) != -1 && o != sz ) {
+	fprintf(stderr, "%s: wrote %lld bytes to %s, expected %lld.\n",
+		argv0, (long long)o, out_fl_nm, (long long)sz);
+	exit(EXIT_FAILURE);
+    }
+    if ( fclose(out) == EOF ) {
+	fprintf(stderr, "%s: could not close %s.\n", argv0, out_fl_nm);
+	exit(EXIT_FAILURE);
+    }
+    RaXPol_Free_Data(&dat);
+    free(swps);
+    return EXIT_SUCCESS;
+}
+
+/*
+   Fill input fields in dat_p for a ray at time t seconds after the first ray,
+   pointing at geographic azimuth az and elevation el, degrees, from a radar at
+   alt km. Gate spacing is dr km. Power noise is set from the file header.
+ */
+
+static void synth_ray(struct RaXPol_Data *dat_p, double t, double az,
+	double el, double alt, double dr)
+{
+    struct RaXPol_File_Hdr *fh_p = &dat_p->file_hdr;
+    int num_gates = fh_p->num_rng_gates;
+    double l = C_LIGHT / RAXPOL_FREQUENCY;/* Wavelength, m */
+    double t1 = 1.0e-6 * fh_p->pri1;	/* Pulse repetition intervals, s */
+    double t2 = 1.0e-6 * fh_p->pri2;
+    double rres = fh_p->range_resolution;
+    double cal = dat_p->cal_hh_val;
+    double h_noise = pow(10.0, 0.1 * fh_p->H_noise_power);
+    double v_noise = pow(10.0, 0.1 * fh_p->v_noise_dBm);
+    double sd;				/* Relative standard deviation of
+					   power estimates */
+    double sin_az = sin(az * M_PI / 180.0), cos_az = cos(az * M_PI / 180.0);
+    double sin_el = sin(el * M_PI / 180.0), cos_el = cos(el * M_PI / 180.0);
+    double phidp = -20.0;		/* Differential phase, degrees. Starts
+					   at system phase, accumulates Kdp */
+    int g;
+
+    sd = 1.0 / sqrt(fh_p->number_group_pulses * fh_p->post_averaging_interval);
+    if ( fh_p->sumpower ) {
+	sd /= sqrt(2.0);
+    }
+    for (g = 0; g < num_gates; g++) {
+	double r;			/* Range, km */
+	double x, y, h;			/* Gate location, km */
+	double dbz, zdr, rhohv, vel;	/* Model values */
+	double s_h, s_v;		/* Signal power, mW */
+	double f;			/* Signal fluctuation */
+	double rho1, rho2;		/* Spectral correlation at lags */
+	double sw = 2.0;		/* Spectrum width, m/s */
+	double ph1, ph2;		/* Pulse pair phase at lags */
+	float zh[3], zv[3];		/* Power samples */
+	float _Complex pp_h1, pp_h2, pp_v1, pp_v2, cc;
+	int n;
+
+	r = dr * (g - fh_p->zero_range_gate_index);
+	r = (r < 1.0e-1) ? 1.0e-1 : r;
+	x = r * cos_el * sin_az;
+	y = r * cos_el * cos_az;
+	h = sqrt(r * r + REFRAC * REFRAC + 2.0 * r * REFRAC * sin_el)
+	    - REFRAC + alt;
+
+	/* Reflectivity and polarimetric variables. Keep the first gates
+	   clear, as raxpol_lib estimates noise from them. */
+	dbz = (g < 12) ? -INFINITY : model_dbz(x, y, h, t);
+	if ( h < ML_BOT ) {
+	    zdr = 0.2 + 3.0 * (dbz - 20.0) / 40.0;
+	    zdr = (zdr < 0.0) ? 0.0 : (zdr > 4.0) ? 4.0 : zdr;
+	    rhohv = 0.985;
+	} else if ( h < ML_TOP ) {
+	    zdr = 1.0;
+	    rhohv = 0.93;
+	} else {
+	    zdr = 0.2;
+	    rhohv = 0.99;
+	}
+	rhohv -= 0.01 * fabs(rnd_gauss());
+	if ( h < ML_BOT && dbz > 20.0 ) {
+	    phidp += 2.0 * 1.5 * pow(10.0, (dbz - 50.0) / 15.0) * dr;
+	}
+	vel = model_vel(x, y, h, t, sin_az * cos_el, cos_az * cos_el)
+	    + 1.0 * rnd_gauss();
+
+	/* Signal power, from the raxpol_lib dbz formula */
+	s_h = pow(10.0, 0.1 * (dbz - 20.0 * log10(r) + 10.0 * log10(rres) - cal));
+	s_v = s_h * pow(10.0, -0.1 * zdr);
+
+	/* Signal fluctuates together in both channels. Noise does not. */
+	f = 1.0 + sd * rnd_gauss();
+	f = (f > 0.1) ? f : 0.1;
+	s_h *= f;
+	s_v *= f;
+	for (n = 0; n < 3; n++) {
+	    zh[n] = s_h * (1.0 + 0.2 * sd * rnd_gauss())
+		+ h_noise * (1.0 + sd * rnd_gauss());
+	    zh[n] = (zh[n] > 0.0) ? zh[n] : 0.01 * h_noise;
+	    zv[n] = s_v * (1.0 + 0.2 * sd * rnd_gauss())
+		+ v_noise * (1.0 + sd * rnd_gauss());
+	    zv[n] = (zv[n] > 0.0) ? zv[n] : 0.01 * v_noise;
+	}
+
+	/*
+	   Pulse pairs. raxpol_lib takes SPP velocity from the negative phase
+	   of the pulse pair at pri1, and DPP velocity from the phase of
+	   pp1 * conj(pp2), so DPP pulse pairs have positive phase.
+	 */
+
+	rho1 = exp(-8.0 * pow(M_PI * sw * t1 / l, 2.0));
+	rho2 = exp(-8.0 * pow(M_PI * sw * t2 / l, 2.0));
+	ph1 = 4.0 * M_PI * vel * t1 / l;
+	ph2 = 4.0 * M_PI * vel * t2 / l;
+	if ( fh_p->servmode == 0 ) {
+	    ph1 = -ph1;
+	}
+	pp_h1 = s_h * rho1 * cexp(I * ph1)
+	    + sd * h_noise * (rnd_gauss() + I * rnd_gauss());
+	pp_v1 = s_v * rho1 * cexp(I * ph1)
+	    + sd * v_noise * (rnd_gauss() + I * rnd_gauss());
+	pp_h2 = s_h * rho2 * cexp(I * ph2)
+	    + sd * h_noise * (rnd_gauss() + I * rnd_gauss());
+	pp_v2 = s_v * rho2 * cexp(I * ph2)
+	    + sd * v_noise * (rnd_gauss() + I * rnd_gauss());
+	cc = rhohv * sqrt(s_h * s_v) * cexp(-I * phidp * M_PI / 180.0)
+	    + sd * sqrt(h_noise * v_noise) * (rnd_gauss() + I * rnd_gauss());
+
+	switch (dat_p->servmode) {
+	    case RAXPOL_SPP:
+		dat_p->dat_in.spp.zv1[g] = zv[0];
+		dat_p->dat_in.spp.zv2[g] = zv[1];
+		dat_p->dat_in.spp.zh1[g] = zh[0];
+		dat_p->dat_in.spp.zh2[g] = zh[1];
+		dat_p->dat_in.spp.pp_v[g] = pp_v1;
+		dat_p->dat_in.spp.pp_h[g] = pp_h1;
+		dat_p->dat_in.spp.cc[g] = cc;
+		break;
+	    case RAXPOL_SPP_SUM_PWR:
+		dat_p->dat_in.spp_sum_pwr.zv[g] = zv[0];
+		dat_p->dat_in.spp_sum_pwr.zh[g] = zh[0];
+		dat_p->dat_in.spp_sum_pwr.pp_v[g] = pp_v1;
+		dat_p->dat_in.spp_sum_pwr.pp_h[g] = pp_h1;
+		dat_p->dat_in.spp_sum_pwr.cc[g] = cc;
+		break;
+	    case RAXPOL_DPP:
+		dat_p->dat_in.dpp.zv1[g] = zv[0];
+		dat_p->dat_in.dpp.zv2[g] = zv[1];
+		dat_p->dat_in.dpp.zv3[g] = zv[2];
+		dat_p->dat_in.dpp.zh1[g] = zh[0];
+		dat_p->dat_in.dpp.zh2[g] = zh[1];
+		dat_p->dat_in.dpp.zh3[g] = zh[2];
+		dat_p->dat_in.dpp.pp_v1[g] = pp_v1;
+		dat_p->dat_in.dpp.pp_v2[g] = pp_v2;
+		dat_p->dat_in.dpp.pp_h1[g] = pp_h1;
+		dat_p->dat_in.dpp.pp_h2[g] = pp_h2;
+		dat_p->dat_in.dpp.cc[g] = cc;
+		break;
+	    case RAXPOL_DPP_SUM_PWR:
+		dat_p->dat_in.dpp_sum_pwr.zv[g] = zv[0];
+		dat_p->dat_in.dpp_sum_pwr.zh[g] = zh[0];
+		dat_p->dat_in.dpp_sum_pwr.pp_v1[g] = pp_v1;
+		dat_p->dat_in.dpp_sum_pwr.pp_v2[g] = pp_v2;
+		dat_p->dat_in.dpp_sum_pwr.pp_h1[g] = pp_h1;
+		dat_p->dat_in.dpp_sum_pwr.pp_h2[g] = pp_h2;
+		dat_p->dat_in.dpp_sum_pwr.cc[g] = cc;
+		break;
+	    default:
+		break;
+	}
+    }
+}
+
+/*
+   Return model reflectivity, dBZ, at x, y km east and north of radar, h km
+   above radar, t seconds after start. This is the linear sum of the storm
+   cells, which move with the storm motion, and light stratiform rain.
+ */
+
+static double model_dbz(double x, double y, double h, double t)
+{
+    double z;				/* Reflectivity, mm^6/m^3 */
+    double dbz;
+    size_t c;
+
+    /* Stratiform rain, 7 to 23 dBZ, to 5 km */
+    dbz = 15.0 + 8.0 * sin(x / 7.0) * cos(y / 9.0);
+    if ( h > 5.0 ) {
+	dbz -= 10.0 * (h - 5.0);
+    }
+    z = pow(10.0, 0.1 * dbz);
+    for (c = 0; c < NUM_CELLS; c++) {
+	double dx = x - (cells[c].x + 0.001 * STORM_U * t);
+	double dy = y - (cells[c].y + 0.001 * STORM_V * t);
+	double d2 = (dx * dx + dy * dy) / (cells[c].radius * cells[c].radius);
+
+	if ( d2 > 9.0 ) {
+	    continue;
+	}
+	dbz = cells[c].dbz_max - 25.0 * d2;
+	if ( h > cells[c].top ) {
+	    dbz -= 10.0 * (h - cells[c].top);
+	}
+	z += pow(10.0, 0.1 * dbz);
+    }
+    return 10.0 * log10(z);
+}
+
+/*
+   Return model radial velocity, m/s, at x, y km east and north of radar,
+   h km above radar, t seconds after start. ux and uy are the east and north
+   components of the unit vector along the beam. The wind veers and increases
+   with height. Cells with vortices add tangential (cyclonic) wind.
+ */
+
+static double model_vel(double x, double y, double h, double t, double ux,
+	double uy)
+{
+    double u, v;			/* Wind, m/s toward east, north */
+    size_t c;
+
+    u = 5.0 + 2.0 * h;
+    v = 10.0 + 0.5 * h;
+    for (c = 0; c < NUM_CELLS; c++) {
+	double dx, dy, d, vt;
+
+	if ( cells[c].vmax == 0.0 || h > cells[c].top ) {
+	    continue;
+	}
+	dx = x - (cells[c].x + 0.001 * STORM_U * t);
+	dy = y - (cells[c].y + 0.001 * STORM_V * t);
+	d = sqrt(dx * dx + dy * dy);
+	if ( d < 1.0e-3 ) {
+	    continue;
+	}
+	vt = (d < cells[c].vr) ? cells[c].vmax * d / cells[c].vr
+	    : cells[c].vmax * cells[c].vr / d;
+	u += -vt * dy / d;
+	v += vt * dx / d;
+    }
+    return u * ux + v * uy;
+}
+
+/* Copy a GPGGA sentence for time tm and location lon, lat, alt to buf. */
+
+static void nmea_gga(char *buf, size_t sz, double tm, double lon, double lat,
+	double alt)
+{
+    double sec_of_day = fmod(tm, 86400.0);
+    int hr = sec_of_day / 3600;
+    int min = (sec_of_day - hr * 3600) / 60;
+    double sec = sec_of_day - hr * 3600 - min * 60;
+    double lat_a = fabs(lat), lon_a = fabs(lon);
+    unsigned char cs = 0;		/* Checksum */
+    char *c;
+    int n;
+
+    n = snprintf(buf, sz, "$GPGGA,%02d%02d%05.2f,%02d%07.4f,%c,"
+	    "%03d%07.4f,%c,1,08,0.9,%.1f,M,,M,,",
+	    hr, min, sec,
+	    (int)lat_a, 60.0 * (lat_a - floor(lat_a)), (lat >= 0.0) ? 'N' : 'S',
+	    (int)lon_a, 60.0 * (lon_a - floor(lon_a)), (lon >= 0.0) ? 'E' : 'W',
+	    alt);
+    if ( n < 0 || (size_t)n + 4 >= sz ) {
+	return;
+    }
+    for (c = buf + 1; *c; c++) {
+	cs ^= *c;
+    }
+    snprintf(buf + n, sz - n, "*%02X", cs);
+}
+
+/*
+   Read comma separated list of angles from s into angls, which must have
+   space for MAX_ANGLS values. Return number of angles, or 0 on failure.
+ */
+
+static int parse_angls(char *s, double *angls)
+{
+    int n;
+    char *c, *e;
+
+    for (n = 0, c = s; n < MAX_ANGLS; n++) {
+	angls[n] = strtod(c, &e);
+	if ( e == c ) {
+	    fprintf(stderr, "%s: expected angle at %s\n", argv0, c);
+	    return 0;
+	}
+	if ( *e == '\0' ) {
+	    return n + 1;
+	}
+	if ( *e != ',' ) {
+	    fprintf(stderr, "%s: bad separator in angle list %s\n", argv0, s);
+	    return 0;
+	}
+	c = e + 1;
+    }
+    fprintf(stderr, "%s: more than %d angles in %s\n", argv0, MAX_ANGLS, s);
+    return 0;
+}
+
+/* Return uniform random value in (0, 1). xorshift64, so output repeats
+   on all platforms for a given seed. */
+
+static double rnd_unif(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 7;
+    rnd_state ^= rnd_state << 17;
+    return ((rnd_state >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/* Return normal random value with mean 0, standard deviation 1 */
+
+static double rnd_gauss(void)
+{
+    return sqrt(-2.0 * log(rnd_unif())) * cos(2.0 * M_PI * rnd_unif());
+}
@@ -0,0 +1,832 @@
+/*
+   -	raxpol_z.c --
+   -		This file defines functions that read and write
+   -		compressed RaXPol files. See raxpol_z.h.
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "alloc.h"
+#include "type_nbit.h"
+#include "val_buf.h"
+#include "swap.h"
+#include "raxpol.h"
+#include "raxpol_z.h"
+
+/* Value of endian tag in host byte order */
+#define ENDIAN_TAG 0x01020304
+
+/* Commands that decompress and compress standard input to standard output */
+static char *gz_dcmp[] = {"gzip", "-dc", NULL};
+static char *zst_dcmp[] = {"zstd", "-dcq", NULL};
+static char *gz_cmp[] = {"gzip", "-c", NULL};
+static char *zst_cmp[] = {"zstd", "-cq", NULL};
+
+static pid_t spawn(char **, int, int);
+static int finish(char *, pid_t);
+static int z_start(struct RaXPol_Z *, off_t, off_t);
+static void z_stop(struct RaXPol_Z *);
+static int z_skip(struct RaXPol_Z *, off_t);
+static int idx_read(struct RaXPol_Z *, FILE *);
+static int mbr_start(struct RaXPol_Z *, int, FILE **, pid_t *);
+static int mbr_finish(struct RaXPol_Z *, FILE **, pid_t *);
+static char **z_cmp(enum RAXPOL_Z_TYPE);
+static U8BYT get_u8(char **);
+static void put_u8(char **, U8BYT);
+
+/* Return the compression of the file named nm, from its suffix */
+enum RAXPOL_Z_TYPE RaXPol_Z_Type(const char *nm)
+{
+    size_t len = strlen(nm);
+
+    if ( len > strlen(RAXPOL_Z_GZ_SFX)
+	    && strcmp(nm + len - strlen(RAXPOL_Z_GZ_SFX), RAXPOL_Z_GZ_SFX) == 0 ) {
+	return RAXPOL_Z_GZ;
+    }
+    if ( len > strlen(RAXPOL_Z_ZST_SFX)
+	    && strcmp(nm + len - strlen(RAXPOL_Z_ZST_SFX),
+		RAXPOL_Z_ZST_SFX) == 0 ) {
+	return RAXPOL_Z_ZST;
+    }
+    return RAXPOL_Z_NONE;
+}
+
+/* Initialize an empty compressed file */
+void RaXPol_Z_Init(struct RaXPol_Z *z_p)
+{
+    memset(z_p, 0, sizeof(struct RaXPol_Z));
+    z_p->nm = NULL;
+    z_p->type = RAXPOL_Z_NONE;
+    z_p->in = NULL;
+    z_p->pid = -1;
+    z_p->mbrs = NULL;
+}
+
+/*
+   Open compressed RaXPol file nm as z_p, which must have been initialized
+   with RaXPol_Z_Init, and start decompressing it. The member index is read
+   if it exists and matches the file. It has the ray header format, which
+   RaXPol_Read_File_Hdr cannot detect in a decompressed stream. See
+   RaXPol_Z_Old_Fmt. On success, z_p->in is at the start of the RaXPol
+   file.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Z_Open(struct RaXPol_Z *z_p, char *nm)
+{
+    struct stat sb;
+    char *idx_nm;
+    FILE *idx_fl;
+
+    if ( (z_p->type = RaXPol_Z_Type(nm)) == RAXPOL_Z_NONE ) {
+	fprintf(stderr, "%s is not a compressed RaXPol file.\n", nm);
+	return 0;
+    }
+    if ( !(z_p->nm = MALLOC(strlen(nm) + 1)) ) {
+	fprintf(stderr, "Could not allocate name for %s.\n", nm);
+	return 0;
+    }
+    strcpy(z_p->nm, nm);
+    if ( stat(nm, &sb) == -1 ) {
+	fprintf(stderr, "Could not get status of %s.\n%s\n",
+		nm, strerror(errno));
+	RaXPol_Z_Close(z_p);
+	return 0;
+    }
+    if ( (idx_nm = RaXPol_Z_Idx_Path(nm)) ) {
+	if ( (idx_fl = fopen(idx_nm, "r")) ) {
+	    z_p->have_idx = idx_read(z_p, idx_fl)
+		&& z_p->src_sz == sb.st_size
+		&& z_p->src_mtime == sb.st_mtime
+		&& (z_p->ray_hdr_sz == (int)RaXPol_Ray_Hdr_Sz(0)
+			|| z_p->ray_hdr_sz == (int)RaXPol_Ray_Hdr_Sz(1));
+	    fclose(idx_fl);
+	}
+	FREE(idx_nm);
+    }
+    if ( !z_p->have_idx ) {
+	FREE(z_p->mbrs);
+	z_p->mbrs = NULL;
+	z_p->num_mbrs = 0;
+    }
+    if ( !z_start(z_p, 0, 0) ) {
+	RaXPol_Z_Close(z_p);
+	return 0;
+    }
+    return 1;
+}
+
+/* Stop decompressing, free memory in z_p, and reinitialize it */
+void RaXPol_Z_Close(struct RaXPol_Z *z_p)
+{
+    z_stop(z_p);
+    FREE(z_p->nm);
+    FREE(z_p->mbrs);
+    RaXPol_Z_Init(z_p);
+}
+
+/*
+   Return true if the RaXPol file in z_p has "old" (2011) ray headers,
+   according to its member index. Without a current member index, return
+   old_fmt, which should be the format from RaXPol_Read_File_Hdr.
+ */
+
+int RaXPol_Z_Old_Fmt(struct RaXPol_Z *z_p, int old_fmt)
+{
+    if ( z_p->have_idx ) {
+	return z_p->ray_hdr_sz == (int)RaXPol_Ray_Hdr_Sz(1);
+    }
+    return old_fmt;
+}
+
+/*
+   Position z_p->in at offset o in the RaXPol file. If the member index has
+   a member that starts after the current position and at or before o, the
+   decompressor restarts there. Otherwise, or to go backward, it restarts
+   at the start of the member with o, or of the file if there is no member
+   index. The rest of the way is decompressed and discarded.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Z_Seek(struct RaXPol_Z *z_p, off_t o)
+{
+    long m = 0;				/* Member with o */
+    off_t o1 = 0;			/* Offset in RaXPol file to member m */
+
+    if ( z_p->have_idx && z_p->num_mbrs > 0 && o >= z_p->o0 ) {
+	m = (o - z_p->o0) / z_p->ray_sz / z_p->mbr_rays;
+	if ( m >= z_p->num_mbrs ) {
+	    m = z_p->num_mbrs - 1;
+	}
+	if ( m > 0 ) {
+	    o1 = z_p->o0 + (off_t)m * z_p->mbr_rays * z_p->ray_sz;
+	}
+    }
+    if ( !z_p->in || z_p->o > o || z_p->o < o1 ) {
+	if ( !z_start(z_p, m > 0 ? z_p->mbrs[m].zo : 0, o1) ) {
+	    return 0;
+	}
+    }
+    return z_skip(z_p, o - z_p->o);
+}
+
+/*
+   Copy the size of the RaXPol file in z_p to sz_p. Without a member index,
+   the rest of the file is decompressed to find its size, which leaves
+   z_p->in at end of file.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Z_Size(struct RaXPol_Z *z_p, off_t *sz_p)
+{
+    char buf[BUFSIZ];
+    size_t n;
+
+    if ( z_p->have_idx ) {
+	*sz_p = z_p->sz;
+	return 1;
+    }
+    while ( (n = fread(buf, 1, sizeof(buf), z_p->in)) > 0 ) {
+	z_p->o += n;
+    }
+    if ( ferror(z_p->in) ) {
+	fprintf(stderr, "Could not decompress %s.\n", z_p->nm);
+	return 0;
+    }
+    *sz_p = z_p->o;
+    return 1;
+}
+
+/*
+   Return the first ray of the member that has ray r, and copy the running
+   noise averages before that ray to v_noise_avg_p and h_noise_avg_p.
+   Without a member index, return 0, with averages 0.0.
+ */
+
+long RaXPol_Z_Mbr_Ray(struct RaXPol_Z *z_p, long r, float *v_noise_avg_p,
+	float *h_noise_avg_p)
+{
+    long m;
+
+    *v_noise_avg_p = *h_noise_avg_p = 0.0;
+    if ( !z_p->have_idx || z_p->num_mbrs == 0 ) {
+	return 0;
+    }
+    m = r / z_p->mbr_rays;
+    if ( m >= z_p->num_mbrs ) {
+	m = z_p->num_mbrs - 1;
+    }
+    *v_noise_avg_p = z_p->mbrs[m].v_noise_avg;
+    *h_noise_avg_p = z_p->mbrs[m].h_noise_avg;
+    return m * z_p->mbr_rays;
+}
+
+/*
+   Same as RaXPol_Idx_Tm_Ray, for compressed file z_p. Member start times
+   in the member index find the member that might have tm. Ray headers are
+   then read in order from the start of the member, or of the file if there
+   is no member index. Ray headers are in "old" (2011) format if old_fmt is
+   true. Position of z_p->in is undefined on return.
+
+   Returns -1 on failure. Prints error messages to stderr on failure.
+ */
+
+long RaXPol_Z_Tm_Ray(struct RaXPol_Z *z_p, off_t o0, off_t ray_sz,
+	int old_fmt, long num_rays, double tm, int incl)
+{
+    long lo, hi, m;			/* Indeces into z_p->mbrs */
+    long r = 0;				/* Ray to examine */
+    struct RaXPol_Ray_Hdr ray_hdr;
+    double t;				/* Time of ray r */
+
+    if ( z_p->have_idx && z_p->num_mbrs > 0 ) {
+
+	/* lo = number of members that start before tm */
+	for (lo = 0, hi = z_p->num_mbrs; lo < hi; ) {
+	    m = lo + (hi - lo) / 2;
+	    t = z_p->mbrs[m].tm;
+	    if ( incl ? t <= tm : t < tm ) {
+		lo = m + 1;
+	    } else {
+		hi = m;
+	    }
+	}
+	if ( lo == 0 ) {
+	    return 0;
+	}
+	r = (lo - 1) * z_p->mbr_rays;
+    }
+    for ( ; r < num_rays; r++) {
+	if ( !RaXPol_Z_Seek(z_p, o0 + r * ray_sz)
+		|| !RaXPol_Read_Ray_Hdr(&ray_hdr, z_p->in, old_fmt) ) {
+	    fprintf(stderr, "Could not read header for ray %ld of %s.\n",
+		    r, z_p->nm);
+	    return -1;
+	}
+	z_p->o += RaXPol_Ray_Hdr_Sz(old_fmt);
+	t = RaXPol_Ray_Tm(&ray_hdr);
+	if ( !(incl ? t <= tm : t < tm) ) {
+	    break;
+	}
+    }
+    return r;
+}
+
+/*
+   Copy the RaXPol file in stream in to file descriptor out_fd, compressed
+   with type, with mbr_rays rays per member. in must be at the start of the
+   file, which must be seekable. z_p receives the member table, which the
+   caller can store with RaXPol_Z_Idx_Write after filling in the size and
+   time of the compressed file. Bytes after the last complete ray, if any,
+   go at the end of the last member.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Z_Compress(struct RaXPol_Z *z_p, FILE *in, int out_fd,
+	enum RAXPOL_Z_TYPE type, int mbr_rays)
+{
+    struct RaXPol_Data dat;		/* Ray data, for noise averages */
+    struct RaXPol_Ray_Hdr ray_hdr;	/* First ray header */
+    char *buf = NULL;			/* File header, then one ray */
+    size_t n;				/* Number of bytes in buf */
+    FILE *out = NULL;			/* Standard input of compressor */
+    pid_t pid = -1;			/* Compressor */
+    struct RaXPol_Z_Mbr *mbr_p;		/* Current member */
+    long r;				/* Ray index */
+    int status = 0;
+
+    RaXPol_Z_Close(z_p);
+    RaXPol_Init_Data(&dat, NULL);
+    z_p->type = type;
+    z_p->mbr_rays = mbr_rays;
+    if ( mbr_rays < 1 ) {
+	fprintf(stderr, "Members must have at least one ray.\n");
+	goto end;
+    }
+    if ( type != RAXPOL_Z_GZ && type != RAXPOL_Z_ZST ) {
+	fprintf(stderr, "Unknown compression type.\n");
+	goto end;
+    }
+
+    /* Ray size comes from first ray header. File may not have any rays. */
+    if ( !RaXPol_Init_Data(&dat, in) || (z_p->o0 = ftello(in)) == -1
+	    || z_p->o0 != RAXPOL_FILE_HDR_SZ ) {
+	fprintf(stderr, "Could not read file header.\n");
+	goto end;
+    }
+    z_p->ray_hdr_sz = RaXPol_Ray_Hdr_Sz(dat.file_hdr.old_fmt);
+    RaXPol_Init_Ray_Hdr(&ray_hdr);
+    if ( RaXPol_Read_Ray_Hdr(&ray_hdr, in, dat.file_hdr.old_fmt) ) {
+	z_p->ray_sz = z_p->ray_hdr_sz + ray_hdr.data_size;
+    } else if ( ferror(in) ) {
+	fprintf(stderr, "Could not read first ray header.\n");
+	goto end;
+    } else {
+	z_p->ray_sz = z_p->ray_hdr_sz;
+    }
+    if ( fseeko(in, 0, SEEK_SET) == -1 ) {
+	fprintf(stderr, "Could not return to start of RaXPol file.\n%s\n",
+		strerror(errno));
+	goto end;
+    }
+    n = (z_p->o0 > z_p->ray_sz) ? z_p->o0 : z_p->ray_sz;
+    if ( !(buf = MALLOC(n)) ) {
+	fprintf(stderr, "Could not allocate %zu byte buffer.\n", n);
+	goto end;
+    }
+    if ( fread(buf, z_p->o0, 1, in) != 1 ) {
+	fprintf(stderr, "Could not read file header.\n");
+	goto end;
+    }
+    z_p->sz = z_p->o0;
+    if ( !mbr_start(z_p, out_fd, &out, &pid)
+	    || fwrite(buf, z_p->o0, 1, out) != 1 ) {
+	fprintf(stderr, "Could not compress file header.\n");
+	goto end;
+    }
+    for (r = 0; ; r++) {
+	if ( (n = fread(buf, 1, z_p->ray_sz, in)) < (size_t)z_p->ray_sz ) {
+	    if ( ferror(in) ) {
+		fprintf(stderr, "Could not read ray %ld.\n", r);
+		goto end;
+	    }
+	    if ( n > 0 && fwrite(buf, n, 1, out) != 1 ) {
+		fprintf(stderr, "Could not compress partial ray at end of "
+			"file.\n");
+		goto end;
+	    }
+	    z_p->sz += n;
+	    break;
+	}
+	if ( r > 0 && r % mbr_rays == 0 && (!mbr_finish(z_p, &out, &pid)
+		    || !mbr_start(z_p, out_fd, &out, &pid)) ) {
+	    goto end;
+	}
+	mbr_p = z_p->mbrs + z_p->num_mbrs - 1;
+	if ( r % mbr_rays == 0 ) {
+	    mbr_p->v_noise_avg = dat.v_noise_avg;
+	    mbr_p->h_noise_avg = dat.h_noise_avg;
+	}
+	if ( !RaXPol_Decode_Ray(&dat, buf, z_p->ray_sz) ) {
+	    fprintf(stderr, "Could not decode ray %ld.\n", r);
+	    goto end;
+	}
+	if ( r % mbr_rays == 0 ) {
+	    mbr_p->tm = RaXPol_Ray_Tm(&dat.ray_hdr);
+	}
+	if ( fwrite(buf, z_p->ray_sz, 1, out) != 1 ) {
+	    fprintf(stderr, "Could not compress ray %ld.\n", r);
+	    goto end;
+	}
+	z_p->sz += z_p->ray_sz;
+	if ( r == INT_MAX ) {
+	    fprintf(stderr, "Too many rays for member index.\n");
+	    goto end;
+	}
+	z_p->num_rays = r + 1;
+    }
+    if ( !mbr_finish(z_p, &out, &pid) ) {
+	goto end;
+    }
+    z_p->have_idx = status = 1;
+
+end:
+    if ( out || pid != -1 ) {
+	mbr_finish(z_p, &out, &pid);
+    }
+    FREE(buf);
+    RaXPol_Free_Data(&dat);
+    return status;
+}
+
+/*
+   Return path to member index for compressed RaXPol file nm, in memory
+   allocated with MALLOC. Caller should eventually FREE it.
+   Returns NULL on failure.
+ */
+
+char *RaXPol_Z_Idx_Path(char *nm)
+{
+    char *path;
+    size_t sz;
+
+    sz = strlen(nm) + strlen(RAXPOL_Z_IDX_SFX) + 1;
+    if ( !(path = MALLOC(sz)) ) {
+	fprintf(stderr, "Could not allocate member index path for %s.\n", nm);
+	return NULL;
+    }
+    strcpy(path, nm);
+    strcat(path, RAXPOL_Z_IDX_SFX);
+    return path;
+}
+
+/*
+   Write member index in z_p to stream out.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+int RaXPol_Z_Idx_Write(struct RaXPol_Z *z_p, FILE *out)
+{
+    char buf[RAXPOL_Z_IDX_HDR_SZ];
+    char *b;
+    int m;
+
+    memset(buf, 0, RAXPOL_Z_IDX_HDR_SZ);
+    b = buf;
+    ValBuf_PutBytes(&b, RAXPOL_Z_IDX_MAGIC, sizeof(RAXPOL_Z_IDX_MAGIC));
+    b = buf + 8;
+    ValBuf_PutI4BYT(&b, ENDIAN_TAG);
+    ValBuf_PutI4BYT(&b, RAXPOL_Z_IDX_VERSION);
+    ValBuf_PutI4BYT(&b, z_p->num_rays);
+    ValBuf_PutI4BYT(&b, z_p->mbr_rays);
+    put_u8(&b, z_p->o0);
+    put_u8(&b, z_p->ray_sz);
+    put_u8(&b, z_p->sz);
+    put_u8(&b, z_p->src_sz);
+    put_u8(&b, z_p->src_mtime);
+    ValBuf_PutI4BYT(&b, z_p->ray_hdr_sz);
+    if ( fwrite(buf, RAXPOL_Z_IDX_HDR_SZ, 1, out) != 1 ) {
+	fprintf(stderr, "Could not write member index header.\n%s\n",
+		strerror(errno));
+	return 0;
+    }
+    for (m = 0; m < z_p->num_mbrs; m++) {
+	struct RaXPol_Z_Mbr *mbr_p = z_p->mbrs + m;
+
+	b = buf;
+	put_u8(&b, mbr_p->zo);
+	ValBuf_PutF8BYT(&b, mbr_p->tm);
+	ValBuf_PutF4BYT(&b, mbr_p->v_noise_avg);
+	ValBuf_PutF4BYT(&b, mbr_p->h_noise_avg);
+	if ( fwrite(buf, RAXPOL_Z_IDX_MBR_SZ, 1, out) != 1 ) {
+	    fprintf(stderr, "Could not write member index entry for member "
+		    "%d.\n%s\n", m, strerror(errno));
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+   Read a member index from stream in into z_p. Failure is not reported,
+   since the index is optional.
+
+   Returns 1/0 on success/failure.
+ */
+
+static int idx_read(struct RaXPol_Z *z_p, FILE *in)
+{
+    char buf[RAXPOL_Z_IDX_HDR_SZ];
+    char *b;
+    I4BYT tag;
+    int m;
+
+    if ( fread(buf, RAXPOL_Z_IDX_HDR_SZ, 1, in) != 1
+	    || memcmp(buf, RAXPOL_Z_IDX_MAGIC,
+		sizeof(RAXPOL_Z_IDX_MAGIC)) != 0 ) {
+	return 0;
+    }
+    memcpy(&tag, buf + 8, 4);
+    if ( tag != ENDIAN_TAG ) {
+	Swap_On();
+	Swap_4Byt(&tag);
+	Swap_Off();
+	if ( tag != ENDIAN_TAG ) {
+	    return 0;
+	}
+	Swap_On();
+    }
+    b = buf + 12;
+    if ( ValBuf_GetI4BYT(&b) != RAXPOL_Z_IDX_VERSION ) {
+	goto error;
+    }
+    z_p->num_rays = ValBuf_GetI4BYT(&b);
+    z_p->mbr_rays = ValBuf_GetI4BYT(&b);
+    z_p->o0 = get_u8(&b);
+    z_p->ray_sz = get_u8(&b);
+    z_p->sz = get_u8(&b);
+    z_p->src_sz = get_u8(&b);
+    z_p->src_mtime = get_u8(&b);
+    z_p->ray_hdr_sz = ValBuf_GetI4BYT(&b);
+    if ( z_p->num_rays < 0 || z_p->mbr_rays < 1 || z_p->ray_sz <= 0 ) {
+	goto error;
+    }
+    z_p->num_mbrs = (z_p->num_rays + z_p->mbr_rays - 1) / z_p->mbr_rays;
+    if ( z_p->num_mbrs == 0 ) {
+	z_p->num_mbrs = 1;
+    }
+    z_p->mbrs = CALLOC(z_p->num_mbrs, sizeof(struct RaXPol_Z_Mbr));
+    if ( !z_p->mbrs ) {
+	goto error;
+    }
+    for (m = 0; m < z_p->num_mbrs; m++) {
+	struct RaXPol_Z_Mbr *mbr_p = z_p->mbrs + m;
+
+	if ( fread(buf, RAXPOL_Z_IDX_MBR_SZ, 1, in) != 1 ) {
+	    goto error;
+	}
+	b = buf;
+	mbr_p->zo = get_u8(&b);
+	mbr_p->tm = ValBuf_GetF8BYT(&b);
+	mbr_p->v_noise_avg = ValBuf_GetF4BYT(&b);
+	mbr_p->h_noise_avg = ValBuf_GetF4BYT(&b);
+    }
+    Swap_Off();
+    return 1;
+
+error:
+    Swap_Off();
+    FREE(z_p->mbrs);
+    z_p->mbrs = NULL;
+    z_p->num_mbrs = 0;
+    return 0;
+}
+
+/*
+   Add a member to the member table in z_p, at the current end of out_fd,
+   and start a compressor that writes to out_fd. Copy the compressor process
+   to pid_p, and a stream to its standard input to out_p.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int mbr_start(struct RaXPol_Z *z_p, int out_fd, FILE **out_p,
+	pid_t *pid_p)
+{
+    struct RaXPol_Z_Mbr *mbrs;
+    off_t zo;				/* Offset in out_fd to new member */
+    int p[2];				/* Pipe to compressor */
+
+    if ( (zo = lseek(out_fd, 0, SEEK_CUR)) == -1 ) {
+	fprintf(stderr, "Could not get position in compressed file.\n%s\n",
+		strerror(errno));
+	return 0;
+    }
+    mbrs = REALLOC(z_p->mbrs,
+	    (z_p->num_mbrs + 1) * sizeof(struct RaXPol_Z_Mbr));
+    if ( !mbrs ) {
+	fprintf(stderr, "Could not allocate member index with %d members.\n",
+		z_p->num_mbrs + 1);
+	return 0;
+    }
+    z_p->mbrs = mbrs;
+    memset(mbrs + z_p->num_mbrs, 0, sizeof(struct RaXPol_Z_Mbr));
+    mbrs[z_p->num_mbrs++].zo = zo;
+    if ( pipe(p) == -1 ) {
+	fprintf(stderr, "Could not make pipe to compressor.\n%s\n",
+		strerror(errno));
+	return 0;
+    }
+    (void)fcntl(p[1], F_SETFD, FD_CLOEXEC);
+    *pid_p = spawn(z_cmp(z_p->type), p[0], out_fd);
+    close(p[0]);
+    if ( *pid_p == -1 ) {
+	close(p[1]);
+	return 0;
+    }
+    if ( !(*out_p = fdopen(p[1], "w")) ) {
+	fprintf(stderr, "Could not open pipe to compressor.\n%s\n",
+		strerror(errno));
+	close(p[1]);
+	return 0;
+    }
+    return 1;
+}
+
+/*
+   Close stream *out_p to the compressor for the current member in z_p, and
+   wait for compressor *pid_p to finish. Set *out_p to NULL and *pid_p to -1.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int mbr_finish(struct RaXPol_Z *z_p, FILE **out_p, pid_t *pid_p)
+{
+    int status = 1;
+
+    if ( *out_p && fclose(*out_p) == EOF ) {
+	fprintf(stderr, "Could not write to compressor.\n%s\n",
+		strerror(errno));
+	status = 0;
+    }
+    *out_p = NULL;
+    if ( *pid_p != -1 && !finish(z_cmp(z_p->type)[0], *pid_p) ) {
+	status = 0;
+    }
+    *pid_p = -1;
+    return status;
+}
+
+/* Return command that compresses with type */
+static char **z_cmp(enum RAXPOL_Z_TYPE type)
+{
+    return (type == RAXPOL_Z_GZ) ? gz_cmp : zst_cmp;
+}
+
+/*
+   Start decompressing z_p at offset zo in the compressed file, which is
+   offset o in the RaXPol file. zo must be the start of a member.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int z_start(struct RaXPol_Z *z_p, off_t zo, off_t o)
+{
+    int fd;				/* Compressed file */
+    int p[2];				/* Pipe from decompressor */
+
+    z_stop(z_p);
+    if ( (fd = open(z_p->nm, O_RDONLY)) == -1 ) {
+	fprintf(stderr, "Could not open %s for reading.\n%s\n",
+		z_p->nm, strerror(errno));
+	return 0;
+    }
+    if ( lseek(fd, zo, SEEK_SET) == -1 ) {
+	fprintf(stderr, "Could not position %s at member at %lld.\n%s\n",
+		z_p->nm, (long long)zo, strerror(errno));
+	close(fd);
+	return 0;
+    }
+    if ( pipe(p) == -1 ) {
+	fprintf(stderr, "Could not make pipe from decompressor.\n%s\n",
+		strerror(errno));
+	close(fd);
+	return 0;
+    }
+    (void)fcntl(p[0], F_SETFD, FD_CLOEXEC);
+    z_p->pid = spawn((z_p->type == RAXPOL_Z_GZ) ? gz_dcmp : zst_dcmp, fd, p[1]);
+    close(fd);
+    close(p[1]);
+    if ( z_p->pid == -1 ) {
+	close(p[0]);
+	return 0;
+    }
+    if ( !(z_p->in = fdopen(p[0], "r")) ) {
+	fprintf(stderr, "Could not open pipe from decompressor.\n%s\n",
+		strerror(errno));
+	close(p[0]);
+	z_stop(z_p);
+	return 0;
+    }
+    z_p->o = o;
+    return 1;
+}
+
+/*
+   Stop decompressing z_p. The decompressor is terminated, since it might
+   not have reached the end of the file.
+ */
+
+static void z_stop(struct RaXPol_Z *z_p)
+{
+    if ( z_p->in ) {
+	fclose(z_p->in);
+	z_p->in = NULL;
+    }
+    if ( z_p->pid != -1 ) {
+	kill(z_p->pid, SIGTERM);
+	while ( waitpid(z_p->pid, NULL, 0) == -1 && errno == EINTR ) {
+	    continue;
+	}
+	z_p->pid = -1;
+    }
+}
+
+/*
+   Decompress and discard n bytes from z_p->in.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int z_skip(struct RaXPol_Z *z_p, off_t n)
+{
+    char buf[BUFSIZ];
+    size_t c;
+
+    while ( n > 0 ) {
+	c = (n < (off_t)sizeof(buf)) ? (size_t)n : sizeof(buf);
+	if ( fread(buf, c, 1, z_p->in) != 1 ) {
+	    fprintf(stderr, "Could not decompress %s to offset %lld.\n",
+		    z_p->nm, (long long)(z_p->o + n));
+	    return 0;
+	}
+	z_p->o += c;
+	n -= c;
+    }
+    return 1;
+}
+
+/*
+   Run command argv, found in PATH, with standard input from in_fd and
+   standard output to out_fd.
+
+   Returns process identifier, or -1 on failure. Prints error messages to
+   stderr on failure.
+ */
+
+static pid_t spawn(char **argv, int in_fd, int out_fd)
+{
+    pid_t pid;
+
+    switch (pid = fork()) {
+	case -1:
+	    fprintf(stderr, "Could not create process for %s.\n%s\n",
+		    argv[0], strerror(errno));
+	    return -1;
+	case 0:
+	    if ( dup2(in_fd, STDIN_FILENO) == -1
+		    || dup2(out_fd, STDOUT_FILENO) == -1 ) {
+		_exit(EXIT_FAILURE);
+	    }
+	    close(in_fd);
+	    close(out_fd);
+	    execvp(argv[0], argv);
+	    fprintf(stderr, "Could not run %s.\n%s\n",
+		    argv[0], strerror(errno));
+	    _exit(EXIT_FAILURE);
+	default:
+	    return pid;
+    }
+}
+
+/*
+   Wait for process pid, running command nm, to exit.
+
+   Returns 1 if it exits with status 0, otherwise 0. Prints error messages to
+   stderr on failure.
+ */
+
+static int finish(char *nm, pid_t pid)
+{
+    int status;
+
+    while ( waitpid(pid, &status, 0) == -1 ) {
+	if ( errno != EINTR ) {
+	    fprintf(stderr, "Could not wait for %s.\n%s\n",
+		    nm, strerror(errno));
+	    return 0;
+	}
+    }
+    if ( !WIFEXITED(status) || WEXITSTATUS(status) != 0 ) {
+	fprintf(stderr, "%s failed.\n", nm);
+	return 0;
+    }
+    return 1;
+}
+
+static U8BYT get_u8(char **buf_p)
+{
+    U8BYT u;
+
+    memcpy(&u, *buf_p, 8);
+    *buf_p += 8;
+    Swap_8Byt(&u);
+    return u;
+}
+
+static void put_u8(char **buf_p, U8BYT u)
+{
+    Swap_8Byt(&u);
+    memcpy(*buf_p, &u, 8);
+    *buf_p += 8;
+}
@@ -0,0 +1,149 @@
+/*
+   -	raxpol_z.h --
+   -		This header file declares structures and functions
+   -		that read and write compressed RaXPol files.
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+/*
+   A RaXPol file compressed with gzip (1) or zstd (1), with a name that ends
+   with RAXPOL_Z_GZ_SFX or RAXPOL_Z_ZST_SFX, is read through a decompressor
+   process, found in PATH, whose output is the original file. Reads are
+   sequential. Seeking backward, or into a later member, restarts the
+   decompressor.
+
+   RaXPol_Z_Compress, used by raxpol_zip, compresses a RaXPol file as a
+   series of independent members (gzip) or frames (zstd). Member 0 has the
+   file header and the first rays. Each following member has the same
+   number of rays. Decompressors read the members as one stream, so the
+   result is an ordinary compressed file. RaXPol_Z_Compress also makes a
+   member index, which is stored next to the compressed file, with
+   RAXPOL_Z_IDX_SFX appended to the name. With a current member index, a
+   seek starts the decompressor at the member that has the ray, and the
+   number of rays, member start times, and running noise averages at member
+   starts are known without decompressing anything.
+
+   A member index has the following layout. Integers and floats are stored
+   in the byte order of the host that wrote the index, as in a ray index.
+   See raxpol_idx.h.
+
+   .	Header, RAXPOL_Z_IDX_HDR_SZ bytes
+   .	    0	char[8]	magic, RAXPOL_Z_IDX_MAGIC, nul padded
+   .	    8	int32	endian tag, 0x01020304
+   .	   12	int32	format version, RAXPOL_Z_IDX_VERSION
+   .	   16	int32	number of rays
+   .	   20	int32	number of rays per member
+   .	   24	uint64	offset in RaXPol file to first ray
+   .	   32	uint64	size in RaXPol file of one ray, header and data
+   .	   40	uint64	size of RaXPol file, decompressed
+   .	   48	uint64	size of compressed file
+   .	   56	int64	modification time of compressed file, seconds since
+   .			1970-01-01 00:00:00 UTC
+   .	   64	int32	size of ray header, distinguishes old (2011) format
+   .	   68	...	zero
+   .
+   .	Member table, RAXPOL_Z_IDX_MBR_SZ bytes per member, starting at
+   .	RAXPOL_Z_IDX_HDR_SZ
+   .	    0	uint64	offset in compressed file to member
+   .	    8	float64	time of first ray in member
+   .	   16	float32	running vertical noise average before first ray
+   .	   20	float32	running horizontal noise average before first ray
+ */
+
+#ifndef RAXPOL_Z_H_
+#define RAXPOL_Z_H_
+
+#include "unix_defs.h"
+#include <stdio.h>
+#include <sys/types.h>
+#include <time.h>
+#include "raxpol.h"
+
+#define RAXPOL_Z_GZ_SFX ".gz"
+#define RAXPOL_Z_ZST_SFX ".zst"
+#define RAXPOL_Z_IDX_MAGIC "RXPLZIX"
+#define RAXPOL_Z_IDX_VERSION 1
+#define RAXPOL_Z_IDX_HDR_SZ 72
+#define RAXPOL_Z_IDX_MBR_SZ 24
+#define RAXPOL_Z_IDX_SFX ".zidx"
+
+/* Default number of rays per member */
+#define RAXPOL_Z_MBR_RAYS 256
+
+enum RAXPOL_Z_TYPE {
+    RAXPOL_Z_NONE, RAXPOL_Z_GZ, RAXPOL_Z_ZST
+};
+
+struct RaXPol_Z_Mbr {
+    off_t zo;				/* Offset in compressed file */
+    double tm;				/* Time of first ray */
+    float v_noise_avg, h_noise_avg;	/* Noise averages before first ray */
+};
+
+struct RaXPol_Z {
+    char *nm;				/* Compressed file. Allocated. */
+    enum RAXPOL_Z_TYPE type;		/* Compression */
+    FILE *in;				/* Decompressed stream */
+    pid_t pid;				/* Decompressor, -1 if none */
+    off_t o;				/* Offset in RaXPol file of next byte
+					   from in. Callers that read from in
+					   must add the number of bytes they
+					   read. */
+    int have_idx;			/* If true, members below are
+					   current */
+    int num_rays;			/* Number of rays */
+    int mbr_rays;			/* Number of rays per member */
+    off_t o0;				/* Offset to first ray */
+    off_t ray_sz;			/* Size of one ray */
+    off_t sz;				/* Size of RaXPol file */
+    off_t src_sz;			/* Size of compressed file */
+    time_t src_mtime;			/* Modification time of compressed
+					   file */
+    int ray_hdr_sz;			/* Size of ray header */
+    int num_mbrs;			/* Number of members */
+    struct RaXPol_Z_Mbr *mbrs;		/* Member table, dimensioned
+					   num_mbrs */
+};
+
+enum RAXPOL_Z_TYPE RaXPol_Z_Type(const char *);
+void RaXPol_Z_Init(struct RaXPol_Z *);
+int RaXPol_Z_Open(struct RaXPol_Z *, char *);
+void RaXPol_Z_Close(struct RaXPol_Z *);
+int RaXPol_Z_Seek(struct RaXPol_Z *, off_t);
+int RaXPol_Z_Size(struct RaXPol_Z *, off_t *);
+long RaXPol_Z_Mbr_Ray(struct RaXPol_Z *, long, float *, float *);
+int RaXPol_Z_Old_Fmt(struct RaXPol_Z *, int);
+long RaXPol_Z_Tm_Ray(struct RaXPol_Z *, off_t, off_t, int, long, double,
+	int);
+int RaXPol_Z_Compress(struct RaXPol_Z *, FILE *, int, enum RAXPOL_Z_TYPE,
+	int);
+char *RaXPol_Z_Idx_Path(char *);
+int RaXPol_Z_Idx_Write(struct RaXPol_Z *, FILE *);
+
+#endif
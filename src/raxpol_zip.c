@@ -0,0 +1,279 @@
+/*
+   -	raxpol_zip.c --
+   -		Compress RaXPol files into seekable gzip or zstd files with
+   -		member indeces. See raxpol_zip (1).
+   -
+   .	Copyright (c) 2016, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+ */
+
+#include "unix_defs.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "alloc.h"
+#include "raxpol.h"
+#include "raxpol_z.h"
+#include "raxpol_prof.h"
+
+#define RAXPOL_OLD_FMT "RAXPOL_OLD_FMT"
+
+/* Suffix for files under construction */
+#define TMP_SFX ".tmp"
+
+static char *argv0;			/* Name of the executable */
+
+/* Local functions */
+static int zip(char *, enum RAXPOL_Z_TYPE, int, int);
+static char *tmp_path(char *);
+
+int main(int argc, char *argv[])
+{
+    extern char *optarg;		/* See getopt (3) */
+    extern int optind;			/* See getopt (3) */
+    int c;				/* Index into argv */
+    enum RAXPOL_Z_TYPE type = RAXPOL_Z_ZST;	/* Compression */
+    int mbr_rays = RAXPOL_Z_MBR_RAYS;	/* Rays per member */
+    char *s;				/* End of mbr_rays in optarg */
+    int force = 0;			/* If true, replace output files */
+    int status = EXIT_SUCCESS;
+
+    argv0 = argv[0];
+    RaXPol_Prof_Init(argv0);
+    if ( atoi(getenv(RAXPOL_OLD_FMT) ? getenv(RAXPOL_OLD_FMT) : "0") ) {
+	RaXPol_Old_Fmt();
+    }
+    while ((c = getopt(argc, argv, ":Vfln:z:")) != -1) {
+	switch(c) {
+	    case 'V':
+		printf("%s\n", RAXPOL_MOMENT_VERSION);
+		exit(EXIT_SUCCESS);
+		break;
+	    case 'f':
+		force = 1;
+		break;
+	    case 'l':
+		RaXPol_Old_Fmt();
+		break;
+	    case 'n':
+		mbr_rays = strtol(optarg, &s, 10);
+		if ( *s != '\0' || s == optarg || mbr_rays < 1 ) {
+		    fprintf(stderr, "%s: expected positive integer for number "
+			    "of rays per member, got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'z':
+		if ( strcmp(optarg, "gz") == 0 ) {
+		    type = RAXPOL_Z_GZ;
+		} else if ( strcmp(optarg, "zst") == 0 ) {
+		    type = RAXPOL_Z_ZST;
+		} else {
+		    fprintf(stderr, "%s: compression must be gz or zst, "
+			    "got %s\n", argv0, optarg);
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case ':':
+		fprintf(stderr, "%s: -%c requires an argument\n",
+			argv0, optopt);
+		exit(EXIT_FAILURE);
+		break;
+	    case '?':
+		fprintf(stderr, "Usage: %s [-f] [-l] [-n rays_per_member] "
+			"[-z gz|zst] raxpol_file ...\n", argv0);
+		exit(EXIT_FAILURE);
+		break;
+	}
+    }
+    if ( optind == argc ) {
+	fprintf(stderr, "Usage: %s [-f] [-l] [-n rays_per_member] "
+		"[-z gz|zst] raxpol_file ...\n", argv0);
+	exit(EXIT_FAILURE);
+    }
+    for ( ; optind < argc; optind++) {
+	if ( !zip(argv[optind], type, mbr_rays, force) ) {
+	    fprintf(stderr, "%s: could not compress %s\n",
+		    argv0, argv[optind]);
+	    status = EXIT_FAILURE;
+	}
+    }
+    return status;
+}
+
+/*
+   Compress RaXPol file raxpol_fl_nm with type, with mbr_rays rays per
+   member, into a file with the same name and the suffix for type. Store the
+   member index next to it. The compressed file and index are assembled in
+   temporary files, which replace existing files, if any, when complete.
+   Existing files are only replaced if force is true. The original file
+   remains.
+
+   Returns 1/0 on success/failure. Prints error messages to stderr on failure.
+ */
+
+static int zip(char *raxpol_fl_nm, enum RAXPOL_Z_TYPE type, int mbr_rays,
+	int force)
+{
+    FILE *raxpol_fl = NULL;		/* RaXPol file */
+    struct RaXPol_Z z;			/* Member table */
+    char *sfx;				/* Suffix for compressed file */
+    char *z_nm = NULL;			/* Path to compressed file */
+    char *z_tmp_nm = NULL;		/* Compressed file under
+					   construction */
+    int z_fd = -1;			/* Compressed file under
+					   construction */
+    struct stat sb;			/* Status of compressed file */
+    char *idx_nm = NULL;		/* Path to member index */
+    char *idx_tmp_nm = NULL;		/* Member index under construction */
+    FILE *out = NULL;			/* Member index under construction */
+    int status = 0;
+
+    RaXPol_Z_Init(&z);
+    if ( RaXPol_Z_Type(raxpol_fl_nm) != RAXPOL_Z_NONE ) {
+	fprintf(stderr, "%s: %s is already compressed.\n",
+		argv0, raxpol_fl_nm);
+	return 0;
+    }
+    sfx = (type == RAXPOL_Z_GZ) ? RAXPOL_Z_GZ_SFX : RAXPOL_Z_ZST_SFX;
+    if ( !(z_nm = MALLOC(strlen(raxpol_fl_nm) + strlen(sfx) + 1))
+	    || !(idx_nm = RaXPol_Z_Idx_Path(strcat(strcpy(z_nm, raxpol_fl_nm),
+			sfx)))
+	    || !(z_tmp_nm = tmp_path(z_nm))
+	    || !(idx_tmp_nm = tmp_path(idx_nm)) ) {
+	fprintf(stderr, "%s: could not allocate output paths for %s.\n",
+		argv0, raxpol_fl_nm);
+	goto end;
+    }
+    if ( !force && access(z_nm, F_OK) == 0 ) {
+	fprintf(stderr, "%s: %s exists. Use -f to replace it.\n",
+		argv0, z_nm);
+	goto end;
+    }
+    if ( !(raxpol_fl = fopen(raxpol_fl_nm, "r")) ) {
+	fprintf(stderr, "%s: could not open %s for reading.\n%s\n",
+		argv0, raxpol_fl_nm, strerror(errno));
+	goto end;
+    }
+    if ( (z_fd = open(z_tmp_nm, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1 ) {
+	fprintf(stderr, "%s: could not create %s.\n%s\n",
+		argv0, z_tmp_nm, strerror(errno));
+	goto end;
+    }
+    if ( !RaXPol_Z_Compress(&z, raxpol_fl, z_fd, type, mbr_rays) ) {
+	fprintf(stderr, "%s: could not compress rays from %s.\n",
+		argv0, raxpol_fl_nm);
+	goto end;
+    }
+    if ( close(z_fd) == -1 ) {
+	z_fd = -1;
+	fprintf(stderr, "%s: could not close %s.\n%s\n",
+		argv0, z_tmp_nm, strerror(errno));
+	goto end;
+    }
+    z_fd = -1;
+    if ( rename(z_tmp_nm, z_nm) == -1 ) {
+	fprintf(stderr, "%s: could not rename %s to %s.\n%s\n",
+		argv0, z_tmp_nm, z_nm, strerror(errno));
+	goto end;
+    }
+
+    /* Index must have size and time of compressed file in its final place */
+    if ( stat(z_nm, &sb) == -1 ) {
+	fprintf(stderr, "%s: could not get status of %s.\n%s\n",
+		argv0, z_nm, strerror(errno));
+	goto end;
+    }
+    z.src_sz = sb.st_size;
+    z.src_mtime = sb.st_mtime;
+    if ( !(out = fopen(idx_tmp_nm, "w")) ) {
+	fprintf(stderr, "%s: could not create %s.\n%s\n",
+		argv0, idx_tmp_nm, strerror(errno));
+	goto end;
+    }
+    if ( !RaXPol_Z_Idx_Write(&z, out) ) {
+	fprintf(stderr, "%s: could not write %s.\n", argv0, idx_tmp_nm);
+	goto end;
+    }
+    if ( fclose(out) == EOF ) {
+	out = NULL;
+	fprintf(stderr, "%s: could not close %s.\n%s\n",
+		argv0, idx_tmp_nm, strerror(errno));
+	goto end;
+    }
+    out = NULL;
+    if ( rename(idx_tmp_nm, idx_nm) == -1 ) {
+	fprintf(stderr, "%s: could not rename %s to %s.\n%s\n",
+		argv0, idx_tmp_nm, idx_nm, strerror(errno));
+	goto end;
+    }
+    status = 1;
+
+end:
+    if ( z_fd != -1 ) {
+	close(z_fd);
+    }
+    if ( out ) {
+	fclose(out);
+    }
+    if ( !status && z_tmp_nm ) {
+	unlink(z_tmp_nm);
+    }
+    if ( !status && idx_tmp_nm ) {
+	unlink(idx_tmp_nm);
+    }
+    if ( raxpol_fl ) {
+	fclose(raxpol_fl);
+    }
+    RaXPol_Z_Close(&z);
+    FREE(z_nm);
+    FREE(z_tmp_nm);
+    FREE(idx_nm);
+    FREE(idx_tmp_nm);
+    return status;
+}
+
+/*
+   Return path nm with TMP_SFX appended, in memory allocated with MALLOC.
+   Caller should eventually FREE it. Returns NULL on failure.
+ */
+
+static char *tmp_path(char *nm)
+{
+    char *path;
+
+    if ( !(path = MALLOC(strlen(nm) + strlen(TMP_SFX) + 1)) ) {
+	return NULL;
+    }
+    strcpy(path, nm);
+    strcat(path, TMP_SFX);
+    return path;
+}
@@ -45,6 +45,8 @@ void Swap_On(void) { swapping = 1; }
 
 void Toggle_Swap(void) { swapping = !swapping; }
 
+int Swapping(void) { return swapping; }
+
 void Swap_2Byt(void *p)
 {
     if (swapping) {
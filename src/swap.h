@@ -38,6 +38,7 @@
 void Swap_On(void);
 void Swap_Off(void);
 void Toggle_Swap(void);
+int Swapping(void);
 void Swap_2Byt(void *);
 void Swap_4Byt(void *);
 void Swap_8Byt(void *);
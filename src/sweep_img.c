@@ -86,6 +86,19 @@
    .
    .	data must provide num_rays * num_gates values for ray 0 gate 0, ray 0
    .	gate 1, ray 0 gate 2, ... ray1 gate 0 ray 1 gate 1, ... and so on.
+   .
+   .	Instead of num_rays, az, el, num_gates, gates, and data, input can
+   .	have
+   .		moment_file: path moment
+   .	where path is a moment file from raxpol_dat -b, and moment is the
+   .	name of a moment in the file. All rays in the file are used, unless
+   .	the moment_file key is preceded by
+   .		ray_range: first count
+   .	in which case rays first through first + count - 1 are used. Ray
+   .	indeces are from the RaXPol file, so they match the ray indeces in
+   .	raxpol_swps output for moment files that start at any ray.
+   .	Scan type, radar_lon, and radar_lat are also taken from the moment
+   .	file if they are not given before the moment_file key.
  */
 
 #include "unix_defs.h"
@@ -93,11 +106,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "geog_lib.h"
 #include "geog_proj.h"
 #include "get_colors.h"
 #include "bisearch_lib.h"
 #include "alloc.h"
+#include "raxpol_mom.h"
+#include "raxpol_prof.h"
 
 #define LEN 256
 #define LEN_S "255"
@@ -135,8 +152,10 @@ static struct GateCoords ppi_gate_corners(int, int, int, double *, double *,
 static struct GateCoords rhi_gate_corners(int, int, int, double *, double *,
 	double *);
 static int is_point(struct Point);
-static float **calloc2f(long, long);
-static void free2f(float **);
+static float **read_mom_file(struct Tkx_Arena *, char *, char *, int, int,
+	int *, int *, double **, double **, double **, char *, double *,
+	double *);
+static float **calloc2f(struct Tkx_Arena *, long, long);
 
 int main(int argc, char *argv[])
 {
@@ -150,6 +169,9 @@ int main(int argc, char *argv[])
     struct GeogProj proj;		/* Geographic projection */
     int num_rays;			/* Number of rays in sweep */
     int num_gates;			/* Number of gates in each ray */
+    int mom_ray0 = 0;			/* First ray to read from moment file */
+    int mom_num_rays = -1;		/* Number of rays to read from moment
+					   file, or -1 for all */
     double *gate_dist;			/* Distance to each gate, dimensioned
 					   [gate] */
     double *az;				/* Ray azimuth, dimensioned [ray] */
@@ -165,8 +187,12 @@ int main(int argc, char *argv[])
 					   See bisearch_lib (3) */
     struct GateCoords cnrs;		/* Gate corner */
     char key[LEN];			/* Input word, says what comes next */
+    struct Tkx_Arena swp = {NULL};	/* Sweep geometry, data, and color
+					   lists */
     int r, g, d, c;			/* Ray, gate, datum, color index */
+    double t0;				/* Profile start time */
 
+    RaXPol_Prof_Init(argv0);
     memset(scan_type_s, 0, 4);
     rearth = GeogREarth(NULL);
     radar_lon = radar_lat = NAN;
@@ -175,6 +201,7 @@ int main(int argc, char *argv[])
     dat = NULL;
 
     /* Get "key value" pairs from standard input */
+    t0 = RaXPol_Prof_Start();
     while ( scanf(" %" LEN_S "s", key) == 1 ) {
 	if ( strcmp(key, "scan_type:") == 0 ) {
 	    if ( scanf(" %s", scan_type_s) != 1 ) {
@@ -228,7 +255,7 @@ int main(int argc, char *argv[])
 			"once.\n", argv0);
 		exit(EXIT_FAILURE);
 	    }
-	    if ( !(az = CALLOC(num_rays, sizeof(double))) ) {
+	    if ( !(az = ARENA_CALLOC(&swp, num_rays, sizeof(double))) ) {
 		fprintf(stderr, "%s: could not allocate memory for ray "
 			"azimuth low limits for %d rays.\n", argv0, num_rays);
 		exit(EXIT_FAILURE);
@@ -252,7 +279,7 @@ int main(int argc, char *argv[])
 			"once.\n", argv0);
 		exit(EXIT_FAILURE);
 	    }
-	    if ( !(d_az = CALLOC(num_rays, sizeof(double))) ) {
+	    if ( !(d_az = ARENA_CALLOC(&swp, num_rays, sizeof(double))) ) {
 		fprintf(stderr, "%s: could not allocate memory for ray "
 			"azimuth low limits for %d rays.\n", argv0, num_rays);
 		exit(EXIT_FAILURE);
@@ -276,7 +303,7 @@ int main(int argc, char *argv[])
 			"once.\n", argv0);
 		exit(EXIT_FAILURE);
 	    }
-	    if ( !(d_el = CALLOC(num_rays, sizeof(double))) ) {
+	    if ( !(d_el = ARENA_CALLOC(&swp, num_rays, sizeof(double))) ) {
 		fprintf(stderr, "%s: could not allocate memory for ray "
 			"elevation low limits for %d rays.\n", argv0, num_rays);
 		exit(EXIT_FAILURE);
@@ -300,7 +327,7 @@ int main(int argc, char *argv[])
 			"once.\n", argv0);
 		exit(EXIT_FAILURE);
 	    }
-	    if ( !(el = CALLOC(num_rays, sizeof(double))) ) {
+	    if ( !(el = ARENA_CALLOC(&swp, num_rays, sizeof(double))) ) {
 		fprintf(stderr, "%s: could not allocate memory for ray "
 			"elevation low limits for %d rays.\n", argv0, num_rays);
 		exit(EXIT_FAILURE);
@@ -333,7 +360,8 @@ int main(int argc, char *argv[])
 			argv0);
 		exit(EXIT_FAILURE);
 	    }
-	    if ( !(gate_dist = CALLOC(num_gates + 1, sizeof(double))) ) {
+	    gate_dist = ARENA_CALLOC(&swp, num_gates + 1, sizeof(double));
+	    if ( !gate_dist ) {
 		fprintf(stderr, "%s: could not allocate memory for gate "
 			"distances for %d gates.\n", argv0, num_gates);
 		exit(EXIT_FAILURE);
@@ -360,7 +388,7 @@ int main(int argc, char *argv[])
 			"known.\n", argv0);
 		exit(EXIT_FAILURE);
 	    }
-	    if ( !(dat = calloc2f(num_rays, num_gates)) ) {
+	    if ( !(dat = calloc2f(&swp, num_rays, num_gates)) ) {
 		fprintf(stderr, "%s: could not allocate memory for input "
 			"data values for %d rays and %d gates.\n",
 			argv0, num_rays, num_gates);
@@ -380,6 +408,43 @@ int main(int argc, char *argv[])
 		    }
 		}
 	    }
+	} else if ( strcmp(key, "ray_range:") == 0 ) {
+	    if ( scanf(" %d %d", &mom_ray0, &mom_num_rays) != 2 ) {
+		fprintf(stderr, "%s: could not read ray range.\n", argv0);
+		exit(EXIT_FAILURE);
+	    }
+	    if ( mom_ray0 < 0 || mom_num_rays < 2 ) {
+		fprintf(stderr, "%s: ray range must start at a non-negative "
+			"index and have at least two rays.\n", argv0);
+		exit(EXIT_FAILURE);
+	    }
+	} else if ( strcmp(key, "moment_file:") == 0 ) {
+	    char mom_fl_nm[LEN];	/* Moment file path */
+	    char mom_nm[LEN];		/* Moment name */
+
+	    if ( scanf(" %" LEN_S "s %" LEN_S "s", mom_fl_nm, mom_nm) != 2 ) {
+		fprintf(stderr, "%s: could not read moment file path and "
+			"moment name.\n", argv0);
+		exit(EXIT_FAILURE);
+	    }
+	    if ( az || el || gate_dist || dat ) {
+		fprintf(stderr, "%s: moment file given after sweep geometry or "
+			"data.\n", argv0);
+		exit(EXIT_FAILURE);
+	    }
+	    dat = read_mom_file(&swp, mom_fl_nm, mom_nm, mom_ray0,
+		    mom_num_rays, &num_rays, &num_gates, &az,
+		    &el, &gate_dist, scan_type_s, &radar_lon, &radar_lat);
+	    if ( !dat ) {
+		fprintf(stderr, "%s: could not read %s from moment file %s.\n",
+			argv0, mom_nm, mom_fl_nm);
+		exit(EXIT_FAILURE);
+	    }
+	    if ( strcmp(scan_type_s, "PPI") == 0 ) {
+		scan_type = PPI;
+	    } else if ( strcmp(scan_type_s, "RHI") == 0 ) {
+		scan_type = RHI;
+	    }
 	} else {
 	    fprintf(stderr, "%s: unknown key word %s\n", argv0, key);
 	    exit(EXIT_FAILURE);
@@ -417,6 +482,7 @@ int main(int argc, char *argv[])
 	fprintf(stderr, "%s: no data.\n", argv0);
 	exit(EXIT_FAILURE);
     }
+    RaXPol_Prof_Stop("input", t0, num_rays * num_gates);
     if ( isnan(GeogREarth(NULL)) || GeogREarth(NULL) == 0.0 ) {
 	fprintf(stderr, "%s: Earth radius not set.\n", argv0);
 	exit(EXIT_FAILURE);
@@ -446,12 +512,16 @@ int main(int argc, char *argv[])
     }
 
     /* Print outlines of gates for each color. Skip TRANSPARENT color. */ 
-    lists = CALLOC((size_t)(num_bnds + num_rays * num_gates), sizeof(int));
+    lists = ARENA_CALLOC(&swp, (size_t)(num_bnds + num_rays * num_gates),
+	    sizeof(int));
     if ( !lists ) {
 	fprintf(stderr, "%s: could not allocate color lists.\n", argv0);
 	exit(EXIT_FAILURE);
     }
+    t0 = RaXPol_Prof_Start();
     BiSearch_FDataToList(dat[0], num_rays * num_gates, dbnds, num_bnds, lists);
+    RaXPol_Prof_Stop("color_lists", t0, num_rays * num_gates);
+    t0 = RaXPol_Prof_Start();
     for (c = 0; c < num_colors; c++) {
 	if ( BiSearch_1stIndex(lists, c) != -1
 		&& strcmp(colors[c], TRANSPARENT) != 0 ) {
@@ -484,16 +554,12 @@ int main(int argc, char *argv[])
 	    }
 	}
     }
+    RaXPol_Prof_Stop("output", t0, num_rays * num_gates);
 
     /* Clean up and exit */ 
-    free(az);
-    free(d_az);
-    free(el);
-    free(d_el);
-    free2f(dat);
+    ARENA_FREE(&swp);
     FREE(colors);
     FREE(dbnds);
-    FREE(lists);
     return 0;
 }
 
@@ -661,13 +727,119 @@ static struct GateCoords rhi_gate_corners(int r, int g, int num_rays,
     return corners;
 }
 
+/*
+   Read moment mom_nm for num_rays rays starting at RaXPol file ray index ray0
+   in moment file mom_fl_nm. If num_rays is -1, read all rays in the moment
+   file. Return the values in an array allocated with calloc2f, and put sweep
+   geometry, also allocated from arena swp_p, at the other arguments, in the
+   units used in main. Angles are in radians. If
+   scan_type_s is "", set it from the moment file. If radar_lon_p or
+   radar_lat_p point to NAN, set them from the first ray.
+
+   Return NULL on failure.
+ */
+
+static float **read_mom_file(struct Tkx_Arena *swp_p, char *mom_fl_nm,
+	char *mom_nm, int ray0, int num_rays, int *num_rays_p,
+	int *num_gates_p, double **az_p, double **el_p, double **gate_dist_p,
+	char *scan_type_s, double *radar_lon_p, double *radar_lat_p)
+{
+    int fd;
+    struct RaXPol_Mom_Hdr hdr;
+    struct RaXPol_Mom_Ray *rays = NULL;
+    int m;				/* Moment index */
+    int r, g;				/* Ray, gate index */
+    double *az, *el, *gate_dist;
+    float **dat;
+
+    if ( (fd = open(mom_fl_nm, O_RDONLY)) == -1 ) {
+	fprintf(stderr, "Could not open moment file %s.\n", mom_fl_nm);
+	return NULL;
+    }
+    if ( !RaXPol_Mom_Read_Hdr(&hdr, fd) ) {
+	goto error;
+    }
+    if ( (m = RaXPol_Mom_Fld_Idx(&hdr, mom_nm)) == -1 ) {
+	fprintf(stderr, "Moment file %s does not have %s.\n",
+		mom_fl_nm, mom_nm);
+	goto error;
+    }
+    if ( num_rays == -1 ) {
+	ray0 = 0;
+	num_rays = hdr.num_rays;
+    } else {
+	ray0 -= hdr.r0;
+	if ( ray0 < 0 || ray0 + num_rays > hdr.num_rays ) {
+	    fprintf(stderr, "Moment file %s does not have rays %d through "
+		    "%d.\n", mom_fl_nm, ray0 + hdr.r0,
+		    ray0 + hdr.r0 + num_rays - 1);
+	    goto error;
+	}
+    }
+    if ( num_rays < 2 || hdr.num_gates < 2 ) {
+	fprintf(stderr, "Moment file %s has too few rays or gates.\n",
+		mom_fl_nm);
+	goto error;
+    }
+    rays = CALLOC(num_rays, sizeof(struct RaXPol_Mom_Ray));
+    az = ARENA_CALLOC(swp_p, num_rays, sizeof(double));
+    el = ARENA_CALLOC(swp_p, num_rays, sizeof(double));
+    gate_dist = ARENA_CALLOC(swp_p, hdr.num_gates + 1, sizeof(double));
+    if ( !rays || !az || !el || !gate_dist ) {
+	fprintf(stderr, "Could not allocate sweep geometry for moment file "
+		"%s.\n", mom_fl_nm);
+	goto error;
+    }
+    if ( !(dat = calloc2f(swp_p, num_rays, hdr.num_gates)) ) {
+	goto error;
+    }
+    if ( !RaXPol_Mom_Read_Rays(&hdr, fd, ray0, num_rays, rays)
+	    || !RaXPol_Mom_Read_Fld(&hdr, fd, m, ray0, num_rays, dat[0]) ) {
+	goto error;
+    }
+    for (r = 0; r < num_rays; r++) {
+	az[r] = rays[r].az * RAD_DEG;
+	el[r] = rays[r].el * RAD_DEG;
+    }
+    for (g = 0; g <= hdr.num_gates; g++) {
+	gate_dist[g] = g * hdr.gate_spacing;
+    }
+    if ( strlen(scan_type_s) == 0 ) {
+	if ( hdr.scan_type == RAXPOL_PPI ) {
+	    strcpy(scan_type_s, "PPI");
+	} else if ( hdr.scan_type == RAXPOL_RHI ) {
+	    strcpy(scan_type_s, "RHI");
+	}
+    }
+    if ( isnan(*radar_lon_p) ) {
+	*radar_lon_p = rays[0].lon * RAD_DEG;
+    }
+    if ( isnan(*radar_lat_p) ) {
+	*radar_lat_p = rays[0].lat * RAD_DEG;
+    }
+    close(fd);
+    FREE(rays);
+    *num_rays_p = num_rays;
+    *num_gates_p = hdr.num_gates;
+    *az_p = az;
+    *el_p = el;
+    *gate_dist_p = gate_dist;
+    return dat;
+
+error:
+    close(fd);
+    FREE(rays);
+    return NULL;
+}
+
 static int is_point(struct Point p)
 {
     return isfinite(p.x + p.y);
 }
 
-/* Allocate a 2 dimensional array of floats, initialized to NAN */
-static float ** calloc2f(long j, long i)
+/* Allocate a 2 dimensional array of floats from arena swp_p, initialized
+   to NAN. The array goes away with the arena. */
+static float ** calloc2f(struct Tkx_Arena *swp_p, long j, long i)
 {
     float **dat = NULL, *dat_p;
     long n;
@@ -688,15 +860,14 @@ static float ** calloc2f(long j, long i)
 	return NULL;
     }
 
-    dat = (float **)CALLOC(jj + 2, sizeof(float *));
+    dat = (float **)ARENA_CALLOC(swp_p, jj + 2, sizeof(float *));
     if ( !dat ) {
 	fprintf(stderr, "Could not allocate memory for 1st dimension of "
 		"two dimensional array.\n");
 	return NULL;
     }
-    dat[0] = (float *)CALLOC(ji, sizeof(float));
+    dat[0] = (float *)ARENA_ALLOC(swp_p, ji * sizeof(float));
     if ( !dat[0] ) {
-	FREE(dat);
 	fprintf(stderr, "Could not allocate memory for values "
 		"of two dimensional array.\n");
 	return NULL;
@@ -710,12 +881,3 @@ static float ** calloc2f(long j, long i)
     return dat;
 }
 
-/* Free memory allocated with calloc2f */
-static void free2f(float **dat)
-{
-    if (dat && dat[0]) {
-	FREE(dat[0]);
-    }
-    FREE(dat);
-}
-
@@ -0,0 +1,132 @@
+#ifndef TYPE_NBIT_H_
+#define TYPE_NBIT_H_
+
+/*
+   I8BIT => 8 bit integer.
+   U8BIT => 8 bit unsigned integer
+   I16BIT => 16 bit integer.
+   U16BIT => 16 bit unsigned integer
+   I32BIT => 32 bit integer.
+   U32BIT => 32 bit unsigned integer
+   I64BIT => 64 bit integer (if any).
+   U64BIT => 64 bit unsigned integer (if any)
+   F32BIT => 32 bit floating point type
+   F64BIT => 64 bit floating point type
+ */
+
+#ifndef TYPE_NBIT_I8BIT
+#define TYPE_NBIT_I8BIT
+typedef char I8BIT;
+#endif
+#ifndef TYPE_NBIT_U8BIT
+#define TYPE_NBIT_U8BIT
+typedef unsigned char U8BIT;
+#endif
+#ifndef TYPE_NBIT_I16BIT
+#define TYPE_NBIT_I16BIT
+typedef short I16BIT;
+#endif
+#ifndef TYPE_NBIT_U16BIT
+#define TYPE_NBIT_U16BIT
+typedef unsigned short U16BIT;
+#endif
+#ifndef TYPE_NBIT_I32BIT
+#define TYPE_NBIT_I32BIT
+typedef int I32BIT;
+#endif
+#ifndef TYPE_NBIT_U32BIT
+#define TYPE_NBIT_U32BIT
+typedef unsigned int U32BIT;
+#endif
+#ifndef TYPE_NBIT_I64BIT
+#define TYPE_NBIT_I64BIT
+typedef long I64BIT;
+#endif
+#ifndef TYPE_NBIT_U64BIT
+#define TYPE_NBIT_U64BIT
+typedef unsigned long U64BIT;
+#endif
+#ifndef TYPE_NBIT_F32BIT
+#define TYPE_NBIT_F32BIT
+typedef float F32BIT;
+#endif
+#ifndef TYPE_NBIT_F64BIT
+#define TYPE_NBIT_F64BIT
+typedef double F64BIT;
+#endif
+
+/*
+   I1BYT => 1 byte integer.
+   U1BYT => 1 byte unsigned integer
+   I2BYT => 2 byte integer.
+   U2BYT => 2 byte unsigned integer
+   I4BYT => 4 byte integer.
+   U4BYT => 4 byte unsigned integer
+   I1BYT => 1 byte integer (if any).
+   U1BYT => 1 byte unsigned integer (if any)
+   F4BYT => 4 byte floating point type
+   F1BYT => 1 byte floating point type
+ */
+
+#ifndef TYPE_NBYT_I1BYT
+#define TYPE_NBYT_I1BYT
+typedef char I1BYT;
+#endif
+#ifndef TYPE_NBYT_U1BYT
+#define TYPE_NBYT_U1BYT
+typedef unsigned char U1BYT;
+#endif
+#ifndef TYPE_NBYT_I2BYT
+#define TYPE_NBYT_I2BYT
+typedef short I2BYT;
+#endif
+#ifndef TYPE_NBYT_U2BYT
+#define TYPE_NBYT_U2BYT
+typedef unsigned short U2BYT;
+#endif
+#ifndef TYPE_NBYT_I4BYT
+#define TYPE_NBYT_I4BYT
+typedef int I4BYT;
+#endif
+#ifndef TYPE_NBYT_U4BYT
+#define TYPE_NBYT_U4BYT
+typedef unsigned int U4BYT;
+#endif
+#ifndef TYPE_NBYT_I8BYT
+#define TYPE_NBYT_I8BYT
+typedef long I8BYT;
+#endif
+#ifndef TYPE_NBYT_U8BYT
+#define TYPE_NBYT_U8BYT
+typedef unsigned long U8BYT;
+#endif
+#ifndef TYPE_NBYT_F4BYT
+#define TYPE_NBYT_F4BYT
+typedef float F4BYT;
+#endif
+#ifndef TYPE_NBYT_F8BYT
+#define TYPE_NBYT_F8BYT
+typedef double F8BYT;
+#endif
+
+/* Byte swapping macros. */
+#define B0 0XFF
+#define B1 0XFF00
+#define B2 0XFF0000
+#define B3 0XFF000000
+#define B4 0XFF00000000
+#define B5 0XFF0000000000
+#define B6 0XFF000000000000
+#define B7 0XFF00000000000000
+#define SWAP2BYT(s) \
+        ((((U2BYT)s & B0) << 8) | (((U2BYT)s & B1) >> 8))
+#define SWAP4BYT(i) \
+        ((((U4BYT)i & B0) << 24) | (((U4BYT)i & B1) << 8) \
+        | (((U4BYT)i & B2) >> 8) | (((U4BYT)i & B3) >> 24))
+#define SWAP16BIT(s) \
+        ((((U16BIT)s & 0xFF) << 8) | (((U16BIT)s & 0xFF00) >> 8))
+#define SWAP32BIT(i) \
+        ((((U32BIT)i & 0xFF) << 24) | (((U32BIT)i & 0xFF00) << 8) \
+        | (((U32BIT)i & 0xFF0000) >> 8) | (((U32BIT)i & 0xFF000000) >> 24))
+
+#endif